@@ -50,12 +50,27 @@ public class OpenAIAPI : ModuleRules
 				"AudioCaptureCore",
 				"SlateCore",
 				"Json",
-				"HTTP"
+				"HTTP",
+				"ImageWrapper",
+				"ImageCore"
 				// ... add private dependencies that you statically link with here ...
 			}
 			);
 
 
+		// Opus for relaying Realtime session audio between machines
+		bool bWithOpus = Target.Platform == UnrealTargetPlatform.Win64 ||
+			Target.Platform == UnrealTargetPlatform.Mac ||
+			Target.IsInPlatformGroup(UnrealPlatformGroup.Unix) ||
+			Target.Platform == UnrealTargetPlatform.Android ||
+			Target.Platform == UnrealTargetPlatform.IOS;
+		if (bWithOpus)
+		{
+			AddEngineThirdPartyPrivateStaticDependencies(Target, "libOpus");
+		}
+		PublicDefinitions.Add("WITH_OPENAI_OPUS=" + (bWithOpus ? "1" : "0"));
+
+
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
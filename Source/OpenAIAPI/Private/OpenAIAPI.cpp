@@ -1,18 +1,25 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "OpenAIAPI.h"
+#include "OpenAIRealtimeSessionManager.h"
+#include "OpenAITokenizer.h"
 
 #define LOCTEXT_NAMESPACE "FOpenAIAPIModule"
 
 void FOpenAIAPIModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+
+	// Merge tables are indexed off the game thread, so the first chat request does not hitch
+	FOpenAITokenizer::Preload(EOATokenizerEncoding::CL100K_BASE);
+	FOpenAITokenizer::Preload(EOATokenizerEncoding::O200K_BASE);
 }
 
 void FOpenAIAPIModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FOpenAIRealtimeSessionManager::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
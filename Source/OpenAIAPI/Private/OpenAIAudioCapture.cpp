@@ -1,5 +1,6 @@
 #include "OpenAIAudioCapture.h"
 #include "Kismet/GameplayStatics.h"
+#include "Async/Async.h"
 #include <mmdeviceapi.h>
 #include <Audioclient.h>
 #include <Functiondiscoverykeys_devpkey.h>
@@ -11,6 +12,7 @@ UOpenAIAudioCapture::UOpenAIAudioCapture()
     AudioCapture = nullptr;
     bIsCapturing = false;
     bAutoActivate = true;
+    CaptureBuffer.Init(MinCaptureBufferCapacity);
     UE_LOG(LogTemp, Log, TEXT("UOpenAIAudioCapture constructor called"));
 }
 
@@ -27,22 +29,149 @@ UOpenAIAudioCapture::UOpenAIAudioCapture()
 //}
 
 
-void UOpenAIAudioCapture::ProcessAndBroadcastBuffer()
+void UOpenAIAudioCapture::ProcessAndBroadcastBuffer(bool bFlush)
 {
-    TArray<float> BufferCopy;
+    FScopeLock Lock(&Consumer->Lock);
+
+    const int32 Chunk = FMath::Max(1, ChunkSamples.load(std::memory_order_relaxed));
+    const uint64 RequestCycles = DrainRequestCycles.exchange(0);
+    bool bDelivered = false;
+
+    // Deliver whole chunks only, so listeners see a fixed frame size regardless of callback size
+    for (;;)
     {
-        if (AudioBuffer.Num() > 0)
+        const int32 NumAvailable = CaptureBuffer.NumAvailable();
+        const int32 NumToSend = NumAvailable >= Chunk ? Chunk : (bFlush ? NumAvailable : 0);
+        if (NumToSend == 0)
+        {
+            break;
+        }
+
+        TArrayView<const float> Samples = CaptureBuffer.Peek(NumToSend, ReadScratch);
+
+        // Native listeners read straight out of the ring buffer
+        OnAudioSamplesCaptured.Broadcast(Samples);
+
+        // Blueprint listeners need an owned array on the game thread
+        if (OnAudioBufferCaptured.IsBound())
+        {
+            TArray<float> BufferCopy(Samples.GetData(), Samples.Num());
+            TWeakObjectPtr<UOpenAIAudioCapture> WeakThis(this);
+            AsyncTask(ENamedThreads::GameThread, [WeakThis, BufferCopy = MoveTemp(BufferCopy)]()
+            {
+                if (UOpenAIAudioCapture* This = WeakThis.Get())
+                {
+                    This->OnAudioBufferCaptured.Broadcast(BufferCopy);
+                }
+            });
+        }
+
+        CaptureBuffer.Consume(Samples.Num());
+        ChunksEmitted++;
+        bDelivered = true;
+    }
+
+    if (bDelivered && RequestCycles != 0)
+    {
+        const float LatencyMs = (float)FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - RequestCycles);
+        TotalDispatchLatencyMs += LatencyMs;
+        NumDispatches++;
+        MaxDispatchLatencyMs = FMath::Max(MaxDispatchLatencyMs, LatencyMs);
+    }
+}
+
+void UOpenAIAudioCapture::ScheduleDrain()
+{
+    // Only one drain task in flight; the capture callback itself never blocks on consumers
+    if (bDrainPending.exchange(true))
+    {
+        return;
+    }
+
+    DrainRequestCycles = FPlatformTime::Cycles64();
+
+    // Weak pointers cannot be resolved off the game thread; the shared state says whether this is
+    // still alive, and BeginDestroy waits on its lock for a drain in progress
+    AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [this, State = Consumer]()
+    {
+        FScopeLock Lock(&State->Lock);
+        if (!State->bAlive)
+        {
+            return;
+        }
+
+        ProcessAndBroadcastBuffer();
+        bDrainPending = false;
+
+        // A chunk may have completed while we were delivering
+        if (CaptureBuffer.NumAvailable() >= ChunkSamples.load(std::memory_order_relaxed))
         {
-            BufferCopy = AudioBuffer;
-            AudioBuffer.Empty();
+            ScheduleDrain();
         }
+    });
+}
+
+FDelegateHandle UOpenAIAudioCapture::AddSamplesListener(FOnAudioSamplesCaptured::FDelegate&& Listener)
+{
+    FScopeLock Lock(&Consumer->Lock);
+    return OnAudioSamplesCaptured.Add(MoveTemp(Listener));
+}
+
+void UOpenAIAudioCapture::RemoveSamplesListener(FDelegateHandle Handle)
+{
+    FScopeLock Lock(&Consumer->Lock);
+    OnAudioSamplesCaptured.Remove(Handle);
+}
+
+void UOpenAIAudioCapture::BeginDestroy()
+{
+    {
+        FScopeLock Lock(&Consumer->Lock);
+        Consumer->bAlive = false;
+        OnAudioSamplesCaptured.Clear();
     }
+    Super::BeginDestroy();
+}
 
-    if (BufferCopy.Num() > 0)
+void UOpenAIAudioCapture::SetChunkDurationMs(int32 DurationMs)
+{
+    ChunkDurationMs = FMath::Clamp(DurationMs, 10, 10000);
+    int32 NewChunkSamples = (int32)(((int64)TargetSampleRate * ChunkDurationMs) / 1000);
+
+    // Keep room for a few chunks so a late drain does not overrun
+    const int32 RequiredCapacity = FMath::Max(MinCaptureBufferCapacity, NewChunkSamples * 4);
+    if (CaptureBuffer.GetCapacity() < RequiredCapacity)
     {
-        // Broadcast the captured audio data
-        OnAudioBufferCaptured.Broadcast(BufferCopy);
+        if (bIsCapturing)
+        {
+            // The ring cannot be resized under the capture callback
+            NewChunkSamples = CaptureBuffer.GetCapacity() / 4;
+            UE_LOG(LogTemp, Warning, TEXT("Chunk of %d ms does not fit while capturing, using %d samples until capture restarts"), ChunkDurationMs, NewChunkSamples);
+        }
+        else
+        {
+            FScopeLock Lock(&Consumer->Lock);
+            CaptureBuffer.Init(RequiredCapacity);
+        }
     }
+
+    ChunkSamples = NewChunkSamples;
+    UE_LOG(LogTemp, Log, TEXT("Audio chunk size set to %d ms (%d samples)"), ChunkDurationMs, NewChunkSamples);
+}
+
+FOpenAIAudioCaptureStats UOpenAIAudioCapture::GetCaptureStats() const
+{
+    FOpenAIAudioCaptureStats Stats;
+    Stats.TotalSamples = (int64)CaptureBuffer.GetTotalWritten();
+    Stats.OverrunSamples = (int64)CaptureBuffer.GetOverrunSamples();
+    Stats.OverrunEvents = (int64)CaptureBuffer.GetOverrunEvents();
+    Stats.HighWaterMark = CaptureBuffer.GetHighWaterMark();
+    Stats.Capacity = CaptureBuffer.GetCapacity();
+    Stats.ChunksEmitted = ChunksEmitted;
+    Stats.ChunkSamples = ChunkSamples.load(std::memory_order_relaxed);
+    Stats.AverageDispatchLatencyMs = NumDispatches > 0 ? (float)(TotalDispatchLatencyMs / NumDispatches) : 0.0f;
+    Stats.MaxDispatchLatencyMs = MaxDispatchLatencyMs;
+    return Stats;
 }
 
 FString UOpenAIAudioCapture::GetDefaultInputDeviceName()
@@ -110,6 +239,8 @@ void UOpenAIAudioCapture::Activate(bool bReset)
             });
 
             AudioCapture->OpenDefaultAudioStream();
+            InitResampler();
+            SetChunkDurationMs(ChunkDurationMs);
             StartCapturing();
             UE_LOG(LogTemp, Log, TEXT("-------------------> AudioCapture started from Activate on GameThread"));
         }
@@ -122,12 +253,52 @@ void UOpenAIAudioCapture::Activate(bool bReset)
     }
 }
 
+bool UOpenAIAudioCapture::InitResampler()
+{
+    if (!AudioCapture)
+    {
+        return false;
+    }
+
+    // Read the real device format instead of assuming 48 kHz stereo
+    int32 InputSampleRate = AudioCapture->GetSampleRate();
+    int32 InputNumChannels = AudioCapture->GetNumChannels();
+
+    FAudioCaptureDeviceInfo DeviceInfo;
+    if (AudioCapture->GetAudioCaptureDeviceInfo(DeviceInfo))
+    {
+        InputSampleRate = DeviceInfo.SampleRate;
+        InputNumChannels = DeviceInfo.NumInputChannels;
+        UE_LOG(LogTemp, Log, TEXT("Capture device %s: %d Hz, %d channels"), *DeviceInfo.DeviceName.ToString(), InputSampleRate, InputNumChannels);
+    }
+
+    if (!Resampler.Init(InputSampleRate, InputNumChannels, TargetSampleRate, MaxCallbackFrames))
+    {
+        return false;
+    }
+
+    ResampleScratch.SetNumUninitialized(Resampler.GetMaxOutputFrames(MaxCallbackFrames));
+    return true;
+}
+
 void UOpenAIAudioCapture::StartCapturing()
 {
     if (AudioCapture && !bIsCapturing)
     {
         if (AudioCapture) {
             UE_LOG(LogTemp, Log, TEXT("AudioCapture is valid"));
+            if (!Resampler.IsInitialized() && !InitResampler())
+            {
+                UE_LOG(LogTemp, Error, TEXT("Capture device format is not supported"));
+                return;
+            }
+            Resampler.Reset();
+            // Applies a chunk size that did not fit the ring while capturing
+            SetChunkDurationMs(ChunkDurationMs);
+            {
+                FScopeLock Lock(&Consumer->Lock);
+                CaptureBuffer.Reset();
+            }
             AudioCapture->StartCapturingAudio();
             bIsCapturing = true;
             UE_LOG(LogTemp, Log, TEXT("Audio capture started successfully"));
@@ -147,7 +318,7 @@ void UOpenAIAudioCapture::StopCapturing()
         UE_LOG(LogTemp, Log, TEXT("AudioCapture is valid"));
         AudioCapture->StopCapturingAudio();
          bIsCapturing = false;
-         ProcessAndBroadcastBuffer(); // Broadcast any remaining data
+         ProcessAndBroadcastBuffer(true); // Broadcast any remaining data
 
         UE_LOG(LogTemp, Log, TEXT("Audio capture stopped successfully"));
     }
@@ -171,136 +342,30 @@ void UOpenAIAudioCapture::DestroyAudioCapture() {
 
 void UOpenAIAudioCapture::OnAudioGenerate(const float* InAudio, int32 NumSamples)
 {
-    
     if (InAudio && bIsCapturing)
     {
-        const int32 TargetSampleRate = 24000; // Target sample rate
-        const int32 InputSampleRate = 48000; // Assuming the input sample rate is 48000 Hz
-        const int32 DownsampleFactor = InputSampleRate / TargetSampleRate; // Calculate downsample factor
-        const int32 LocalNumChannels = 2; // Assuming stereo input
-        const int32 SamplesPerChannel = NumSamples / LocalNumChannels;
-        const int32 DownsampledSamples = SamplesPerChannel / DownsampleFactor;
-
-        // Process samples in stereo pairs and downsample
-        for (int32 i = 0; i < DownsampledSamples; i++)
+        // Set up in Activate and StartCapturing; building the filter bank here would stall the audio thread
+        if (!Resampler.IsInitialized())
         {
-            // Calculate source index in original buffer
-            int32 srcIdx = i * DownsampleFactor * LocalNumChannels;
-
-            // Average the left and right channels for mono conversion
-            float monoSample = 0.0f;
-            for (int32 j = 0; j < DownsampleFactor; j++)
-            {
-                // Get left and right channel samples
-                float leftSample = InAudio[srcIdx + (j * LocalNumChannels)];
-                float rightSample = InAudio[srcIdx + (j * LocalNumChannels) + 1];
-
-                // Average the channels
-                monoSample += (leftSample + rightSample) * 0.5f;
-            }
-
-            // Average the downsampled values
-            monoSample /= DownsampleFactor;
-
-            // Add the mono sample to the buffer
-            AudioBuffer.Add(monoSample);
+            return;
         }
 
-        // Check if we should broadcast the buffer
-        double CurrentTime = FPlatformTime::Seconds();
-        if (CurrentTime - LastBroadcastTime >= MaxBufferTime || AudioBuffer.Num() >= MaxBufferSize)
-        {
-            ProcessAndBroadcastBuffer();
-            LastBroadcastTime = CurrentTime;
-        }
-    }
-    
-    /*
-    if (InAudio && bIsCapturing)
-    {
-        const int32 DownsampleFactor = 2; // Downsample by factor of 2 (e.g., 48kHz -> 24kHz)
-        const int32 LocalNumChannels = 2; // Assuming stereo input
-        const int32 SamplesPerChannel = NumSamples / LocalNumChannels;
-        const int32 DownsampledSamples = SamplesPerChannel / DownsampleFactor;
+        // NumSamples counts interleaved samples across all device channels
+        const int32 NumChannels = Resampler.GetInputNumChannels();
+        const int32 NumFrames = NumSamples / NumChannels;
 
-        // Process samples in stereo pairs and downsample
-        for (int32 i = 0; i < DownsampledSamples; i++)
+        // In blocks the scratch was sized for, so the audio thread never allocates
+        for (int32 Frame = 0; Frame < NumFrames; Frame += MaxCallbackFrames)
         {
-            // Calculate source index in original buffer
-            int32 srcIdx = i * DownsampleFactor * LocalNumChannels;
-
-            // Average the left and right channels for mono conversion
-            float monoSample = 0.0f;
-            for (int32 j = 0; j < DownsampleFactor; j++)
-            {
-                // Get left and right channel samples
-                float leftSample = InAudio[srcIdx + (j * LocalNumChannels)];
-                float rightSample = InAudio[srcIdx + (j * LocalNumChannels) + 1];
-
-                // Average the channels
-                monoSample += (leftSample + rightSample) * 0.5f;
-            }
-
-            // Average the downsampled values
-            monoSample /= DownsampleFactor;
-
-            // Add the mono sample to the buffer
-            AudioBuffer.Add(monoSample);
+            const int32 BlockFrames = FMath::Min(MaxCallbackFrames, NumFrames - Frame);
+            const int32 NumOutputSamples = Resampler.Process(InAudio + (int64)Frame * NumChannels, BlockFrames, ResampleScratch.GetData(), ResampleScratch.Num());
+            CaptureBuffer.Write(ResampleScratch.GetData(), NumOutputSamples);
         }
 
-        // Check if we should broadcast the buffer
-        double CurrentTime = FPlatformTime::Seconds();
-        if (CurrentTime - LastBroadcastTime >= MaxBufferTime || AudioBuffer.Num() >= MaxBufferSize)
+        // Flush on sample count, so chunk boundaries do not depend on callback timing
+        if (CaptureBuffer.NumAvailable() >= ChunkSamples.load(std::memory_order_relaxed))
         {
-            ProcessAndBroadcastBuffer();
-            LastBroadcastTime = CurrentTime;
+            ScheduleDrain();
         }
     }
-    */
 }
-
-
-    /*
-    if (InAudio) {
-        if (bIsCapturing)
-        {
-            const int32 DownsampleFactor = 2; // Factor by which to downsample
-            const int32 InterpolatedSamples = NumSamples / DownsampleFactor;
-    
-            for (int32 i = 0; i < InterpolatedSamples - 1; i++)
-            {
-               // Indices for original samples
-                int32 index1 = i * DownsampleFactor;
-                int32 index2 = index1 + DownsampleFactor;
-
-                // Boundary check to prevent accessing out-of-range samples
-                if (index2 >= NumSamples)
-                {
-                    // Handle the last sample if NumSamples is not perfectly divisible
-                    index2 = NumSamples - 1;
-                }
-
-                // Original sample values
-                float sample1 = InAudio[index1];
-                float sample2 = InAudio[index2];
-
-                // Calculate the interpolated sample using linear interpolation
-                float interpolatedSample = sample1 + ((sample2 - sample1) * 0.5f);
-
-                // Add the interpolated sample to the AudioBuffer
-                AudioBuffer.Add(interpolatedSample);
-            }
-            double CurrentTime = FPlatformTime::Seconds();
-            if (CurrentTime - LastBroadcastTime >= MaxBufferTime || AudioBuffer.Num() >= MaxBufferSize)
-            {
-                ProcessAndBroadcastBuffer();
-                LastBroadcastTime = CurrentTime;
-            }
-
-        } else {
-            UE_LOG(LogTemp, Log, TEXT("bIsCapturing is false"));
-        }
-    } else {
-        UE_LOG(LogTemp, Log, TEXT("InAudio is null"));
-    }
-    */
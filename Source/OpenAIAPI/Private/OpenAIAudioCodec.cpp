@@ -0,0 +1,1264 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIAudioCodec.h"
+#include "Async/Async.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/SecureHash.h"
+
+#if !UE_BUILD_SHIPPING
+#include "Audio.h"
+#include "Misc/FileHelper.h"
+#include "HAL/IConsoleManager.h"
+#endif
+
+#if WITH_OPENAI_OPUS
+THIRD_PARTY_INCLUDES_START
+#include "opus.h"
+THIRD_PARTY_INCLUDES_END
+#endif
+
+namespace
+{
+	FORCEINLINE int16 FloatToInt16(float Sample)
+	{
+		return (int16)(FMath::Clamp(Sample, -1.0f, 1.0f) * 32767.0f);
+	}
+
+	// Decoding is a table lookup, the tables are filled on first use
+	struct FG711DecodeTables
+	{
+		int16 ULaw[256];
+		int16 ALaw[256];
+
+		FG711DecodeTables()
+		{
+			for (int32 Code = 0; Code < 256; Code++)
+			{
+				ULaw[Code] = FOpenAIG711::ULawToLinear((uint8)Code);
+				ALaw[Code] = FOpenAIG711::ALawToLinear((uint8)Code);
+			}
+		}
+	};
+
+	const FG711DecodeTables& GetG711DecodeTables()
+	{
+		static const FG711DecodeTables Tables;
+		return Tables;
+	}
+}
+
+void OpenAIAudioCodec::FloatToPCM16(const float* Samples, int32 Num, TArray<uint8>& OutBytes)
+{
+	const int32 Start = OutBytes.Num();
+	OutBytes.AddUninitialized(Num * sizeof(int16));
+	uint8* Out = OutBytes.GetData() + Start;
+
+	for (int32 i = 0; i < Num; i++)
+	{
+		const int16 IntSample = FloatToInt16(Samples[i]);
+		Out[i * 2] = IntSample & 0xFF;
+		Out[i * 2 + 1] = (IntSample >> 8) & 0xFF;
+	}
+}
+
+void OpenAIAudioCodec::PCM16ToFloat(TArrayView<const uint8> Bytes, TArray<float>& OutSamples)
+{
+	const int32 Num = Bytes.Num() / 2;
+	const int32 Start = OutSamples.Num();
+	OutSamples.AddUninitialized(Num);
+	float* Out = OutSamples.GetData() + Start;
+
+	for (int32 i = 0; i < Num; i++)
+	{
+		const int16 IntSample = (int16)(Bytes[i * 2] | (Bytes[i * 2 + 1] << 8));
+		Out[i] = IntSample / 32768.0f;
+	}
+}
+
+void OpenAIAudioCodec::WriteWavHeader(TArray<uint8>& OutBytes, int32 DataBytes, int32 SampleRate, int32 NumChannels, int32 BitsPerSample)
+{
+	const int32 Start = OutBytes.Num();
+	OutBytes.AddUninitialized(44);
+	uint8* Out = OutBytes.GetData() + Start;
+
+	// Written field by field in little endian, independent of struct packing and host byte order
+	auto Write32 = [&Out](uint32 Value)
+	{
+		Out[0] = Value & 0xFF;
+		Out[1] = (Value >> 8) & 0xFF;
+		Out[2] = (Value >> 16) & 0xFF;
+		Out[3] = (Value >> 24) & 0xFF;
+		Out += 4;
+	};
+	auto Write16 = [&Out](uint16 Value)
+	{
+		Out[0] = Value & 0xFF;
+		Out[1] = (Value >> 8) & 0xFF;
+		Out += 2;
+	};
+	auto WriteTag = [&Out](const char* Tag)
+	{
+		FMemory::Memcpy(Out, Tag, 4);
+		Out += 4;
+	};
+
+	const int32 BlockAlign = NumChannels * BitsPerSample / 8;
+	WriteTag("RIFF");
+	Write32(36 + DataBytes);
+	WriteTag("WAVE");
+	WriteTag("fmt ");
+	Write32(16);
+	Write16(1); // PCM
+	Write16((uint16)NumChannels);
+	Write32(SampleRate);
+	Write32(SampleRate * BlockAlign);
+	Write16((uint16)BlockAlign);
+	Write16((uint16)BitsPerSample);
+	WriteTag("data");
+	Write32(DataBytes);
+}
+
+void OpenAIAudioCodec::EncodeWav(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, TArray<uint8>& OutBytes)
+{
+	const int32 DataBytes = Samples.Num() * sizeof(int16);
+	OutBytes.Reserve(OutBytes.Num() + 44 + DataBytes);
+	WriteWavHeader(OutBytes, DataBytes, SampleRate, NumChannels);
+	FloatToPCM16(Samples.GetData(), Samples.Num(), OutBytes);
+}
+
+namespace
+{
+	// FLAC frames carry a CRC-8 and a CRC-16, Ogg pages a CRC-32; all three are MSB first
+	struct FCrcTables
+	{
+		uint8 Crc8[256];
+		uint16 Crc16[256];
+		uint32 Crc32[256];
+
+		FCrcTables()
+		{
+			for (uint32 Byte = 0; Byte < 256; Byte++)
+			{
+				uint32 C8 = Byte;
+				uint32 C16 = Byte << 8;
+				uint32 C32 = Byte << 24;
+				for (int32 Bit = 0; Bit < 8; Bit++)
+				{
+					C8 = (C8 & 0x80) ? (C8 << 1) ^ 0x07 : C8 << 1;
+					C16 = (C16 & 0x8000) ? (C16 << 1) ^ 0x8005 : C16 << 1;
+					C32 = (C32 & 0x80000000) ? (C32 << 1) ^ 0x04C11DB7 : C32 << 1;
+				}
+				Crc8[Byte] = (uint8)C8;
+				Crc16[Byte] = (uint16)C16;
+				Crc32[Byte] = C32;
+			}
+		}
+	};
+
+	const FCrcTables& GetCrcTables()
+	{
+		static const FCrcTables Tables;
+		return Tables;
+	}
+
+	uint8 FlacCrc8(const uint8* Data, int32 Num)
+	{
+		const FCrcTables& Tables = GetCrcTables();
+		uint8 Crc = 0;
+		for (int32 i = 0; i < Num; i++)
+		{
+			Crc = Tables.Crc8[Crc ^ Data[i]];
+		}
+		return Crc;
+	}
+
+	uint16 FlacCrc16(const uint8* Data, int32 Num)
+	{
+		const FCrcTables& Tables = GetCrcTables();
+		uint16 Crc = 0;
+		for (int32 i = 0; i < Num; i++)
+		{
+			Crc = (uint16)((Crc << 8) ^ Tables.Crc16[((Crc >> 8) ^ Data[i]) & 0xFF]);
+		}
+		return Crc;
+	}
+
+	// MSB first bit packing; whole bytes are appended as soon as they are complete
+	class FFlacBitWriter
+	{
+	public:
+		explicit FFlacBitWriter(TArray<uint8>& InOut)
+			: Out(InOut)
+			, Accumulator(0)
+			, NumBits(0)
+		{
+		}
+
+		FORCEINLINE void Write(uint32 Value, int32 Bits)
+		{
+			Accumulator = (Accumulator << Bits) | (Value & ((1ull << Bits) - 1));
+			NumBits += Bits;
+			while (NumBits >= 8)
+			{
+				NumBits -= 8;
+				Out.Add((uint8)(Accumulator >> NumBits));
+			}
+		}
+
+		/** Q zeros, a one, then the low K bits of Value. */
+		FORCEINLINE void WriteRice(uint32 Value, int32 K)
+		{
+			uint32 Quotient = Value >> K;
+			const uint32 Tail = (1u << K) | (Value & ((1u << K) - 1));
+			if (Quotient + K + 1 <= 32)
+			{
+				Write(Tail, Quotient + K + 1);
+				return;
+			}
+			for (; Quotient >= 32; Quotient -= 32)
+			{
+				Write(0, 32);
+			}
+			Write(0, Quotient);
+			Write(Tail, K + 1);
+		}
+
+		void Align()
+		{
+			if (NumBits > 0)
+			{
+				Write(0, 8 - NumBits);
+			}
+		}
+
+	private:
+		TArray<uint8>& Out;
+		uint64 Accumulator;
+		int32 NumBits;
+	};
+
+	constexpr int32 FlacBlockSize = 4096;
+	constexpr int32 FlacMaxFixedOrder = 4;
+	constexpr int32 FlacMaxPartitionOrder = 8;
+	// 15 is the escape code for unencoded partitions
+	constexpr int32 FlacMaxRiceParameter = 14;
+
+	// Rice parameter for Count residuals summing to Sum, and roughly how many bits they take with it
+	int32 ChooseRiceParameter(uint64 Sum, int32 Count, uint64& OutBits)
+	{
+		int32 Best = 0;
+		OutBits = MAX_uint64;
+		for (int32 K = 0; K <= FlacMaxRiceParameter; K++)
+		{
+			const uint64 Bits = (uint64)Count * (K + 1) + (Sum >> K);
+			if (Bits < OutBits)
+			{
+				OutBits = Bits;
+				Best = K;
+			}
+		}
+		return Best;
+	}
+
+	void WriteFlacSubframe(FFlacBitWriter& Writer, const int32* Samples, int32 Num, TArray<uint32>& Folded)
+	{
+		// Subframe header byte: a zero pad bit, six type bits, no wasted bits
+		bool bConstant = true;
+		for (int32 i = 1; i < Num && bConstant; i++)
+		{
+			bConstant = Samples[i] == Samples[0];
+		}
+		if (bConstant)
+		{
+			Writer.Write(0x00, 8);
+			Writer.Write((uint32)Samples[0], 16);
+			return;
+		}
+
+		int32 Order = INDEX_NONE;
+		if (Num > FlacMaxFixedOrder)
+		{
+			// The fixed predictor with the smallest total residual, found from running differences
+			uint64 Sums[FlacMaxFixedOrder + 1] = {};
+			int32 Last0 = Samples[3];
+			int32 Last1 = Samples[3] - Samples[2];
+			int32 Last2 = Last1 - (Samples[2] - Samples[1]);
+			int32 Last3 = Last2 - (Samples[2] - Samples[1]) + (Samples[1] - Samples[0]);
+			for (int32 i = FlacMaxFixedOrder; i < Num; i++)
+			{
+				const int32 E0 = Samples[i];
+				const int32 E1 = E0 - Last0;
+				const int32 E2 = E1 - Last1;
+				const int32 E3 = E2 - Last2;
+				const int32 E4 = E3 - Last3;
+				Sums[0] += FMath::Abs(E0);
+				Sums[1] += FMath::Abs(E1);
+				Sums[2] += FMath::Abs(E2);
+				Sums[3] += FMath::Abs(E3);
+				Sums[4] += FMath::Abs(E4);
+				Last0 = E0;
+				Last1 = E1;
+				Last2 = E2;
+				Last3 = E3;
+			}
+			Order = 0;
+			for (int32 Candidate = 1; Candidate <= FlacMaxFixedOrder; Candidate++)
+			{
+				if (Sums[Candidate] < Sums[Order])
+				{
+					Order = Candidate;
+				}
+			}
+		}
+
+		uint64 BestBits = MAX_uint64;
+		int32 BestPartitionOrder = 0;
+		if (Order != INDEX_NONE)
+		{
+			for (int32 i = Order; i < Num; i++)
+			{
+				const int32* X = Samples + i;
+				int32 Residual;
+				switch (Order)
+				{
+				case 0: Residual = X[0]; break;
+				case 1: Residual = X[0] - X[-1]; break;
+				case 2: Residual = X[0] - 2 * X[-1] + X[-2]; break;
+				case 3: Residual = X[0] - 3 * X[-1] + 3 * X[-2] - X[-3]; break;
+				default: Residual = X[0] - 4 * X[-1] + 6 * X[-2] - 4 * X[-3] + X[-4]; break;
+				}
+				// Zigzag, so small negative residuals get small codes too
+				Folded[i - Order] = ((uint32)Residual << 1) ^ (uint32)(Residual >> 31);
+			}
+
+			// More partitions let the parameter follow loud and quiet stretches, at 4 bits each
+			for (int32 PartitionOrder = 0; PartitionOrder <= FlacMaxPartitionOrder; PartitionOrder++)
+			{
+				const int32 PartitionSize = Num >> PartitionOrder;
+				if ((Num & ((1 << PartitionOrder) - 1)) != 0 || PartitionSize <= Order)
+				{
+					break;
+				}
+
+				uint64 Bits = 0;
+				for (int32 Partition = 0; Partition < (1 << PartitionOrder); Partition++)
+				{
+					const int32 First = FMath::Max(Partition * PartitionSize - Order, 0);
+					const int32 End = (Partition + 1) * PartitionSize - Order;
+					uint64 Sum = 0;
+					for (int32 i = First; i < End; i++)
+					{
+						Sum += Folded[i];
+					}
+					uint64 PartitionBits;
+					ChooseRiceParameter(Sum, End - First, PartitionBits);
+					Bits += 4 + PartitionBits;
+				}
+				if (Bits < BestBits)
+				{
+					BestBits = Bits;
+					BestPartitionOrder = PartitionOrder;
+				}
+			}
+		}
+
+		if (Order == INDEX_NONE || BestBits + Order * 16 >= (uint64)Num * 16)
+		{
+			Writer.Write(0x01 << 1, 8);
+			for (int32 i = 0; i < Num; i++)
+			{
+				Writer.Write((uint32)Samples[i], 16);
+			}
+			return;
+		}
+
+		Writer.Write((0x08 | Order) << 1, 8);
+		for (int32 i = 0; i < Order; i++)
+		{
+			Writer.Write((uint32)Samples[i], 16);
+		}
+
+		// Rice coding with 4 bit parameters
+		Writer.Write(0, 2);
+		Writer.Write(BestPartitionOrder, 4);
+		const int32 PartitionSize = Num >> BestPartitionOrder;
+		for (int32 Partition = 0; Partition < (1 << BestPartitionOrder); Partition++)
+		{
+			const int32 First = FMath::Max(Partition * PartitionSize - Order, 0);
+			const int32 End = (Partition + 1) * PartitionSize - Order;
+			uint64 Sum = 0;
+			for (int32 i = First; i < End; i++)
+			{
+				Sum += Folded[i];
+			}
+			uint64 PartitionBits;
+			const int32 K = ChooseRiceParameter(Sum, End - First, PartitionBits);
+			Writer.Write(K, 4);
+			for (int32 i = First; i < End; i++)
+			{
+				Writer.WriteRice(Folded[i], K);
+			}
+		}
+	}
+
+	void WriteFlacFrame(TArray<uint8>& Out, FFlacBitWriter& Writer, uint32 FrameNumber, const TArray<int32>* Channels, int32 NumChannels, int32 Num, TArray<uint32>& Folded)
+	{
+		const int32 FrameStart = Out.Num();
+
+		// Sync code, fixed block size stream
+		Writer.Write(0x3FFE, 14);
+		Writer.Write(0, 2);
+		// 4096 samples, or the size as 16 bits at the end of the header
+		Writer.Write(Num == FlacBlockSize ? 0xC : 0x7, 4);
+		// Sample rate from STREAMINFO
+		Writer.Write(0, 4);
+		// Independent channels
+		Writer.Write(NumChannels - 1, 4);
+		// 16 bits per sample
+		Writer.Write(0x4, 3);
+		Writer.Write(0, 1);
+
+		// Frame number in the UTF-8 style variable length code
+		if (FrameNumber < 0x80)
+		{
+			Writer.Write(FrameNumber, 8);
+		}
+		else
+		{
+			const int32 NumBytes = FrameNumber < 0x800 ? 2 : FrameNumber < 0x10000 ? 3 : FrameNumber < 0x200000 ? 4 : FrameNumber < 0x4000000 ? 5 : 6;
+			Writer.Write(((0xFF00 >> NumBytes) & 0xFF) | (FrameNumber >> (6 * (NumBytes - 1))), 8);
+			for (int32 Byte = NumBytes - 2; Byte >= 0; Byte--)
+			{
+				Writer.Write(0x80 | ((FrameNumber >> (6 * Byte)) & 0x3F), 8);
+			}
+		}
+		if (Num != FlacBlockSize)
+		{
+			Writer.Write(Num - 1, 16);
+		}
+		Writer.Write(FlacCrc8(Out.GetData() + FrameStart, Out.Num() - FrameStart), 8);
+
+		for (int32 Channel = 0; Channel < NumChannels; Channel++)
+		{
+			WriteFlacSubframe(Writer, Channels[Channel].GetData(), Num, Folded);
+		}
+
+		Writer.Align();
+		Writer.Write(FlacCrc16(Out.GetData() + FrameStart, Out.Num() - FrameStart), 16);
+	}
+
+#if WITH_OPENAI_OPUS
+	uint32 OggCrc(const uint8* Data, int32 Num)
+	{
+		const FCrcTables& Tables = GetCrcTables();
+		uint32 Crc = 0;
+		for (int32 i = 0; i < Num; i++)
+		{
+			Crc = (Crc << 8) ^ Tables.Crc32[(Crc >> 24) ^ Data[i]];
+		}
+		return Crc;
+	}
+
+	void AppendLE(TArray<uint8>& Out, uint64 Value, int32 NumBytes)
+	{
+		for (int32 Byte = 0; Byte < NumBytes; Byte++)
+		{
+			Out.Add((uint8)(Value >> (8 * Byte)));
+		}
+	}
+
+	// Packs packets into Ogg pages for a single logical stream
+	class FOggPageWriter
+	{
+	public:
+		FOggPageWriter(TArray<uint8>& InOut, uint32 InSerial)
+			: Out(InOut)
+			, Serial(InSerial)
+			, Sequence(0)
+			, Granule(0)
+			, NumPackets(0)
+			, bFirstPage(true)
+		{
+		}
+
+		/** Adds a packet to the open page. InGranule is the stream position once the packet is decoded. */
+		void AddPacket(TArrayView<const uint8> Packet, int64 InGranule)
+		{
+			// A page holds at most 255 lacing values; a packet takes one per 255 bytes plus a final one
+			const int32 NumLacing = Packet.Num() / 255 + 1;
+			if (Lacing.Num() + NumLacing > 255)
+			{
+				FlushPage(false);
+			}
+			for (int32 Remaining = Packet.Num(); ; Remaining -= 255)
+			{
+				Lacing.Add((uint8)FMath::Min(Remaining, 255));
+				if (Remaining < 255)
+				{
+					break;
+				}
+			}
+			Body.Append(Packet.GetData(), Packet.Num());
+			Granule = InGranule;
+			NumPackets++;
+		}
+
+		void FlushPage(bool bLastPage)
+		{
+			if (Lacing.Num() == 0 && !bLastPage)
+			{
+				return;
+			}
+
+			const int32 PageStart = Out.Num();
+			Out.Append((const uint8*)"OggS", 4);
+			Out.Add(0);
+			Out.Add((bFirstPage ? 0x02 : 0x00) | (bLastPage ? 0x04 : 0x00));
+			AppendLE(Out, (uint64)Granule, 8);
+			AppendLE(Out, Serial, 4);
+			AppendLE(Out, Sequence++, 4);
+			const int32 CrcOffset = Out.Num();
+			AppendLE(Out, 0, 4);
+			Out.Add((uint8)Lacing.Num());
+			Out.Append(Lacing);
+			Out.Append(Body);
+
+			const uint32 Crc = OggCrc(Out.GetData() + PageStart, Out.Num() - PageStart);
+			for (int32 Byte = 0; Byte < 4; Byte++)
+			{
+				Out[CrcOffset + Byte] = (uint8)(Crc >> (8 * Byte));
+			}
+
+			Lacing.Reset();
+			Body.Reset();
+			NumPackets = 0;
+			bFirstPage = false;
+		}
+
+		int32 GetNumPackets() const { return NumPackets; }
+
+	private:
+		TArray<uint8>& Out;
+		uint32 Serial;
+		uint32 Sequence;
+		int64 Granule;
+		int32 NumPackets;
+		bool bFirstPage;
+		TArray<uint8> Lacing;
+		TArray<uint8> Body;
+	};
+#endif
+}
+
+void OpenAIAudioCodec::EncodeFlac(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, TArray<uint8>& OutBytes)
+{
+	check(NumChannels >= 1 && NumChannels <= 8);
+	const int64 NumFrames = Samples.Num() / NumChannels;
+
+	// Speech typically codes to about half the size of 16 bit PCM
+	OutBytes.Reserve(OutBytes.Num() + 42 + NumFrames * NumChannels);
+	FFlacBitWriter Writer(OutBytes);
+
+	Writer.Write(0x664C6143, 32); // "fLaC"
+	// STREAMINFO, the only metadata block
+	Writer.Write(0x80, 8);
+	Writer.Write(34, 24);
+	Writer.Write(FlacBlockSize, 16);
+	Writer.Write(FlacBlockSize, 16);
+	// Frame sizes unknown
+	Writer.Write(0, 24);
+	Writer.Write(0, 24);
+	Writer.Write(SampleRate, 20);
+	Writer.Write(NumChannels - 1, 3);
+	Writer.Write(16 - 1, 5);
+	Writer.Write((uint32)(NumFrames >> 32), 4);
+	Writer.Write((uint32)NumFrames, 32);
+	// MD5 of the decoded samples, filled in at the end
+	const int32 Md5Offset = OutBytes.Num();
+	OutBytes.AddZeroed(16);
+
+	FMD5 Md5;
+	TArray<int32> Channels[8];
+	for (int32 Channel = 0; Channel < NumChannels; Channel++)
+	{
+		Channels[Channel].SetNumUninitialized(FlacBlockSize);
+	}
+	TArray<uint32> Folded;
+	Folded.SetNumUninitialized(FlacBlockSize);
+	TArray<uint8> PCM;
+	PCM.Reserve(FlacBlockSize * NumChannels * sizeof(int16));
+
+	uint32 FrameNumber = 0;
+	for (int64 Start = 0; Start < NumFrames; Start += FlacBlockSize, FrameNumber++)
+	{
+		const int32 Num = (int32)FMath::Min<int64>(FlacBlockSize, NumFrames - Start);
+
+		// The PCM bytes are what a decoder checks the MD5 against
+		PCM.Reset();
+		FloatToPCM16(Samples.GetData() + Start * NumChannels, Num * NumChannels, PCM);
+		Md5.Update(PCM.GetData(), PCM.Num());
+		for (int32 i = 0; i < Num * NumChannels; i++)
+		{
+			Channels[i % NumChannels][i / NumChannels] = (int16)(PCM[i * 2] | (PCM[i * 2 + 1] << 8));
+		}
+
+		WriteFlacFrame(OutBytes, Writer, FrameNumber, Channels, NumChannels, Num, Folded);
+	}
+
+	Md5.Final(OutBytes.GetData() + Md5Offset);
+}
+
+bool OpenAIAudioCodec::EncodeOggOpus(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, int32 BitrateBps, TArray<uint8>& OutBytes)
+{
+#if WITH_OPENAI_OPUS
+	if (NumChannels < 1 || NumChannels > 2 || !(SampleRate == 8000 || SampleRate == 12000 || SampleRate == 16000 || SampleRate == 24000 || SampleRate == 48000))
+	{
+		return false;
+	}
+
+	int Error = OPUS_OK;
+	OpusEncoder* Encoder = opus_encoder_create(SampleRate, NumChannels, OPUS_APPLICATION_VOIP, &Error);
+	if (Error != OPUS_OK || !Encoder)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to create Opus encoder: %hs"), opus_strerror(Error));
+		return false;
+	}
+	ON_SCOPE_EXIT
+	{
+		opus_encoder_destroy(Encoder);
+	};
+	opus_encoder_ctl(Encoder, OPUS_SET_BITRATE(BitrateBps));
+	opus_encoder_ctl(Encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+	opus_int32 Lookahead = 0;
+	opus_encoder_ctl(Encoder, OPUS_GET_LOOKAHEAD(&Lookahead));
+
+	// Ogg Opus granule positions count 48 kHz samples whatever the input rate
+	const int32 Scale = 48000 / SampleRate;
+	const int32 FrameSamples = SampleRate / 50;
+	const int64 NumFrames = Samples.Num() / NumChannels;
+	const int64 PreSkip = (int64)Lookahead * Scale;
+	const int64 EndGranule = PreSkip + NumFrames * Scale;
+	// Enough frames to push the encoder's lookahead out as well
+	const int64 NumPackets = (NumFrames + Lookahead + FrameSamples - 1) / FrameSamples;
+
+	const int32 StartSize = OutBytes.Num();
+	OutBytes.Reserve(StartSize + NumPackets * (BitrateBps / 400 + 2) + 1024);
+	FOggPageWriter Ogg(OutBytes, (uint32)FMath::Rand());
+
+	TArray<uint8> Header;
+	Header.Append((const uint8*)"OpusHead", 8);
+	Header.Add(1);
+	Header.Add((uint8)NumChannels);
+	AppendLE(Header, (uint64)PreSkip, 2);
+	AppendLE(Header, (uint64)SampleRate, 4);
+	AppendLE(Header, 0, 2);
+	Header.Add(0);
+	Ogg.AddPacket(Header, 0);
+	Ogg.FlushPage(false);
+
+	static const char Vendor[] = "OpenAIAPI";
+	Header.Reset();
+	Header.Append((const uint8*)"OpusTags", 8);
+	AppendLE(Header, sizeof(Vendor) - 1, 4);
+	Header.Append((const uint8*)Vendor, sizeof(Vendor) - 1);
+	AppendLE(Header, 0, 4);
+	Ogg.AddPacket(Header, 0);
+	Ogg.FlushPage(false);
+
+	TArray<float> Padded;
+	TArray<uint8> Packet;
+	Packet.SetNumUninitialized(4000);
+	for (int64 PacketIndex = 0; PacketIndex < NumPackets; PacketIndex++)
+	{
+		const int64 Start = PacketIndex * FrameSamples;
+		const float* Input = Samples.GetData() + Start * NumChannels;
+		if (Start + FrameSamples > NumFrames)
+		{
+			// The last frames run past the input, finish them with silence
+			Padded.Reset();
+			Padded.SetNumZeroed(FrameSamples * NumChannels);
+			if (Start < NumFrames)
+			{
+				FMemory::Memcpy(Padded.GetData(), Input, (NumFrames - Start) * NumChannels * sizeof(float));
+			}
+			Input = Padded.GetData();
+		}
+
+		const opus_int32 Size = opus_encode_float(Encoder, Input, FrameSamples, Packet.GetData(), Packet.Num());
+		if (Size < 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Opus encode failed: %hs"), opus_strerror(Size));
+			OutBytes.SetNum(StartSize);
+			return false;
+		}
+
+		// The last page's granule stops at the real end, so decoders trim the padding
+		Ogg.AddPacket(MakeArrayView(Packet.GetData(), Size), FMath::Min((PacketIndex + 1) * FrameSamples * Scale, EndGranule));
+		// About a second of audio per page
+		if (Ogg.GetNumPackets() >= 50 && PacketIndex + 1 < NumPackets)
+		{
+			Ogg.FlushPage(false);
+		}
+	}
+	Ogg.FlushPage(true);
+	return true;
+#else
+	return false;
+#endif
+}
+
+OpenAIAudioCodec::FEncodedUpload OpenAIAudioCodec::EncodeUpload(EOAUploadAudioFormat Format, TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, int32 OpusBitrateBps)
+{
+	FEncodedUpload Encoded;
+	if (Format == EOAUploadAudioFormat::OPUS)
+	{
+		if (EncodeOggOpus(Samples, SampleRate, NumChannels, OpusBitrateBps, Encoded.Bytes))
+		{
+			Encoded.FileName = TEXT("audio.ogg");
+			Encoded.ContentType = TEXT("audio/ogg");
+			return Encoded;
+		}
+		UE_LOG(LogTemp, Log, TEXT("Opus cannot encode %d Hz, %d channel audio here, uploading FLAC"), SampleRate, NumChannels);
+		Format = EOAUploadAudioFormat::FLAC;
+	}
+
+	if (Format == EOAUploadAudioFormat::FLAC && NumChannels >= 1 && NumChannels <= 8)
+	{
+		EncodeFlac(Samples, SampleRate, NumChannels, Encoded.Bytes);
+		Encoded.FileName = TEXT("audio.flac");
+		Encoded.ContentType = TEXT("audio/flac");
+		return Encoded;
+	}
+
+	EncodeWav(Samples, SampleRate, NumChannels, Encoded.Bytes);
+	Encoded.FileName = TEXT("audio.wav");
+	Encoded.ContentType = TEXT("audio/wav");
+	return Encoded;
+}
+
+void OpenAIAudioCodec::EncodeUploadAsync(EOAUploadAudioFormat Format, TArray<float>&& Samples, int32 SampleRate, int32 NumChannels, int32 OpusBitrateBps,
+	TFunction<void(FEncodedUpload&& Encoded)> OnEncoded)
+{
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Format, Samples = MoveTemp(Samples), SampleRate, NumChannels, OpusBitrateBps, OnEncoded = MoveTemp(OnEncoded)]() mutable
+	{
+		FEncodedUpload Encoded = EncodeUpload(Format, Samples, SampleRate, NumChannels, OpusBitrateBps);
+		Samples.Empty();
+		AsyncTask(ENamedThreads::GameThread, [Encoded = MoveTemp(Encoded), OnEncoded = MoveTemp(OnEncoded)]() mutable
+		{
+			OnEncoded(MoveTemp(Encoded));
+		});
+	});
+}
+
+uint8 FOpenAIG711::LinearToULaw(int16 Sample)
+{
+	constexpr int32 Bias = 0x84;
+	constexpr int32 Clip = 32635;
+
+	int32 Value = Sample;
+	const uint8 Sign = Value < 0 ? 0x80 : 0x00;
+	if (Value < 0)
+	{
+		Value = -Value;
+	}
+	Value = FMath::Min(Value, Clip) + Bias;
+
+	// Segment is the position of the highest set bit above the 8 bit mantissa window
+	const int32 Exponent = (int32)FMath::FloorLog2((uint32)Value) - 7;
+	const int32 Mantissa = (Value >> (Exponent + 3)) & 0x0F;
+	return (uint8)~(Sign | (Exponent << 4) | Mantissa);
+}
+
+int16 FOpenAIG711::ULawToLinear(uint8 Code)
+{
+	constexpr int32 Bias = 0x84;
+
+	Code = ~Code;
+	const int32 Exponent = (Code >> 4) & 0x07;
+	const int32 Mantissa = Code & 0x0F;
+	const int32 Magnitude = (((Mantissa << 3) + Bias) << Exponent) - Bias;
+	return (int16)((Code & 0x80) ? -Magnitude : Magnitude);
+}
+
+uint8 FOpenAIG711::LinearToALaw(int16 Sample)
+{
+	// A-law works on 13 bit samples
+	int32 Value = Sample >> 3;
+	uint8 Mask;
+	if (Value >= 0)
+	{
+		Mask = 0xD5;
+	}
+	else
+	{
+		Mask = 0x55;
+		Value = -Value - 1;
+	}
+
+	const int32 Segment = Value < 0x20 ? 0 : (int32)FMath::FloorLog2((uint32)Value) - 4;
+	if (Segment >= 8)
+	{
+		return 0x7F ^ Mask;
+	}
+
+	uint8 Code = (uint8)(Segment << 4);
+	Code |= Segment < 2 ? (Value >> 1) & 0x0F : (Value >> Segment) & 0x0F;
+	return Code ^ Mask;
+}
+
+int16 FOpenAIG711::ALawToLinear(uint8 Code)
+{
+	Code ^= 0x55;
+	int32 Magnitude = (Code & 0x0F) << 4;
+	const int32 Segment = (Code & 0x70) >> 4;
+	switch (Segment)
+	{
+	case 0:
+		Magnitude += 8;
+		break;
+	case 1:
+		Magnitude += 0x108;
+		break;
+	default:
+		Magnitude += 0x108;
+		Magnitude <<= Segment - 1;
+		break;
+	}
+	return (int16)((Code & 0x80) ? Magnitude : -Magnitude);
+}
+
+void FOpenAIG711::Encode(bool bALaw, const float* Samples, int32 Num, TArray<uint8>& OutCodes)
+{
+	const int32 Start = OutCodes.Num();
+	OutCodes.AddUninitialized(Num);
+	uint8* Out = OutCodes.GetData() + Start;
+
+	if (bALaw)
+	{
+		for (int32 i = 0; i < Num; i++)
+		{
+			Out[i] = LinearToALaw(FloatToInt16(Samples[i]));
+		}
+	}
+	else
+	{
+		for (int32 i = 0; i < Num; i++)
+		{
+			Out[i] = LinearToULaw(FloatToInt16(Samples[i]));
+		}
+	}
+}
+
+void FOpenAIG711::Decode(bool bALaw, TArrayView<const uint8> Codes, TArray<float>& OutSamples)
+{
+	const int16* Table = bALaw ? GetG711DecodeTables().ALaw : GetG711DecodeTables().ULaw;
+
+	const int32 Start = OutSamples.Num();
+	OutSamples.AddUninitialized(Codes.Num());
+	float* Out = OutSamples.GetData() + Start;
+
+	for (int32 i = 0; i < Codes.Num(); i++)
+	{
+		Out[i] = Table[Codes[i]] / 32768.0f;
+	}
+}
+
+FOpenAIOpusEncoder::FOpenAIOpusEncoder()
+	: Encoder(nullptr)
+{
+}
+
+FOpenAIOpusEncoder::~FOpenAIOpusEncoder()
+{
+#if WITH_OPENAI_OPUS
+	if (Encoder)
+	{
+		opus_encoder_destroy(Encoder);
+	}
+#endif
+}
+
+bool FOpenAIOpusEncoder::Init(int32 BitrateBps)
+{
+#if WITH_OPENAI_OPUS
+	if (Encoder)
+	{
+		opus_encoder_destroy(Encoder);
+		Encoder = nullptr;
+	}
+
+	int Error = OPUS_OK;
+	Encoder = opus_encoder_create(SampleRate, 1, OPUS_APPLICATION_VOIP, &Error);
+	if (Error != OPUS_OK || !Encoder)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to create Opus encoder: %hs"), opus_strerror(Error));
+		Encoder = nullptr;
+		return false;
+	}
+
+	opus_encoder_ctl(Encoder, OPUS_SET_BITRATE(BitrateBps));
+	opus_encoder_ctl(Encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+	// Realtime sessions already pace their own uplink; keep encoding cheap
+	opus_encoder_ctl(Encoder, OPUS_SET_COMPLEXITY(5));
+
+	Pending.Reset(FrameSamples);
+	FrameScratch.SetNumUninitialized(4000);
+	return true;
+#else
+	UE_LOG(LogTemp, Warning, TEXT("Opus is not available on this platform"));
+	return false;
+#endif
+}
+
+int32 FOpenAIOpusEncoder::Encode(const float* Samples, int32 Num, TArray<uint8>& OutPacket)
+{
+#if WITH_OPENAI_OPUS
+	if (!Encoder)
+	{
+		return 0;
+	}
+
+	int32 NumFrames = 0;
+	while (Num > 0)
+	{
+		const float* Frame = Samples;
+		const int32 Needed = FrameSamples - Pending.Num();
+
+		if (Pending.Num() > 0 || Num < FrameSamples)
+		{
+			// Complete a held partial frame, or hold on to the tail of this call
+			const int32 ToCopy = FMath::Min(Needed, Num);
+			Pending.Append(Samples, ToCopy);
+			Samples += ToCopy;
+			Num -= ToCopy;
+			if (Pending.Num() < FrameSamples)
+			{
+				break;
+			}
+			Frame = Pending.GetData();
+		}
+		else
+		{
+			Samples += FrameSamples;
+			Num -= FrameSamples;
+		}
+
+		const opus_int32 Size = opus_encode_float(Encoder, Frame, FrameSamples, FrameScratch.GetData(), FrameScratch.Num());
+		Pending.Reset();
+		if (Size < 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Opus encode failed: %hs"), opus_strerror(Size));
+			continue;
+		}
+
+		OutPacket.Add((uint8)(Size & 0xFF));
+		OutPacket.Add((uint8)(Size >> 8));
+		OutPacket.Append(FrameScratch.GetData(), Size);
+		NumFrames++;
+	}
+	return NumFrames;
+#else
+	return 0;
+#endif
+}
+
+FOpenAIOpusDecoder::FOpenAIOpusDecoder()
+	: Decoder(nullptr)
+{
+}
+
+FOpenAIOpusDecoder::~FOpenAIOpusDecoder()
+{
+#if WITH_OPENAI_OPUS
+	if (Decoder)
+	{
+		opus_decoder_destroy(Decoder);
+	}
+#endif
+}
+
+bool FOpenAIOpusDecoder::Init()
+{
+#if WITH_OPENAI_OPUS
+	if (Decoder)
+	{
+		opus_decoder_destroy(Decoder);
+		Decoder = nullptr;
+	}
+
+	int Error = OPUS_OK;
+	Decoder = opus_decoder_create(FOpenAIOpusEncoder::SampleRate, 1, &Error);
+	if (Error != OPUS_OK || !Decoder)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to create Opus decoder: %hs"), opus_strerror(Error));
+		Decoder = nullptr;
+		return false;
+	}
+	return true;
+#else
+	UE_LOG(LogTemp, Warning, TEXT("Opus is not available on this platform"));
+	return false;
+#endif
+}
+
+bool FOpenAIOpusDecoder::Decode(TArrayView<const uint8> Packet, TArray<float>& OutSamples)
+{
+#if WITH_OPENAI_OPUS
+	if (!Decoder)
+	{
+		return false;
+	}
+
+	// 120 ms is the longest frame Opus can produce
+	constexpr int32 MaxFrameSamples = FOpenAIOpusEncoder::SampleRate * 120 / 1000;
+
+	int32 Offset = 0;
+	while (Offset + 2 <= Packet.Num())
+	{
+		const int32 Size = Packet[Offset] | (Packet[Offset + 1] << 8);
+		Offset += 2;
+		if (Offset + Size > Packet.Num())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Truncated Opus relay packet"));
+			return false;
+		}
+
+		const int32 Start = OutSamples.Num();
+		OutSamples.AddUninitialized(MaxFrameSamples);
+		const int Decoded = opus_decode_float(Decoder, Packet.GetData() + Offset, Size, OutSamples.GetData() + Start, MaxFrameSamples, 0);
+		OutSamples.SetNum(Start + FMath::Max(Decoded, 0), EAllowShrinking::No);
+		if (Decoded < 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Opus decode failed: %hs"), opus_strerror(Decoded));
+			return false;
+		}
+		Offset += Size;
+	}
+	return Offset == Packet.Num();
+#else
+	return false;
+#endif
+}
+
+FOpenAIOggOpusDecoder::FOpenAIOggOpusDecoder()
+	: Decoder(nullptr)
+	, SampleRate(24000)
+	, NumPackets(0)
+	, SamplesToSkip(0)
+{
+}
+
+FOpenAIOggOpusDecoder::~FOpenAIOggOpusDecoder()
+{
+#if WITH_OPENAI_OPUS
+	if (Decoder)
+	{
+		opus_decoder_destroy(Decoder);
+	}
+#endif
+}
+
+bool FOpenAIOggOpusDecoder::Init(int32 OutputSampleRate)
+{
+#if WITH_OPENAI_OPUS
+	if (Decoder)
+	{
+		opus_decoder_destroy(Decoder);
+		Decoder = nullptr;
+	}
+
+	// Stereo streams are downmixed by the decoder
+	int Error = OPUS_OK;
+	Decoder = opus_decoder_create(OutputSampleRate, 1, &Error);
+	if (Error != OPUS_OK || !Decoder)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to create Opus decoder: %hs"), opus_strerror(Error));
+		Decoder = nullptr;
+		return false;
+	}
+
+	SampleRate = OutputSampleRate;
+	PendingPage.Reset();
+	Packet.Reset();
+	NumPackets = 0;
+	SamplesToSkip = 0;
+	return true;
+#else
+	UE_LOG(LogTemp, Warning, TEXT("Opus is not available on this platform"));
+	return false;
+#endif
+}
+
+bool FOpenAIOggOpusDecoder::Decode(TArrayView<const uint8> Bytes, TArray<float>& OutSamples)
+{
+#if WITH_OPENAI_OPUS
+	if (!Decoder)
+	{
+		return false;
+	}
+
+	PendingPage.Append(Bytes.GetData(), Bytes.Num());
+	int32 Offset = 0;
+	while (PendingPage.Num() - Offset >= 27)
+	{
+		const uint8* Page = PendingPage.GetData() + Offset;
+		if (FMemory::Memcmp(Page, "OggS", 4) != 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Ogg stream lost page sync"));
+			return false;
+		}
+
+		const int32 NumSegments = Page[26];
+		if (PendingPage.Num() - Offset < 27 + NumSegments)
+		{
+			break;
+		}
+		int32 BodySize = 0;
+		for (int32 Segment = 0; Segment < NumSegments; Segment++)
+		{
+			BodySize += Page[27 + Segment];
+		}
+		if (PendingPage.Num() - Offset < 27 + NumSegments + BodySize)
+		{
+			break;
+		}
+
+		// A lacing value below 255 ends a packet; 255 continues it, possibly onto the next page
+		const uint8* Body = Page + 27 + NumSegments;
+		for (int32 Segment = 0; Segment < NumSegments; Segment++)
+		{
+			const int32 Size = Page[27 + Segment];
+			Packet.Append(Body, Size);
+			Body += Size;
+			if (Size < 255)
+			{
+				if (!DecodePacket(Packet, OutSamples))
+				{
+					return false;
+				}
+				Packet.Reset();
+			}
+		}
+		Offset += 27 + NumSegments + BodySize;
+	}
+
+	PendingPage.RemoveAt(0, Offset, EAllowShrinking::No);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool FOpenAIOggOpusDecoder::DecodePacket(TArrayView<const uint8> InPacket, TArray<float>& OutSamples)
+{
+#if WITH_OPENAI_OPUS
+	const int32 PacketIndex = NumPackets++;
+	if (PacketIndex == 0)
+	{
+		// OpusHead: pre-skip counts 48 kHz samples the encoder's delay put before the audio
+		if (InPacket.Num() < 19 || FMemory::Memcmp(InPacket.GetData(), "OpusHead", 8) != 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Ogg stream is not Opus"));
+			return false;
+		}
+		const int32 PreSkip = InPacket[10] | (InPacket[11] << 8);
+		SamplesToSkip = (int32)((int64)PreSkip * SampleRate / 48000);
+		return true;
+	}
+	if (PacketIndex == 1)
+	{
+		// OpusTags
+		return true;
+	}
+
+	// 120 ms is the longest frame Opus can produce
+	const int32 MaxFrameSamples = SampleRate * 120 / 1000;
+	const int32 Start = OutSamples.Num();
+	OutSamples.AddUninitialized(MaxFrameSamples);
+	const int Decoded = opus_decode_float(Decoder, InPacket.GetData(), InPacket.Num(), OutSamples.GetData() + Start, MaxFrameSamples, 0);
+	OutSamples.SetNum(Start + FMath::Max(Decoded, 0), EAllowShrinking::No);
+	if (Decoded < 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Opus decode failed: %hs"), opus_strerror(Decoded));
+		return false;
+	}
+
+	const int32 Skipped = FMath::Min(SamplesToSkip, Decoded);
+	if (Skipped > 0)
+	{
+		OutSamples.RemoveAt(Start, Skipped, EAllowShrinking::No);
+		SamplesToSkip -= Skipped;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+#if !UE_BUILD_SHIPPING
+
+namespace
+{
+	// Whether compressing before upload pays off: encode time against the transfer time it saves
+	void BenchmarkUploadEncoding(const TArray<FString>& Args)
+	{
+		if (Args.Num() == 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Usage: OpenAI.BenchmarkUploadEncoding <16 bit PCM WAV file> [Opus bitrate]"));
+			return;
+		}
+
+		TArray<uint8> FileData;
+		FWaveModInfo WaveInfo;
+		if (!FFileHelper::LoadFileToArray(FileData, *Args[0]) || !WaveInfo.ReadWaveInfo(FileData.GetData(), FileData.Num()) || *WaveInfo.pBitsPerSample != 16)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s is not a 16 bit PCM WAV file"), *Args[0]);
+			return;
+		}
+		const int32 SampleRate = *WaveInfo.pSamplesPerSec;
+		const int32 NumChannels = *WaveInfo.pChannels;
+		const int32 OpusBitrate = Args.Num() > 1 ? FMath::Max(6000, FCString::Atoi(*Args[1])) : 24000;
+		TArray<float> Samples;
+		OpenAIAudioCodec::PCM16ToFloat(MakeArrayView(WaveInfo.SampleDataStart, (int32)WaveInfo.SampleDataSize), Samples);
+		const double Duration = (double)Samples.Num() / NumChannels / SampleRate;
+
+		// Typical uplinks: poor mobile, home broadband, office
+		const double UplinkMbps[] = { 1.0, 5.0, 20.0 };
+		constexpr int32 Iterations = 3;
+
+		int64 WavBytes = 0;
+		for (const EOAUploadAudioFormat Format : { EOAUploadAudioFormat::WAV, EOAUploadAudioFormat::FLAC, EOAUploadAudioFormat::OPUS })
+		{
+			OpenAIAudioCodec::FEncodedUpload Encoded;
+			const double Start = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Iterations; i++)
+			{
+				Encoded = OpenAIAudioCodec::EncodeUpload(Format, Samples, SampleRate, NumChannels, OpusBitrate);
+			}
+			const double EncodeSeconds = (FPlatformTime::Seconds() - Start) / Iterations;
+			if (Format == EOAUploadAudioFormat::WAV)
+			{
+				WavBytes = Encoded.Bytes.Num();
+			}
+
+			TStringBuilder<256> Saved;
+			for (const double Mbps : UplinkMbps)
+			{
+				const double BytesPerSecond = Mbps * 1000000.0 / 8.0;
+				const double SavedSeconds = (WavBytes - Encoded.Bytes.Num()) / BytesPerSecond - EncodeSeconds;
+				Saved.Appendf(TEXT(" | %.0f Mbps %+.2f s"), Mbps, SavedSeconds);
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%s: %.1f s of audio, %d bytes (%.1fx smaller), encode %.1f ms (%.0fx realtime)%s"),
+				*Encoded.FileName, Duration, Encoded.Bytes.Num(), (double)WavBytes / FMath::Max(Encoded.Bytes.Num(), 1),
+				EncodeSeconds * 1000.0, Duration / FMath::Max(EncodeSeconds, 1e-9), *Saved);
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkUploadEncodingCommand(
+		TEXT("OpenAI.BenchmarkUploadEncoding"),
+		TEXT("Times WAV, FLAC and Opus upload encoding for a recording and the upload time each saves. Usage: OpenAI.BenchmarkUploadEncoding <WAV file> [Opus bitrate]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkUploadEncoding));
+}
+
+#endif
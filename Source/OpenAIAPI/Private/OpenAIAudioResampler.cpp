@@ -0,0 +1,300 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIAudioResampler.h"
+#include "Math/VectorRegister.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	// Kaiser window shape; 8.0 gives roughly 80 dB of stopband attenuation
+	constexpr double KaiserBeta = 8.0;
+	// Passband edge as a fraction of the lower Nyquist frequency
+	constexpr double PassbandRolloff = 0.9;
+
+	// Zeroth order modified Bessel function of the first kind, used by the Kaiser window
+	double BesselI0(double X)
+	{
+		double Sum = 1.0;
+		double Term = 1.0;
+		const double HalfX = X * 0.5;
+		for (int32 k = 1; k < 32; k++)
+		{
+			Term *= HalfX / k;
+			const double TermSq = Term * Term;
+			Sum += TermSq;
+			if (TermSq < Sum * 1e-12)
+			{
+				break;
+			}
+		}
+		return Sum;
+	}
+
+	int32 GreatestCommonDivisor(int32 A, int32 B)
+	{
+		while (B != 0)
+		{
+			const int32 T = A % B;
+			A = B;
+			B = T;
+		}
+		return A;
+	}
+
+	FORCEINLINE float DotProduct(const float* RESTRICT X, const float* RESTRICT C, int32 Num)
+	{
+		// Num is always a multiple of 8, two accumulators hide the FMA latency
+		VectorRegister4Float Sum0 = VectorZeroFloat();
+		VectorRegister4Float Sum1 = VectorZeroFloat();
+		for (int32 j = 0; j < Num; j += 8)
+		{
+			Sum0 = VectorMultiplyAdd(VectorLoad(X + j), VectorLoad(C + j), Sum0);
+			Sum1 = VectorMultiplyAdd(VectorLoad(X + j + 4), VectorLoad(C + j + 4), Sum1);
+		}
+
+		float Lanes[4];
+		VectorStore(VectorAdd(Sum0, Sum1), Lanes);
+		return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+}
+
+FOpenAIAudioResampler::FOpenAIAudioResampler()
+	: InputSampleRate(0)
+	, InputNumChannels(0)
+	, OutputSampleRate(0)
+	, Interpolation(1)
+	, Decimation(1)
+	, NumPhases(1)
+	, TapsPerPhase(0)
+	, PhaseAccumulator(0)
+	, HistoryNum(0)
+	, ReadIndex(0)
+{
+}
+
+bool FOpenAIAudioResampler::Init(int32 InInputSampleRate, int32 InInputNumChannels, int32 InOutputSampleRate, int32 InMaxInputFrames)
+{
+	if (InInputSampleRate <= 0 || InInputNumChannels <= 0 || InOutputSampleRate <= 0 || InMaxInputFrames <= 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Invalid resampler format: %d Hz, %d channels -> %d Hz"), InInputSampleRate, InInputNumChannels, InOutputSampleRate);
+		TapsPerPhase = 0;
+		return false;
+	}
+
+	InputSampleRate = InInputSampleRate;
+	InputNumChannels = InInputNumChannels;
+	OutputSampleRate = InOutputSampleRate;
+
+	const int32 Divisor = GreatestCommonDivisor(OutputSampleRate, InputSampleRate);
+	Interpolation = OutputSampleRate / Divisor;
+	Decimation = InputSampleRate / Divisor;
+	NumPhases = FMath::Min(Interpolation, MaxPhases);
+
+	// Widen the filter when decimating so the transition band stays the same width at the output rate
+	const int32 DecimationScale = FMath::Max(1, FMath::DivideAndRoundUp(Decimation, Interpolation));
+	TapsPerPhase = Align(BaseTapsPerPhase * DecimationScale, 8);
+
+	// Prototype low pass at the upsampled rate, cut off below the lower of the two Nyquist frequencies
+	const int32 PrototypeLength = TapsPerPhase * NumPhases;
+	const double Cutoff = 0.5 * PassbandRolloff * FMath::Min(1.0, (double)Interpolation / Decimation) / NumPhases;
+	const double Center = (PrototypeLength - 1) * 0.5;
+	const double WindowNorm = 1.0 / BesselI0(KaiserBeta);
+
+	FilterBank.SetNumUninitialized(PrototypeLength);
+	for (int32 i = 0; i < PrototypeLength; i++)
+	{
+		const double T = i - Center;
+		const double SincArg = 2.0 * Cutoff * T;
+		const double Sinc = FMath::IsNearlyZero(SincArg) ? 1.0 : FMath::Sin(PI * SincArg) / (PI * SincArg);
+		const double Ratio = T / (Center + 0.5);
+		const double Window = BesselI0(KaiserBeta * FMath::Sqrt(FMath::Max(0.0, 1.0 - Ratio * Ratio))) * WindowNorm;
+		const float Coefficient = (float)(2.0 * Cutoff * Sinc * Window * NumPhases);
+
+		// Tap k of phase p is prototype sample k * NumPhases + p, stored reversed within the row
+		const int32 Phase = i % NumPhases;
+		const int32 Tap = i / NumPhases;
+		FilterBank[Phase * TapsPerPhase + (TapsPerPhase - 1 - Tap)] = Coefficient;
+	}
+
+	History.SetNumUninitialized(TapsPerPhase + InMaxInputFrames);
+	Reset();
+
+	UE_LOG(LogTemp, Log, TEXT("Resampler initialized: %d Hz x%d -> %d Hz mono (L=%d, M=%d, %d phases, %d taps)"),
+		InputSampleRate, InputNumChannels, OutputSampleRate, Interpolation, Decimation, NumPhases, TapsPerPhase);
+	return true;
+}
+
+void FOpenAIAudioResampler::Reset()
+{
+	// Prime the history with silence so the first output is aligned with the first input sample
+	HistoryNum = TapsPerPhase - 1;
+	ReadIndex = 0;
+	PhaseAccumulator = 0;
+	if (HistoryNum > 0)
+	{
+		FMemory::Memzero(History.GetData(), HistoryNum * sizeof(float));
+	}
+}
+
+int32 FOpenAIAudioResampler::GetMaxOutputFrames(int32 NumInputFrames) const
+{
+	return (int32)(((int64)NumInputFrames * Interpolation) / Decimation) + 2;
+}
+
+void FOpenAIAudioResampler::DownmixToHistory(const float* InInterleaved, int32 NumInputFrames)
+{
+	float* RESTRICT Out = History.GetData() + HistoryNum;
+
+	if (InputNumChannels == 1)
+	{
+		FMemory::Memcpy(Out, InInterleaved, NumInputFrames * sizeof(float));
+	}
+	else if (InputNumChannels == 2)
+	{
+		for (int32 i = 0; i < NumInputFrames; i++)
+		{
+			Out[i] = (InInterleaved[2 * i] + InInterleaved[2 * i + 1]) * 0.5f;
+		}
+	}
+	else
+	{
+		const float Gain = 1.0f / InputNumChannels;
+		for (int32 i = 0; i < NumInputFrames; i++)
+		{
+			const float* Frame = InInterleaved + i * InputNumChannels;
+			float Sum = 0.0f;
+			for (int32 c = 0; c < InputNumChannels; c++)
+			{
+				Sum += Frame[c];
+			}
+			Out[i] = Sum * Gain;
+		}
+	}
+
+	HistoryNum += NumInputFrames;
+}
+
+int32 FOpenAIAudioResampler::Process(const float* InInterleaved, int32 NumInputFrames, float* OutMono, int32 MaxOutputSamples)
+{
+	if (!IsInitialized() || !InInterleaved || NumInputFrames <= 0)
+	{
+		return 0;
+	}
+
+	const int32 MaxBlockFrames = History.Num() - TapsPerPhase;
+	int32 Written = 0;
+
+	while (NumInputFrames > 0)
+	{
+		const int32 BlockFrames = FMath::Min(NumInputFrames, MaxBlockFrames);
+		DownmixToHistory(InInterleaved, BlockFrames);
+		InInterleaved += BlockFrames * InputNumChannels;
+		NumInputFrames -= BlockFrames;
+
+		const float* Samples = History.GetData();
+		while (ReadIndex + TapsPerPhase <= HistoryNum && Written < MaxOutputSamples)
+		{
+			const int32 Phase = (NumPhases == Interpolation)
+				? PhaseAccumulator
+				: (int32)(((int64)PhaseAccumulator * NumPhases) / Interpolation);
+
+			OutMono[Written++] = DotProduct(Samples + ReadIndex, FilterBank.GetData() + Phase * TapsPerPhase, TapsPerPhase);
+
+			PhaseAccumulator += Decimation;
+			ReadIndex += PhaseAccumulator / Interpolation;
+			PhaseAccumulator %= Interpolation;
+		}
+
+		if (Written >= MaxOutputSamples && ReadIndex + TapsPerPhase <= HistoryNum)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Resampler output buffer too small, dropping input"));
+			ReadIndex = HistoryNum - (TapsPerPhase - 1);
+		}
+
+		// Carry the unconsumed tail (at most TapsPerPhase - 1 samples) to the front of the history
+		const int32 Consumed = FMath::Min(ReadIndex, HistoryNum);
+		if (Consumed > 0)
+		{
+			FMemory::Memmove(History.GetData(), History.GetData() + Consumed, (HistoryNum - Consumed) * sizeof(float));
+			HistoryNum -= Consumed;
+			ReadIndex -= Consumed;
+		}
+	}
+
+	return Written;
+}
+
+#if !UE_BUILD_SHIPPING
+
+namespace
+{
+	// Resamples a sine to 24 kHz in capture sized callbacks and reports speed and quality.
+	// SNR is the tone against everything else in the output: the residual after a least squares
+	// fit of a sine and cosine at the tone frequency, so it needs no knowledge of the filter delay.
+	void BenchmarkResampler(const TArray<FString>& Args)
+	{
+		const int32 InputSampleRate = Args.Num() > 0 ? FMath::Max(8000, FCString::Atoi(*Args[0])) : 48000;
+		const int32 NumChannels = Args.Num() > 1 ? FMath::Clamp(FCString::Atoi(*Args[1]), 1, 8) : 2;
+		const double ToneHz = Args.Num() > 2 ? FCString::Atod(*Args[2]) : 1000.0;
+		constexpr int32 OutputSampleRate = 24000;
+		constexpr int32 CallbackFrames = 480;
+		constexpr double Seconds = 10.0;
+
+		const int32 NumFrames = (int32)(InputSampleRate * Seconds);
+		TArray<float> Input;
+		Input.SetNumUninitialized(NumFrames * NumChannels);
+		for (int32 i = 0; i < NumFrames; i++)
+		{
+			const float Value = 0.5f * (float)FMath::Sin(2.0 * PI * ToneHz * i / InputSampleRate);
+			for (int32 c = 0; c < NumChannels; c++)
+			{
+				Input[i * NumChannels + c] = Value;
+			}
+		}
+
+		FOpenAIAudioResampler Resampler;
+		if (!Resampler.Init(InputSampleRate, NumChannels, OutputSampleRate, CallbackFrames))
+		{
+			return;
+		}
+
+		TArray<float> Output;
+		Output.SetNumUninitialized(Resampler.GetMaxOutputFrames(NumFrames) + Resampler.GetMaxOutputFrames(CallbackFrames));
+		int32 NumOutput = 0;
+		const double Start = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < NumFrames; Frame += CallbackFrames)
+		{
+			const int32 Count = FMath::Min(CallbackFrames, NumFrames - Frame);
+			NumOutput += Resampler.Process(Input.GetData() + Frame * NumChannels, Count, Output.GetData() + NumOutput, Output.Num() - NumOutput);
+		}
+		const double Elapsed = FPlatformTime::Seconds() - Start;
+
+		// The first few milliseconds are the filter filling up from silence
+		const int32 Skip = OutputSampleRate / 100;
+		double SS = 0.0, SC = 0.0, CC = 0.0, YS = 0.0, YC = 0.0, YY = 0.0;
+		for (int32 i = Skip; i < NumOutput; i++)
+		{
+			const double S = FMath::Sin(2.0 * PI * ToneHz * i / OutputSampleRate);
+			const double C = FMath::Cos(2.0 * PI * ToneHz * i / OutputSampleRate);
+			const double Y = Output[i];
+			SS += S * S; SC += S * C; CC += C * C;
+			YS += Y * S; YC += Y * C; YY += Y * Y;
+		}
+		const double Det = SS * CC - SC * SC;
+		const double A = (YS * CC - YC * SC) / Det;
+		const double B = (YC * SS - YS * SC) / Det;
+		const double Signal = A * YS + B * YC;
+		const double Noise = FMath::Max(YY - Signal, 1e-20);
+
+		UE_LOG(LogTemp, Display, TEXT("Resampler %d Hz x%d -> %d Hz, %.0f Hz tone: %.2f ms for %.0f s (%.0fx realtime), SNR %.1f dB, gain %.3f"),
+			InputSampleRate, NumChannels, OutputSampleRate, ToneHz, Elapsed * 1000.0, Seconds, Seconds / FMath::Max(Elapsed, 1e-9),
+			10.0 * FMath::LogX(10.0, Signal / Noise), FMath::Sqrt(A * A + B * B) / 0.5);
+	}
+
+	FAutoConsoleCommand BenchmarkResamplerCommand(
+		TEXT("OpenAI.BenchmarkResampler"),
+		TEXT("Times the capture resampler on a sine and reports its SNR. Usage: OpenAI.BenchmarkResampler [Input rate] [Channels] [Tone Hz]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkResampler));
+}
+
+#endif
@@ -0,0 +1,111 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIAudioRingBuffer.h"
+
+FOpenAIAudioRingBuffer::FOpenAIAudioRingBuffer()
+	: Capacity(0)
+	, Mask(0)
+	, WriteIndex(0)
+	, ReadIndex(0)
+	, TotalWritten(0)
+	, OverrunSamples(0)
+	, OverrunEvents(0)
+	, HighWaterMark(0)
+{
+}
+
+void FOpenAIAudioRingBuffer::Init(int32 MinCapacity)
+{
+	// Power of two capacity so indices wrap with a mask
+	Capacity = (int32)FMath::RoundUpToPowerOfTwo((uint32)FMath::Max(MinCapacity, 2));
+	Mask = (uint32)Capacity - 1;
+	Storage.SetNumZeroed(Capacity);
+
+	WriteIndex.store(0, std::memory_order_relaxed);
+	ReadIndex.store(0, std::memory_order_relaxed);
+	TotalWritten.store(0, std::memory_order_relaxed);
+	OverrunSamples.store(0, std::memory_order_relaxed);
+	OverrunEvents.store(0, std::memory_order_relaxed);
+	HighWaterMark.store(0, std::memory_order_relaxed);
+}
+
+void FOpenAIAudioRingBuffer::Reset()
+{
+	ReadIndex.store(WriteIndex.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+int32 FOpenAIAudioRingBuffer::Write(const float* Data, int32 Num)
+{
+	if (Capacity == 0 || Num <= 0)
+	{
+		return 0;
+	}
+
+	const uint64 Write = WriteIndex.load(std::memory_order_relaxed);
+	const uint64 Read = ReadIndex.load(std::memory_order_acquire);
+	const int32 Used = (int32)(Write - Read);
+	const int32 ToWrite = FMath::Min(Num, Capacity - Used);
+
+	if (ToWrite < Num)
+	{
+		OverrunSamples.fetch_add(Num - ToWrite, std::memory_order_relaxed);
+		OverrunEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (ToWrite > 0)
+	{
+		const int32 Start = (int32)(Write & Mask);
+		const int32 FirstPart = FMath::Min(ToWrite, Capacity - Start);
+		FMemory::Memcpy(Storage.GetData() + Start, Data, FirstPart * sizeof(float));
+		if (FirstPart < ToWrite)
+		{
+			FMemory::Memcpy(Storage.GetData(), Data + FirstPart, (ToWrite - FirstPart) * sizeof(float));
+		}
+
+		WriteIndex.store(Write + ToWrite, std::memory_order_release);
+		TotalWritten.fetch_add(ToWrite, std::memory_order_relaxed);
+
+		if (Used + ToWrite > HighWaterMark.load(std::memory_order_relaxed))
+		{
+			HighWaterMark.store(Used + ToWrite, std::memory_order_relaxed);
+		}
+	}
+
+	return ToWrite;
+}
+
+int32 FOpenAIAudioRingBuffer::NumAvailable() const
+{
+	return (int32)(WriteIndex.load(std::memory_order_acquire) - ReadIndex.load(std::memory_order_relaxed));
+}
+
+TArrayView<const float> FOpenAIAudioRingBuffer::Peek(int32 Num, TArray<float>& Scratch) const
+{
+	Num = FMath::Min(Num, NumAvailable());
+	if (Num <= 0)
+	{
+		return TArrayView<const float>();
+	}
+
+	const int32 Start = (int32)(ReadIndex.load(std::memory_order_relaxed) & Mask);
+	if (Start + Num <= Capacity)
+	{
+		return TArrayView<const float>(Storage.GetData() + Start, Num);
+	}
+
+	// The span wraps around the end of the storage, stitch the two halves together
+	const int32 FirstPart = Capacity - Start;
+	if (Scratch.Num() < Num)
+	{
+		Scratch.SetNumUninitialized(Num);
+	}
+	FMemory::Memcpy(Scratch.GetData(), Storage.GetData() + Start, FirstPart * sizeof(float));
+	FMemory::Memcpy(Scratch.GetData() + FirstPart, Storage.GetData(), (Num - FirstPart) * sizeof(float));
+	return TArrayView<const float>(Scratch.GetData(), Num);
+}
+
+void FOpenAIAudioRingBuffer::Consume(int32 Num)
+{
+	Num = FMath::Clamp(Num, 0, NumAvailable());
+	ReadIndex.store(ReadIndex.load(std::memory_order_relaxed) + Num, std::memory_order_release);
+}
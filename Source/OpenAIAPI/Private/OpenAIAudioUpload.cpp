@@ -0,0 +1,86 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIAudioUpload.h"
+#include "OpenAIUtils.h"
+#include "OpenAIAudioCodec.h"
+#include "OpenAIMultipartBody.h"
+#include "HttpModule.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	void SendBody(const FString& Endpoint, const FString& AuthHeader, TSharedRef<FOpenAIMultipartBody, ESPMode::ThreadSafe> Body,
+		const TArray<TPair<FString, FString>>& Fields, FHttpRequestCompleteDelegate OnComplete)
+	{
+		for (const TPair<FString, FString>& Field : Fields)
+		{
+			Body->AddField(Field.Key, Field.Value);
+		}
+		Body->Finish();
+
+		TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+		HttpRequest->SetURL(UOpenAIUtils::getBaseUrl() + Endpoint);
+		HttpRequest->SetVerb(TEXT("POST"));
+		HttpRequest->SetHeader(TEXT("Authorization"), AuthHeader);
+		HttpRequest->SetHeader(TEXT("Content-Type"), Body->GetContentType());
+		HttpRequest->SetContentFromStream(Body);
+		HttpRequest->OnProcessRequestComplete() = OnComplete;
+
+		if (!HttpRequest->ProcessRequest())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Error sending request to %s"), *Endpoint);
+			HttpRequest->OnProcessRequestComplete().Unbind();
+			OnComplete.ExecuteIfBound(HttpRequest, nullptr, false);
+		}
+	}
+}
+
+bool OpenAIAudioUpload::Send(FUpload&& Upload, FHttpRequestCompleteDelegate OnComplete, FString& OutError)
+{
+	check(IsInGameThread());
+
+	FString ApiKey;
+	if (UOpenAIUtils::getUseApiKeyFromEnvironmentVars())
+		ApiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		ApiKey = UOpenAIUtils::getApiKey();
+
+	if (ApiKey.IsEmpty())
+	{
+		OutError = TEXT("Api key is not set");
+		return false;
+	}
+	if (Upload.Samples.Num() == 0 && Upload.FileName.IsEmpty())
+	{
+		OutError = TEXT("No audio to send");
+		return false;
+	}
+
+	const FString AuthHeader = TEXT("Bearer ") + ApiKey;
+	TSharedRef<FOpenAIMultipartBody, ESPMode::ThreadSafe> Body = MakeShared<FOpenAIMultipartBody, ESPMode::ThreadSafe>();
+	if (Upload.Samples.Num() > 0)
+	{
+		// captured audio is compressed on a worker thread, the request is sent once it is ready
+		OpenAIAudioCodec::EncodeUploadAsync(Upload.UploadFormat, MoveTemp(Upload.Samples), Upload.SampleRate, Upload.NumChannels, Upload.OpusBitrate,
+			[Endpoint = MoveTemp(Upload.Endpoint), Fields = MoveTemp(Upload.Fields), AuthHeader, Body, OnComplete](OpenAIAudioCodec::FEncodedUpload&& Encoded)
+		{
+			// a node destroyed while encoding has nothing to report to
+			if (OnComplete.IsBound())
+			{
+				Body->AddFile(TEXT("file"), MoveTemp(Encoded.Bytes), Encoded.FileName, Encoded.ContentType);
+				SendBody(Endpoint, AuthHeader, Body, Fields, OnComplete);
+			}
+		});
+		return true;
+	}
+
+	// the wav is streamed from disk while the request is sent instead of being loaded up front
+	const FString AbsolutePath = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() + TEXT("BouncedWavFiles/") + Upload.FileName);
+	if (!Body->AddFile(TEXT("file"), AbsolutePath, Upload.FileName, TEXT("audio/wav")))
+	{
+		OutError = FString::Printf(TEXT("Cannot read %s"), *AbsolutePath);
+		return false;
+	}
+	SendBody(Upload.Endpoint, AuthHeader, Body, Upload.Fields, OnComplete);
+	return true;
+}
@@ -0,0 +1,754 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIBatch.h"
+#include "OpenAIUtils.h"
+#include "OpenAICallChat.h"
+#include "OpenAIEmbedding.h"
+#include "OpenAIJsonReader.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIMultipartBody.h"
+#include "OpenAIParser.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	// Per input file limits of the Batch API
+	constexpr int32 MaxBatchRequests = 50000;
+	constexpr int64 MaxBatchBytes = 200ll * 1024 * 1024;
+
+	// Results files are read this much at a time; a longer line grows the buffer to fit
+	constexpr int32 ResultsChunkSize = 1024 * 1024;
+
+	const TCHAR* GetEndpointPath(EOABatchEndpoint Endpoint)
+	{
+		return Endpoint == EOABatchEndpoint::EMBEDDINGS ? TEXT("/v1/embeddings") : TEXT("/v1/chat/completions");
+	}
+
+	bool ReadOptionalString(FOpenAIJsonReader& Reader, FString& OutValue)
+	{
+		return Reader.TryReadNull() || Reader.ReadString(OutValue);
+	}
+
+	// Reads {"message": ...} style error objects; anything else is skipped
+	void ReadErrorMessage(FOpenAIJsonReader& Reader, FString& OutMessage)
+	{
+		if (Reader.Peek() != EOpenAIJsonToken::ObjectStart)
+		{
+			Reader.Skip();
+			return;
+		}
+
+		Reader.ReadObjectStart();
+		FAnsiStringView Key;
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "message")
+			{
+				ReadOptionalString(Reader, OutMessage);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+
+	/**
+	 * Splits one results line into its custom_id and the raw response body. A request the batch
+	 * could not run has no body and OutError set instead.
+	 */
+	bool ReadResultLine(TArrayView<const uint8> Line, FString& OutCustomId, TArrayView<const uint8>& OutBody, FString& OutError)
+	{
+		OutCustomId.Reset();
+		OutBody = {};
+		OutError.Reset();
+
+		FOpenAIJsonReader Reader(Line);
+		FAnsiStringView Key;
+		if (Reader.ReadObjectStart())
+		{
+			while (Reader.NextMember(Key))
+			{
+				if (Key == "custom_id")
+				{
+					ReadOptionalString(Reader, OutCustomId);
+				}
+				else if (Key == "response")
+				{
+					if (Reader.TryReadNull() || !Reader.ReadObjectStart())
+					{
+						continue;
+					}
+					while (Reader.NextMember(Key))
+					{
+						if (Key == "body")
+						{
+							Reader.ReadRawValue(OutBody);
+						}
+						else
+						{
+							Reader.Skip();
+						}
+					}
+				}
+				else if (Key == "error")
+				{
+					if (!Reader.TryReadNull())
+					{
+						FString Message;
+						ReadErrorMessage(Reader, Message);
+						OutError = TEXT("Batch error: ") + Message;
+					}
+				}
+				else
+				{
+					Reader.Skip();
+				}
+			}
+		}
+
+		if (Reader.HasError())
+		{
+			OutError = FString::Printf(TEXT("Malformed result at byte %d"), Reader.GetErrorOffset());
+			return false;
+		}
+		if (OutBody.Num() == 0 && OutError.IsEmpty())
+		{
+			OutError = TEXT("Result has no response");
+		}
+		return true;
+	}
+
+	/** Calls OnLine for each non-empty line of the file, holding one chunk of it in memory at a time. */
+	bool ForEachLine(const FString& Path, TFunctionRef<void(TArrayView<const uint8> Line)> OnLine)
+	{
+		TUniquePtr<FArchive> File(IFileManager::Get().CreateFileReader(*Path));
+		if (!File)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Cannot open batch results %s"), *Path);
+			return false;
+		}
+
+		auto EmitLine = [&OnLine](const uint8* Start, int32 Len)
+		{
+			if (Len > 0 && Start[Len - 1] == '\r')
+			{
+				Len--;
+			}
+			if (Len > 0)
+			{
+				OnLine(TArrayView<const uint8>(Start, Len));
+			}
+		};
+
+		TArray<uint8> Buffer;
+		Buffer.SetNumUninitialized(ResultsChunkSize);
+		int32 Filled = 0;
+		int64 Remaining = File->TotalSize();
+		while (Remaining > 0)
+		{
+			if (Filled == Buffer.Num())
+			{
+				Buffer.SetNumUninitialized(Buffer.Num() * 2);
+			}
+			const int32 ScanFrom = Filled;
+			const int32 ToRead = (int32)FMath::Min<int64>(Buffer.Num() - Filled, Remaining);
+			File->Serialize(Buffer.GetData() + Filled, ToRead);
+			if (File->IsError())
+			{
+				return false;
+			}
+			Filled += ToRead;
+			Remaining -= ToRead;
+
+			// Only the new bytes can hold a line end; everything before them is an unfinished line
+			uint8* Data = Buffer.GetData();
+			int32 LineStart = 0;
+			for (int32 Index = ScanFrom; Index < Filled; Index++)
+			{
+				if (Data[Index] == '\n')
+				{
+					EmitLine(Data + LineStart, Index - LineStart);
+					LineStart = Index + 1;
+				}
+			}
+
+			Filled -= LineStart;
+			FMemory::Memmove(Data, Data + LineStart, Filled);
+		}
+
+		EmitLine(Buffer.GetData(), Filled);
+		return true;
+	}
+
+	FString GetApiKey()
+	{
+		return UOpenAIUtils::getUseApiKeyFromEnvironmentVars() ? UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY")) : UOpenAIUtils::getApiKey();
+	}
+}
+
+FOpenAIBatchWriter::FOpenAIBatchWriter(const FString& InPath)
+	: File(IFileManager::Get().CreateFileWriter(*InPath))
+	, Path(InPath)
+	, Count(0)
+	, Bytes(0)
+	, Endpoint(EOABatchEndpoint::CHAT_COMPLETIONS)
+	, bError(false)
+{
+	if (!File)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cannot create batch input %s"), *Path);
+		bError = true;
+	}
+}
+
+FOpenAIBatchWriter::~FOpenAIBatchWriter()
+{
+	Close();
+}
+
+bool FOpenAIBatchWriter::CanAdd(EOABatchEndpoint LineEndpoint)
+{
+	if (!File)
+	{
+		return false;
+	}
+	if (Count == 0)
+	{
+		Endpoint = LineEndpoint;
+	}
+	else if (LineEndpoint != Endpoint)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Batch %s already holds requests for %s"), *Path, GetEndpointPath(Endpoint));
+		return false;
+	}
+	if (Count >= MaxBatchRequests)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Batch %s is full at %d requests"), *Path, MaxBatchRequests);
+		return false;
+	}
+	return true;
+}
+
+void FOpenAIBatchWriter::BeginLine(FOpenAIJsonWriter& Writer, const FString& CustomId)
+{
+	Writer.BeginObject();
+	Writer.Field("custom_id", CustomId);
+	Writer.Field("method", TEXT("POST"));
+	Writer.Field("url", GetEndpointPath(Endpoint));
+	Writer.Key("body");
+}
+
+bool FOpenAIBatchWriter::EndLine()
+{
+	Line.Add('\n');
+	if (Bytes + Line.Num() > MaxBatchBytes)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Batch %s would pass %lld bytes"), *Path, MaxBatchBytes);
+		return false;
+	}
+
+	File->Serialize(Line.GetData(), Line.Num());
+	if (File->IsError())
+	{
+		bError = true;
+		return false;
+	}
+	Bytes += Line.Num();
+	Count++;
+	return true;
+}
+
+bool FOpenAIBatchWriter::AddChat(const FString& CustomId, const FChatSettings& ChatSettings)
+{
+	if (!CanAdd(EOABatchEndpoint::CHAT_COMPLETIONS))
+	{
+		return false;
+	}
+
+	Line.Reset();
+	FOpenAIJsonWriter Writer(Line);
+	BeginLine(Writer, CustomId);
+	if (ChatSettings.canonicalPromptPrefix)
+	{
+		FChatSettings Canonical = ChatSettings;
+		UOpenAIUtils::CanonicalizePromptPrefix(Canonical.messages);
+		UOpenAICallChat::WriteRequestBody(Writer, Canonical);
+	}
+	else
+	{
+		UOpenAICallChat::WriteRequestBody(Writer, ChatSettings);
+	}
+	Writer.EndObject();
+	return EndLine();
+}
+
+bool FOpenAIBatchWriter::AddEmbedding(const FString& CustomId, const FEmbeddingSettings& EmbeddingSettings)
+{
+	if (!CanAdd(EOABatchEndpoint::EMBEDDINGS))
+	{
+		return false;
+	}
+
+	Line.Reset();
+	FOpenAIJsonWriter Writer(Line);
+	BeginLine(Writer, CustomId);
+	UOpenAIEmbedding::WriteRequestBody(Writer, EmbeddingSettings);
+	Writer.EndObject();
+	return EndLine();
+}
+
+bool FOpenAIBatchWriter::Close()
+{
+	if (File)
+	{
+		bError |= !File->Close();
+		File.Reset();
+	}
+	return !bError;
+}
+
+UOpenAIBatch::UOpenAIBatch()
+	: PollIntervalSeconds(30.0f)
+	, Endpoint(EOABatchEndpoint::CHAT_COMPLETIONS)
+{
+}
+
+UOpenAIBatch* UOpenAIBatch::Run(const FString& InputPath, const FString& OutputPath, EOABatchEndpoint Endpoint,
+	TFunction<void(const FBatchStatus& Status, const FString& ErrorMessage, bool Success)> Callback,
+	TFunction<void(const FBatchStatus& Status)> OnProgress)
+{
+	UOpenAIBatch* Batch = NewObject<UOpenAIBatch>();
+	Batch->AddToRoot();
+	Batch->InputPath = InputPath;
+	Batch->OutputPath = OutputPath;
+	Batch->Endpoint = Endpoint;
+	Batch->Callback = MoveTemp(Callback);
+	Batch->OnProgress = MoveTemp(OnProgress);
+	Batch->ApiKey = GetApiKey();
+
+	if (Batch->ApiKey.IsEmpty())
+	{
+		Batch->Finish(TEXT("Api key is not set"), false);
+	}
+	else
+	{
+		Batch->Upload();
+	}
+	return Batch;
+}
+
+TSharedRef<IHttpRequest, ESPMode::ThreadSafe> UOpenAIBatch::CreateRequest(const FString& Verb, const FString& Path) const
+{
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(UOpenAIUtils::getBaseUrl() + Path);
+	HttpRequest->SetVerb(Verb);
+	HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + ApiKey);
+	return HttpRequest;
+}
+
+void UOpenAIBatch::Upload()
+{
+	// Streamed from disk while it is sent, so a 200 MB input never sits in memory
+	TSharedRef<FOpenAIMultipartBody, ESPMode::ThreadSafe> Body = MakeShared<FOpenAIMultipartBody, ESPMode::ThreadSafe>();
+	Body->AddField(TEXT("purpose"), TEXT("batch"));
+	if (!Body->AddFile(TEXT("file"), InputPath, FPaths::GetCleanFilename(InputPath), TEXT("application/jsonl")))
+	{
+		Finish(FString::Printf(TEXT("Cannot read batch input %s"), *InputPath), false);
+		return;
+	}
+	Body->Finish();
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("POST"), TEXT("/files"));
+	HttpRequest->SetHeader(TEXT("Content-Type"), Body->GetContentType());
+	HttpRequest->SetContentFromStream(Body);
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAIBatch::OnUploaded);
+	CurrentRequest = HttpRequest;
+	HttpRequest->ProcessRequest();
+}
+
+void UOpenAIBatch::OnUploaded(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	CurrentRequest.Reset();
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		Finish(TEXT("Uploading the batch input failed"), false);
+		return;
+	}
+
+	FString FileId;
+	FString Error;
+	FOpenAIJsonReader Reader(Response->GetContent());
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "id")
+			{
+				ReadOptionalString(Reader, FileId);
+			}
+			else if (Key == "error")
+			{
+				ReadErrorMessage(Reader, Error);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+	if (FileId.IsEmpty())
+	{
+		Finish(TEXT("Uploading the batch input failed: ") + (Error.IsEmpty() ? Response->GetContentAsString() : Error), false);
+		return;
+	}
+	Status.inputFileId = FileId;
+
+	FOpenAIJsonWriter Writer;
+	Writer.BeginObject();
+	Writer.Field("input_file_id", FileId);
+	Writer.Field("endpoint", GetEndpointPath(Endpoint));
+	Writer.Field("completion_window", TEXT("24h"));
+	Writer.EndObject();
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("POST"), TEXT("/batches"));
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	HttpRequest->SetContent(Writer.GetBuffer());
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAIBatch::OnCreated);
+	CurrentRequest = HttpRequest;
+	HttpRequest->ProcessRequest();
+}
+
+bool UOpenAIBatch::ReadStatus(FHttpResponsePtr Response, bool WasSuccessful, FString& OutError)
+{
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		OutError = TEXT("Batch request failed: No response from server");
+		return false;
+	}
+
+	FString ApiError;
+	FOpenAIJsonReader Reader(Response->GetContent());
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "id")
+			{
+				ReadOptionalString(Reader, Status.id);
+			}
+			else if (Key == "status")
+			{
+				ReadOptionalString(Reader, Status.status);
+			}
+			else if (Key == "input_file_id")
+			{
+				ReadOptionalString(Reader, Status.inputFileId);
+			}
+			else if (Key == "output_file_id")
+			{
+				ReadOptionalString(Reader, Status.outputFileId);
+			}
+			else if (Key == "error_file_id")
+			{
+				ReadOptionalString(Reader, Status.errorFileId);
+			}
+			else if (Key == "request_counts" && Reader.Peek() == EOpenAIJsonToken::ObjectStart)
+			{
+				Reader.ReadObjectStart();
+				while (Reader.NextMember(Key))
+				{
+					int32* Count = Key == "total" ? &Status.total : Key == "completed" ? &Status.completed : Key == "failed" ? &Status.failed : nullptr;
+					int64 Value = 0;
+					if (!Count)
+					{
+						Reader.Skip();
+					}
+					else if (Reader.ReadInteger(Value))
+					{
+						*Count = (int32)Value;
+					}
+				}
+			}
+			else if (Key == "errors" && Reader.Peek() == EOpenAIJsonToken::ObjectStart)
+			{
+				// {"object": "list", "data": [{"code", "message", "line"}]}
+				Reader.ReadObjectStart();
+				while (Reader.NextMember(Key))
+				{
+					if (Key == "data" && Reader.Peek() == EOpenAIJsonToken::ArrayStart)
+					{
+						Reader.ReadArrayStart();
+						while (Reader.NextElement())
+						{
+							FString Message;
+							ReadErrorMessage(Reader, Message);
+							if (BatchError.IsEmpty())
+							{
+								BatchError = Message;
+							}
+						}
+					}
+					else
+					{
+						Reader.Skip();
+					}
+				}
+			}
+			else if (Key == "error")
+			{
+				ReadErrorMessage(Reader, ApiError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+
+	if (Reader.HasError())
+	{
+		OutError = FString::Printf(TEXT("Malformed batch response at byte %d"), Reader.GetErrorOffset());
+		return false;
+	}
+	if (!EHttpResponseCodes::IsOk(Response->GetResponseCode()) || Status.id.IsEmpty())
+	{
+		OutError = TEXT("Api error: ") + (ApiError.IsEmpty() ? Response->GetContentAsString() : ApiError);
+		return false;
+	}
+	return true;
+}
+
+void UOpenAIBatch::OnCreated(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	CurrentRequest.Reset();
+	FString Error;
+	if (!ReadStatus(Response, WasSuccessful, Error))
+	{
+		Finish(Error, false);
+		return;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Batch %s created from %s"), *Status.id, *Status.inputFileId);
+	if (OnProgress)
+	{
+		OnProgress(Status);
+	}
+	PollHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UOpenAIBatch::Poll), PollIntervalSeconds);
+}
+
+bool UOpenAIBatch::Poll(float DeltaTime)
+{
+	PollHandle.Reset();
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("GET"), TEXT("/batches/") + Status.id);
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAIBatch::OnPolled);
+	CurrentRequest = HttpRequest;
+	HttpRequest->ProcessRequest();
+
+	// One shot; the next poll is scheduled once this one has answered
+	return false;
+}
+
+void UOpenAIBatch::OnPolled(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	CurrentRequest.Reset();
+	FString Error;
+	if (!ReadStatus(Response, WasSuccessful, Error))
+	{
+		// A failed poll says nothing about the job, so try again on the next interval
+		UE_LOG(LogTemp, Warning, TEXT("Polling batch %s failed: %s"), *Status.id, *Error);
+	}
+	else if (Status.status == TEXT("failed"))
+	{
+		Finish(BatchError.IsEmpty() ? TEXT("Batch failed") : TEXT("Batch failed: ") + BatchError, false);
+		return;
+	}
+	else if (Status.status == TEXT("completed") || Status.status == TEXT("expired") || Status.status == TEXT("cancelled"))
+	{
+		// Expired and cancelled jobs still hand back the requests that finished in time
+		if (!Status.outputFileId.IsEmpty())
+		{
+			Download(Status.outputFileId, false);
+		}
+		else if (!Status.errorFileId.IsEmpty())
+		{
+			Download(Status.errorFileId, false);
+		}
+		else
+		{
+			Finish(Status.status == TEXT("completed") ? FString() : TEXT("Batch ") + Status.status, Status.status == TEXT("completed"));
+		}
+		return;
+	}
+	else if (OnProgress)
+	{
+		OnProgress(Status);
+	}
+
+	PollHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UOpenAIBatch::Poll), PollIntervalSeconds);
+}
+
+void UOpenAIBatch::Download(const FString& FileId, bool bAppend)
+{
+	// Written to disk by the HTTP thread as it arrives, so results of hundreds of MB never sit in memory
+	FArchive* Writer = IFileManager::Get().CreateFileWriter(*OutputPath, bAppend ? FILEWRITE_Append : FILEWRITE_None);
+	if (!Writer)
+	{
+		Finish(FString::Printf(TEXT("Cannot write batch results to %s"), *OutputPath), false);
+		return;
+	}
+	TSharedRef<FArchive> File = MakeShareable(Writer);
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("GET"), FString::Printf(TEXT("/files/%s/content"), *FileId));
+	HttpRequest->SetResponseBodyReceiveStream(File);
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAIBatch::OnDownloaded, bAppend, File);
+	CurrentRequest = HttpRequest;
+	if (!HttpRequest->ProcessRequest())
+	{
+		CurrentRequest.Reset();
+		File->Close();
+		Finish(TEXT("Error sending request"), false);
+	}
+}
+
+void UOpenAIBatch::OnDownloaded(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, bool bAppend, TSharedRef<FArchive> File)
+{
+	CurrentRequest.Reset();
+	const bool bWritten = File->Close() && !File->IsError();
+
+	if (!WasSuccessful || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		// The body went to the file; an error body is small, so it is read back for the message
+		FString ErrorBody = Response.IsValid() ? FString::Printf(TEXT("Request failed with status %d"), Response->GetResponseCode()) : TEXT("No response from server");
+		if (!bAppend)
+		{
+			FString Body;
+			if (Response.IsValid() && IFileManager::Get().FileSize(*OutputPath) < 64 * 1024 && FFileHelper::LoadFileToString(Body, *OutputPath) && !Body.IsEmpty())
+			{
+				ErrorBody = MoveTemp(Body);
+			}
+			IFileManager::Get().Delete(*OutputPath);
+		}
+		Finish(TEXT("Downloading the batch results failed: ") + ErrorBody, false);
+		return;
+	}
+
+	if (!bWritten)
+	{
+		Finish(FString::Printf(TEXT("Cannot write batch results to %s"), *OutputPath), false);
+		return;
+	}
+
+	// Failed requests live in a separate file; both share the line format, so they go into one results file
+	if (!bAppend && !Status.outputFileId.IsEmpty() && !Status.errorFileId.IsEmpty())
+	{
+		Download(Status.errorFileId, true);
+		return;
+	}
+
+	const bool bCompleted = Status.status == TEXT("completed");
+	Finish(bCompleted ? FString() : TEXT("Batch ") + Status.status, bCompleted);
+}
+
+void UOpenAIBatch::Cancel()
+{
+	if (Status.id.IsEmpty())
+	{
+		// Not created yet; stop the upload or create request and give up locally
+		if (CurrentRequest.IsValid())
+		{
+			CurrentRequest->OnProcessRequestComplete().Unbind();
+			CurrentRequest->CancelRequest();
+			CurrentRequest.Reset();
+		}
+		Finish(TEXT("Batch cancelled"), false);
+		return;
+	}
+
+	// Polling carries on until the job reports cancelled, then the partial results are saved
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = CreateRequest(TEXT("POST"), FString::Printf(TEXT("/batches/%s/cancel"), *Status.id));
+	HttpRequest->ProcessRequest();
+}
+
+void UOpenAIBatch::Finish(const FString& ErrorMessage, bool Success)
+{
+	if (!Success)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Batch %s failed. Error: %s"), *Status.id, *ErrorMessage);
+	}
+
+	FTSTicker::GetCoreTicker().RemoveTicker(PollHandle);
+	PollHandle.Reset();
+
+	// Called once; a late Cancel() after this finds nothing to report to
+	TFunction<void(const FBatchStatus&, const FString&, bool)> FinishedCallback = MoveTemp(Callback);
+	Callback = nullptr;
+	OnProgress = nullptr;
+	if (FinishedCallback)
+	{
+		FinishedCallback(Status, ErrorMessage, Success);
+	}
+
+	RemoveFromRoot();
+	ConditionalBeginDestroy();
+}
+
+void UOpenAIBatch::BeginDestroy()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(PollHandle);
+	PollHandle.Reset();
+	if (CurrentRequest.IsValid())
+	{
+		CurrentRequest->OnProcessRequestComplete().Unbind();
+		CurrentRequest->CancelRequest();
+		CurrentRequest.Reset();
+	}
+	Super::BeginDestroy();
+}
+
+bool UOpenAIBatch::ReadChatResults(const FString& Path,
+	TFunctionRef<void(const FString& CustomId, const TArray<FChatCompletion>& Choices, const FChatUsage& Usage, const FString& ErrorMessage)> OnResult)
+{
+	OpenAIParser parser;
+	FString CustomId;
+	FString Error;
+	TArray<FChatCompletion> Choices;
+	FChatUsage Usage;
+	return ForEachLine(Path, [&](TArrayView<const uint8> Line)
+	{
+		TArrayView<const uint8> Body;
+		Choices.Reset();
+		Usage = {};
+		if (ReadResultLine(Line, CustomId, Body, Error) && Body.Num() > 0)
+		{
+			parser.DecodeChatCompletions(Body, Choices, Usage, Error);
+		}
+		OnResult(CustomId, Choices, Usage, Error);
+	});
+}
+
+bool UOpenAIBatch::ReadEmbeddingResults(const FString& Path,
+	TFunctionRef<void(const FString& CustomId, const FEmbeddingResult& Result, const FString& ErrorMessage)> OnResult)
+{
+	OpenAIParser parser;
+	FString CustomId;
+	FString Error;
+	FEmbeddingResult Result;
+	return ForEachLine(Path, [&](TArrayView<const uint8> Line)
+	{
+		TArrayView<const uint8> Body;
+		Result.embeddingVector.Components.Reset();
+		if (ReadResultLine(Line, CustomId, Body, Error) && Body.Num() > 0)
+		{
+			parser.DecodeEmbedding(Body, Result, Error);
+		}
+		OnResult(CustomId, Result, Error);
+	});
+}
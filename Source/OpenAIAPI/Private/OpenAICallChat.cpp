@@ -7,6 +7,136 @@
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
 #include "OpenAIParser.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIModels.h"
+#include "OpenAITokenizer.h"
+#include "OpenAIToolbox.h"
+#include "OpenAIStructuredOutput.h"
+#include "UObject/StructOnScope.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+
+/**
+ * Response body sink for a streamed chat request. The HTTP thread splits the body into server-sent
+ * events as it arrives and decodes each; content deltas collect here until the game thread takes
+ * them. A body that holds no events, i.e. an error, is kept for the game thread instead.
+ */
+class FOpenAIChatStream final : public FArchive
+{
+public:
+	explicit FOpenAIChatStream(TFunction<void()> InOnDelta)
+		: OnDelta(MoveTemp(InOnDelta))
+	{
+		SetIsSaving(true);
+	}
+
+	virtual void Serialize(void* Data, int64 Num) override
+	{
+		const uint8* Bytes = (const uint8*)Data;
+		Received += Num;
+		if (!bSawEvent)
+		{
+			Held.Append(Bytes, (int32)Num);
+		}
+
+		// events are lines; a chunk can end in the middle of one
+		int32 Start = 0;
+		for (int32 i = 0; i < (int32)Num; i++)
+		{
+			if (Bytes[i] == '\n')
+			{
+				Line.Append(Bytes + Start, i - Start);
+				ParseLine();
+				Start = i + 1;
+			}
+		}
+		Line.Append(Bytes + Start, (int32)Num - Start);
+	}
+
+	virtual int64 Tell() override { return Received; }
+	virtual FString GetArchiveName() const override { return TEXT("FOpenAIChatStream"); }
+
+	/** Called on the game thread once the body is complete. */
+	void Finish()
+	{
+		ParseLine();
+	}
+
+	FString TakeDelta()
+	{
+		FScopeLock ScopeLock(&Lock);
+		return MoveTemp(PendingDelta);
+	}
+
+	bool HasEvents() const { return bSawEvent; }
+	const FString& GetFinishReason() const { return FinishReason; }
+	const FChatUsage& GetUsage() const { return Usage; }
+	const FString& GetError() const { return Error; }
+	const TArray<uint8>& GetHeldBody() const { return Held; }
+
+	/** The request is going away; nothing is announced after this. */
+	void Detach()
+	{
+		FScopeLock ScopeLock(&Lock);
+		OnDelta = nullptr;
+	}
+
+private:
+	void ParseLine()
+	{
+		if (Line.Num() > 0 && Line.Last() == '\r')
+		{
+			Line.Pop(EAllowShrinking::No);
+		}
+
+		// only "data: <json>" lines matter; comments, other fields and the blank lines between events do not
+		const FAnsiStringView Text((const ANSICHAR*)Line.GetData(), Line.Num());
+		if (Text.StartsWith("data:"))
+		{
+			const FAnsiStringView Payload = Text.RightChop(Text.StartsWith("data: ") ? 6 : 5);
+			if (Payload != "[DONE]")
+			{
+				if (!bSawEvent)
+				{
+					bSawEvent = true;
+					Held.Empty();
+				}
+
+				FString Delta;
+				FString EventError;
+				Parser.DecodeChatCompletionChunk(MakeArrayView((const uint8*)Payload.GetData(), Payload.Len()), Delta, FinishReason, Usage, EventError);
+
+				FScopeLock ScopeLock(&Lock);
+				if (!EventError.IsEmpty() && Error.IsEmpty())
+				{
+					Error = EventError;
+				}
+				const bool bAnnounce = PendingDelta.IsEmpty() && !Delta.IsEmpty();
+				PendingDelta += Delta;
+				if (bAnnounce && OnDelta)
+				{
+					OnDelta();
+				}
+			}
+		}
+		Line.Reset();
+	}
+
+	TFunction<void()> OnDelta;
+	FCriticalSection Lock;
+
+	int64 Received = 0;
+	bool bSawEvent = false;
+	// The whole body until the first event
+	TArray<uint8> Held;
+	TArray<uint8> Line;
+
+	OpenAIParser Parser;
+	FString PendingDelta;
+	FString FinishReason;
+	FChatUsage Usage;
+	FString Error;
+};
 
 UOpenAICallChat::UOpenAICallChat()
 {
@@ -23,6 +153,101 @@ UOpenAICallChat* UOpenAICallChat::OpenAICallChat(FChatSettings chatSettingsInput
 	return BPNode;
 }
 
+UOpenAICallChat* UOpenAICallChat::Chat(const FChatSettings& ChatSettings,
+	TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback)
+{
+	UOpenAICallChat* ChatNode = OpenAICallChat(ChatSettings);
+	ChatNode->AddToRoot();
+	return ChatNode->Start(MoveTemp(Callback));
+}
+
+UOpenAICallChat* UOpenAICallChat::Chat(const FChatSettings& ChatSettings, TSharedRef<const FOpenAIToolbox, ESPMode::ThreadSafe> Toolbox,
+	TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback)
+{
+	UOpenAICallChat* ChatNode = OpenAICallChat(ChatSettings);
+	ChatNode->AddToRoot();
+	ChatNode->Toolbox = Toolbox;
+	for (const FChatTool& Tool : Toolbox->GetDefinitions())
+	{
+		if (!ChatNode->chatSettings.tools.ContainsByPredicate([&Tool](const FChatTool& Existing) { return Existing.name == Tool.name; }))
+		{
+			ChatNode->chatSettings.tools.Add(Tool);
+		}
+	}
+	return ChatNode->Start(MoveTemp(Callback));
+}
+
+UOpenAICallChat* UOpenAICallChat::ChatStructured(const FChatSettings& ChatSettings, const UScriptStruct* Struct,
+	TFunction<void(const void* Result, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback)
+{
+	FChatSettings StructuredSettings = ChatSettings;
+	StructuredSettings.responseStruct = const_cast<UScriptStruct*>(Struct);
+
+	UOpenAICallChat* ChatNode = OpenAICallChat(StructuredSettings);
+	ChatNode->AddToRoot();
+	return ChatNode->Start([ChatNode, Callback](const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)
+	{
+		const bool bDecoded = Success && ChatNode->StructuredOutput.IsValid();
+		if (Callback)
+		{
+			Callback(bDecoded ? ChatNode->StructuredOutput->GetStructMemory() : nullptr, Usage, ErrorMessage, bDecoded);
+		}
+	});
+}
+
+UOpenAICallChat* UOpenAICallChat::ChatStreamed(const FChatSettings& ChatSettings, TFunction<void(const FString& Delta)> OnDelta,
+	TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback)
+{
+	UOpenAICallChat* ChatNode = OpenAICallChat(ChatSettings);
+	ChatNode->AddToRoot();
+	ChatNode->bStreamReply = true;
+	TSharedRef<bool> bGotDelta = MakeShared<bool>(false);
+	ChatNode->DeltaF.BindLambda([OnDelta, bGotDelta](const FString& Delta)
+	{
+		*bGotDelta = true;
+		if (OnDelta)
+		{
+			OnDelta(Delta);
+		}
+	});
+	return ChatNode->Start([OnDelta, Callback, bGotDelta](const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)
+	{
+		// a reply that was not streamed still reaches OnDelta, in one piece
+		if (Success && !*bGotDelta && OnDelta && !Message.message.content.IsEmpty())
+		{
+			OnDelta(Message.message.content);
+		}
+
+		if (Callback)
+		{
+			Callback(Message, Usage, ErrorMessage, Success);
+		}
+	});
+}
+
+UOpenAICallChat* UOpenAICallChat::Start(TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback)
+{
+	UOpenAICallChat* ChatNode = this;
+	FinishedF.BindLambda([Callback, ChatNode](const FChatCompletion& Message, const TArray<FChatCompletion>& Choices, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)
+	{
+		if (!Success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Chat request failed. Error: %s"), *ErrorMessage);
+		}
+
+		if (Callback)
+		{
+			Callback(Message, Usage, ErrorMessage, Success);
+		}
+
+		ChatNode->RemoveFromRoot();
+		ChatNode->ConditionalBeginDestroy();
+	});
+
+	Activate();
+	return this;
+}
+
 void UOpenAICallChat::Activate()
 {
 	FString _apiKey;
@@ -31,38 +256,37 @@ void UOpenAICallChat::Activate()
 	else
 		_apiKey = UOpenAIUtils::getApiKey();
 
+	if (chatSettings.canonicalPromptPrefix)
+	{
+		UOpenAIUtils::CanonicalizePromptPrefix(chatSettings.messages);
+	}
+
+	// count the prompt up front so a history that cannot fit fails without a round trip
+	const FOpenAIModelInfo& Model = FOpenAIModels::Get(chatSettings);
+	const FOpenAITokenizer& Tokenizer = FOpenAITokenizer::Get(Model.Encoding);
+	const int32 PromptTokens = Tokenizer.CountChatTokens(chatSettings.messages);
+	const int32 ContextWindow = Model.ContextWindow;
+
 	// checking parameters are valid
 	if (_apiKey.IsEmpty())
 	{
-		Finished.Broadcast({}, TEXT("Api key is not set"), false);
+		BroadcastFinished({}, {}, {}, TEXT("Api key is not set"), false);
+	}
+	else if (chatSettings.maxTokens > Model.MaxOutputTokens)
+	{
+		BroadcastFinished({}, {}, {}, FString::Printf(TEXT("Max tokens is %d, %s replies with at most %d"),
+			chatSettings.maxTokens, *FOpenAIModels::GetModelName(chatSettings), Model.MaxOutputTokens), false);
+	}
+	else if (Tokenizer.IsExact() && PromptTokens + chatSettings.maxTokens > ContextWindow)
+	{
+		BroadcastFinished({}, {}, {}, FString::Printf(TEXT("Prompt is %d tokens, with max tokens %d it does not fit the %d token context window"),
+			PromptTokens, chatSettings.maxTokens, ContextWindow), false);
 	}	else
 	{
+		UE_LOG(LogTemp, Verbose, TEXT("Chat prompt is %s%d tokens"), Tokenizer.IsExact() ? TEXT("") : TEXT("about "), PromptTokens);
 
 		auto HttpRequest = FHttpModule::Get().CreateRequest();
 
-		FString apiMethod;
-		switch (chatSettings.model)
-		{
-		case EOAChatEngineType::GPT_3_5_TURBO:
-			apiMethod = "gpt-3.5-turbo";
-			break;
-		case EOAChatEngineType::GPT_4:
-			apiMethod = "gpt-4";
-			break;
-		case EOAChatEngineType::GPT_4o:
-			apiMethod = "gpt-4o";
-			break;
-		case EOAChatEngineType::GPT_4o_mini:
-			apiMethod = "gpt-4o-mini";
-			break;
-		case EOAChatEngineType::GPT_4_32k:
-			apiMethod = "gpt-4-32k";
-			break;
-			case EOAChatEngineType::GPT_4_TURBO:
-				apiMethod = "gpt-4-0125-preview";
-			break;
-		}
-
 		//TODO: add aditional params to match the ones listed in the curl response in: https://platform.openai.com/docs/api-reference/making-requests
 
 		// convert parameters to strings
@@ -70,52 +294,40 @@ void UOpenAICallChat::Activate()
 		tempHeader += _apiKey;
 
 		// set headers
-		FString url = FString::Printf(TEXT("https://api.openai.com/v1/chat/completions"));
+		FString url = UOpenAIUtils::getBaseUrl() + TEXT("/chat/completions");
 		HttpRequest->SetURL(url);
 		HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
 		HttpRequest->SetHeader(TEXT("Authorization"), tempHeader);
 
-		//build payload
-		TSharedPtr<FJsonObject> _payloadObject = MakeShareable(new FJsonObject());
-		_payloadObject->SetStringField(TEXT("model"), apiMethod);
-		_payloadObject->SetNumberField(TEXT("max_tokens"), chatSettings.maxTokens);
+		// tool calls and structured replies are only useful whole, so those are never streamed
+		const bool bStream = bStreamReply && chatSettings.tools.Num() == 0 && !chatSettings.responseStruct;
 
+		//build payload, written straight to UTF-8
+		FOpenAIJsonWriter Writer;
+		WriteRequestBody(Writer, chatSettings, bStream);
 
-		// convert role enum to model string
-		if (!(chatSettings.messages.Num() == 0))
+		// commit request
+		HttpRequest->SetVerb(TEXT("POST"));
+		HttpRequest->SetContent(Writer.GetBuffer());
+
+		if (bStream)
 		{
-			TArray<TSharedPtr<FJsonValue>> Messages;
-			FString role;
-			for (int i = 0; i < chatSettings.messages.Num(); i++)
+			// deltas are announced from the HTTP thread and taken in order on the game thread
+			TWeakObjectPtr<UOpenAICallChat> WeakThis(this);
+			Stream = MakeShared<FOpenAIChatStream, ESPMode::ThreadSafe>([WeakThis]()
 			{
-				TSharedPtr<FJsonObject> Message = MakeShareable(new FJsonObject());
-				switch (chatSettings.messages[i].role)
+				AsyncTask(ENamedThreads::GameThread, [WeakThis]()
 				{
-				case EOAChatRole::USER:
-					role = "user";
-					break;
-				case EOAChatRole::ASSISTANT:
-					role = "assistant";
-					break;
-				case EOAChatRole::SYSTEM:
-					role = "system";
-					break;
-				}
-				Message->SetStringField(TEXT("role"), role);
-				Message->SetStringField(TEXT("content"), chatSettings.messages[i].content);
-				Messages.Add(MakeShareable(new FJsonValueObject(Message)));
-			}
-			_payloadObject->SetArrayField(TEXT("messages"), Messages);
+					if (UOpenAICallChat* This = WeakThis.Get())
+					{
+						This->DrainStream();
+					}
+				});
+			});
+			StreamedContent.Reset();
+			HttpRequest->SetResponseBodyReceiveStream(Stream.ToSharedRef());
 		}
-
-		// convert payload to string
-		FString _payload;
-		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&_payload);
-		FJsonSerializer::Serialize(_payloadObject.ToSharedRef(), Writer);
-
-		// commit request
-		HttpRequest->SetVerb(TEXT("POST"));
-		HttpRequest->SetContentAsString(_payload);
+		CurrentRequest = HttpRequest;
 
 		if (HttpRequest->ProcessRequest())
 		{
@@ -123,42 +335,270 @@ void UOpenAICallChat::Activate()
 		}
 		else
 		{
-			Finished.Broadcast({}, ("Error sending request"), false);
+			CurrentRequest.Reset();
+			Stream.Reset();
+			BroadcastFinished({}, {}, {}, ("Error sending request"), false);
+		}
+	}
+}
+
+void UOpenAICallChat::WriteRequestBody(FOpenAIJsonWriter& Writer, const FChatSettings& chatSettings, bool bStream)
+{
+	Writer.BeginObject();
+	Writer.Field("model", FOpenAIModels::GetModelName(chatSettings));
+	Writer.Field("max_tokens", chatSettings.maxTokens);
+	if (chatSettings.numChoices > 1)
+	{
+		Writer.Field("n", FMath::Clamp(chatSettings.numChoices, 1, 128));
+	}
+	if (bStream)
+	{
+		Writer.Field("stream", true);
+		// the last event then carries the usage
+		Writer.Key("stream_options");
+		Writer.BeginObject();
+		Writer.Field("include_usage", true);
+		Writer.EndObject();
+	}
+	if (!chatSettings.promptCacheKey.IsEmpty())
+	{
+		Writer.Field("prompt_cache_key", chatSettings.promptCacheKey);
+	}
+
+	// convert role enum to model string
+	if (!(chatSettings.messages.Num() == 0))
+	{
+		Writer.Key("messages");
+		Writer.BeginArray();
+		for (const FChatLog& message : chatSettings.messages)
+		{
+			const TCHAR* role = TEXT("system");
+			switch (message.role)
+			{
+			case EOAChatRole::USER:
+				role = TEXT("user");
+				break;
+			case EOAChatRole::ASSISTANT:
+				role = TEXT("assistant");
+				break;
+			case EOAChatRole::SYSTEM:
+				role = TEXT("system");
+				break;
+			case EOAChatRole::TOOL:
+				role = TEXT("tool");
+				break;
+			}
+			Writer.BeginObject();
+			Writer.Field("role", role);
+			if (message.content.IsEmpty() && message.toolCalls.Num() > 0)
+			{
+				Writer.Key("content");
+				Writer.Null();
+			}
+			else
+			{
+				Writer.Field("content", message.content);
+			}
+			if (message.toolCalls.Num() > 0)
+			{
+				Writer.Key("tool_calls");
+				Writer.BeginArray();
+				for (const FChatToolCall& call : message.toolCalls)
+				{
+					Writer.BeginObject();
+					Writer.Field("id", call.id);
+					Writer.Field("type", TEXT("function"));
+					Writer.Key("function");
+					Writer.BeginObject();
+					Writer.Field("name", call.name);
+					Writer.Field("arguments", call.arguments);
+					Writer.EndObject();
+					Writer.EndObject();
+				}
+				Writer.EndArray();
+			}
+			if (message.role == EOAChatRole::TOOL)
+			{
+				Writer.Field("tool_call_id", message.toolCallId);
+			}
+			Writer.EndObject();
 		}
+		Writer.EndArray();
+	}
+
+	if (chatSettings.tools.Num() > 0)
+	{
+		Writer.Key("tools");
+		FOpenAIToolbox::WriteDefinitions(Writer, chatSettings.tools, false, chatSettings.canonicalPromptPrefix);
+	}
+	if (chatSettings.responseStruct)
+	{
+		Writer.Key("response_format");
+		FOpenAIStructuredOutput::WriteResponseFormat(Writer, chatSettings.responseStruct);
+	}
+	Writer.EndObject();
+}
+
+void UOpenAICallChat::DrainStream()
+{
+	if (!Stream.IsValid())
+	{
+		return;
+	}
+
+	const FString Delta = Stream->TakeDelta();
+	if (!Delta.IsEmpty())
+	{
+		StreamedContent += Delta;
+		DeltaF.ExecuteIfBound(Delta);
 	}
 }
 
 void UOpenAICallChat::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
 {
+	CurrentRequest.Reset();
+	if (Stream.IsValid())
+	{
+		// the last deltas may still be waiting for the game thread
+		Stream->Finish();
+		DrainStream();
+		Stream->Detach();
+	}
+	TSharedPtr<FOpenAIChatStream, ESPMode::ThreadSafe> StreamedReply = MoveTemp(Stream);
+
 	// print response as debug message
 	if (!WasSuccessful)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s \n%s"), *Response->GetContentAsString(), *Response->GetURL());
-		if (Finished.IsBound())
-		{
-			Finished.Broadcast({}, *Response->GetContentAsString(), false);
-		}
+		BroadcastFinished({}, {}, {}, *Response->GetContentAsString(), false);
 
 		return;
 	}
 
-	TSharedPtr<FJsonObject> responseObject;
-	TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(reader, responseObject))
+	// decode straight from the UTF-8 body
+	OpenAIParser parser(chatSettings);
+	TArray<FChatCompletion> _choices;
+	FChatUsage _usage;
+	FString error;
+	if (StreamedReply.IsValid())
 	{
-		bool err = responseObject->HasField("error");
+		// the reply has been decoded event by event as it arrived
+		if (!StreamedReply->HasEvents())
+		{
+			if (!parser.DecodeError(StreamedReply->GetHeldBody(), error))
+			{
+				error = FString::Printf(TEXT("Request failed with status %d"), Response->GetResponseCode());
+			}
+		}
+		else
+		{
+			error = StreamedReply->GetError();
+		}
+		if (!error.IsEmpty())
+		{
+			BroadcastFinished({}, {}, {}, error, false);
+			return;
+		}
 
-		if (err)
+		FChatCompletion& Choice = _choices.AddDefaulted_GetRef();
+		Choice.message.role = EOAChatRole::ASSISTANT;
+		Choice.message.content = StreamedContent;
+		Choice.finishReason = StreamedReply->GetFinishReason();
+		_usage = StreamedReply->GetUsage();
+	}
+	else
+	{
+		// a structured reply is decoded into its struct straight from the body
+		StructuredOutput.Reset();
+		if (chatSettings.responseStruct)
+		{
+			StructuredOutput = MakeShared<FStructOnScope>(chatSettings.responseStruct);
+		}
+		if (!parser.DecodeChatCompletions(Response->GetContent(), _choices, _usage, error, StructuredOutput.IsValid() ? StructuredOutput->GetStructMemory() : nullptr))
 		{
 			UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
-			Finished.Broadcast({}, TEXT("Api error"), false);
+			BroadcastFinished({}, {}, {}, error, false);
+			return;
+		}
+	}
+
+	UOpenAIUtils::RecordPromptCacheUsage(_usage);
+	UE_LOG(LogTemp, Verbose, TEXT("Chat prompt cache served %d of %d prompt tokens"), _usage.cachedTokens, _usage.promptTokens);
+
+	// usage of the earlier tool rounds is billed too
+	ToolUsage.promptTokens += _usage.promptTokens;
+	ToolUsage.completionTokens += _usage.completionTokens;
+	ToolUsage.totalTokens += _usage.totalTokens;
+	ToolUsage.cachedTokens += _usage.cachedTokens;
+
+	if (Toolbox.IsValid() && _choices.Num() > 0 && _choices[0].message.toolCalls.Num() > 0)
+	{
+		if (ToolRounds < MaxToolRounds)
+		{
+			// run every call of the turn at once and answer them all in one follow-up request
+			ToolRounds++;
+			chatSettings.messages.Add(_choices[0].message);
+			TWeakObjectPtr<UOpenAICallChat> WeakThis(this);
+			Toolbox->Dispatch(_choices[0].message.toolCalls, [WeakThis](TArray<FChatLog>&& Results)
+			{
+				if (UOpenAICallChat* This = WeakThis.Get())
+				{
+					This->chatSettings.messages.Append(MoveTemp(Results));
+					This->Activate();
+				}
+			});
 			return;
 		}
+		UE_LOG(LogTemp, Warning, TEXT("Chat stopped running tools after %d rounds"), MaxToolRounds);
+	}
+	_usage = ToolUsage;
+
+	// message stays the first choice for graphs that only use one
+	FChatCompletion _out = _choices.Num() > 0 ? _choices[0] : FChatCompletion();
+	BroadcastFinished(_out, _choices, _usage, "", true);
+}
 
-		OpenAIParser parser(chatSettings);
-		FChatCompletion _out = parser.ParseChatCompletion(*responseObject);
+void UOpenAICallChat::Cancel()
+{
+	if (CurrentRequest.IsValid())
+	{
+		CurrentRequest->OnProcessRequestComplete().Unbind();
+		CurrentRequest->CancelRequest();
+		CurrentRequest.Reset();
+	}
+	if (Stream.IsValid())
+	{
+		Stream->Detach();
+		Stream.Reset();
+	}
+	DeltaF.Unbind();
+	if (FinishedF.IsBound())
+	{
+		// the C++ entry points keep the node rooted until it finishes
+		FinishedF.Unbind();
+		RemoveFromRoot();
+		ConditionalBeginDestroy();
+	}
+}
 
-		Finished.Broadcast(_out, "", true);
+void UOpenAICallChat::BeginDestroy()
+{
+	if (CurrentRequest.IsValid())
+	{
+		CurrentRequest->OnProcessRequestComplete().Unbind();
+		CurrentRequest->CancelRequest();
+		CurrentRequest.Reset();
+	}
+	if (Stream.IsValid())
+	{
+		// the HTTP thread may still hold the stream
+		Stream->Detach();
 	}
+	Super::BeginDestroy();
 }
 
+void UOpenAICallChat::BroadcastFinished(const FChatCompletion& Message, const TArray<FChatCompletion>& Choices, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(Message, Choices, Usage, ErrorMessage, Success);
+	FinishedF.ExecuteIfBound(Message, Choices, Usage, ErrorMessage, Success);
+}
@@ -0,0 +1,482 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallChatSpeech.h"
+#include "OpenAICallChat.h"
+#include "OpenAICallSpeech.h"
+#include "OpenAIUtils.h"
+#include "OpenAIParser.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIAudioCodec.h"
+#include "OpenAISpeechCache.h"
+#include "Sound/SoundWaveProcedural.h"
+#include "Algo/AnyOf.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "UObject/Package.h"
+
+namespace
+{
+	// Shorter sentences are spoken with the next one, so "Oh." is not a request of its own
+	constexpr int32 MinSentenceChars = 12;
+
+	// A run without an end of sentence is cut at a pause anyway, so speech does not wait on it
+	constexpr int32 MaxSentenceChars = 240;
+
+	bool IsSentenceEnd(TCHAR C)
+	{
+		return C == TEXT('.') || C == TEXT('!') || C == TEXT('?') || C == 0x2026;
+	}
+
+	bool IsCloser(TCHAR C)
+	{
+		return C == TEXT('"') || C == TEXT('\'') || C == TEXT(')') || C == TEXT(']') || C == 0x201D || C == 0x2019;
+	}
+
+	// Full width punctuation ends a sentence without a following space
+	bool IsWideSentenceEnd(TCHAR C)
+	{
+		return C == 0x3002 || C == 0xFF01 || C == 0xFF1F;
+	}
+
+	// "Mr." or the initials in "J. R. R." do not end a sentence
+	bool IsAbbreviation(const FString& Text, int32 Period)
+	{
+		int32 Start = Period;
+		while (Start > 0 && FChar::IsAlpha(Text[Start - 1]))
+		{
+			Start--;
+		}
+		const FStringView Word = FStringView(Text).Mid(Start, Period - Start);
+		if (Word.Len() == 1)
+		{
+			return true;
+		}
+		for (const TCHAR* Abbreviation : { TEXT("mr"), TEXT("mrs"), TEXT("ms"), TEXT("dr"), TEXT("st"), TEXT("jr"), TEXT("sr"), TEXT("vs"), TEXT("prof") })
+		{
+			if (Word.Equals(Abbreviation, ESearchCase::IgnoreCase))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * Length of the first complete sentence of Text, or INDEX_NONE while it could still go on.
+	 * A period only ends a sentence once the character after it is known, so "3.5" and "e.g."
+	 * are not cut while they are streaming in.
+	 */
+	int32 FindSentenceEnd(const FString& Text)
+	{
+		int32 LastPause = INDEX_NONE;
+		int32 LastSpace = INDEX_NONE;
+		for (int32 i = 0; i < Text.Len(); i++)
+		{
+			const TCHAR C = Text[i];
+			int32 End = INDEX_NONE;
+			if (C == TEXT('\n') || IsWideSentenceEnd(C))
+			{
+				End = i + 1;
+			}
+			else if (IsSentenceEnd(C))
+			{
+				// runs like "?!" or "..." and closing quotes or brackets belong to the sentence
+				int32 j = i + 1;
+				while (j < Text.Len() && (IsSentenceEnd(Text[j]) || IsCloser(Text[j])))
+				{
+					j++;
+				}
+				if (j == Text.Len())
+				{
+					return INDEX_NONE;
+				}
+				if (FChar::IsWhitespace(Text[j]) && !(C == TEXT('.') && j == i + 1 && IsAbbreviation(Text, i)))
+				{
+					End = j;
+				}
+				i = j - 1;
+			}
+			else if (FChar::IsWhitespace(C))
+			{
+				LastSpace = i;
+				if (i > 0 && (Text[i - 1] == TEXT(',') || Text[i - 1] == TEXT(';') || Text[i - 1] == TEXT(':')))
+				{
+					LastPause = i;
+				}
+			}
+
+			if (End != INDEX_NONE && End >= MinSentenceChars)
+			{
+				return End;
+			}
+			if (i + 1 >= MaxSentenceChars)
+			{
+				return LastPause > MinSentenceChars ? LastPause : (LastSpace > MinSentenceChars ? LastSpace : i + 1);
+			}
+		}
+		return INDEX_NONE;
+	}
+}
+
+UOpenAICallChatSpeech::UOpenAICallChatSpeech()
+{
+}
+
+UOpenAICallChatSpeech::~UOpenAICallChatSpeech()
+{
+}
+
+UOpenAICallChatSpeech* UOpenAICallChatSpeech::OpenAICallChatSpeech(FChatSettings chatSettingsInput, FSpeechSettings speechSettingsInput)
+{
+	UOpenAICallChatSpeech* BPNode = NewObject<UOpenAICallChatSpeech>();
+	BPNode->chatSettings = chatSettingsInput;
+	BPNode->speechSettings = speechSettingsInput;
+	return BPNode;
+}
+
+UOpenAICallChatSpeech* UOpenAICallChatSpeech::ChatAndSpeak(const FChatSettings& ChatSettings, const FSpeechSettings& SpeechSettings,
+	TFunction<void(USoundWaveProcedural* Sound)> OnStarted,
+	TFunction<void(USoundWaveProcedural* Sound, const FChatCompletion& Message, float Duration, const FString& ErrorMessage, bool Success)> OnFinished)
+{
+	UOpenAICallChatSpeech* Node = NewObject<UOpenAICallChatSpeech>();
+	Node->chatSettings = ChatSettings;
+	Node->speechSettings = SpeechSettings;
+	Node->AddToRoot();
+	Node->StartedF.BindLambda([OnStarted](USoundWaveProcedural* Sound)
+	{
+		if (OnStarted)
+		{
+			OnStarted(Sound);
+		}
+	});
+	Node->FinishedF.BindLambda([OnFinished, Node](USoundWaveProcedural* Sound, const FChatCompletion& Message, float Duration, const FString& ErrorMessage, bool Success)
+	{
+		if (!Success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Chat speech failed. Error: %s"), *ErrorMessage);
+		}
+
+		if (OnFinished)
+		{
+			OnFinished(Sound, Message, Duration, ErrorMessage, Success);
+		}
+
+		Node->RemoveFromRoot();
+		Node->ConditionalBeginDestroy();
+	});
+	Node->Activate();
+	return Node;
+}
+
+void UOpenAICallChatSpeech::BroadcastStarted()
+{
+	if (bStarted)
+	{
+		return;
+	}
+	bStarted = true;
+
+	FirstAudioLatencyMs = (float)FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+	UE_LOG(LogTemp, Log, TEXT("Chat speech started after %.0f ms"), FirstAudioLatencyMs);
+
+	Started.Broadcast(SoundWave);
+	StartedF.ExecuteIfBound(SoundWave);
+}
+
+void UOpenAICallChatSpeech::BroadcastFinished(const FChatCompletion& Message, float Duration, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(SoundWave, Message, Duration, ErrorMessage, Success);
+	FinishedF.ExecuteIfBound(SoundWave, Message, Duration, ErrorMessage, Success);
+}
+
+void UOpenAICallChatSpeech::Activate()
+{
+	FString _apiKey;
+	if (UOpenAIUtils::getUseApiKeyFromEnvironmentVars())
+		_apiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		_apiKey = UOpenAIUtils::getApiKey();
+
+	// checking parameters are valid
+	if (_apiKey.IsEmpty())
+	{
+		BroadcastFinished({}, 0.0f, TEXT("Api key is not set"), false);
+		return;
+	}
+	AuthHeader = TEXT("Bearer ") + _apiKey;
+
+	bOpus = speechSettings.responseFormat == EOASpeechResponseFormat::OPUS;
+#if !WITH_OPENAI_OPUS
+	bOpus = false;
+#endif
+
+	// the sound plays on after Finished, when the C++ entry point destroys this node
+	SoundWave = UOpenAICallSpeech::CreateSound(GetTransientPackage());
+	StartCycles = FPlatformTime::Cycles64();
+
+	TWeakObjectPtr<UOpenAICallChatSpeech> WeakThis(this);
+	ChatNode = UOpenAICallChat::ChatStreamed(chatSettings, [WeakThis](const FString& Delta)
+	{
+		if (UOpenAICallChatSpeech* This = WeakThis.Get())
+		{
+			This->OnDelta(Delta);
+		}
+	},
+	[WeakThis](const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)
+	{
+		if (UOpenAICallChatSpeech* This = WeakThis.Get())
+		{
+			This->OnChatFinished(Message, ErrorMessage, Success);
+		}
+	});
+}
+
+void UOpenAICallChatSpeech::OnDelta(const FString& Delta)
+{
+	PendingText += Delta;
+	for (int32 End = FindSentenceEnd(PendingText); End != INDEX_NONE; End = FindSentenceEnd(PendingText))
+	{
+		AddSentence(PendingText.Left(End));
+		PendingText.RightChopInline(End);
+	}
+	Pump();
+}
+
+void UOpenAICallChatSpeech::OnChatFinished(const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+{
+	ChatNode.Reset();
+	bChatDone = true;
+	Reply = Message;
+	if (Success)
+	{
+		AddSentence(PendingText);
+	}
+	else
+	{
+		// what was spoken so far still plays out
+		ChatError = ErrorMessage;
+	}
+	PendingText.Reset();
+	Pump();
+}
+
+void UOpenAICallChatSpeech::AddSentence(const FString& Text)
+{
+	FString Trimmed = Text.TrimStartAndEnd();
+	const bool bHasWords = Algo::AnyOf(Trimmed, [](TCHAR C) { return FChar::IsAlnum(C); });
+	if (bHasWords)
+	{
+		Sentences.AddDefaulted_GetRef().Text = MoveTemp(Trimmed);
+	}
+}
+
+void UOpenAICallChatSpeech::Pump()
+{
+	while (NumInFlight < FMath::Max(1, MaxConcurrentSpeech) && NextToRequest < Sentences.Num())
+	{
+		RequestSentence(NextToRequest++);
+	}
+
+	// a sentence that is ready waits for every sentence before it
+	while (NextToQueue < Sentences.Num() && Sentences[NextToQueue].bDone)
+	{
+		FSentence& Sentence = Sentences[NextToQueue++];
+		if (Sentence.PCM.Num() > 0)
+		{
+			SoundWave->QueueAudio(Sentence.PCM.GetData(), Sentence.PCM.Num());
+			NumSamples += Sentence.PCM.Num() / sizeof(int16);
+			Sentence.PCM.Empty();
+			BroadcastStarted();
+		}
+	}
+
+	if (bChatDone && !bFinished && NextToQueue == Sentences.Num())
+	{
+		bFinished = true;
+		const float Duration = (float)NumSamples / UOpenAICallSpeech::SampleRate;
+		const FString& ErrorMessage = ChatError.IsEmpty() ? SpeechError : ChatError;
+		BroadcastFinished(Reply, Duration, ErrorMessage, ErrorMessage.IsEmpty());
+	}
+}
+
+void UOpenAICallChatSpeech::RequestSentence(int32 Index)
+{
+	FSentence& Sentence = Sentences[Index];
+	FSpeechSettings Settings = speechSettings;
+	Settings.input = Sentence.Text;
+
+	// NPCs repeat themselves; a sentence spoken before is not requested again
+	Sentence.CacheKey = FOpenAISpeechCache::MakeKey(Settings);
+	FOpenAISpeechCache::FHit Hit;
+	if (FOpenAISpeechCache::Get().Find(Sentence.CacheKey, Hit) && DecodeSentence(Sentence, Hit.Format, Hit.Audio))
+	{
+		Sentence.bDone = true;
+		return;
+	}
+
+	// a loose file is read off the game thread and counts as in flight until it is decoded
+	TWeakObjectPtr<UOpenAICallChatSpeech> WeakThis(this);
+	const bool bReading = FOpenAISpeechCache::Get().FindLoose(Sentence.CacheKey, [WeakThis, Index](FOpenAISpeechCache::FHit* Loaded)
+	{
+		UOpenAICallChatSpeech* This = WeakThis.Get();
+		if (!This || This->bCancelled)
+		{
+			return;
+		}
+
+		This->NumInFlight--;
+		FSentence& Read = This->Sentences[Index];
+		if (Loaded && This->DecodeSentence(Read, Loaded->Format, Loaded->Audio))
+		{
+			Read.bDone = true;
+		}
+		else
+		{
+			This->SendSentenceRequest(Index);
+		}
+		This->Pump();
+	});
+	if (bReading)
+	{
+		NumInFlight++;
+		return;
+	}
+
+	SendSentenceRequest(Index);
+}
+
+void UOpenAICallChatSpeech::SendSentenceRequest(int32 Index)
+{
+	FSentence& Sentence = Sentences[Index];
+	FSpeechSettings Settings = speechSettings;
+	Settings.input = Sentence.Text;
+
+	FOpenAIJsonWriter Writer;
+	UOpenAICallSpeech::WriteRequestBody(Writer, Settings, bOpus);
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(UOpenAIUtils::getBaseUrl() + TEXT("/audio/speech"));
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	HttpRequest->SetHeader(TEXT("Authorization"), AuthHeader);
+	HttpRequest->SetContent(Writer.GetBuffer());
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallChatSpeech::OnSentenceResponse, Index);
+
+	Sentence.Request = HttpRequest;
+	if (HttpRequest->ProcessRequest())
+	{
+		NumInFlight++;
+	}
+	else
+	{
+		Sentence.Request.Reset();
+		Sentence.bDone = true;
+		UE_LOG(LogTemp, Warning, TEXT("Speech of \"%s\" failed. Error: Error sending request"), *Sentence.Text);
+		if (SpeechError.IsEmpty())
+		{
+			SpeechError = TEXT("Error sending request");
+		}
+	}
+}
+
+void UOpenAICallChatSpeech::OnSentenceResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, int32 Index)
+{
+	NumInFlight--;
+	FSentence& Sentence = Sentences[Index];
+	Sentence.Request.Reset();
+	Sentence.bDone = true;
+
+	const EOASpeechResponseFormat Format = bOpus ? EOASpeechResponseFormat::OPUS : EOASpeechResponseFormat::PCM;
+	FString ErrorMessage;
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		ErrorMessage = TEXT("No response from server");
+	}
+	else if (!EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		OpenAIParser parser;
+		if (!parser.DecodeError(Response->GetContent(), ErrorMessage))
+		{
+			ErrorMessage = FString::Printf(TEXT("Request failed with status %d"), Response->GetResponseCode());
+		}
+	}
+	else if (!DecodeSentence(Sentence, Format, Response->GetContent()))
+	{
+		ErrorMessage = TEXT("Response has no audio");
+	}
+	else
+	{
+		FOpenAISpeechCache::Get().Store(Sentence.CacheKey, Format, TArray<uint8>(Response->GetContent()));
+	}
+
+	if (!ErrorMessage.IsEmpty())
+	{
+		// the sentence is skipped, the rest of the reply is still spoken
+		UE_LOG(LogTemp, Warning, TEXT("Speech of \"%s\" failed. Error: %s"), *Sentence.Text, *ErrorMessage);
+		if (SpeechError.IsEmpty())
+		{
+			SpeechError = ErrorMessage;
+		}
+	}
+	Pump();
+}
+
+bool UOpenAICallChatSpeech::DecodeSentence(FSentence& Sentence, EOASpeechResponseFormat Format, TArrayView<const uint8> Audio)
+{
+	Sentence.PCM.Reset();
+	if (Format == EOASpeechResponseFormat::OPUS)
+	{
+		FOpenAIOggOpusDecoder Decoder;
+		TArray<float> Samples;
+		if (!Decoder.Init(UOpenAICallSpeech::SampleRate) || !Decoder.Decode(Audio, Samples))
+		{
+			return false;
+		}
+		OpenAIAudioCodec::FloatToPCM16(Samples.GetData(), Samples.Num(), Sentence.PCM);
+	}
+	else
+	{
+		Sentence.PCM.Append(Audio.GetData(), Audio.Num() & ~1);
+	}
+	return Sentence.PCM.Num() > 0;
+}
+
+void UOpenAICallChatSpeech::CancelRequests()
+{
+	bCancelled = true;
+	if (UOpenAICallChat* Chat = ChatNode.Get())
+	{
+		Chat->Cancel();
+	}
+	ChatNode.Reset();
+
+	for (FSentence& Sentence : Sentences)
+	{
+		if (Sentence.Request.IsValid())
+		{
+			Sentence.Request->OnProcessRequestComplete().Unbind();
+			Sentence.Request->CancelRequest();
+			Sentence.Request.Reset();
+		}
+	}
+	NumInFlight = 0;
+}
+
+void UOpenAICallChatSpeech::Cancel()
+{
+	CancelRequests();
+	StartedF.Unbind();
+	if (FinishedF.IsBound())
+	{
+		// the C++ entry point keeps the node rooted until it finishes
+		FinishedF.Unbind();
+		RemoveFromRoot();
+		ConditionalBeginDestroy();
+	}
+}
+
+void UOpenAICallChatSpeech::BeginDestroy()
+{
+	CancelRequests();
+	Super::BeginDestroy();
+}
@@ -8,6 +8,8 @@
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
 #include "OpenAIParser.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIModels.h"
 
 
 UOpenAICallCompletions::UOpenAICallCompletions()
@@ -35,6 +37,7 @@ void UOpenAICallCompletions::Activate()
 	else
 		_apiKey = UOpenAIUtils::getApiKey();
 
+	const FOpenAIModelInfo& Model = FOpenAIModels::Get(engine);
 
 	// checking parameters are valid
 	if (_apiKey.IsEmpty())
@@ -46,9 +49,9 @@ void UOpenAICallCompletions::Activate()
 	} else if (settings.bestOf < settings.numCompletions)
 	{
 		Finished.Broadcast({}, TEXT("bestOf must be greater than numCompletions"), {}, false);
-	} else if (settings.maxTokens <= 0 || ( engine != EOACompletionsEngineType::TEXT_DAVINCI_003 && settings.maxTokens >= 2048) || ( engine == EOACompletionsEngineType::TEXT_DAVINCI_003 && settings.maxTokens >= 4000))
+	} else if (settings.maxTokens <= 0 || settings.maxTokens > Model.MaxOutputTokens)
 	{
-		Finished.Broadcast({}, TEXT("maxTokens must be within 0 and 2048. Up to 4096 if using davinci-3."), {}, false);
+		Finished.Broadcast({}, FString::Printf(TEXT("maxTokens must be within 0 and %d for %s."), Model.MaxOutputTokens, Model.Name), {}, false);
 	} else if (settings.stopSequences.Num() > 4)
 	{
 		Finished.Broadcast({}, TEXT("You can only include up to 4 Stop Sequences"), {}, false);
@@ -59,83 +62,47 @@ void UOpenAICallCompletions::Activate()
 	
 	auto HttpRequest = FHttpModule::Get().CreateRequest();
 	
-	FString apiMethod;
-	switch (engine)
-	{
-	case EOACompletionsEngineType::DAVINCI:
-			apiMethod = "davinci";
-	break;
-	case EOACompletionsEngineType::CURIE:
-			apiMethod = "curie";
-	break;
-	case EOACompletionsEngineType::BABBAGE:
-			apiMethod = "babbage";
-	break;
-	case EOACompletionsEngineType::ADA:
-			apiMethod = "ada";
-	break;
-	case EOACompletionsEngineType::TEXT_DAVINCI_002:
-		apiMethod = "text-davinci-002";
-	break;
-	case EOACompletionsEngineType::TEXT_CURIE_001:
-		apiMethod = "text-curie-001";
-	break;
-	case EOACompletionsEngineType::TEXT_BABBAGE_001:
-		apiMethod = "text-babbage-001";
-		break;
-	case EOACompletionsEngineType::TEXT_ADA_001:
-		apiMethod = "text-ada-001";
-		break;
-	case EOACompletionsEngineType::TEXT_DAVINCI_003:
-		apiMethod = "text-davinci-003";
-		break;
-	}
-
 	// convert parameters to strings
 	FString tempPrompt = settings.startSequence + prompt + settings.injectStartText;
 	FString tempHeader = "Bearer ";
 	tempHeader += _apiKey;
 
 	// set headers
-	FString url = FString::Printf(TEXT("https://api.openai.com/v1/engines/%s/completions"), *apiMethod);
+	FString url = FString::Printf(TEXT("%s/engines/%s/completions"), *UOpenAIUtils::getBaseUrl(), Model.Name);
 	HttpRequest->SetURL(url);
 	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
 	HttpRequest->SetHeader(TEXT("Authorization"), tempHeader);
 
-	//build payload
-	TSharedPtr<FJsonObject> _payloadObject = MakeShareable(new FJsonObject());
-	_payloadObject->SetStringField(TEXT("prompt"), tempPrompt);
-	_payloadObject->SetNumberField(TEXT("max_tokens"), settings.maxTokens);
-	_payloadObject->SetNumberField(TEXT("temperature"), FMath::Clamp(settings.temperature, 0.0f, 1.0f));
-	_payloadObject->SetNumberField(TEXT("top_p"), FMath::Clamp(settings.topP, 0.0f, 1.0f));
-	_payloadObject->SetNumberField(TEXT("n"), settings.numCompletions);
-	_payloadObject->SetNumberField(TEXT("best_of"), settings.bestOf);
+	//build payload, written straight to UTF-8
+	FOpenAIJsonWriter Writer;
+	Writer.BeginObject();
+	Writer.Field("prompt", tempPrompt);
+	Writer.Field("max_tokens", settings.maxTokens);
+	Writer.Field("temperature", FMath::Clamp(settings.temperature, 0.0f, 1.0f));
+	Writer.Field("top_p", FMath::Clamp(settings.topP, 0.0f, 1.0f));
+	Writer.Field("n", settings.numCompletions);
+	Writer.Field("best_of", settings.bestOf);
 	if (!(settings.presencePenalty == 0))
-		_payloadObject->SetNumberField(TEXT("presence_penalty"), FMath::Clamp(settings.presencePenalty, 0.0f, 1.0f));
-	if (!(settings.logprobs == 0)){
-		_payloadObject->SetNumberField(TEXT("logprobs"), FMath::Clamp(settings.logprobs, 0, 10));
-		_payloadObject->SetNumberField(TEXT("presence_penalty"), FMath::Clamp(settings.presencePenalty, 0.0f, 1.0f));
-	}
+		Writer.Field("presence_penalty", FMath::Clamp(settings.presencePenalty, 0.0f, 1.0f));
+	if (!(settings.logprobs == 0))
+		Writer.Field("logprobs", FMath::Clamp(settings.logprobs, 0, 10));
 	if (!(settings.frequencyPenalty == 0))
-		_payloadObject->SetNumberField(TEXT("frequency_penalty"), FMath::Clamp(settings.frequencyPenalty, 0.0f, 1.0f));
+		Writer.Field("frequency_penalty", FMath::Clamp(settings.frequencyPenalty, 0.0f, 1.0f));
 	if (!(settings.stopSequences.Num() == 0))
 	{
-		TArray<TSharedPtr<FJsonValue>> StopSequences;
-		for (int i = 0; i < settings.stopSequences.Num(); i++)
+		Writer.Key("stop");
+		Writer.BeginArray();
+		for (const FString& stopSequence : settings.stopSequences)
 		{
-			StopSequences.Add(MakeShareable(new FJsonValueString(settings.stopSequences[i])));
+			Writer.Value(stopSequence);
 		}
-		_payloadObject->SetArrayField(TEXT("stop"), StopSequences);
+		Writer.EndArray();
 	}
-
-	// convert payload to string
-	FString _payload;
-	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&_payload);
-	FJsonSerializer::Serialize(_payloadObject.ToSharedRef(), Writer);
+	Writer.EndObject();
 
 	// commit request
 	HttpRequest->SetVerb(TEXT("POST"));
-	HttpRequest->SetContentAsString(_payload);
+	HttpRequest->SetContent(Writer.GetBuffer());
 
 	if (HttpRequest->ProcessRequest())
 	{
@@ -160,32 +127,18 @@ void UOpenAICallCompletions::OnResponse(FHttpRequestPtr Request, FHttpResponsePt
 		return;
 	}
 
-	TSharedPtr<FJsonObject> responseObject;
-	TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	
-	if (FJsonSerializer::Deserialize(reader, responseObject))
+	// decode straight from the UTF-8 body
+	OpenAIParser parser(settings);
+	TArray<FCompletion> _out;
+	FCompletionInfo _info;
+	FString error;
+	if (!parser.DecodeCompletions(Response->GetContent(), _out, _info, error))
 	{
-		bool err = responseObject->HasField("error");
-
-		if (err)
-		{
-			FString ResponseString = Response->GetContentAsString();
-			UE_LOG(LogTemp, Warning, TEXT("%s"), *ResponseString);
-			Finished.Broadcast({}, TEXT("Api error: ") + ResponseString, {}, false);
-			return;
-		}
-
-		OpenAIParser parser(settings);
-		TArray<FCompletion> _out;
-		FCompletionInfo _info = parser.ParseGPTCompletionInfo(*responseObject);
-
-		auto CompletionsObject = responseObject->GetArrayField(TEXT("Choices"));
-		for (auto& elem : CompletionsObject)
-		{
-			_out.Add(parser.ParseCompletionsResponse(*elem->AsObject()));
-		}
-
-		Finished.Broadcast(_out, "", _info, true);
+		UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
+		Finished.Broadcast({}, error, {}, false);
+		return;
 	}
+
+	Finished.Broadcast(_out, "", _info, true);
 }
 
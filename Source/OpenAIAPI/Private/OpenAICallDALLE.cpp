@@ -8,6 +8,8 @@
 #include "Serialization/JsonReader.h"
 #include "Serialization/JsonSerializer.h"
 #include "OpenAIParser.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIModels.h"
 
 
 UOpenAICallDALLE::UOpenAICallDALLE()
@@ -50,44 +52,23 @@ void UOpenAICallDALLE::Activate()
 	
 	auto HttpRequest = FHttpModule::Get().CreateRequest();
 	
-	FString imageResolution;
-	switch (imageSize)
-	{
-	case EOAImageSize::SMALL:
-			imageResolution = "256x256";
-	break;
-	case EOAImageSize::MEDIUM:
-			imageResolution = "512x512";
-	break;
-	case EOAImageSize::LARGE:
-			imageResolution = "1024x1024";
-	break;
-	}
-
 	// convert parameters to strings
 	FString tempHeader = "Bearer ";
 	tempHeader += _apiKey;
 
 	// set headers
-	FString url = FString::Printf(TEXT("https://api.openai.com/v1/images/generations"));
+	FString url = UOpenAIUtils::getBaseUrl() + TEXT("/images/generations");
 	HttpRequest->SetURL(url);
 	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
 	HttpRequest->SetHeader(TEXT("Authorization"), tempHeader);
 
-	// build payload
-	TSharedPtr<FJsonObject> _payloadObject = MakeShareable(new FJsonObject());
-	_payloadObject->SetStringField(TEXT("prompt"), prompt);
-	_payloadObject->SetNumberField(TEXT("n"), numImages);
-	_payloadObject->SetStringField(TEXT("size"), imageResolution);
-
-	// convert payload to string
-	FString _payload;
-	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&_payload);
-	FJsonSerializer::Serialize(_payloadObject.ToSharedRef(), Writer);
+	// build payload, written straight to UTF-8
+	FOpenAIJsonWriter Writer;
+	WriteRequestBody(Writer, imageSize, prompt, numImages);
 
 	// commit request
 	HttpRequest->SetVerb(TEXT("POST"));
-	HttpRequest->SetContentAsString(_payload);
+	HttpRequest->SetContent(Writer.GetBuffer());
 
 	if (HttpRequest->ProcessRequest())
 	{
@@ -99,6 +80,19 @@ void UOpenAICallDALLE::Activate()
 	}
 }
 
+void UOpenAICallDALLE::WriteRequestBody(FOpenAIJsonWriter& Writer, EOAImageSize ImageSize, const FString& Prompt, int32 NumImages, bool bBase64)
+{
+	Writer.BeginObject();
+	Writer.Field("prompt", Prompt);
+	Writer.Field("n", NumImages);
+	Writer.Field("size", FOpenAIModels::GetImageSize(ImageSize));
+	if (bBase64)
+	{
+		Writer.Field("response_format", TEXT("b64_json"));
+	}
+	Writer.EndObject();
+}
+
 void UOpenAICallDALLE::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
 {
 	if (!WasSuccessful)
@@ -111,30 +105,17 @@ void UOpenAICallDALLE::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Resp
 		return;
 	}
 
-	TSharedPtr<FJsonObject> responseObject;
-	TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(reader, responseObject))
+	// decode straight from the UTF-8 body
+	OpenAIParser parser(settings);
+	TArray<FString> _out;
+	FString error;
+	if (!parser.DecodeGeneratedImages(Response->GetContent(), _out, error))
 	{
 		UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
-		bool err = responseObject->HasField("error");
-		
-		if (err)
-		{
-			UE_LOG(LogTemp, Warning, TEXT("%s"), *Response->GetContentAsString());
-			Finished.Broadcast({}, TEXT("Api error"), false);
-			return;
-		}
-
-		OpenAIParser parser(settings);
-		TArray<FString> _out;
-
-		auto GeneratedImagesObject = responseObject->GetArrayField(TEXT("data"));
-		for (auto& elem : GeneratedImagesObject)
-		{
-		_out.Add(parser.ParseGeneratedImage(*elem->AsObject()));
-		}
-
-		Finished.Broadcast(_out, "", true);
+		Finished.Broadcast({}, error, false);
+		return;
 	}
+
+	Finished.Broadcast(_out, "", true);
 }
 
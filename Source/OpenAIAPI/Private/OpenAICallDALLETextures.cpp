@@ -0,0 +1,334 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallDALLETextures.h"
+#include "OpenAICallDALLE.h"
+#include "OpenAIUtils.h"
+#include "OpenAIParser.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIImageCodec.h"
+#include "OpenAIImageCache.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+
+namespace
+{
+	// Response bodies are collected here by the HTTP thread and moved out whole, never copied on the game thread
+	TArray<uint8> TakeBody(const TSharedRef<FBufferArchive>& Archive)
+	{
+		return MoveTemp(static_cast<TArray<uint8>&>(*Archive));
+	}
+}
+
+UOpenAICallDALLETextures::UOpenAICallDALLETextures()
+{
+}
+
+UOpenAICallDALLETextures::~UOpenAICallDALLETextures()
+{
+}
+
+UOpenAICallDALLETextures* UOpenAICallDALLETextures::OpenAICallDALLETextures(EOAImageSize imageSizeInput, FString promptInput, int32 numImagesInput, bool base64Input, bool useCacheInput)
+{
+	UOpenAICallDALLETextures* BPNode = NewObject<UOpenAICallDALLETextures>();
+	BPNode->imageSize = imageSizeInput;
+	BPNode->prompt = promptInput;
+	BPNode->numImages = numImagesInput;
+	BPNode->base64 = base64Input;
+	BPNode->useCache = useCacheInput;
+	return BPNode;
+}
+
+UOpenAICallDALLETextures* UOpenAICallDALLETextures::Generate(EOAImageSize ImageSize, const FString& Prompt, int32 NumImages,
+	TFunction<void(const TArray<UTexture2D*>& Textures, const TArray<FString>& Urls, const FString& ErrorMessage, bool Success)> Callback, bool bBase64, bool bUseCache)
+{
+	UOpenAICallDALLETextures* Node = OpenAICallDALLETextures(ImageSize, Prompt, NumImages, bBase64, bUseCache);
+	Node->AddToRoot();
+	Node->FinishedF.BindLambda([Callback, Node](const TArray<UTexture2D*>& Textures, const TArray<FString>& Urls, const FString& ErrorMessage, bool Success)
+	{
+		if (!Success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Image generation failed. Error: %s"), *ErrorMessage);
+		}
+
+		if (Callback)
+		{
+			Callback(Textures, Urls, ErrorMessage, Success);
+		}
+
+		Node->RemoveFromRoot();
+		Node->ConditionalBeginDestroy();
+	});
+	Node->Activate();
+	return Node;
+}
+
+void UOpenAICallDALLETextures::BroadcastFinished(const FString& ErrorMessage, bool Success)
+{
+	TArray<UTexture2D*> Out;
+	Out.Reserve(Textures.Num());
+	for (UTexture2D* Texture : Textures)
+	{
+		Out.Add(Texture);
+	}
+
+	Finished.Broadcast(Out, Urls, ErrorMessage, Success);
+	FinishedF.ExecuteIfBound(Out, Urls, ErrorMessage, Success);
+}
+
+void UOpenAICallDALLETextures::Activate()
+{
+	FString _apiKey;
+	if (UOpenAIUtils::getUseApiKeyFromEnvironmentVars())
+		_apiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		_apiKey = UOpenAIUtils::getApiKey();
+
+	// checking parameters are valid
+	if (_apiKey.IsEmpty())
+	{
+		BroadcastFinished(TEXT("Api key is not set"), false);
+		return;
+	}
+	if (prompt.IsEmpty())
+	{
+		BroadcastFinished(TEXT("Prompt is empty"), false);
+		return;
+	}
+	if (numImages < 1 || numImages > 10)
+	{
+		BroadcastFinished(TEXT("NumImages must be set to a value between 1 and 10"), false);
+		return;
+	}
+
+	if (useCache)
+	{
+		CacheKey = FOpenAIImageCache::MakeKey(prompt, imageSize);
+		TArray<FString> Cached = FOpenAIImageCache::Get().FindImages(CacheKey);
+		if (Cached.Num() >= numImages)
+		{
+			Urls.SetNum(numImages);
+			Images.SetNum(numImages);
+			for (int32 Index = 0; Index < numImages; Index++)
+			{
+				Images[Index].CachedPath = MoveTemp(Cached[Index]);
+			}
+			Textures.SetNum(numImages);
+			Pump();
+			return;
+		}
+	}
+
+	FOpenAIJsonWriter Writer;
+	UOpenAICallDALLE::WriteRequestBody(Writer, imageSize, prompt, numImages, base64);
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(UOpenAIUtils::getBaseUrl() + TEXT("/images/generations"));
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + _apiKey);
+	HttpRequest->SetContent(Writer.GetBuffer());
+
+	// a base64 response is megabytes per image; it is collected off the game thread
+	TSharedRef<FBufferArchive> Body = MakeShared<FBufferArchive>();
+	HttpRequest->SetResponseBodyReceiveStream(Body);
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallDALLETextures::OnResponse, Body);
+
+	CurrentRequest = HttpRequest;
+	if (!HttpRequest->ProcessRequest())
+	{
+		CurrentRequest.Reset();
+		BroadcastFinished(TEXT("Error sending request"), false);
+	}
+}
+
+void UOpenAICallDALLETextures::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, TSharedRef<FBufferArchive> Body)
+{
+	CurrentRequest.Reset();
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		BroadcastFinished(TEXT("No response from server"), false);
+		return;
+	}
+
+	// parsed on a worker too, the base64 text is copied out of the body there
+	TWeakObjectPtr<UOpenAICallDALLETextures> WeakThis(this);
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [WeakThis, Bytes = TakeBody(Body)]()
+	{
+		OpenAIParser parser;
+		TArray<FString> ParsedUrls;
+		TArray<TArray<uint8>> Base64Images;
+		FString Error;
+		parser.DecodeGeneratedImages(Bytes, ParsedUrls, Base64Images, Error);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, ParsedUrls = MoveTemp(ParsedUrls), Base64Images = MoveTemp(Base64Images), Error = MoveTemp(Error)]() mutable
+		{
+			if (UOpenAICallDALLETextures* This = WeakThis.Get())
+			{
+				This->OnParsed(MoveTemp(ParsedUrls), MoveTemp(Base64Images), Error);
+			}
+		});
+	});
+}
+
+void UOpenAICallDALLETextures::OnParsed(TArray<FString>&& InUrls, TArray<TArray<uint8>>&& Base64Images, const FString& ErrorMessage)
+{
+	if (!ErrorMessage.IsEmpty() || InUrls.Num() == 0)
+	{
+		BroadcastFinished(ErrorMessage.IsEmpty() ? TEXT("Response has no images") : ErrorMessage, false);
+		return;
+	}
+	// the parser gives one base64 slot per image, empty when the image came as a URL
+	if (Base64Images.Num() != InUrls.Num())
+	{
+		BroadcastFinished(FString::Printf(TEXT("Response has %d URLs but %d inline images"), InUrls.Num(), Base64Images.Num()), false);
+		return;
+	}
+
+	Urls = MoveTemp(InUrls);
+	Images.SetNum(Urls.Num());
+	for (int32 Index = 0; Index < Images.Num(); Index++)
+	{
+		Images[Index].Base64 = MoveTemp(Base64Images[Index]);
+	}
+	Textures.SetNum(Images.Num());
+	Pump();
+}
+
+void UOpenAICallDALLETextures::Pump()
+{
+	while (NumInFlight < FMath::Max(1, maxConcurrentImages) && NextImage < Images.Num())
+	{
+		NumInFlight++;
+		StartImage(NextImage++);
+	}
+}
+
+void UOpenAICallDALLETextures::StartImage(int32 Index)
+{
+	FPendingImage& Image = Images[Index];
+	TWeakObjectPtr<UOpenAICallDALLETextures> WeakThis(this);
+	auto OnLoaded = [WeakThis, Index](UTexture2D* Texture, const FString& ErrorMessage)
+	{
+		if (UOpenAICallDALLETextures* This = WeakThis.Get())
+		{
+			This->OnImageLoaded(Index, Texture, ErrorMessage);
+		}
+	};
+
+	// new images are cached from the worker that decodes them
+	TFunction<void(const FImage&)> OnDecoded;
+	if (useCache)
+	{
+		OnDecoded = [Key = CacheKey](const FImage& Decoded)
+		{
+			FOpenAIImageCache::Get().Store(Key, Decoded);
+		};
+	}
+
+	if (!Image.CachedPath.IsEmpty())
+	{
+		FOpenAIImageCache::Get().LoadAsync(Image.CachedPath, maxCachedSize, OnLoaded);
+		return;
+	}
+	if (Image.Base64.Num() > 0)
+	{
+		OpenAIImageCodec::LoadTextureAsync(MoveTemp(Image.Base64), true, OnLoaded, MoveTemp(OnDecoded));
+		return;
+	}
+	if (Urls[Index].IsEmpty())
+	{
+		OnImageLoaded(Index, nullptr, TEXT("Response has no image data"));
+		return;
+	}
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(Urls[Index]);
+	HttpRequest->SetVerb(TEXT("GET"));
+	TSharedRef<FBufferArchive> Body = MakeShared<FBufferArchive>();
+	HttpRequest->SetResponseBodyReceiveStream(Body);
+	HttpRequest->OnProcessRequestComplete().BindLambda([WeakThis, Index, Body, OnLoaded, OnDecoded](FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+	{
+		UOpenAICallDALLETextures* This = WeakThis.Get();
+		if (!This)
+		{
+			return;
+		}
+		This->Images[Index].Request.Reset();
+
+		if (!WasSuccessful || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+		{
+			This->OnImageLoaded(Index, nullptr, Response.IsValid()
+				? FString::Printf(TEXT("Image download failed with status %d"), Response->GetResponseCode())
+				: TEXT("Image download failed"));
+			return;
+		}
+		OpenAIImageCodec::LoadTextureAsync(TakeBody(Body), false, OnLoaded, OnDecoded);
+	});
+
+	Image.Request = HttpRequest;
+	if (!HttpRequest->ProcessRequest())
+	{
+		Image.Request.Reset();
+		OnImageLoaded(Index, nullptr, TEXT("Error sending request"));
+	}
+}
+
+void UOpenAICallDALLETextures::OnImageLoaded(int32 Index, UTexture2D* Texture, const FString& ErrorMessage)
+{
+	NumInFlight--;
+	NumDone++;
+	Textures[Index] = Texture;
+	if (!Texture)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Image %d of %d failed. Error: %s"), Index + 1, Images.Num(), *ErrorMessage);
+		if (FirstError.IsEmpty())
+		{
+			FirstError = FString::Printf(TEXT("Image %d of %d failed: %s"), Index + 1, Images.Num(), *ErrorMessage);
+		}
+	}
+
+	if (NumDone == Images.Num())
+	{
+		BroadcastFinished(FirstError, FirstError.IsEmpty());
+		return;
+	}
+	Pump();
+}
+
+void UOpenAICallDALLETextures::CancelRequests()
+{
+	if (CurrentRequest.IsValid())
+	{
+		CurrentRequest->OnProcessRequestComplete().Unbind();
+		CurrentRequest->CancelRequest();
+		CurrentRequest.Reset();
+	}
+	for (FPendingImage& Image : Images)
+	{
+		if (Image.Request.IsValid())
+		{
+			Image.Request->OnProcessRequestComplete().Unbind();
+			Image.Request->CancelRequest();
+			Image.Request.Reset();
+		}
+	}
+}
+
+void UOpenAICallDALLETextures::Cancel()
+{
+	CancelRequests();
+	if (FinishedF.IsBound())
+	{
+		// the C++ entry point keeps the node rooted until it finishes
+		FinishedF.Unbind();
+		RemoveFromRoot();
+		ConditionalBeginDestroy();
+	}
+}
+
+void UOpenAICallDALLETextures::BeginDestroy()
+{
+	CancelRequests();
+	Super::BeginDestroy();
+}
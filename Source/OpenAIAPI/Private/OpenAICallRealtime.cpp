@@ -3,6 +3,9 @@
 #include "OpenAICallRealtime.h"
 #include "OpenAIUtils.h"
 #include "OpenAIAudioCapture.h"
+#include "OpenAIRealtimeSessionManager.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIToolbox.h"
 #include "WebSocketsModule.h"
 #include "JsonUtilities.h"
 #include "Sound/SoundWaveProcedural.h"
@@ -10,24 +13,10 @@
 #include "Async/Async.h"
 #include "Kismet/GameplayStatics.h"
 
-struct FWavHeader
+namespace
 {
-    char ChunkID[4];       // "RIFF"
-    uint32 ChunkSize;
-    char Format[4];        // "WAVE"
-    char Subchunk1ID[4];   // "fmt "
-    uint32 Subchunk1Size;  // 16 for PCM
-    uint16 AudioFormat;    // 1 for PCM
-    uint16 NumChannels;
-    uint32 SampleRate;
-    uint32 ByteRate;
-    uint16 BlockAlign;
-    uint16 BitsPerSample;
-    char Subchunk2ID[4];   // "data"
-    uint32 Subchunk2Size;
-};
-
-TWeakObjectPtr<UOpenAICallRealtime> UOpenAICallRealtime::CurrentSession = nullptr;
+    std::atomic<int32> GNextRealtimeSessionId{ 1 };
+}
 
 UOpenAICallRealtime::UOpenAICallRealtime()
     : AudioCaptureComponent(nullptr),
@@ -56,48 +45,25 @@ void UOpenAICallRealtime::BeginDestroy()
 {
     UE_LOG(LogTemp, Log, TEXT("UOpenAICallRealtime BeginDestroy called"));
     StopRealtimeSession();
+    // Strand tasks hold a raw this; closing waits for the one running and drops the rest
+    if (Strand.IsValid())
+    {
+        Strand->Close();
+    }
     Super::BeginDestroy();
 }
 
-void UOpenAICallRealtime::CreateWavHeader(const TArray<uint8>& AudioData, TArray<uint8>& OutWavData, uint32 SampleRate, uint16 NumChannels, uint16 BitsPerSample)
-{
-    FWavHeader WavHeader;
-
-    // RIFF Chunk
-    FMemory::Memcpy(WavHeader.ChunkID, "RIFF", 4);
-    WavHeader.ChunkSize = 36 + AudioData.Num(); // 4 + (8 + Subchunk1Size) + (8 + Subchunk2Size)
-    FMemory::Memcpy(WavHeader.Format, "WAVE", 4);
-
-    // fmt Subchunk
-    FMemory::Memcpy(WavHeader.Subchunk1ID, "fmt ", 4);
-    WavHeader.Subchunk1Size = 16;
-    WavHeader.AudioFormat = 1; // PCM
-    WavHeader.NumChannels = NumChannels;
-    WavHeader.SampleRate = SampleRate;
-    WavHeader.BitsPerSample = BitsPerSample;
-    WavHeader.ByteRate = WavHeader.SampleRate * WavHeader.NumChannels * WavHeader.BitsPerSample / 8;
-    WavHeader.BlockAlign = WavHeader.NumChannels * WavHeader.BitsPerSample / 8;
-
-    // data Subchunk
-    FMemory::Memcpy(WavHeader.Subchunk2ID, "data", 4);
-    WavHeader.Subchunk2Size = AudioData.Num();
-
-    // Append header to WavData
-    OutWavData.Append(reinterpret_cast<uint8*>(&WavHeader), sizeof(FWavHeader));
-
-    // Append audio data
-    OutWavData.Append(AudioData);
-}
-
 UOpenAICallRealtime* UOpenAICallRealtime::OpenAICallRealtime(
     FString Instructions,
     FString CreateResponseMessage,
     EOAOpenAIVoices Voice,
     float VadThreshold,
     int32 SilenceDurationMs,
-    int32 PrefixPaddingMs)
+    int32 PrefixPaddingMs,
+    int32 AudioChunkMs,
+    bool bCaptureMicrophone,
+    EOARealtimeAudioFormat AudioFormat)
 {
-    if (CurrentSession.IsValid()) { CurrentSession->StopRealtimeSession(); }
     UOpenAICallRealtime* Node = NewObject<UOpenAICallRealtime>();
     Node->SessionInstructions = Instructions;
     Node->CreateResponseMessage = CreateResponseMessage;
@@ -105,12 +71,10 @@ UOpenAICallRealtime* UOpenAICallRealtime::OpenAICallRealtime(
     Node->VadThreshold = VadThreshold;
     Node->SilenceDurationMs = SilenceDurationMs;
     Node->PrefixPaddingMs = PrefixPaddingMs;
-<<<<<<< HEAD
-
-    CurrentSession = Node;
-
-=======
->>>>>>> 84098f5661dbf475c0e73e58b73fa0e894b8df9e
+    Node->AudioChunkMs = AudioChunkMs;
+    Node->bCaptureMicrophone = bCaptureMicrophone;
+    Node->AudioFormat = AudioFormat;
+    Node->SessionId = GNextRealtimeSessionId++;
     UE_LOG(LogTemp, Log, TEXT("OpenAICallRealtime created with instructions: %s and voice: %d"), *Instructions, static_cast<int>(Voice));
     return Node;
 }
@@ -119,6 +83,24 @@ UOpenAICallRealtime* UOpenAICallRealtime::OpenAICallRealtime(
 void UOpenAICallRealtime::Activate()
 {
     UE_LOG(LogTemp, Log, TEXT("UOpenAICallRealtime::Activate called"));
+
+    // Sessions run side by side; the manager only refuses new ones past the per-process cap
+    if (!FOpenAIRealtimeSessionManager::Get().RegisterSession(this))
+    {
+        bSessionStopped = true;
+        OnResponseReceived.Broadcast(TEXT("Realtime session limit reached"), false);
+        return;
+    }
+
+    if (AudioFormat != EOARealtimeAudioFormat::PCM16)
+    {
+        // G.711 is narrowband, the rest of the pipeline stays at 24 kHz
+        UplinkResampler.Init(24000, 1, 8000);
+        DownlinkResampler.Init(8000, 1, 24000);
+    }
+
+    Strand = FOpenAIRealtimeSessionManager::Get().CreateStrand();
+    StartTime = FPlatformTime::Seconds();
     StartRealtimeSession();
 }
 
@@ -137,6 +119,12 @@ void UOpenAICallRealtime::StartRealtimeSession()
 
     InitializeWebSocket();
 
+    if (!bCaptureMicrophone)
+    {
+        UE_LOG(LogTemp, Log, TEXT("Session %d takes its input through SendInputAudio"), SessionId);
+        return;
+    }
+
     // Create and initialize the audio capture component
     AudioCaptureComponent = NewObject<UOpenAIAudioCapture>(this);
     if (AudioCaptureComponent)
@@ -144,12 +132,15 @@ void UOpenAICallRealtime::StartRealtimeSession()
         AudioCaptureComponent->RegisterComponent();
         UE_LOG(LogTemp, Log, TEXT("AudioCaptureComponent created and registered"));
 
+        AudioCaptureComponent->SetChunkDurationMs(AudioChunkMs);
         AudioCaptureComponent->Activate(false);
 
         // Bind the audio buffer captured event
-        AudioCaptureComponent->OnAudioBufferCaptured.AddDynamic(
-            this, &UOpenAICallRealtime::OnAudioBufferCaptured);
-        UE_LOG(LogTemp, Log, TEXT("OnAudioBufferCaptured event bound"));
+        // Raw, as it is called off the game thread; removed in StopRealtimeSession, which
+        // BeginDestroy runs, and removal waits for a delivery in progress
+        AudioCapturedHandle = AudioCaptureComponent->AddSamplesListener(
+            FOnAudioSamplesCaptured::FDelegate::CreateRaw(this, &UOpenAICallRealtime::OnAudioSamplesCaptured));
+        UE_LOG(LogTemp, Log, TEXT("OnAudioSamplesCaptured event bound"));
 
         // Start capturing audio
         AudioCaptureComponent->StartCapturing();
@@ -172,36 +163,65 @@ void UOpenAICallRealtime::StopRealtimeSession()
     if (!IsInGameThread())
     {
         UE_LOG(LogTemp, Warning, TEXT("StopRealtimeSession called off GameThread. Executing on GameThread."));
-        AsyncTask(ENamedThreads::GameThread, [this]()
+        TWeakObjectPtr<UOpenAICallRealtime> WeakThis(this);
+        AsyncTask(ENamedThreads::GameThread, [WeakThis]()
         {
-            StopRealtimeSession();
+            if (UOpenAICallRealtime* This = WeakThis.Get())
+            {
+                This->StopRealtimeSession();
+            }
         });
         return;
     }
 
 
     bSessionStopped = true;
+    // Before the socket lock is taken, as a running task may be sending
+    if (Strand.IsValid())
+    {
+        Strand->Close();
+    }
 
     UE_LOG(LogTemp, Log, TEXT("StopRealtimeSession called"));
     // Stop capturing audio
     if (IsValid(AudioCaptureComponent))
     {
+        AudioCaptureComponent->RemoveSamplesListener(AudioCapturedHandle);
         AudioCaptureComponent->StopCapturing();
         AudioCaptureComponent->DestroyAudioCapture();
-        AudioCaptureComponent->OnAudioBufferCaptured.RemoveDynamic(this, &UOpenAICallRealtime::OnAudioBufferCaptured);
         AudioCaptureComponent->DestroyComponent();
         AudioCaptureComponent = nullptr;
     }
 
     // Close WebSocket connection
-    if (WebSocket.IsValid())
+    TSharedPtr<IWebSocket> SocketToClose;
+    {
+        FScopeLock Lock(&SocketLock);
+        SocketToClose = MoveTemp(WebSocket);
+    }
+    if (SocketToClose.IsValid())
     {
         UE_LOG(LogTemp, Log, TEXT("Closing WebSocket"));
-        WebSocket->Close();
-        WebSocket.Reset();
+        SocketToClose->Close();
         UE_LOG(LogTemp, Log, TEXT("WebSocket closed and reset"));
     }
 
+    StopTime = FPlatformTime::Seconds();
+    FOpenAIRealtimeSessionManager::Get().UnregisterSession(this);
+
+    if (AudioEventsSent > 0)
+    {
+        const int64 PayloadBytes = AudioPayloadBytes;
+        const int64 WireBytes = AudioWireBytes;
+        UE_LOG(LogTemp, Log, TEXT("Session %d uplink: %lld audio events of %d ms, %lld %s bytes, %lld bytes sent (%.1f%% framing overhead over base64)"),
+            SessionId, AudioEventsSent.load(), AudioChunkMs, PayloadBytes, *UOpenAIUtils::GetRealtimeAudioFormatString(AudioFormat), WireBytes,
+            100.0 * (WireBytes - (int64)FBase64::GetEncodedDataSize((uint32)PayloadBytes)) / FMath::Max<int64>(1, WireBytes));
+    }
+
+    const FOpenAIRealtimeSessionStats Stats = GetSessionStats();
+    UE_LOG(LogTemp, Log, TEXT("Session %d audio: %lld bytes in, relay %lld in / %lld out, codec %.1f ms (%.2f%% of a core)"),
+        SessionId, Stats.AudioBytesReceived, Stats.RelayBytesIn, Stats.RelayBytesOut, Stats.CodecCpuMs, Stats.CodecCpuPercent);
+
     UE_LOG(LogTemp, Log, TEXT("Realtime session stopped successfully"));
 }
 
@@ -212,9 +232,13 @@ void UOpenAICallRealtime::CancelRealtimeSession() {
     if (!IsInGameThread())
     {
         UE_LOG(LogTemp, Warning, TEXT("CancelRealtimeSession called off GameThread. Executing on GameThread."));
-        AsyncTask(ENamedThreads::GameThread, [this]()
+        TWeakObjectPtr<UOpenAICallRealtime> WeakThis(this);
+        AsyncTask(ENamedThreads::GameThread, [WeakThis]()
             {
-                CancelRealtimeSession();
+                if (UOpenAICallRealtime* This = WeakThis.Get())
+                {
+                    This->CancelRealtimeSession();
+                }
             });
         return;
     }
@@ -271,7 +295,10 @@ void UOpenAICallRealtime::InitializeWebSocket()
     Headers.Add(TEXT("OpenAI-Beta"), TEXT("realtime=v1"));
 
     // Create the WebSocket with headers
-    WebSocket = FWebSocketsModule::Get().CreateWebSocket(Url, TEXT(""), Headers);
+    {
+        FScopeLock Lock(&SocketLock);
+        WebSocket = FWebSocketsModule::Get().CreateWebSocket(Url, TEXT(""), Headers);
+    }
 
     if (WebSocket.IsValid())
     {
@@ -298,62 +325,71 @@ void UOpenAICallRealtime::InitializeWebSocket()
 void UOpenAICallRealtime::OnWebSocketConnected()
 {
     UE_LOG(LogTemp, Log, TEXT("WebSocket connected"));
-     // Clamp the threshold value
-    float ClampedThreshold = FMath::Clamp(VadThreshold, 0.0f, 1.0f);
-
-    // Format the threshold with exactly 6 decimal places
-    FString FormattedThreshold = FString::Printf(TEXT("%.6f"), ClampedThreshold);
-
-    // Construct the entire message as a string
-    FString SessionUpdateEvent = FString::Printf(TEXT(R"({
-        "type": "session.update",
-        "session": {
-            "modalities": ["text", "audio"],
-            "instructions": "%s",
-            "voice": "%s",
-            "input_audio_format": "pcm16",
-            "output_audio_format": "pcm16",
-            "input_audio_transcription": {
-                "model": "whisper-1"
-            },
-            "turn_detection": {
-                "type": "server_vad",
-                "threshold": %s,
-                "prefix_padding_ms": %d,
-                "silence_duration_ms": %d
-            },
-            "tools": [],
-            "tool_choice": "auto"
+    // Both events are written straight to UTF-8; instructions are escaped by the writer
+    TArray<uint8> Buffer;
+    {
+        FOpenAIJsonWriter Writer(Buffer);
+        Writer.BeginObject();
+        Writer.Field("type", TEXT("session.update"));
+        Writer.Key("session");
+        Writer.BeginObject();
+        Writer.Key("modalities");
+        Writer.BeginArray();
+        Writer.Value(TEXT("text"));
+        Writer.Value(TEXT("audio"));
+        Writer.EndArray();
+        Writer.Field("instructions", SessionInstructions);
+        Writer.Field("voice", UOpenAIUtils::GetVoiceString(SelectedVoice));
+        Writer.Field("input_audio_format", UOpenAIUtils::GetRealtimeAudioFormatString(AudioFormat));
+        Writer.Field("output_audio_format", UOpenAIUtils::GetRealtimeAudioFormatString(AudioFormat));
+        Writer.Key("input_audio_transcription");
+        Writer.BeginObject();
+        Writer.Field("model", TEXT("whisper-1"));
+        Writer.EndObject();
+        Writer.Key("turn_detection");
+        Writer.BeginObject();
+        Writer.Field("type", TEXT("server_vad"));
+        Writer.Field("threshold", FMath::Clamp(VadThreshold, 0.0f, 1.0f));
+        Writer.Field("prefix_padding_ms", PrefixPaddingMs);
+        Writer.Field("silence_duration_ms", SilenceDurationMs);
+        Writer.EndObject();
+        Writer.Key("tools");
+        if (Toolbox.IsValid() && Toolbox->GetDefinitions().Num() > 0)
+        {
+            FOpenAIToolbox::WriteDefinitions(Writer, Toolbox->GetDefinitions(), true, false);
+        }
+        else
+        {
+            Writer.BeginArray();
+            Writer.EndArray();
         }
-    })"),
-        *SessionInstructions.ReplaceCharWithEscapedChar(),
-        *UOpenAIUtils::GetVoiceString(SelectedVoice),
-        *FormattedThreshold,
-        PrefixPaddingMs,
-        SilenceDurationMs
-    );
+        Writer.Field("tool_choice", TEXT("auto"));
+        Writer.EndObject();
+        Writer.EndObject();
+    }
 
-    UE_LOG(LogTemp, Log, TEXT("Sending Session Update Event: %s"), *SessionUpdateEvent);
-    WebSocket->Send(SessionUpdateEvent);
+    const FUTF8ToTCHAR SessionUpdateText((const ANSICHAR*)Buffer.GetData(), Buffer.Num());
+    UE_LOG(LogTemp, Log, TEXT("Sending Session Update Event: %s"), *FString(SessionUpdateText.Length(), SessionUpdateText.Get()));
+    SendUtf8(Buffer);
 
     if (!CreateResponseMessage.IsEmpty()) {
-        // Construct the modalities array as a string
-        FString ModalitiesString = TEXT("\"text\", \"audio\"");  // Adjust if needed
-
-        // Construct the entire response.create event as a string
-        FString ResponseCreateEvent = FString::Printf(TEXT(R"({
-            "type": "response.create",
-            "response": {
-                "instructions": "%s",
-                "modalities": [%s]
-            }
-        })"),
-            *CreateResponseMessage.ReplaceCharWithEscapedChar(),
-            *ModalitiesString
-        );
-
-        UE_LOG(LogTemp, Log, TEXT("Sending Response Create Event: %s"), *ResponseCreateEvent);
-        WebSocket->Send(ResponseCreateEvent);
+        Buffer.Reset();
+        FOpenAIJsonWriter Writer(Buffer);
+        Writer.BeginObject();
+        Writer.Field("type", TEXT("response.create"));
+        Writer.Key("response");
+        Writer.BeginObject();
+        Writer.Field("instructions", CreateResponseMessage);
+        Writer.Key("modalities");
+        Writer.BeginArray();
+        Writer.Value(TEXT("text"));
+        Writer.Value(TEXT("audio"));
+        Writer.EndArray();
+        Writer.EndObject();
+        Writer.EndObject();
+
+        UE_LOG(LogTemp, Log, TEXT("Sending Response Create Event"));
+        SendUtf8(Buffer);
         UE_LOG(LogTemp, Log, TEXT("Response create event sent"));
     } else {
         UE_LOG(LogTemp, Log, TEXT("No create response message provided, skipping response create event"));
@@ -379,6 +415,25 @@ void UOpenAICallRealtime::OnWebSocketClosed(int32 StatusCode,
 }
 
 void UOpenAICallRealtime::OnWebSocketMessage(const FString& Message)
+{
+    BytesReceived += Message.Len();
+    MessagesReceived++;
+
+    // Parsing and base64 decoding happen on the shared worker pool, in arrival order
+    if (Strand.IsValid())
+    {
+        // Raw this: the strand is closed in StopRealtimeSession and BeginDestroy
+        Strand->Enqueue([this, Message]()
+        {
+            if (!bSessionStopped)
+            {
+                HandleWebSocketMessage(Message);
+            }
+        });
+    }
+}
+
+void UOpenAICallRealtime::HandleWebSocketMessage(const FString& Message)
 {
     FString TruncatedMessage = Message.Left(200);
     if (Message.Len() > 200)
@@ -391,6 +446,9 @@ void UOpenAICallRealtime::OnWebSocketMessage(const FString& Message)
     TSharedRef<TJsonReader<>> Reader =
         TJsonReaderFactory<>::Create(Message);
 
+    // Replies hop to the game thread, where the weak pointer is safe to resolve
+    TWeakObjectPtr<UOpenAICallRealtime> WeakThis(this);
+
     if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
     {
         FString EventType = JsonObject->GetStringField(TEXT("type"));
@@ -401,15 +459,20 @@ void UOpenAICallRealtime::OnWebSocketMessage(const FString& Message)
             // Extract text delta
             FString TextDelta = JsonObject->GetStringField(TEXT("text"));
             UE_LOG(LogTemp, Log, TEXT("Text Delta: %s"), *TextDelta);
-            AsyncTask(ENamedThreads::GameThread, [this, TextDelta]()
+            RecordResponseLatency();
+            AsyncTask(ENamedThreads::GameThread, [WeakThis, TextDelta]()
             {
-                  OnResponseReceived.Broadcast(TextDelta, true);
+                if (UOpenAICallRealtime* This = WeakThis.Get())
+                {
+                    This->OnResponseReceived.Broadcast(TextDelta, true);
+                }
             });
         }
         else if (EventType == TEXT("response.audio_transcript.delta"))
         {
             FString AudioTranscriptDelta = JsonObject->GetStringField(TEXT("delta"));
             UE_LOG(LogTemp, Log, TEXT("Audio Transcript Delta: %s"), *AudioTranscriptDelta);
+            RecordResponseLatency();
         }
         else if (EventType == TEXT("response.audio.delta"))
         {
@@ -417,21 +480,44 @@ void UOpenAICallRealtime::OnWebSocketMessage(const FString& Message)
             TArray<uint8> AudioData;
             FBase64::Decode(AudioBase64, AudioData);
             UE_LOG(LogTemp, Log, TEXT("Audio Delta received, size: %d bytes"), AudioData.Num());
+            RecordResponseLatency();
+            AudioBytesReceived += AudioData.Num();
 
-            AsyncTask(ENamedThreads::GameThread, [this, AudioData]()
+            TArray<uint8> PCM16Data;
+            DecodeOutputAudio(AudioData, PCM16Data);
+
+            AsyncTask(ENamedThreads::GameThread, [WeakThis, PCM16Data = MoveTemp(PCM16Data)]()
             {
-                PlayAudioData(AudioData);
+                if (UOpenAICallRealtime* This = WeakThis.Get())
+                {
+                    This->PlayAudioData(PCM16Data);
+                }
             });
         }
         else if (EventType == TEXT("input_audio_buffer.speech_started"))
         {
             UE_LOG(LogTemp, Log, TEXT("-------------------------------------------------> Response was cancelled due to turn_detected"));
             // Ensure the delegate is called on the game thread
-            AsyncTask(ENamedThreads::GameThread, [this]()
+            AsyncTask(ENamedThreads::GameThread, [WeakThis]()
             {
-                OnCancelAudioReceived.Broadcast(true);
+                if (UOpenAICallRealtime* This = WeakThis.Get())
+                {
+                    This->OnCancelAudioReceived.Broadcast(true);
+                }
             });
         }
+        else if (EventType == TEXT("response.done") && Toolbox.IsValid())
+        {
+            const TSharedPtr<FJsonObject>* Response = nullptr;
+            if (JsonObject->TryGetObjectField(TEXT("response"), Response))
+            {
+                DispatchToolCalls(*Response);
+            }
+        }
+        else if (EventType == TEXT("input_audio_buffer.speech_stopped"))
+        {
+            SpeechStoppedCycles = FPlatformTime::Cycles64();
+        }
         else if (EventType == TEXT("error"))
         {
             // Handle error
@@ -439,7 +525,13 @@ void UOpenAICallRealtime::OnWebSocketMessage(const FString& Message)
                 JsonObject->GetObjectField(TEXT("error"));
             FString ErrorMessage = ErrorObject->GetStringField(TEXT("message"));
             UE_LOG(LogTemp, Error, TEXT("Error received: %s"), *ErrorMessage);
-            OnResponseReceived.Broadcast(ErrorMessage, false);
+            AsyncTask(ENamedThreads::GameThread, [WeakThis, ErrorMessage]()
+            {
+                if (UOpenAICallRealtime* This = WeakThis.Get())
+                {
+                    This->OnResponseReceived.Broadcast(ErrorMessage, false);
+                }
+            });
         }
         // Handle other event types as needed
     }
@@ -449,82 +541,319 @@ void UOpenAICallRealtime::OnWebSocketMessage(const FString& Message)
     }
 }
 
-void UOpenAICallRealtime::SendRealtimeEvent(
-    const TSharedPtr<FJsonObject>& Event, bool isAudioStreamEvent)
+void UOpenAICallRealtime::SetToolbox(TSharedRef<const FOpenAIToolbox, ESPMode::ThreadSafe> InToolbox)
+{
+    Toolbox = InToolbox;
+}
+
+void UOpenAICallRealtime::DispatchToolCalls(const TSharedPtr<FJsonObject>& Response)
+{
+    const TArray<TSharedPtr<FJsonValue>>* Output = nullptr;
+    if (!Response.IsValid() || !Response->TryGetArrayField(TEXT("output"), Output))
+    {
+        return;
+    }
+
+    TArray<FChatToolCall> Calls;
+    for (const TSharedPtr<FJsonValue>& Item : *Output)
+    {
+        const TSharedPtr<FJsonObject>* ItemObject = nullptr;
+        if (Item.IsValid() && Item->TryGetObject(ItemObject) && (*ItemObject)->GetStringField(TEXT("type")) == TEXT("function_call"))
+        {
+            FChatToolCall& Call = Calls.AddDefaulted_GetRef();
+            (*ItemObject)->TryGetStringField(TEXT("call_id"), Call.id);
+            (*ItemObject)->TryGetStringField(TEXT("name"), Call.name);
+            (*ItemObject)->TryGetStringField(TEXT("arguments"), Call.arguments);
+        }
+    }
+
+    if (Calls.Num() == 0)
+    {
+        return;
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("Realtime response called %d tools"), Calls.Num());
+    TWeakObjectPtr<UOpenAICallRealtime> WeakThis(this);
+    Toolbox->Dispatch(Calls, [WeakThis](TArray<FChatLog>&& Results)
+    {
+        UOpenAICallRealtime* This = WeakThis.Get();
+        if (This && !This->bSessionStopped)
+        {
+            This->SendToolResults(Results);
+        }
+    });
+}
+
+void UOpenAICallRealtime::SendToolResults(const TArray<FChatLog>& Results)
 {
-    FString EventString;
-    TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer =
-        TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&EventString);
-    FJsonSerializer::Serialize(Event.ToSharedRef(), Writer);
+    TArray<uint8> Buffer;
+    for (const FChatLog& Result : Results)
+    {
+        Buffer.Reset();
+        FOpenAIJsonWriter Writer(Buffer);
+        Writer.BeginObject();
+        Writer.Field("type", TEXT("conversation.item.create"));
+        Writer.Key("item");
+        Writer.BeginObject();
+        Writer.Field("type", TEXT("function_call_output"));
+        Writer.Field("call_id", Result.toolCallId);
+        Writer.Field("output", Result.content);
+        Writer.EndObject();
+        Writer.EndObject();
+        SendUtf8(Buffer);
+    }
+
+    // One response for the whole batch of outputs
+    SendText(TEXT("{\"type\":\"response.create\"}"));
+}
 
-    if (!isAudioStreamEvent) {
-        UE_LOG(LogTemp, Log, TEXT("Full JSON Event: %s"), *EventString);
+void UOpenAICallRealtime::SendText(const FString& Text)
+{
+    FScopeLock Lock(&SocketLock);
+    if (WebSocket.IsValid())
+    {
+        WebSocket->Send(Text);
+        BytesSent += FTCHARToUTF8_Convert::ConvertedLength(*Text, Text.Len());
+        MessagesSent++;
     }
+}
 
-    FString TruncatedEventString = EventString.Left(2000);
-    if (EventString.Len() > 2000)
+void UOpenAICallRealtime::SendUtf8(TArrayView<const uint8> Utf8)
+{
+    FScopeLock Lock(&SocketLock);
+    if (WebSocket.IsValid())
     {
-        TruncatedEventString += TEXT("...");
+        WebSocket->Send(Utf8.GetData(), Utf8.Num(), false);
+        BytesSent += Utf8.Num();
+        MessagesSent++;
     }
+}
 
-    if (!isAudioStreamEvent) {
-        UE_LOG(LogTemp, Log, TEXT("Sending Realtime Event: %s"), *TruncatedEventString);
+void UOpenAICallRealtime::RecordResponseLatency()
+{
+    // Only the first delta after the end of speech counts
+    const uint64 StoppedCycles = SpeechStoppedCycles.exchange(0);
+    if (StoppedCycles != 0)
+    {
+        const float LatencyMs = (float)FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StoppedCycles);
+        LastResponseLatencyMs = LatencyMs;
+        // The strand is the only writer, so a plain load/store of the total is enough
+        TotalResponseLatencyMs = TotalResponseLatencyMs.load() + LatencyMs;
+        NumLatencySamples++;
     }
+}
 
-    WebSocket->Send(EventString);
+FOpenAIRealtimeSessionStats UOpenAICallRealtime::GetSessionStats() const
+{
+    FOpenAIRealtimeSessionStats Stats;
+    Stats.SessionId = SessionId;
+    if (StartTime > 0.0)
+    {
+        Stats.DurationSeconds = (float)((StopTime > 0.0 ? StopTime : FPlatformTime::Seconds()) - StartTime);
+    }
+    Stats.BytesSent = BytesSent;
+    Stats.BytesReceived = BytesReceived;
+    Stats.MessagesSent = MessagesSent;
+    Stats.MessagesReceived = MessagesReceived;
+    if (Stats.DurationSeconds > 0.0f)
+    {
+        Stats.UplinkKbps = Stats.BytesSent * 8.0f / 1000.0f / Stats.DurationSeconds;
+        Stats.DownlinkKbps = Stats.BytesReceived * 8.0f / 1000.0f / Stats.DurationSeconds;
+    }
+    Stats.AudioFormat = AudioFormat;
+    Stats.AudioBytesSent = AudioPayloadBytes;
+    Stats.AudioBytesReceived = AudioBytesReceived;
+    Stats.RelayBytesIn = RelayBytesIn;
+    Stats.RelayBytesOut = RelayBytesOut;
+    Stats.CodecCpuMs = (float)FPlatformTime::ToMilliseconds64(CodecCycles.load());
+    if (Stats.DurationSeconds > 0.0f)
+    {
+        Stats.CodecCpuPercent = Stats.CodecCpuMs / (Stats.DurationSeconds * 1000.0f) * 100.0f;
+    }
+    Stats.LastResponseLatencyMs = LastResponseLatencyMs.load();
+    const int32 LatencySamples = NumLatencySamples.load();
+    Stats.AverageResponseLatencyMs = LatencySamples > 0 ? (float)(TotalResponseLatencyMs.load() / LatencySamples) : 0.0f;
+    Stats.PendingTasks = Strand.IsValid() ? Strand->GetNumPending() : 0;
+    return Stats;
 }
 
-void UOpenAICallRealtime::OnAudioBufferCaptured(
-    const TArray<float>& AudioBuffer)
+void UOpenAICallRealtime::OnAudioSamplesCaptured(
+    TArrayView<const float> AudioBuffer)
 {
     //UE_LOG(LogTemp, Log, TEXT("Audio Buffer Captured, size: %d samples"), AudioBuffer.Num());
     // Send the audio data to the OpenAI API
-    SendAudioDataToAPI(AudioBuffer);
+    SendInputAudio(AudioBuffer);
 
     // Broadcast the audio buffer to Blueprints
     //OnAudioBufferReceived.Broadcast(AudioBuffer);
 }
 
-void UOpenAICallRealtime::SendAudioDataToAPI(
-    const TArray<float>& AudioBuffer)
+void UOpenAICallRealtime::SendInputAudio(TArrayView<const float> AudioBuffer)
 {
+    if (bSessionStopped || !Strand.IsValid() || AudioBuffer.Num() == 0)
+    {
+        return;
+    }
 
-    UE_LOG(LogTemp, Log, TEXT("Audio out -> %d samples"), AudioBuffer.Num());
-    // Convert float audio data to PCM16
-    TArray<uint8> PCM16Data;
-    PCM16Data.SetNumUninitialized(AudioBuffer.Num() * sizeof(int16));
+    // The view is only valid during this call; encoding and sending run on the
+    // session strand so appends stay in order
+    TArray<float> Samples(AudioBuffer.GetData(), AudioBuffer.Num());
+    Strand->Enqueue([this, Samples = MoveTemp(Samples)]()
+    {
+        if (!bSessionStopped)
+        {
+            EncodeAndSendInputAudio(Samples.GetData(), Samples.Num());
+        }
+    });
+}
 
-    for (int32 i = 0; i < AudioBuffer.Num(); ++i)
+void UOpenAICallRealtime::SendInputAudioOpus(TArray<uint8> RelayPacket)
+{
+    if (bSessionStopped || !Strand.IsValid() || RelayPacket.Num() == 0)
     {
-        float Sample = FMath::Clamp(AudioBuffer[i], -1.0f, 1.0f);
-        int16 IntSample = (int16)(Sample * 32767.0f);
-        PCM16Data[i * 2] = IntSample & 0xFF;
-        PCM16Data[i * 2 + 1] = (IntSample >> 8) & 0xFF;
-        //UE_LOG(LogTemp, Log, TEXT("Sample"), Sample);
+        return;
     }
 
-    // Base64 encode the PCM16 data
-    FString Base64Audio = FBase64::Encode(PCM16Data);
-    //UE_LOG(LogTemp, Log, TEXT("Audio data encoded to Base64, length: %d"), Base64Audio.Len());
+    RelayBytesIn += RelayPacket.Num();
 
-    // Create the input_audio_buffer.append event
-    TSharedPtr<FJsonObject> AudioEvent =
-        MakeShareable(new FJsonObject());
-    AudioEvent->SetStringField(TEXT("type"),
-                               TEXT("input_audio_buffer.append"));
-    AudioEvent->SetStringField(TEXT("audio"), Base64Audio);
+    Strand->Enqueue([this, RelayPacket = MoveTemp(RelayPacket)]()
+    {
+        if (bSessionStopped)
+        {
+            return;
+        }
 
-    SendRealtimeEvent(AudioEvent, true);
-    //UE_LOG(LogTemp, Log, TEXT("Audio data sent to API"));
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        if (!RelayDecoder.IsValid())
+        {
+            RelayDecoder = MakeUnique<FOpenAIOpusDecoder>();
+            RelayDecoder->Init();
+        }
+
+        TArray<float> Samples;
+        if (!RelayDecoder->Decode(RelayPacket, Samples))
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Session %d dropped an undecodable relay packet"), SessionId);
+        }
+        CodecCycles += FPlatformTime::Cycles64() - StartCycles;
+
+        if (Samples.Num() > 0)
+        {
+            EncodeAndSendInputAudio(Samples.GetData(), Samples.Num());
+        }
+    });
 }
 
-void UOpenAICallRealtime::PlayAudioData(const TArray<uint8>& AudioData)
+bool UOpenAICallRealtime::EnableOutputRelay(int32 BitrateBps)
 {
-    TArray<uint8> ProcessedData;
+    if (Strand.IsValid())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("EnableOutputRelay must be called before the session starts"));
+        return false;
+    }
 
-    //CreateWavHeader(AudioData, ProcessedData);
+    RelayEncoder = MakeUnique<FOpenAIOpusEncoder>();
+    if (!RelayEncoder->Init(BitrateBps))
+    {
+        RelayEncoder.Reset();
+        return false;
+    }
+    return true;
+}
 
-    // Broadcast the processed data
-    //OnAudioDataReceived.Broadcast(ProcessedData);
+void UOpenAICallRealtime::EncodeAndSendInputAudio(const float* Samples, int32 Num)
+{
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+
+    TArray<uint8> EncodedAudio;
+    if (AudioFormat == EOARealtimeAudioFormat::PCM16)
+    {
+        OpenAIAudioCodec::FloatToPCM16(Samples, Num, EncodedAudio);
+    }
+    else
+    {
+        UplinkScratch.SetNumUninitialized(UplinkResampler.GetMaxOutputFrames(Num), EAllowShrinking::No);
+        const int32 NumNarrowband = UplinkResampler.Process(Samples, Num, UplinkScratch.GetData(), UplinkScratch.Num());
+        FOpenAIG711::Encode(AudioFormat == EOARealtimeAudioFormat::G711_ALAW, UplinkScratch.GetData(), NumNarrowband, EncodedAudio);
+    }
+
+    CodecCycles += FPlatformTime::Cycles64() - StartCycles;
+
+    if (EncodedAudio.Num() > 0)
+    {
+        SendAudioDataToAPI(EncodedAudio);
+    }
+}
+
+void UOpenAICallRealtime::DecodeOutputAudio(const TArray<uint8>& Payload, TArray<uint8>& OutPCM16)
+{
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+
+    const float* Samples = nullptr;
+    int32 NumSamples = 0;
+
+    if (AudioFormat == EOARealtimeAudioFormat::PCM16)
+    {
+        OutPCM16 = Payload;
+        if (RelayEncoder.IsValid())
+        {
+            DownlinkScratch.Reset();
+            OpenAIAudioCodec::PCM16ToFloat(Payload, DownlinkScratch);
+            Samples = DownlinkScratch.GetData();
+            NumSamples = DownlinkScratch.Num();
+        }
+    }
+    else
+    {
+        // Playback and the relay expect 24 kHz PCM16 whatever the wire format
+        TArray<float> Narrowband;
+        FOpenAIG711::Decode(AudioFormat == EOARealtimeAudioFormat::G711_ALAW, Payload, Narrowband);
+
+        DownlinkScratch.SetNumUninitialized(DownlinkResampler.GetMaxOutputFrames(Narrowband.Num()), EAllowShrinking::No);
+        NumSamples = DownlinkResampler.Process(Narrowband.GetData(), Narrowband.Num(), DownlinkScratch.GetData(), DownlinkScratch.Num());
+        Samples = DownlinkScratch.GetData();
+
+        OutPCM16.Reset();
+        OpenAIAudioCodec::FloatToPCM16(Samples, NumSamples, OutPCM16);
+    }
+
+    TArray<uint8> RelayPacket;
+    if (RelayEncoder.IsValid() && NumSamples > 0)
+    {
+        RelayEncoder->Encode(Samples, NumSamples, RelayPacket);
+    }
+
+    CodecCycles += FPlatformTime::Cycles64() - StartCycles;
+
+    if (RelayPacket.Num() > 0)
+    {
+        RelayBytesOut += RelayPacket.Num();
+        OnRelayAudioEncoded.Broadcast(RelayPacket);
+    }
+}
+
+void UOpenAICallRealtime::SendAudioDataToAPI(
+    const TArray<uint8>& EncodedAudio)
+{
+    UE_LOG(LogTemp, Log, TEXT("Audio out -> %d bytes"), EncodedAudio.Num());
+
+    // Build the input_audio_buffer.append event in UTF-8, base64 encoding straight into the frame
+    FOpenAIJsonWriter Writer;
+    Writer.BeginObject();
+    Writer.Field("type", TEXT("input_audio_buffer.append"));
+    Writer.Key("audio");
+    Writer.Base64Value(EncodedAudio);
+    Writer.EndObject();
+
+    AudioWireBytes += Writer.Num();
+    SendUtf8(Writer.GetBuffer());
+
+    AudioEventsSent++;
+    AudioPayloadBytes += EncodedAudio.Num();
+    //UE_LOG(LogTemp, Log, TEXT("Audio data sent to API"));
+}
+
+void UOpenAICallRealtime::PlayAudioData(const TArray<uint8>& AudioData)
+{
     OnAudioDataReceived.Broadcast(AudioData);
 }
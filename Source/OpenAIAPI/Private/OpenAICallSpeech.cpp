@@ -0,0 +1,530 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallSpeech.h"
+#include "OpenAIUtils.h"
+#include "OpenAIParser.h"
+#include "OpenAIModels.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIAudioCodec.h"
+#include "OpenAISpeechCache.h"
+#include "Sound/SoundWaveProcedural.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
+#include "UObject/Package.h"
+
+namespace
+{
+	constexpr int32 SpeechSampleRate = UOpenAICallSpeech::SampleRate;
+}
+
+/**
+ * Response body sink for a speech request. The HTTP thread writes the body into it as it arrives;
+ * once the status is known to be 2xx, audio is queued into the sound wave right away, from that
+ * thread alone, which is what the procedural wave's queue supports. Any other status, a proxy's
+ * HTML page included, makes the body an error held back for the game thread.
+ */
+class FOpenAISpeechStream final : public FArchive
+{
+public:
+	FOpenAISpeechStream(USoundWaveProcedural* InSound, bool bInOpus, bool bInKeepEncoded, TFunction<void()> InOnFirstAudio)
+		: Sound(InSound)
+		, bOpus(bInOpus)
+		, bRequestedOpus(bInOpus)
+		, bKeepEncoded(bInKeepEncoded)
+		, OnFirstAudio(MoveTemp(InOnFirstAudio))
+	{
+		SetIsSaving(true);
+		if (bOpus)
+		{
+			bOpus = Decoder.Init(SpeechSampleRate);
+		}
+	}
+
+	/** The request whose status decides what the body is. Set before it is sent. */
+	void SetRequest(const FHttpRequestPtr& InRequest)
+	{
+		Request = InRequest;
+	}
+
+	virtual void Serialize(void* Data, int64 Num) override
+	{
+		const TArrayView<const uint8> Bytes((const uint8*)Data, (int32)Num);
+		Received += Num;
+		if (Mode == EMode::Undecided)
+		{
+			// the status line is read on this thread before any body bytes; until a backend reports it, the body is held
+			const int32 Status = GetStatus();
+			if (Status > 0)
+			{
+				Decide(EHttpResponseCodes::IsOk(Status));
+			}
+		}
+		if (Mode == EMode::Audio)
+		{
+			Consume(Bytes);
+			return;
+		}
+
+		Held.Append(Bytes.GetData(), Bytes.Num());
+	}
+
+	virtual int64 Tell() override { return Received; }
+	virtual FString GetArchiveName() const override { return TEXT("FOpenAISpeechStream"); }
+
+	/** Called on the game thread once the body is complete, with whether the request got a 2xx status. */
+	void Finish(bool bSuccessStatus)
+	{
+		if (Mode == EMode::Undecided)
+		{
+			Decide(bSuccessStatus);
+		}
+	}
+
+	bool HasAudio() const { return NumSamples > 0; }
+	bool IsMalformed() const { return bMalformed; }
+	float GetDuration() const { return (float)NumSamples / SpeechSampleRate; }
+	uint64 GetFirstAudioCycles() const { return FirstAudioCycles; }
+	const TArray<uint8>& GetHeldBody() const { return Held; }
+	EOASpeechResponseFormat GetFormat() const { return bRequestedOpus ? EOASpeechResponseFormat::OPUS : EOASpeechResponseFormat::PCM; }
+
+	/** The response body as received, for the cache. Empty unless it was asked to be kept. */
+	TArray<uint8> TakeEncoded() { return MoveTemp(Encoded); }
+
+	/** The request is going away; nothing is queued after this. */
+	void Detach()
+	{
+		FScopeLock Lock(&DetachLock);
+		Sound = nullptr;
+		OnFirstAudio = nullptr;
+	}
+
+private:
+	enum class EMode : uint8
+	{
+		Undecided,
+		Audio,
+		Error,
+	};
+
+	int32 GetStatus() const
+	{
+		const FHttpRequestPtr Pinned = Request.Pin();
+		const FHttpResponsePtr Response = Pinned.IsValid() ? Pinned->GetResponse() : nullptr;
+		return Response.IsValid() ? Response->GetResponseCode() : 0;
+	}
+
+	void Decide(bool bSuccessStatus)
+	{
+		Mode = bSuccessStatus ? EMode::Audio : EMode::Error;
+		if (Mode == EMode::Audio)
+		{
+			TArray<uint8> Bytes = MoveTemp(Held);
+			Consume(Bytes);
+		}
+	}
+
+	void Consume(TArrayView<const uint8> Bytes)
+	{
+		if (bKeepEncoded)
+		{
+			Encoded.Append(Bytes.GetData(), Bytes.Num());
+		}
+
+		if (bOpus)
+		{
+			Decoded.Reset();
+			if (!Decoder.Decode(Bytes, Decoded))
+			{
+				bMalformed = true;
+				return;
+			}
+			PCM.Reset();
+			OpenAIAudioCodec::FloatToPCM16(Decoded.GetData(), Decoded.Num(), PCM);
+			Queue(PCM.GetData(), PCM.Num());
+			return;
+		}
+
+		// Chunks can split a sample; the odd byte waits for the next chunk
+		const uint8* Ptr = Bytes.GetData();
+		int32 Num = Bytes.Num();
+		if (bHasOddByte && Num > 0)
+		{
+			const uint8 Sample[2] = { OddByte, Ptr[0] };
+			Queue(Sample, 2);
+			bHasOddByte = false;
+			Ptr++;
+			Num--;
+		}
+		const int32 Even = Num & ~1;
+		Queue(Ptr, Even);
+		if (Num != Even)
+		{
+			OddByte = Ptr[Even];
+			bHasOddByte = true;
+		}
+	}
+
+	void Queue(const uint8* Data, int32 Num)
+	{
+		if (Num <= 0)
+		{
+			return;
+		}
+
+		FScopeLock Lock(&DetachLock);
+		if (!Sound)
+		{
+			return;
+		}
+		Sound->QueueAudio(Data, Num);
+		NumSamples += Num / sizeof(int16);
+		if (FirstAudioCycles == 0)
+		{
+			FirstAudioCycles = FPlatformTime::Cycles64();
+			if (OnFirstAudio)
+			{
+				OnFirstAudio();
+			}
+		}
+	}
+
+	USoundWaveProcedural* Sound;
+	bool bOpus;
+	bool bRequestedOpus;
+	bool bKeepEncoded;
+	TArray<uint8> Encoded;
+	TFunction<void()> OnFirstAudio;
+	FCriticalSection DetachLock;
+	TWeakPtr<IHttpRequest, ESPMode::ThreadSafe> Request;
+
+	EMode Mode = EMode::Undecided;
+	int64 Received = 0;
+	// Body bytes until the status is known, and all of an error body
+	TArray<uint8> Held;
+
+	FOpenAIOggOpusDecoder Decoder;
+	TArray<float> Decoded;
+	TArray<uint8> PCM;
+	uint8 OddByte = 0;
+	bool bHasOddByte = false;
+	bool bMalformed = false;
+	int64 NumSamples = 0;
+	uint64 FirstAudioCycles = 0;
+};
+
+UOpenAICallSpeech::UOpenAICallSpeech()
+{
+}
+
+UOpenAICallSpeech::~UOpenAICallSpeech()
+{
+}
+
+UOpenAICallSpeech* UOpenAICallSpeech::OpenAICallSpeech(FSpeechSettings speechSettingsInput)
+{
+	UOpenAICallSpeech* BPNode = NewObject<UOpenAICallSpeech>();
+	BPNode->speechSettings = speechSettingsInput;
+	return BPNode;
+}
+
+UOpenAICallSpeech* UOpenAICallSpeech::Speak(const FSpeechSettings& SpeechSettings, TFunction<void(USoundWaveProcedural* Sound)> OnStarted,
+	TFunction<void(USoundWaveProcedural* Sound, float Duration, const FString& ErrorMessage, bool Success)> OnFinished)
+{
+	UOpenAICallSpeech* Node = NewObject<UOpenAICallSpeech>();
+	Node->speechSettings = SpeechSettings;
+	Node->AddToRoot();
+	Node->StartedF.BindLambda([OnStarted](USoundWaveProcedural* Sound)
+	{
+		if (OnStarted)
+		{
+			OnStarted(Sound);
+		}
+	});
+	Node->FinishedF.BindLambda([OnFinished, Node](USoundWaveProcedural* Sound, float Duration, const FString& ErrorMessage, bool Success)
+	{
+		if (!Success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Speech failed. Error: %s"), *ErrorMessage);
+		}
+
+		if (OnFinished)
+		{
+			OnFinished(Sound, Duration, ErrorMessage, Success);
+		}
+
+		Node->RemoveFromRoot();
+		Node->ConditionalBeginDestroy();
+	});
+	Node->Activate();
+	return Node;
+}
+
+void UOpenAICallSpeech::BroadcastStarted()
+{
+	if (bStarted)
+	{
+		return;
+	}
+	bStarted = true;
+
+	if (Stream.IsValid() && Stream->GetFirstAudioCycles() > SentCycles)
+	{
+		FirstAudioLatencyMs = (float)FPlatformTime::ToMilliseconds64(Stream->GetFirstAudioCycles() - SentCycles);
+		UE_LOG(LogTemp, Log, TEXT("Speech audio started after %.0f ms"), FirstAudioLatencyMs);
+	}
+
+	Started.Broadcast(SoundWave);
+	StartedF.ExecuteIfBound(SoundWave);
+}
+
+void UOpenAICallSpeech::BroadcastFinished(float Duration, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(SoundWave, Duration, ErrorMessage, Success);
+	FinishedF.ExecuteIfBound(SoundWave, Duration, ErrorMessage, Success);
+}
+
+void UOpenAICallSpeech::Activate()
+{
+	FString _apiKey;
+	if (UOpenAIUtils::getUseApiKeyFromEnvironmentVars())
+		_apiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		_apiKey = UOpenAIUtils::getApiKey();
+
+	// checking parameters are valid
+	if (_apiKey.IsEmpty())
+	{
+		BroadcastFinished(0.0f, TEXT("Api key is not set"), false);
+		return;
+	}
+	if (speechSettings.input.IsEmpty())
+	{
+		BroadcastFinished(0.0f, TEXT("Input is empty"), false);
+		return;
+	}
+
+	AuthHeader = TEXT("Bearer ") + _apiKey;
+	bOpus = speechSettings.responseFormat == EOASpeechResponseFormat::OPUS;
+#if !WITH_OPENAI_OPUS
+	if (bOpus)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Opus is not available on this platform, requesting PCM speech"));
+		bOpus = false;
+	}
+#endif
+
+	// not outered to this node, which the C++ entry point destroys while the sound still plays
+	SoundWave = CreateSound(GetTransientPackage());
+
+	// lines spoken before, or pre-generated into a pack, play without a request
+	FOpenAISpeechCache& Cache = FOpenAISpeechCache::Get();
+	CacheKey = FOpenAISpeechCache::MakeKey(speechSettings);
+	FOpenAISpeechCache::FHit Hit;
+	if (Cache.Find(CacheKey, Hit) && PlayCached(Hit))
+	{
+		return;
+	}
+
+	// a loose file is read off the game thread; the request is only sent if it cannot be played
+	TWeakObjectPtr<UOpenAICallSpeech> WeakThis(this);
+	const bool bReading = Cache.FindLoose(CacheKey, [WeakThis](FOpenAISpeechCache::FHit* Loaded)
+	{
+		UOpenAICallSpeech* This = WeakThis.Get();
+		if (This && !This->bCancelled && (!Loaded || !This->PlayCached(*Loaded)))
+		{
+			This->SendRequest();
+		}
+	});
+	if (!bReading)
+	{
+		SendRequest();
+	}
+}
+
+void UOpenAICallSpeech::SendRequest()
+{
+	// first audio is announced from the HTTP thread; Started is broadcast on the game thread
+	TWeakObjectPtr<UOpenAICallSpeech> WeakThis(this);
+	Stream = MakeShared<FOpenAISpeechStream, ESPMode::ThreadSafe>(SoundWave, bOpus, FOpenAISpeechCache::Get().bStoreMisses, [WeakThis]()
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakThis]()
+		{
+			if (UOpenAICallSpeech* This = WeakThis.Get())
+			{
+				This->BroadcastStarted();
+			}
+		});
+	});
+
+	FOpenAIJsonWriter Writer;
+	WriteRequestBody(Writer, speechSettings, bOpus);
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(UOpenAIUtils::getBaseUrl() + TEXT("/audio/speech"));
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	HttpRequest->SetHeader(TEXT("Authorization"), AuthHeader);
+	HttpRequest->SetContent(Writer.GetBuffer());
+	// the body goes to the stream as it arrives instead of being collected for OnResponse
+	HttpRequest->SetResponseBodyReceiveStream(Stream.ToSharedRef());
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallSpeech::OnResponse);
+	Stream->SetRequest(HttpRequest);
+
+	CurrentRequest = HttpRequest;
+	SentCycles = FPlatformTime::Cycles64();
+	if (!HttpRequest->ProcessRequest())
+	{
+		CurrentRequest.Reset();
+		BroadcastFinished(0.0f, TEXT("Error sending request"), false);
+	}
+}
+
+void UOpenAICallSpeech::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	CurrentRequest.Reset();
+
+	const bool bSuccessStatus = WasSuccessful && Response.IsValid() && EHttpResponseCodes::IsOk(Response->GetResponseCode());
+	Stream->Finish(bSuccessStatus);
+
+	// the first-audio task may still be queued behind this one
+	if (Stream->HasAudio())
+	{
+		BroadcastStarted();
+	}
+
+	FString ErrorMessage;
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		ErrorMessage = TEXT("No response from server");
+	}
+	else if (!bSuccessStatus)
+	{
+		OpenAIParser parser;
+		if (!parser.DecodeError(Stream->GetHeldBody(), ErrorMessage))
+		{
+			ErrorMessage = FString::Printf(TEXT("Request failed with status %d"), Response->GetResponseCode());
+		}
+	}
+	else if (Stream->IsMalformed())
+	{
+		ErrorMessage = TEXT("Malformed Opus stream");
+	}
+	else if (!Stream->HasAudio())
+	{
+		ErrorMessage = TEXT("Response has no audio");
+	}
+
+	const float Duration = Stream->GetDuration();
+	Stream->Detach();
+	if (ErrorMessage.IsEmpty())
+	{
+		FOpenAISpeechCache::Get().Store(CacheKey, Stream->GetFormat(), Stream->TakeEncoded());
+	}
+	BroadcastFinished(Duration, ErrorMessage, ErrorMessage.IsEmpty());
+}
+
+bool UOpenAICallSpeech::PlayCached(const FOpenAISpeechCache::FHit& Hit)
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	int64 NumSamples = 0;
+	if (Hit.Format == EOASpeechResponseFormat::OPUS)
+	{
+		FOpenAIOggOpusDecoder Decoder;
+		TArray<float> Samples;
+		TArray<uint8> PCM;
+		if (!Decoder.Init(SpeechSampleRate) || !Decoder.Decode(Hit.Audio, Samples) || Samples.Num() == 0)
+		{
+			// e.g. a pack made with Opus on a platform without it; the line is requested instead
+			UE_LOG(LogTemp, Log, TEXT("Cached speech cannot be decoded, requesting it"));
+			return false;
+		}
+		OpenAIAudioCodec::FloatToPCM16(Samples.GetData(), Samples.Num(), PCM);
+		SoundWave->QueueAudio(PCM.GetData(), PCM.Num());
+		NumSamples = Samples.Num();
+	}
+	else
+	{
+		SoundWave->QueueAudio(Hit.Audio.GetData(), Hit.Audio.Num() & ~1);
+		NumSamples = Hit.Audio.Num() / sizeof(int16);
+	}
+
+	FirstAudioLatencyMs = (float)FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+	bStarted = true;
+
+	// announced on the next tick, so Speak() hands back a node that is still alive
+	TWeakObjectPtr<UOpenAICallSpeech> WeakThis(this);
+	const float Duration = (float)NumSamples / SpeechSampleRate;
+	AsyncTask(ENamedThreads::GameThread, [WeakThis, Duration]()
+	{
+		if (UOpenAICallSpeech* This = WeakThis.Get())
+		{
+			This->Started.Broadcast(This->SoundWave);
+			This->StartedF.ExecuteIfBound(This->SoundWave);
+			This->BroadcastFinished(Duration, FString(), true);
+		}
+	});
+	return true;
+}
+
+USoundWaveProcedural* UOpenAICallSpeech::CreateSound(UObject* Outer)
+{
+	USoundWaveProcedural* Sound = NewObject<USoundWaveProcedural>(Outer);
+	Sound->SetSampleRate(SpeechSampleRate);
+	Sound->NumChannels = 1;
+	Sound->Duration = INDEFINITELY_LOOPING_DURATION;
+	Sound->SoundGroup = SOUNDGROUP_Voice;
+	Sound->bLooping = false;
+	return Sound;
+}
+
+void UOpenAICallSpeech::WriteRequestBody(FOpenAIJsonWriter& Writer, const FSpeechSettings& Settings, bool bOpus)
+{
+	Writer.BeginObject();
+	Writer.Field("model", FOpenAIModels::GetModelName(Settings.model));
+	Writer.Field("input", Settings.input);
+	Writer.Field("voice", FOpenAIModels::GetVoiceName(Settings.voice));
+	Writer.Field("speed", FMath::Clamp(Settings.speed, 0.25f, 4.0f));
+	Writer.Field("response_format", bOpus ? TEXT("opus") : TEXT("pcm"));
+	Writer.EndObject();
+}
+
+void UOpenAICallSpeech::Cancel()
+{
+	bCancelled = true;
+	if (CurrentRequest.IsValid())
+	{
+		CurrentRequest->OnProcessRequestComplete().Unbind();
+		CurrentRequest->CancelRequest();
+		CurrentRequest.Reset();
+	}
+	if (Stream.IsValid())
+	{
+		Stream->Detach();
+	}
+	StartedF.Unbind();
+	if (FinishedF.IsBound())
+	{
+		// the C++ entry point keeps the node rooted until it finishes
+		FinishedF.Unbind();
+		RemoveFromRoot();
+		ConditionalBeginDestroy();
+	}
+}
+
+void UOpenAICallSpeech::BeginDestroy()
+{
+	if (CurrentRequest.IsValid())
+	{
+		CurrentRequest->OnProcessRequestComplete().Unbind();
+		CurrentRequest->CancelRequest();
+		CurrentRequest.Reset();
+	}
+	if (Stream.IsValid())
+	{
+		// the HTTP thread may still hold the stream; it must not touch the sound any more
+		Stream->Detach();
+	}
+	Super::BeginDestroy();
+}
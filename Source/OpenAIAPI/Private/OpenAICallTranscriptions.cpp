@@ -1,13 +1,9 @@
 // Copyright Kellan Mythen 2023. All rights Reserved.
 
 #include "OpenAICallTranscriptions.h"
-#include "OpenAIUtils.h"
 #include "Http.h"
-#include "Dom/JsonObject.h"
-#include "Serialization/JsonReader.h"
-#include "Serialization/JsonSerializer.h"
-#include "Misc/FileHelper.h"
-#include "Misc/Paths.h"
+#include "OpenAIParser.h"
+#include "OpenAIAudioUpload.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
 
@@ -26,99 +22,93 @@ UOpenAICallTranscriptions* UOpenAICallTranscriptions::OpenAICallTranscriptions(F
 	return BPNode;
 }
 
-void UOpenAICallTranscriptions::Activate()
+UOpenAICallTranscriptions* UOpenAICallTranscriptions::OpenAICallTranscriptionsFromAudio(const TArray<float>& Samples, int32 SampleRate, int32 NumChannels,
+	EOAUploadAudioFormat UploadFormat, int32 OpusBitrate)
 {
-	FString _apiKey;
-	if (UOpenAIUtils::getUseApiKeyFromEnvironmentVars())
-		_apiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
-	else
-		_apiKey = UOpenAIUtils::getApiKey();
-	
-	// checking parameters are valid
-	if (_apiKey.IsEmpty())
+	UOpenAICallTranscriptions* BPNode = NewObject<UOpenAICallTranscriptions>();
+	BPNode->samples = Samples;
+	BPNode->sampleRate = SampleRate;
+	BPNode->numChannels = NumChannels;
+	BPNode->uploadFormat = UploadFormat;
+	BPNode->opusBitrate = OpusBitrate;
+	return BPNode;
+}
+
+UOpenAICallTranscriptions* UOpenAICallTranscriptions::Transcribe(TArray<float>&& Samples, int32 SampleRate, int32 NumChannels,
+	TFunction<void(const FString& Transcription, const FString& ErrorMessage, bool Success)> Callback,
+	EOAUploadAudioFormat UploadFormat, int32 OpusBitrate)
+{
+	UOpenAICallTranscriptions* Node = NewObject<UOpenAICallTranscriptions>();
+	Node->samples = MoveTemp(Samples);
+	Node->sampleRate = SampleRate;
+	Node->numChannels = NumChannels;
+	Node->uploadFormat = UploadFormat;
+	Node->opusBitrate = OpusBitrate;
+	Node->AddToRoot();
+	Node->FinishedF.BindLambda([Callback, Node](const FString& Transcription, const FString& ErrorMessage, bool Success)
 	{
-		Finished.Broadcast({}, TEXT("Api key is not set"), false);
-	}
-	
-	// get the absolutePath to the wav file
-	FString relativePath = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() + "BouncedWavFiles/" + fileName);
-	FString absolutePath = FPaths::ConvertRelativePathToFull(relativePath);
-	
-	FString tempHeader = "Bearer ";
-	tempHeader += _apiKey;
-	
-	// Create the HTTP request
-	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+		if (!Success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Transcription failed. Error: %s"), *ErrorMessage);
+		}
 
-	// Set the request method, URL, and headers
+		if (Callback)
+		{
+			Callback(Transcription, ErrorMessage, Success);
+		}
 
-	HttpRequest->SetURL("https://api.openai.com/v1/audio/transcriptions");
-	HttpRequest->SetVerb("POST");
-	
-	// Set the content type, boundary, and form data
-	HttpRequest->SetHeader("Authorization", tempHeader);
-	HttpRequest->SetHeader("Content-Type", "multipart/form-data; boundary=boundary");
-	HttpRequest->SetHeader("model", "whisper-1");
-	
-	TArray<uint8> UpFileRawData;
-	FFileHelper::LoadFileToArray(UpFileRawData, *absolutePath);
-	
-	FString boundaryStart = "\r\n--boundary\r\n";
-	FString contentDispositionFile = FString::Printf(TEXT("Content-Disposition: form-data; name=\"file\"; filename=\"%s\"\r\n"), *fileName);
-	FString contentType = "Content-Type: audio/wav\r\n\r\n";
-	FString boundaryMiddle = "\r\n--boundary\r\n";
-	FString contentDisposition = "Content-Disposition: form-data; name=\"model\"\r\n\r\n";
-	FString transcriptionModel = "whisper-1";
-	FString boundaryEnd = "\r\n--boundary--\r\n";
+		Node->RemoveFromRoot();
+		Node->ConditionalBeginDestroy();
+	});
+	Node->Activate();
+	return Node;
+}
 
-	TArray<uint8> data;
-	data.Append((uint8*)TCHAR_TO_UTF8(*boundaryStart), boundaryStart.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*contentDispositionFile), contentDispositionFile.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*contentType), contentType.Len());
-	data.Append(UpFileRawData);
-	data.Append((uint8*)TCHAR_TO_UTF8(*boundaryMiddle), boundaryMiddle.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*contentDisposition), contentDisposition.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*transcriptionModel), transcriptionModel.Len());
-	data.Append((uint8*)TCHAR_TO_UTF8(*boundaryEnd), boundaryEnd.Len());
+void UOpenAICallTranscriptions::BroadcastFinished(const FString& Transcription, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(Transcription, ErrorMessage, Success);
+	FinishedF.ExecuteIfBound(Transcription, ErrorMessage, Success);
+}
 
-	HttpRequest->SetContent(data); 
+void UOpenAICallTranscriptions::Activate()
+{
+	OpenAIAudioUpload::FUpload Upload;
+	Upload.Endpoint = TEXT("/audio/transcriptions");
+	Upload.FileName = fileName;
+	Upload.Samples = MoveTemp(samples);
+	Upload.SampleRate = sampleRate;
+	Upload.NumChannels = numChannels;
+	Upload.UploadFormat = uploadFormat;
+	Upload.OpusBitrate = opusBitrate;
+	Upload.Fields.Emplace(TEXT("model"), TEXT("whisper-1"));
 
-	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAICallTranscriptions::OnResponse);
-	
-	HttpRequest->ProcessRequest();
+	FString ErrorMessage;
+	if (!OpenAIAudioUpload::Send(MoveTemp(Upload), FHttpRequestCompleteDelegate::CreateUObject(this, &UOpenAICallTranscriptions::OnResponse), ErrorMessage))
+	{
+		BroadcastFinished({}, ErrorMessage, false);
+	}
 }
 
 void UOpenAICallTranscriptions::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
 {
-	if (!WasSuccessful)
+	if (!WasSuccessful || !Response.IsValid())
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s \n%s"), *Response->GetContentAsString(), *Response->GetURL());
-		if (Finished.IsBound())
-		{
-			Finished.Broadcast({}, *Response->GetContentAsString(), false);
-		}
+		const FString ErrorMessage = Response.IsValid() ? Response->GetContentAsString() : TEXT("No response from server");
+		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s"), *ErrorMessage);
+		BroadcastFinished({}, ErrorMessage, false);
 		return;
 	}
 
-	TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject());
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-
-	if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+	FString TextValue;
+	FString ErrorMessage;
+	OpenAIParser parser;
+	if (parser.DecodeTranscription(Response->GetContent(), TextValue, ErrorMessage))
 	{
-		FString TextValue;
-		if (JsonObject->TryGetStringField("text", TextValue))
-		{
-			UE_LOG(LogTemp, Log, TEXT("Extracted text: %s"), *TextValue);
-		}
-		else
-		{
-			Finished.Broadcast("", "Failed to get 'text' field from JSON response", false);
-		}
-
-		Finished.Broadcast(TextValue, "", true);
+		UE_LOG(LogTemp, Log, TEXT("Extracted text: %s"), *TextValue);
+		BroadcastFinished(TextValue, "", true);
 	}
 	else
 	{
-		Finished.Broadcast("", "Failed to parse JSON response", false);
+		BroadcastFinished("", ErrorMessage, false);
 	}
 }
@@ -0,0 +1,145 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAICallTranslations.h"
+#include "Http.h"
+#include "OpenAIParser.h"
+#include "OpenAIAudioUpload.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+
+UOpenAICallTranslations::UOpenAICallTranslations()
+{
+}
+
+UOpenAICallTranslations::~UOpenAICallTranslations()
+{
+}
+
+UOpenAICallTranslations* UOpenAICallTranslations::OpenAICallTranslations(FString fileName, FTranslationSettings translationSettingsInput)
+{
+	UOpenAICallTranslations* BPNode = NewObject<UOpenAICallTranslations>();
+	BPNode->fileName = fileName + ".wav";
+	BPNode->translationSettings = translationSettingsInput;
+	return BPNode;
+}
+
+UOpenAICallTranslations* UOpenAICallTranslations::OpenAICallTranslationsFromAudio(const TArray<float>& Samples, FTranslationSettings translationSettingsInput,
+	int32 SampleRate, int32 NumChannels, EOAUploadAudioFormat UploadFormat, int32 OpusBitrate)
+{
+	UOpenAICallTranslations* BPNode = NewObject<UOpenAICallTranslations>();
+	BPNode->samples = Samples;
+	BPNode->translationSettings = translationSettingsInput;
+	BPNode->sampleRate = SampleRate;
+	BPNode->numChannels = NumChannels;
+	BPNode->uploadFormat = UploadFormat;
+	BPNode->opusBitrate = OpusBitrate;
+	return BPNode;
+}
+
+UOpenAICallTranslations* UOpenAICallTranslations::Translate(TArray<float>&& Samples, int32 SampleRate, int32 NumChannels, const FTranslationSettings& TranslationSettings,
+	TFunction<void(const FString& Translation, const FString& ErrorMessage, bool Success)> Callback,
+	EOAUploadAudioFormat UploadFormat, int32 OpusBitrate)
+{
+	UOpenAICallTranslations* Node = NewObject<UOpenAICallTranslations>();
+	Node->samples = MoveTemp(Samples);
+	Node->translationSettings = TranslationSettings;
+	Node->sampleRate = SampleRate;
+	Node->numChannels = NumChannels;
+	Node->uploadFormat = UploadFormat;
+	Node->opusBitrate = OpusBitrate;
+	Node->AddToRoot();
+	Node->FinishedF.BindLambda([Callback, Node](const FString& Translation, const FString& ErrorMessage, bool Success)
+	{
+		if (!Success)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Translation failed. Error: %s"), *ErrorMessage);
+		}
+
+		if (Callback)
+		{
+			Callback(Translation, ErrorMessage, Success);
+		}
+
+		Node->RemoveFromRoot();
+		Node->ConditionalBeginDestroy();
+	});
+	Node->Activate();
+	return Node;
+}
+
+void UOpenAICallTranslations::BroadcastFinished(const FString& Translation, const FString& ErrorMessage, bool Success)
+{
+	Finished.Broadcast(Translation, ErrorMessage, Success);
+	FinishedF.ExecuteIfBound(Translation, ErrorMessage, Success);
+}
+
+void UOpenAICallTranslations::Activate()
+{
+	OpenAIAudioUpload::FUpload Upload;
+	Upload.Endpoint = TEXT("/audio/translations");
+	Upload.FileName = fileName;
+	Upload.Samples = MoveTemp(samples);
+	Upload.SampleRate = sampleRate;
+	Upload.NumChannels = numChannels;
+	Upload.UploadFormat = uploadFormat;
+	Upload.OpusBitrate = opusBitrate;
+	Upload.Fields.Emplace(TEXT("model"), translationSettings.model.IsEmpty() ? TEXT("whisper-1") : translationSettings.model);
+	if (!translationSettings.prompt.IsEmpty())
+	{
+		Upload.Fields.Emplace(TEXT("prompt"), translationSettings.prompt);
+	}
+	if (!translationSettings.response_format.IsEmpty())
+	{
+		Upload.Fields.Emplace(TEXT("response_format"), translationSettings.response_format);
+	}
+	if (translationSettings.temperature > 0.0f)
+	{
+		Upload.Fields.Emplace(TEXT("temperature"), FString::SanitizeFloat(FMath::Clamp(translationSettings.temperature, 0.0f, 1.0f)));
+	}
+
+	FString ErrorMessage;
+	if (!OpenAIAudioUpload::Send(MoveTemp(Upload), FHttpRequestCompleteDelegate::CreateUObject(this, &UOpenAICallTranslations::OnResponse), ErrorMessage))
+	{
+		BroadcastFinished({}, ErrorMessage, false);
+	}
+}
+
+void UOpenAICallTranslations::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+{
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		const FString ErrorMessage = Response.IsValid() ? Response->GetContentAsString() : TEXT("No response from server");
+		UE_LOG(LogTemp, Warning, TEXT("Error processing request. \n%s"), *ErrorMessage);
+		BroadcastFinished({}, ErrorMessage, false);
+		return;
+	}
+
+	FString TextValue;
+	FString ErrorMessage;
+	OpenAIParser parser;
+
+	// text, srt and vtt come back as they are; json and verbose_json carry the text in a field
+	const FString& Format = translationSettings.response_format;
+	const bool bJson = Format.IsEmpty() || Format == TEXT("json") || Format == TEXT("verbose_json");
+	if (!bJson && EHttpResponseCodes::IsOk(Response->GetResponseCode()))
+	{
+		BroadcastFinished(Response->GetContentAsString(), "", true);
+	}
+	else if (!bJson)
+	{
+		if (!parser.DecodeError(Response->GetContent(), ErrorMessage))
+		{
+			ErrorMessage = FString::Printf(TEXT("Request failed with status %d"), Response->GetResponseCode());
+		}
+		BroadcastFinished("", ErrorMessage, false);
+	}
+	else if (parser.DecodeTranscription(Response->GetContent(), TextValue, ErrorMessage))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Extracted text: %s"), *TextValue);
+		BroadcastFinished(TextValue, "", true);
+	}
+	else
+	{
+		BroadcastFinished("", ErrorMessage, false);
+	}
+}
@@ -0,0 +1,258 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIChatContext.h"
+#include "OpenAICallChat.h"
+#include "OpenAITokenizer.h"
+
+namespace
+{
+	const TCHAR* SummaryInstructions = TEXT("Summarize the conversation below for the assistant that continues it. ")
+		TEXT("Keep names, facts, promises and open questions, drop small talk. Reply with the summary only.");
+
+	const TCHAR* SummaryPrefix = TEXT("Summary of the earlier conversation: ");
+
+	const TCHAR* RoleLabel(EOAChatRole Role)
+	{
+		switch (Role)
+		{
+		case EOAChatRole::USER:
+			return TEXT("User");
+		case EOAChatRole::ASSISTANT:
+			return TEXT("Assistant");
+		case EOAChatRole::TOOL:
+			return TEXT("Tool");
+		default:
+			return TEXT("System");
+		}
+	}
+}
+
+UOpenAIChatContext::UOpenAIChatContext()
+	: Model(EOAChatEngineType::GPT_4o)
+	, TokenBudget(4000)
+	, bSummarizeEvicted(false)
+	, SummaryModel(EOAChatEngineType::GPT_4o_mini)
+	, SummaryMaxTokens(256)
+	, PinnedTokens(0)
+	, WindowTokens(0)
+	, SummaryTokens(0)
+	, bSummaryInFlight(false)
+	, Generation(0)
+{
+}
+
+UOpenAIChatContext* UOpenAIChatContext::CreateChatContext(EOAChatEngineType InModel, int32 InTokenBudget, bool bInSummarizeEvicted)
+{
+	UOpenAIChatContext* Context = NewObject<UOpenAIChatContext>();
+	Context->Model = InModel;
+	Context->TokenBudget = InTokenBudget;
+	Context->bSummarizeEvicted = bInSummarizeEvicted;
+	return Context;
+}
+
+int32 UOpenAIChatContext::CountMessage(const FChatLog& Message) const
+{
+	// Counted once when the message is added instead of on every request
+	const FOpenAITokenizer& Tokenizer = FOpenAITokenizer::Get(FOpenAITokenizer::GetEncodingForModel(Model));
+	return Tokenizer.CountChatTokens(MakeArrayView(&Message, 1)) - FOpenAITokenizer::TokensPerReply;
+}
+
+void UOpenAIChatContext::Append(const FChatLog& Message)
+{
+	const int32 Tokens = CountMessage(Message);
+	if (Message.role == EOAChatRole::SYSTEM)
+	{
+		Pinned.Add({ Message, Tokens });
+		PinnedTokens += Tokens;
+	}
+	else
+	{
+		Window.Add({ Message, Tokens });
+		WindowTokens += Tokens;
+	}
+}
+
+void UOpenAIChatContext::AddMessage(const FChatLog& Message)
+{
+	Append(Message);
+	Trim();
+}
+
+void UOpenAIChatContext::AddMessages(const TArray<FChatLog>& Messages)
+{
+	for (const FChatLog& Message : Messages)
+	{
+		Append(Message);
+	}
+	Trim();
+}
+
+TArray<FChatLog> UOpenAIChatContext::GetMessages() const
+{
+	TArray<FChatLog> Messages;
+	Messages.Reserve(Pinned.Num() + Window.Num() + 1);
+	for (const FCountedMessage& Entry : Pinned)
+	{
+		Messages.Add(Entry.Message);
+	}
+	if (!Summary.IsEmpty())
+	{
+		FChatLog& SummaryMessage = Messages.AddDefaulted_GetRef();
+		SummaryMessage.role = EOAChatRole::SYSTEM;
+		SummaryMessage.content = SummaryPrefix + Summary;
+	}
+	for (const FCountedMessage& Entry : Window)
+	{
+		Messages.Add(Entry.Message);
+	}
+	return Messages;
+}
+
+void UOpenAIChatContext::ApplyTo(FChatSettings& ChatSettings) const
+{
+	ChatSettings.model = Model;
+	ChatSettings.messages = GetMessages();
+}
+
+int32 UOpenAIChatContext::GetTokenCount() const
+{
+	return FOpenAITokenizer::TokensPerReply + PinnedTokens + SummaryTokens + WindowTokens;
+}
+
+void UOpenAIChatContext::Clear()
+{
+	Pinned.Reset();
+	Window.Reset();
+	PinnedTokens = 0;
+	WindowTokens = 0;
+	Summary.Reset();
+	SummaryTokens = 0;
+	PendingSummary.Reset();
+	SummaryInFlight.Reset();
+	bSummaryInFlight = false;
+	Generation++;
+}
+
+void UOpenAIChatContext::Trim()
+{
+	int32 NumEvicted = 0;
+	int32 Total = GetTokenCount();
+	// Tool results go with the assistant message that made the calls, the request is rejected without it,
+	// so a message is evicted together with the tool results that follow it. The newest such group stays.
+	while (NumEvicted < Window.Num())
+	{
+		int32 GroupEnd = NumEvicted + 1;
+		while (GroupEnd < Window.Num() && Window[GroupEnd].Message.role == EOAChatRole::TOOL)
+		{
+			GroupEnd++;
+		}
+
+		const bool bOrphaned = Window[NumEvicted].Message.role == EOAChatRole::TOOL;
+		if (!bOrphaned && (Total <= TokenBudget || GroupEnd == Window.Num()))
+		{
+			break;
+		}
+
+		for (; NumEvicted < GroupEnd; NumEvicted++)
+		{
+			Total -= Window[NumEvicted].Tokens;
+			WindowTokens -= Window[NumEvicted].Tokens;
+			if (bSummarizeEvicted)
+			{
+				PendingSummary.Add(MoveTemp(Window[NumEvicted].Message));
+			}
+		}
+	}
+
+	if (NumEvicted > 0)
+	{
+		Window.RemoveAt(0, NumEvicted, EAllowShrinking::No);
+		UE_LOG(LogTemp, Verbose, TEXT("Chat context evicted %d messages, now %d of %d tokens"), NumEvicted, Total, TokenBudget);
+	}
+
+	if (Total > TokenBudget)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Chat context is %d tokens after eviction, over its %d token budget"), Total, TokenBudget);
+	}
+
+	StartSummary();
+}
+
+void UOpenAIChatContext::StartSummary()
+{
+	if (!bSummarizeEvicted || bSummaryInFlight || PendingSummary.Num() == 0)
+	{
+		return;
+	}
+
+	// The previous summary goes in with the new turns so the result covers the whole evicted history
+	FString Transcript;
+	if (!Summary.IsEmpty())
+	{
+		Transcript += SummaryPrefix;
+		Transcript += Summary;
+		Transcript += TEXT("\n\n");
+	}
+	for (const FChatLog& Message : PendingSummary)
+	{
+		Transcript += RoleLabel(Message.role);
+		Transcript += TEXT(": ");
+		Transcript += Message.content;
+		for (const FChatToolCall& Call : Message.toolCalls)
+		{
+			Transcript += FString::Printf(TEXT(" [called %s(%s)]"), *Call.name, *Call.arguments);
+		}
+		Transcript += TEXT("\n");
+	}
+
+	FChatSettings Settings;
+	Settings.model = SummaryModel;
+	Settings.maxTokens = SummaryMaxTokens;
+	FChatLog& Instructions = Settings.messages.AddDefaulted_GetRef();
+	Instructions.role = EOAChatRole::SYSTEM;
+	Instructions.content = SummaryInstructions;
+	FChatLog& Conversation = Settings.messages.AddDefaulted_GetRef();
+	Conversation.role = EOAChatRole::USER;
+	Conversation.content = MoveTemp(Transcript);
+
+	SummaryInFlight = MoveTemp(PendingSummary);
+	PendingSummary.Reset();
+	bSummaryInFlight = true;
+
+	TWeakObjectPtr<UOpenAIChatContext> WeakThis(this);
+	const uint32 RequestGeneration = Generation;
+	UOpenAICallChat::Chat(Settings, [WeakThis, RequestGeneration](const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)
+	{
+		UOpenAIChatContext* Context = WeakThis.Get();
+		if (Context && Context->Generation == RequestGeneration)
+		{
+			Context->OnSummary(Message, ErrorMessage, Success);
+		}
+	});
+}
+
+void UOpenAIChatContext::OnSummary(const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+{
+	bSummaryInFlight = false;
+
+	const FString& Content = Message.message.content;
+	if (!Success || Content.IsEmpty())
+	{
+		// Keep the turns for the next attempt, ahead of anything evicted since
+		UE_LOG(LogTemp, Warning, TEXT("Chat context summary failed, retrying on the next eviction: %s"), *ErrorMessage);
+		SummaryInFlight.Append(MoveTemp(PendingSummary));
+		PendingSummary = MoveTemp(SummaryInFlight);
+		SummaryInFlight.Reset();
+		return;
+	}
+
+	Summary = Content.TrimStartAndEnd();
+	FChatLog SummaryMessage;
+	SummaryMessage.role = EOAChatRole::SYSTEM;
+	SummaryMessage.content = SummaryPrefix + Summary;
+	SummaryTokens = CountMessage(SummaryMessage);
+	SummaryInFlight.Reset();
+
+	// The summary takes part of the budget, which can push more turns out and into the next summary
+	Trim();
+}
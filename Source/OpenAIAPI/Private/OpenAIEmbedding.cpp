@@ -3,10 +3,12 @@
 #include "OpenAIEmbedding.h"
 #include "HttpModule.h"
 #include "OpenAIUtils.h"
+#include "OpenAIJsonWriter.h"
+#include "OpenAIParser.h"
+#include "OpenAIModels.h"
+#include "OpenAITokenizer.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
-#include "Serialization/JsonSerializer.h"
-#include "Dom/JsonObject.h"
 
 DEFINE_LOG_CATEGORY(LogEmbedding);
 
@@ -43,28 +45,26 @@ void UOpenAIEmbedding::StartEmbedding()
     else
         _apiKey = UOpenAIUtils::getApiKey();
 
+    const FString Input = EmbeddingSettings.input.Replace(TEXT("\n"), TEXT(" "));
+    const FOpenAIModelInfo& Model = FOpenAIModels::Get(EmbeddingSettings);
+    const FOpenAITokenizer& Tokenizer = FOpenAITokenizer::Get(Model.Encoding);
+    const int32 InputTokens = Tokenizer.CountTokens(Input);
+
     if (_apiKey.IsEmpty())
 	{
 		OnResponseReceived.ExecuteIfBound({}, TEXT("Api key is not set"), false);
 		OnResponseReceivedF.ExecuteIfBound({}, TEXT("Api key is not set"), false);
 	}
+	else if (Tokenizer.IsExact() && InputTokens > Model.ContextWindow)
+	{
+		const FString ErrorMessage = FString::Printf(TEXT("Input is %d tokens, %s takes at most %d"), InputTokens, *FOpenAIModels::GetModelName(EmbeddingSettings), Model.ContextWindow);
+		OnResponseReceived.ExecuteIfBound({}, ErrorMessage, false);
+		OnResponseReceivedF.ExecuteIfBound({}, ErrorMessage, false);
+	}
 	else
 	{
 		auto HttpRequest = FHttpModule::Get().CreateRequest();
 
-		FString apiMethod;
-		switch (EmbeddingSettings.model)
-		{
-		case EEmbeddingEngineType::TEXT_EMBEDDING_3_SMALL:
-			apiMethod = "text-embedding-3-small";
-			break;
-		case EEmbeddingEngineType::TEXT_EMBEDDING_3_LARGE:
-			apiMethod = "text-embedding-3-large";
-			break;
-		case EEmbeddingEngineType::TEXT_EMBEDDING_ADA_002:
-			apiMethod = "text-embedding-ada";
-			break;
-		}
 		// TODO: Add additional params to match the ones listed in the curl response in: https://platform.openai.com/docs/api-reference/making-requests
 		
 		// convert parameters to strings
@@ -72,25 +72,18 @@ void UOpenAIEmbedding::StartEmbedding()
 		tempHeader += _apiKey;
 
 		// set headers
-		FString url = FString::Printf(TEXT("https://api.openai.com/v1/embeddings"));
+		FString url = UOpenAIUtils::getBaseUrl() + TEXT("/embeddings");
 		HttpRequest->SetURL(url);
 		HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
 		HttpRequest->SetHeader(TEXT("Authorization"), tempHeader);
 
-		// build payload
-		TSharedPtr<FJsonObject> _payloadObject = MakeShareable(new FJsonObject());
-		_payloadObject->SetStringField(TEXT("model"), apiMethod);
-		_payloadObject->SetStringField(TEXT("input"),
-			EmbeddingSettings.input.Replace(TEXT("\n"), TEXT(" ")));
-
-		// convert payload to string
-		FString _payload;
-		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&_payload);
-		FJsonSerializer::Serialize(_payloadObject.ToSharedRef(), Writer);
+		// build payload, written straight to UTF-8
+		FOpenAIJsonWriter Writer;
+		WriteRequestBody(Writer, EmbeddingSettings);
 
 		// commit request
 		HttpRequest->SetVerb(TEXT("POST"));
-		HttpRequest->SetContentAsString(_payload);
+		HttpRequest->SetContent(Writer.GetBuffer());
 
 		UE_LOG(LogEmbedding, Log, TEXT("UOpenAIEmbedding ProcessHttpRequest"));
 
@@ -115,6 +108,14 @@ void UOpenAIEmbedding::StartEmbedding()
 	}
 }
 
+void UOpenAIEmbedding::WriteRequestBody(FOpenAIJsonWriter& Writer, const FEmbeddingSettings& Settings)
+{
+	Writer.BeginObject();
+	Writer.Field("model", FOpenAIModels::GetModelName(Settings));
+	Writer.Field("input", Settings.input.Replace(TEXT("\n"), TEXT(" ")));
+	Writer.EndObject();
+}
+
 void UOpenAIEmbedding::CancelRequest()
 {
 	if (CurrentRequest.IsValid() && CurrentRequest->GetStatus() == EHttpRequestStatus::Processing)
@@ -134,37 +135,18 @@ void UOpenAIEmbedding::OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Resp
 {
 	if (bWasSuccessful && Response.IsValid())
 	{
-		TSharedPtr<FJsonObject> JsonResponse;
-		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-
-		if (FJsonSerializer::Deserialize(Reader, JsonResponse) && JsonResponse.IsValid())
+		FEmbeddingResult Result;
+		FString ErrorMessage;
+		OpenAIParser parser;
+		if (parser.DecodeEmbedding(Response->GetContent(), Result, ErrorMessage))
 		{
-			TArray<float> EmbeddingVector;
-			const TArray<TSharedPtr<FJsonValue>>* DataArray;
-			if (JsonResponse->TryGetArrayField(TEXT("data"), DataArray))
-			{
-				const TSharedPtr<FJsonObject>* FirstObject;
-				if ((*DataArray)[0]->TryGetObject(FirstObject))
-				{
-					const TArray<TSharedPtr<FJsonValue>>* EmbeddingsArray;
-					if ((*FirstObject)->TryGetArrayField(TEXT("embedding"), EmbeddingsArray))
-					{
-						for (const TSharedPtr<FJsonValue>& EmbeddingValue : *EmbeddingsArray)
-						{
-							EmbeddingVector.Add(static_cast<float>(EmbeddingValue->AsNumber()));
-						}
-					}
-				}
-			}
-
-			FEmbeddingResult Result{EmbeddingVector};
 			OnResponseReceived.ExecuteIfBound(Result, TEXT(""), true);
 			OnResponseReceivedF.ExecuteIfBound(Result, TEXT(""), true);
 		}
 		else
 		{
-			OnResponseReceived.ExecuteIfBound({}, TEXT("Failed to parse response"), false);
-			OnResponseReceivedF.ExecuteIfBound({}, TEXT("Failed to parse response"), false);
+			OnResponseReceived.ExecuteIfBound({}, ErrorMessage, false);
+			OnResponseReceivedF.ExecuteIfBound({}, ErrorMessage, false);
 		}
 	}
 	else
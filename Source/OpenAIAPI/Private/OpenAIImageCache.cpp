@@ -0,0 +1,399 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIImageCache.h"
+#include "OpenAIImageCodec.h"
+#include "OpenAIModels.h"
+#include "IImageWrapperModule.h"
+#include "ImageCore.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+
+namespace
+{
+	// File layout: header, mip table largest first, then each mip as a PNG. Little endian.
+	constexpr uint32 FileMagic = 0x4D49414F; // "OAIM"
+	constexpr uint32 FileVersion = 1;
+	constexpr uint32 MaxMips = 16;
+
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 NumMips;
+		uint32 Reserved;
+		uint64 DHash;
+	};
+	static_assert(sizeof(FFileHeader) == 24, "Image file header layout is part of the file format");
+
+	struct FMipEntry
+	{
+		uint32 SizeX;
+		uint32 SizeY;
+		uint64 Offset;
+		uint64 Size;
+	};
+	static_assert(sizeof(FMipEntry) == 24, "Image file mip layout is part of the file format");
+
+	FString KeyToString(const FXxHash128& Key)
+	{
+		return FString::Printf(TEXT("%016llx%016llx"), Key.HashHigh, Key.HashLow);
+	}
+
+	// Files are named <key>_<dhash>.oaimg, so near duplicates are found without opening anything
+	uint64 ParseDHash(const FString& FileName)
+	{
+		const FString Base = FPaths::GetBaseFilename(FileName);
+		int32 Separator;
+		return Base.FindLastChar(TEXT('_'), Separator) ? FCString::Strtoui64(*Base + Separator + 1, nullptr, 16) : 0;
+	}
+
+	int32 DHashDistance(uint64 A, uint64 B)
+	{
+		return (int32)FMath::CountBits(A ^ B);
+	}
+
+	bool ReadMip(const FString& Path, int32 MaxSize, TArray<uint8>& OutEncoded, uint64& OutDHash, FString& OutError)
+	{
+		TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path, FILEREAD_Silent));
+		if (!Reader)
+		{
+			OutError = FString::Printf(TEXT("Cannot open %s"), *Path);
+			return false;
+		}
+
+		FFileHeader Header;
+		Reader->Serialize(&Header, sizeof(Header));
+		if (Reader->IsError() || Header.Magic != FileMagic || Header.Version != FileVersion || Header.NumMips == 0 || Header.NumMips > MaxMips)
+		{
+			OutError = FString::Printf(TEXT("%s is not a cached image of version %u"), *Path, FileVersion);
+			return false;
+		}
+
+		TArray<FMipEntry> Mips;
+		Mips.SetNumUninitialized(Header.NumMips);
+		Reader->Serialize(Mips.GetData(), Mips.Num() * sizeof(FMipEntry));
+
+		// The largest mip that fits, or the smallest there is
+		int32 MipIndex = 0;
+		if (MaxSize > 0)
+		{
+			MipIndex = Mips.Num() - 1;
+			for (int32 Index = 0; Index < Mips.Num(); Index++)
+			{
+				if ((int32)FMath::Max(Mips[Index].SizeX, Mips[Index].SizeY) <= MaxSize)
+				{
+					MipIndex = Index;
+					break;
+				}
+			}
+		}
+
+		const FMipEntry& Mip = Mips[MipIndex];
+		if (Reader->IsError() || Mip.Offset + Mip.Size > (uint64)Reader->TotalSize() || Mip.Size > MAX_int32)
+		{
+			OutError = FString::Printf(TEXT("Cached image %s is truncated"), *Path);
+			return false;
+		}
+
+		OutEncoded.SetNumUninitialized((int32)Mip.Size);
+		Reader->Seek((int64)Mip.Offset);
+		Reader->Serialize(OutEncoded.GetData(), OutEncoded.Num());
+		OutDHash = Header.DHash;
+		return !Reader->IsError();
+	}
+}
+
+FOpenAIImageCache::FOpenAIImageCache()
+	: Dir(FPaths::ProjectSavedDir() / TEXT("OpenAIImageCache"))
+{
+}
+
+FOpenAIImageCache& FOpenAIImageCache::Get()
+{
+	// Never destroyed: the textures it holds cannot be released after the object system is gone
+	static FOpenAIImageCache* Cache = new FOpenAIImageCache();
+	return *Cache;
+}
+
+FXxHash128 FOpenAIImageCache::MakeKey(const FString& Prompt, EOAImageSize ImageSize)
+{
+	// "A red fox." and "a  red fox" are the same request
+	FString Normalized;
+	Normalized.Reserve(Prompt.Len());
+	for (const TCHAR Character : Prompt.TrimStartAndEnd())
+	{
+		if (FChar::IsWhitespace(Character))
+		{
+			if (!Normalized.IsEmpty() && Normalized[Normalized.Len() - 1] != TEXT(' '))
+			{
+				Normalized.AppendChar(TEXT(' '));
+			}
+		}
+		else
+		{
+			Normalized.AppendChar(FChar::ToLower(Character));
+		}
+	}
+	while (!Normalized.IsEmpty() && FCString::Strchr(TEXT(".!?, "), Normalized[Normalized.Len() - 1]))
+	{
+		Normalized.LeftChopInline(1);
+	}
+
+	const FString Canonical = FString::Printf(TEXT("%s\n%s"), FOpenAIModels::GetImageSize(ImageSize), *Normalized);
+	const FTCHARToUTF8 Utf8(*Canonical);
+	return FXxHash128::HashBuffer(Utf8.Get(), Utf8.Length());
+}
+
+uint64 FOpenAIImageCache::ComputeDHash(const FImage& Image)
+{
+	FImage Small;
+	Image.ResizeTo(Small, 9, 8, ERawImageFormat::G8, EGammaSpace::sRGB);
+
+	const uint8* Pixels = Small.RawData.GetData();
+	uint64 Hash = 0;
+	for (int32 Y = 0; Y < 8; Y++)
+	{
+		for (int32 X = 0; X < 8; X++)
+		{
+			Hash = (Hash << 1) | (Pixels[Y * 9 + X] < Pixels[Y * 9 + X + 1] ? 1 : 0);
+		}
+	}
+	return Hash;
+}
+
+TArray<FString> FOpenAIImageCache::FindImages(const FXxHash128& Key) const
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *(Dir / KeyToString(Key) + TEXT("_*.oaimg")), true, false);
+	Files.Sort();
+	for (FString& File : Files)
+	{
+		File = Dir / File;
+	}
+	return Files;
+}
+
+void FOpenAIImageCache::LoadAsync(const FString& Path, int32 MaxSize, TFunction<void(UTexture2D* Texture, const FString& ErrorMessage)> OnLoaded)
+{
+	check(IsInGameThread());
+
+	const FString ResidentKey = FString::Printf(TEXT("%s@%d"), *Path, FMath::Max(MaxSize, 0));
+	if (FResident* Found = Resident.Find(ResidentKey))
+	{
+		Found->LastUse = ++UseCounter;
+
+		// Completed on the next tick, like a load, so a caller's Activate never finishes before it returns
+		TWeakObjectPtr<UTexture2D> WeakTexture(Found->Texture.Get());
+		AsyncTask(ENamedThreads::GameThread, [WeakTexture, OnLoaded = MoveTemp(OnLoaded)]()
+		{
+			UTexture2D* Texture = WeakTexture.Get();
+			OnLoaded(Texture, Texture ? FString() : TEXT("Cached texture was released"));
+		});
+		return;
+	}
+
+	IImageWrapperModule& ImageWrapper = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [&ImageWrapper, Path, MaxSize, ResidentKey, OnLoaded = MoveTemp(OnLoaded)]() mutable
+	{
+		TArray<uint8> Encoded;
+		uint64 DHash = 0;
+		FString Error;
+		TUniquePtr<FTexturePlatformData> PlatformData;
+		if (ReadMip(Path, MaxSize, Encoded, DHash, Error))
+		{
+			PlatformData = OpenAIImageCodec::DecodeToPlatformData(ImageWrapper, Encoded, Error);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [ResidentKey, DHash, PlatformData = MoveTemp(PlatformData), Error = MoveTemp(Error), OnLoaded = MoveTemp(OnLoaded)]() mutable
+		{
+			if (!PlatformData.IsValid())
+			{
+				OnLoaded(nullptr, Error);
+				return;
+			}
+
+			FOpenAIImageCache& Cache = FOpenAIImageCache::Get();
+			UTexture2D* Texture = Cache.FindSimilar(DHash, PlatformData->SizeX, PlatformData->SizeY);
+			if (!Texture)
+			{
+				Texture = OpenAIImageCodec::CreateTexture(MoveTemp(PlatformData));
+			}
+			Cache.AddResident(ResidentKey, Texture, DHash);
+			OnLoaded(Texture, FString());
+		});
+	});
+}
+
+void FOpenAIImageCache::Store(const FXxHash128& Key, const FImage& Image)
+{
+	if (!bStoreResults)
+	{
+		return;
+	}
+
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Prefix = Dir / KeyToString(Key), MaxDistance = MaxDHashDistance, Image = FImage(Image)]()
+	{
+		const uint64 DHash = ComputeDHash(Image);
+
+		TArray<FString> Existing;
+		IFileManager::Get().FindFiles(Existing, *(Prefix + TEXT("_*.oaimg")), true, false);
+		for (const FString& File : Existing)
+		{
+			if (DHashDistance(ParseDHash(File), DHash) <= MaxDistance)
+			{
+				return;
+			}
+		}
+
+		// Written to a temporary name first, so a reader never sees half a file
+		const FString Path = FString::Printf(TEXT("%s_%016llx.oaimg"), *Prefix, DHash);
+		const FString TempPath = Path + TEXT(".tmp");
+		if (!WriteImage(TempPath, Image, DHash) || !IFileManager::Get().Move(*Path, *TempPath, true, true))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Cannot write image cache file %s"), *Path);
+		}
+	});
+}
+
+bool FOpenAIImageCache::WriteImage(const FString& Path, const FImage& Image, uint64 DHash)
+{
+	IImageWrapperModule* ImageWrapper = FModuleManager::GetModulePtr<IImageWrapperModule>(TEXT("ImageWrapper"));
+	if (!ImageWrapper)
+	{
+		return false;
+	}
+
+	// Each mip halves the last, from full resolution down to MinMipSize
+	TArray<TArray64<uint8>> Encoded;
+	TArray<FMipEntry> Mips;
+	FImage Mip = Image;
+	while (true)
+	{
+		TArray64<uint8>& Png = Encoded.AddDefaulted_GetRef();
+		if (!ImageWrapper->CompressImage(Png, EImageFormat::PNG, Mip))
+		{
+			return false;
+		}
+		Mips.Add({ (uint32)Mip.SizeX, (uint32)Mip.SizeY, 0, (uint64)Png.Num() });
+
+		if (FMath::Max(Mip.SizeX, Mip.SizeY) / 2 < MinMipSize || Mips.Num() == MaxMips)
+		{
+			break;
+		}
+		FImage Half;
+		Mip.ResizeTo(Half, FMath::Max(Mip.SizeX / 2, 1), FMath::Max(Mip.SizeY / 2, 1), ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+		Mip = MoveTemp(Half);
+	}
+
+	uint64 Offset = sizeof(FFileHeader) + Mips.Num() * sizeof(FMipEntry);
+	for (FMipEntry& Entry : Mips)
+	{
+		Entry.Offset = Offset;
+		Offset += Entry.Size;
+	}
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+	if (!Writer)
+	{
+		return false;
+	}
+
+	FFileHeader Header = { FileMagic, FileVersion, (uint32)Mips.Num(), 0, DHash };
+	Writer->Serialize(&Header, sizeof(Header));
+	Writer->Serialize(Mips.GetData(), Mips.Num() * sizeof(FMipEntry));
+	for (TArray64<uint8>& Png : Encoded)
+	{
+		Writer->Serialize(Png.GetData(), Png.Num());
+	}
+	return Writer->Close();
+}
+
+UTexture2D* FOpenAIImageCache::FindSimilar(uint64 DHash, int32 SizeX, int32 SizeY)
+{
+	for (TPair<FString, FResident>& Pair : Resident)
+	{
+		const FResident& Entry = Pair.Value;
+		if (Entry.SizeX == SizeX && Entry.SizeY == SizeY && DHashDistance(Entry.DHash, DHash) <= MaxDHashDistance)
+		{
+			return Entry.Texture.Get();
+		}
+	}
+	return nullptr;
+}
+
+void FOpenAIImageCache::AddResident(const FString& ResidentKey, UTexture2D* Texture, uint64 DHash)
+{
+	// Two loads of the same path can both finish; the second only refreshes the entry
+	if (FResident* Existing = Resident.Find(ResidentKey))
+	{
+		if (Existing->Texture.Get() == Texture)
+		{
+			Existing->LastUse = ++UseCounter;
+			return;
+		}
+	}
+
+	// A shared texture is only counted once
+	int64 Bytes = (int64)Texture->GetSizeX() * Texture->GetSizeY() * 4;
+	for (const TPair<FString, FResident>& Pair : Resident)
+	{
+		if (Pair.Key != ResidentKey && Pair.Value.Texture.Get() == Texture)
+		{
+			Bytes = 0;
+			break;
+		}
+	}
+
+	FResident& Entry = Resident.FindOrAdd(ResidentKey);
+	ResidentBytes -= Entry.Bytes;
+	Entry.Texture.Reset(Texture);
+	Entry.Bytes = Bytes;
+	Entry.DHash = DHash;
+	Entry.SizeX = Texture->GetSizeX();
+	Entry.SizeY = Texture->GetSizeY();
+	Entry.LastUse = ++UseCounter;
+	ResidentBytes += Bytes;
+	Trim();
+}
+
+void FOpenAIImageCache::Trim()
+{
+	// The newest entry always stays, even when it alone is over budget
+	while (ResidentBytes > MemoryBudget && Resident.Num() > 1)
+	{
+		const FString* Oldest = nullptr;
+		uint64 OldestUse = MAX_uint64;
+		for (const TPair<FString, FResident>& Pair : Resident)
+		{
+			if (Pair.Value.LastUse < OldestUse)
+			{
+				Oldest = &Pair.Key;
+				OldestUse = Pair.Value.LastUse;
+			}
+		}
+
+		// Bytes of a shared texture move to an entry that still holds it
+		FResident Removed;
+		Resident.RemoveAndCopyValue(FString(*Oldest), Removed);
+		UTexture2D* Texture = Removed.Texture.Get();
+		const int64 Bytes = Removed.Bytes;
+		ResidentBytes -= Bytes;
+		for (TPair<FString, FResident>& Pair : Resident)
+		{
+			if (Bytes > 0 && Pair.Value.Texture.Get() == Texture)
+			{
+				Pair.Value.Bytes = Bytes;
+				ResidentBytes += Bytes;
+				break;
+			}
+		}
+	}
+}
+
+void FOpenAIImageCache::EmptyMemory()
+{
+	Resident.Empty();
+	ResidentBytes = 0;
+}
@@ -0,0 +1,112 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIImageCodec.h"
+#include "IImageWrapperModule.h"
+#include "ImageCore.h"
+#include "Async/Async.h"
+#include "Misc/Base64.h"
+#include "Modules/ModuleManager.h"
+#include "UObject/Package.h"
+
+bool OpenAIImageCodec::DecodeBase64(TArrayView<const uint8> Base64, TArray<uint8>& OutBytes)
+{
+	const ANSICHAR* Source = (const ANSICHAR*)Base64.GetData();
+	OutBytes.SetNumUninitialized(FBase64::GetDecodedDataSize(Source, Base64.Num()));
+	if (OutBytes.Num() == 0 || !FBase64::Decode(Source, Base64.Num(), OutBytes.GetData()))
+	{
+		OutBytes.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool OpenAIImageCodec::DecodeImage(IImageWrapperModule& ImageWrapper, TArrayView<const uint8> Encoded, FImage& OutImage, FString& OutError)
+{
+	if (Encoded.Num() == 0 || !ImageWrapper.DecompressImage(Encoded.GetData(), Encoded.Num(), OutImage))
+	{
+		OutError = TEXT("Image cannot be decoded");
+		return false;
+	}
+
+	// generated images are 8 bit sRGB; BGRA8 is taken as it is by every RHI
+	OutImage.ChangeFormat(ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	return true;
+}
+
+TUniquePtr<FTexturePlatformData> OpenAIImageCodec::CreatePlatformData(const FImage& Image)
+{
+	check(Image.Format == ERawImageFormat::BGRA8);
+
+	TUniquePtr<FTexturePlatformData> PlatformData = MakeUnique<FTexturePlatformData>();
+	PlatformData->SizeX = Image.SizeX;
+	PlatformData->SizeY = Image.SizeY;
+	PlatformData->SetNumSlices(1);
+	PlatformData->PixelFormat = PF_B8G8R8A8;
+
+	FTexture2DMipMap* Mip = new FTexture2DMipMap(Image.SizeX, Image.SizeY, 1);
+	PlatformData->Mips.Add(Mip);
+	Mip->BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(Mip->BulkData.Realloc(Image.RawData.Num()), Image.RawData.GetData(), Image.RawData.Num());
+	Mip->BulkData.Unlock();
+	return PlatformData;
+}
+
+TUniquePtr<FTexturePlatformData> OpenAIImageCodec::DecodeToPlatformData(IImageWrapperModule& ImageWrapper, TArrayView<const uint8> Encoded, FString& OutError)
+{
+	FImage Image;
+	if (!DecodeImage(ImageWrapper, Encoded, Image, OutError))
+	{
+		return nullptr;
+	}
+	return CreatePlatformData(Image);
+}
+
+UTexture2D* OpenAIImageCodec::CreateTexture(TUniquePtr<FTexturePlatformData>&& PlatformData)
+{
+	check(IsInGameThread());
+
+	UTexture2D* Texture = NewObject<UTexture2D>(GetTransientPackage(), NAME_None, RF_Transient);
+	Texture->NeverStream = true;
+	Texture->SRGB = true;
+	Texture->SetPlatformData(PlatformData.Release());
+	Texture->UpdateResource();
+	return Texture;
+}
+
+void OpenAIImageCodec::LoadTextureAsync(TArray<uint8>&& Encoded, bool bBase64, TFunction<void(UTexture2D* Texture, const FString& ErrorMessage)> OnLoaded,
+	TFunction<void(const FImage& Image)> OnDecoded)
+{
+	// modules are loaded on the game thread; the worker only uses it
+	IImageWrapperModule& ImageWrapper = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [&ImageWrapper, Encoded = MoveTemp(Encoded), bBase64, OnLoaded = MoveTemp(OnLoaded), OnDecoded = MoveTemp(OnDecoded)]() mutable
+	{
+		FString Error;
+		TUniquePtr<FTexturePlatformData> PlatformData;
+		TArray<uint8> Decoded;
+		if (bBase64 && !DecodeBase64(Encoded, Decoded))
+		{
+			Error = TEXT("Image is not valid base64");
+		}
+		else
+		{
+			FImage Image;
+			if (DecodeImage(ImageWrapper, bBase64 ? Decoded : Encoded, Image, Error))
+			{
+				if (OnDecoded)
+				{
+					OnDecoded(Image);
+				}
+				PlatformData = CreatePlatformData(Image);
+			}
+		}
+		Encoded.Empty();
+		Decoded.Empty();
+
+		AsyncTask(ENamedThreads::GameThread, [PlatformData = MoveTemp(PlatformData), Error = MoveTemp(Error), OnLoaded = MoveTemp(OnLoaded)]() mutable
+		{
+			UTexture2D* Texture = PlatformData.IsValid() ? CreateTexture(MoveTemp(PlatformData)) : nullptr;
+			OnLoaded(Texture, Error);
+		});
+	});
+}
@@ -0,0 +1,567 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIJsonReader.h"
+
+namespace
+{
+	FORCEINLINE bool IsJsonWhitespace(uint8 Char)
+	{
+		return Char == ' ' || Char == '\n' || Char == '\r' || Char == '\t';
+	}
+
+	int32 HexValue(uint8 Char)
+	{
+		if (Char >= '0' && Char <= '9') return Char - '0';
+		if (Char >= 'a' && Char <= 'f') return Char - 'a' + 10;
+		if (Char >= 'A' && Char <= 'F') return Char - 'A' + 10;
+		return -1;
+	}
+
+	void AppendUtf8(FString& Out, const uint8* Start, int32 Len)
+	{
+		if (Len > 0)
+		{
+			FUTF8ToTCHAR Converted((const ANSICHAR*)Start, Len);
+			Out.AppendChars(Converted.Get(), Converted.Length());
+		}
+	}
+
+	void AppendUtf8Codepoint(TArray<uint8>& Out, uint32 Codepoint)
+	{
+		if (Codepoint >= 0xD800 && Codepoint <= 0xDFFF)
+		{
+			// Lone surrogate
+			Codepoint = 0xFFFD;
+		}
+
+		if (Codepoint < 0x80)
+		{
+			Out.Add((uint8)Codepoint);
+		}
+		else if (Codepoint < 0x800)
+		{
+			Out.Add((uint8)(0xC0 | (Codepoint >> 6)));
+			Out.Add((uint8)(0x80 | (Codepoint & 0x3F)));
+		}
+		else if (Codepoint < 0x10000)
+		{
+			Out.Add((uint8)(0xE0 | (Codepoint >> 12)));
+			Out.Add((uint8)(0x80 | ((Codepoint >> 6) & 0x3F)));
+			Out.Add((uint8)(0x80 | (Codepoint & 0x3F)));
+		}
+		else
+		{
+			Out.Add((uint8)(0xF0 | (Codepoint >> 18)));
+			Out.Add((uint8)(0x80 | ((Codepoint >> 12) & 0x3F)));
+			Out.Add((uint8)(0x80 | ((Codepoint >> 6) & 0x3F)));
+			Out.Add((uint8)(0x80 | (Codepoint & 0x3F)));
+		}
+	}
+
+	void AppendCodepoint(FString& Out, uint32 Codepoint)
+	{
+		if constexpr (sizeof(TCHAR) == 2)
+		{
+			if (Codepoint >= 0x10000)
+			{
+				Codepoint -= 0x10000;
+				Out.AppendChar((TCHAR)(0xD800 + (Codepoint >> 10)));
+				Out.AppendChar((TCHAR)(0xDC00 + (Codepoint & 0x3FF)));
+				return;
+			}
+		}
+		Out.AppendChar((TCHAR)Codepoint);
+	}
+
+	// Decodes the escapes of a raw string span, passing the runs between them and each escaped codepoint on
+	template <typename AppendRunType, typename AppendCodepointType>
+	bool Unescape(const uint8* Start, int32 Len, AppendRunType&& AppendRun, AppendCodepointType&& AppendEscaped)
+	{
+		const uint8* End = Start + Len;
+		const uint8* Run = Start;
+		const uint8* Cursor = Start;
+		while (Cursor < End)
+		{
+			if (*Cursor != '\\')
+			{
+				Cursor++;
+				continue;
+			}
+
+			AppendRun(Run, (int32)(Cursor - Run));
+			Cursor++;
+			if (Cursor >= End)
+			{
+				return false;
+			}
+
+			switch (*Cursor++)
+			{
+			case '"': AppendEscaped('"'); break;
+			case '\\': AppendEscaped('\\'); break;
+			case '/': AppendEscaped('/'); break;
+			case 'b': AppendEscaped('\b'); break;
+			case 'f': AppendEscaped('\f'); break;
+			case 'n': AppendEscaped('\n'); break;
+			case 'r': AppendEscaped('\r'); break;
+			case 't': AppendEscaped('\t'); break;
+			case 'u':
+			{
+				auto ReadHex4 = [&Cursor, End](uint32& OutUnit) -> bool
+				{
+					if (End - Cursor < 4)
+					{
+						return false;
+					}
+					OutUnit = 0;
+					for (int32 i = 0; i < 4; i++)
+					{
+						const int32 Digit = HexValue(*Cursor++);
+						if (Digit < 0)
+						{
+							return false;
+						}
+						OutUnit = (OutUnit << 4) | (uint32)Digit;
+					}
+					return true;
+				};
+
+				uint32 Codepoint = 0;
+				if (!ReadHex4(Codepoint))
+				{
+					return false;
+				}
+
+				// Combine a surrogate pair written as two escapes
+				if (Codepoint >= 0xD800 && Codepoint <= 0xDBFF && End - Cursor >= 6 && Cursor[0] == '\\' && Cursor[1] == 'u')
+				{
+					const uint8* PairStart = Cursor;
+					Cursor += 2;
+					uint32 Low = 0;
+					if (ReadHex4(Low) && Low >= 0xDC00 && Low <= 0xDFFF)
+					{
+						Codepoint = 0x10000 + ((Codepoint - 0xD800) << 10) + (Low - 0xDC00);
+					}
+					else
+					{
+						Cursor = PairStart;
+					}
+				}
+				AppendEscaped(Codepoint);
+				break;
+			}
+			default:
+				return false;
+			}
+			Run = Cursor;
+		}
+		AppendRun(Run, (int32)(End - Run));
+		return true;
+	}
+}
+
+FOpenAIJsonReader::FOpenAIJsonReader(TArrayView<const uint8> InUtf8)
+	: Data(InUtf8.GetData())
+	, Num(InUtf8.Num())
+	, Pos(0)
+	, bError(false)
+	, ErrorOffset(INDEX_NONE)
+	, bNeedSeparator(false)
+{
+	// Skip a UTF-8 byte order mark
+	if (Num >= 3 && Data[0] == 0xEF && Data[1] == 0xBB && Data[2] == 0xBF)
+	{
+		Pos = 3;
+	}
+}
+
+void FOpenAIJsonReader::SkipWhitespace()
+{
+	while (Pos < Num && IsJsonWhitespace(Data[Pos]))
+	{
+		Pos++;
+	}
+}
+
+bool FOpenAIJsonReader::SetError()
+{
+	if (!bError)
+	{
+		bError = true;
+		ErrorOffset = Pos;
+	}
+	return false;
+}
+
+bool FOpenAIJsonReader::Expect(uint8 Char)
+{
+	SkipWhitespace();
+	if (bError || Pos >= Num || Data[Pos] != Char)
+	{
+		return SetError();
+	}
+	Pos++;
+	return true;
+}
+
+EOpenAIJsonToken FOpenAIJsonReader::Peek()
+{
+	if (bError)
+	{
+		return EOpenAIJsonToken::Error;
+	}
+
+	SkipWhitespace();
+	if (Pos >= Num)
+	{
+		return EOpenAIJsonToken::End;
+	}
+
+	switch (Data[Pos])
+	{
+	case '{': return EOpenAIJsonToken::ObjectStart;
+	case '}': return EOpenAIJsonToken::ObjectEnd;
+	case '[': return EOpenAIJsonToken::ArrayStart;
+	case ']': return EOpenAIJsonToken::ArrayEnd;
+	case '"': return EOpenAIJsonToken::String;
+	case 't':
+	case 'f': return EOpenAIJsonToken::Boolean;
+	case 'n': return EOpenAIJsonToken::Null;
+	default:
+		if (Data[Pos] == '-' || (Data[Pos] >= '0' && Data[Pos] <= '9'))
+		{
+			return EOpenAIJsonToken::Number;
+		}
+		return EOpenAIJsonToken::Error;
+	}
+}
+
+bool FOpenAIJsonReader::ReadObjectStart()
+{
+	bNeedSeparator = false;
+	return Expect('{');
+}
+
+bool FOpenAIJsonReader::ReadArrayStart()
+{
+	bNeedSeparator = false;
+	return Expect('[');
+}
+
+bool FOpenAIJsonReader::NextMember(FAnsiStringView& OutKey)
+{
+	SkipWhitespace();
+	if (bError || Pos >= Num)
+	{
+		return SetError();
+	}
+
+	if (Data[Pos] == '}')
+	{
+		Pos++;
+		// The object itself was a member or element of its parent
+		bNeedSeparator = true;
+		return false;
+	}
+
+	if (bNeedSeparator && !Expect(','))
+	{
+		return false;
+	}
+
+	SkipWhitespace();
+	const uint8* KeyStart = nullptr;
+	int32 KeyLen = 0;
+	bool bHasEscapes = false;
+	if (!ScanString(KeyStart, KeyLen, bHasEscapes) || !Expect(':'))
+	{
+		return false;
+	}
+
+	OutKey = FAnsiStringView((const ANSICHAR*)KeyStart, KeyLen);
+	// Whatever the caller reads next is the value, the separator comes after it
+	bNeedSeparator = true;
+	return true;
+}
+
+bool FOpenAIJsonReader::NextElement()
+{
+	SkipWhitespace();
+	if (bError || Pos >= Num)
+	{
+		return SetError();
+	}
+
+	if (Data[Pos] == ']')
+	{
+		Pos++;
+		bNeedSeparator = true;
+		return false;
+	}
+
+	if (bNeedSeparator && !Expect(','))
+	{
+		return false;
+	}
+
+	bNeedSeparator = true;
+	return true;
+}
+
+bool FOpenAIJsonReader::ScanString(const uint8*& OutStart, int32& OutLen, bool& bOutHasEscapes)
+{
+	if (Pos >= Num || Data[Pos] != '"')
+	{
+		return SetError();
+	}
+
+	const int32 Start = ++Pos;
+	bOutHasEscapes = false;
+	while (Pos < Num)
+	{
+		const uint8 Char = Data[Pos];
+		if (Char == '"')
+		{
+			OutStart = Data + Start;
+			OutLen = Pos - Start;
+			Pos++;
+			return true;
+		}
+		if (Char == '\\')
+		{
+			bOutHasEscapes = true;
+			Pos++;
+		}
+		Pos++;
+	}
+	return SetError();
+}
+
+bool FOpenAIJsonReader::ScanNumber(const uint8*& OutStart, int32& OutLen)
+{
+	const int32 Start = Pos;
+	while (Pos < Num)
+	{
+		const uint8 Char = Data[Pos];
+		if ((Char >= '0' && Char <= '9') || Char == '-' || Char == '+' || Char == '.' || Char == 'e' || Char == 'E')
+		{
+			Pos++;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (Pos == Start)
+	{
+		return SetError();
+	}
+	OutStart = Data + Start;
+	OutLen = Pos - Start;
+	return true;
+}
+
+bool FOpenAIJsonReader::ReadString(FString& OutValue)
+{
+	SkipWhitespace();
+	const uint8* Start = nullptr;
+	int32 Len = 0;
+	bool bHasEscapes = false;
+	if (bError || !ScanString(Start, Len, bHasEscapes))
+	{
+		return SetError();
+	}
+
+	OutValue.Reset(Len);
+	if (!bHasEscapes)
+	{
+		AppendUtf8(OutValue, Start, Len);
+		return true;
+	}
+
+	const bool bValid = Unescape(Start, Len,
+		[&OutValue](const uint8* Run, int32 RunLen) { AppendUtf8(OutValue, Run, RunLen); },
+		[&OutValue](uint32 Codepoint) { AppendCodepoint(OutValue, Codepoint); });
+	return bValid || SetError();
+}
+
+bool FOpenAIJsonReader::ReadUtf8String(TArray<uint8>& OutValue)
+{
+	SkipWhitespace();
+	const uint8* Start = nullptr;
+	int32 Len = 0;
+	bool bHasEscapes = false;
+	if (bError || !ScanString(Start, Len, bHasEscapes))
+	{
+		return SetError();
+	}
+
+	OutValue.Reset(Len);
+	if (!bHasEscapes)
+	{
+		OutValue.Append(Start, Len);
+		return true;
+	}
+
+	const bool bValid = Unescape(Start, Len,
+		[&OutValue](const uint8* Run, int32 RunLen) { OutValue.Append(Run, RunLen); },
+		[&OutValue](uint32 Codepoint) { AppendUtf8Codepoint(OutValue, Codepoint); });
+	return bValid || SetError();
+}
+
+bool FOpenAIJsonReader::ReadNumber(double& OutValue)
+{
+	SkipWhitespace();
+	const uint8* Start = nullptr;
+	int32 Len = 0;
+	if (bError || !ScanNumber(Start, Len))
+	{
+		return SetError();
+	}
+
+	// Numbers are short, copy into a terminated buffer for the C runtime parser
+	ANSICHAR Buffer[64];
+	if (Len >= UE_ARRAY_COUNT(Buffer))
+	{
+		return SetError();
+	}
+	FMemory::Memcpy(Buffer, Start, Len);
+	Buffer[Len] = 0;
+	OutValue = FCStringAnsi::Atod(Buffer);
+	return true;
+}
+
+bool FOpenAIJsonReader::ReadInteger(int64& OutValue)
+{
+	double Value = 0.0;
+	if (!ReadNumber(Value))
+	{
+		return false;
+	}
+	OutValue = (int64)Value;
+	return true;
+}
+
+bool FOpenAIJsonReader::ReadBool(bool& OutValue)
+{
+	SkipWhitespace();
+	if (Pos + 4 <= Num && FMemory::Memcmp(Data + Pos, "true", 4) == 0)
+	{
+		Pos += 4;
+		OutValue = true;
+		return true;
+	}
+	if (Pos + 5 <= Num && FMemory::Memcmp(Data + Pos, "false", 5) == 0)
+	{
+		Pos += 5;
+		OutValue = false;
+		return true;
+	}
+	return SetError();
+}
+
+bool FOpenAIJsonReader::TryReadNull()
+{
+	SkipWhitespace();
+	if (!bError && Pos + 4 <= Num && FMemory::Memcmp(Data + Pos, "null", 4) == 0)
+	{
+		Pos += 4;
+		return true;
+	}
+	return false;
+}
+
+bool FOpenAIJsonReader::Skip()
+{
+	// Containers are skipped by bracket depth; strings are scanned so brackets inside them are ignored
+	int32 Depth = 0;
+	do
+	{
+		SkipWhitespace();
+		if (bError || Pos >= Num)
+		{
+			return SetError();
+		}
+
+		const uint8 Char = Data[Pos];
+		switch (Char)
+		{
+		case '{':
+		case '[':
+			Depth++;
+			Pos++;
+			break;
+		case '}':
+		case ']':
+			if (Depth == 0)
+			{
+				return SetError();
+			}
+			Depth--;
+			Pos++;
+			break;
+		case ',':
+		case ':':
+			if (Depth == 0)
+			{
+				return SetError();
+			}
+			Pos++;
+			break;
+		case '"':
+		{
+			const uint8* Start = nullptr;
+			int32 Len = 0;
+			bool bHasEscapes = false;
+			if (!ScanString(Start, Len, bHasEscapes))
+			{
+				return false;
+			}
+			break;
+		}
+		case 't':
+		case 'f':
+		{
+			bool Value = false;
+			if (!ReadBool(Value))
+			{
+				return false;
+			}
+			break;
+		}
+		case 'n':
+			if (!TryReadNull())
+			{
+				return SetError();
+			}
+			break;
+		default:
+		{
+			const uint8* Start = nullptr;
+			int32 Len = 0;
+			if (!ScanNumber(Start, Len))
+			{
+				return false;
+			}
+			break;
+		}
+		}
+	}
+	while (Depth > 0);
+
+	bNeedSeparator = true;
+	return true;
+}
+
+bool FOpenAIJsonReader::ReadRawValue(TArrayView<const uint8>& OutValue)
+{
+	SkipWhitespace();
+	const int32 Start = Pos;
+	if (!Skip())
+	{
+		return false;
+	}
+	OutValue = TArrayView<const uint8>(Data + Start, Pos - Start);
+	return true;
+}
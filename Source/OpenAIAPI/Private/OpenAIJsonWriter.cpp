@@ -0,0 +1,357 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIJsonWriter.h"
+#include "Misc/Base64.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#define OPENAI_JSON_SSE2 1
+#define OPENAI_JSON_NEON 0
+#elif PLATFORM_CPU_ARM_FAMILY && PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#include <arm_neon.h>
+#define OPENAI_JSON_SSE2 0
+#define OPENAI_JSON_NEON 1
+#else
+#define OPENAI_JSON_SSE2 0
+#define OPENAI_JSON_NEON 0
+#endif
+
+namespace
+{
+	// Buffers that grew past this for one huge request are released instead of kept per thread
+	constexpr int32 MaxRetainedBufferBytes = 4 * 1024 * 1024;
+
+	TArray<uint8>& GetThreadBuffer()
+	{
+		static thread_local TArray<uint8> Buffer;
+		if (Buffer.Max() > MaxRetainedBufferBytes)
+		{
+			Buffer.Empty();
+		}
+		else
+		{
+			Buffer.Reset();
+		}
+		return Buffer;
+	}
+
+	// Escapes and transcodes the character at Src[Index], advancing Index past it (two units for a surrogate pair)
+	FORCEINLINE uint8* EscapeChar(const TCHAR* Src, int32 Len, int32& Index, uint8* Dst)
+	{
+		static const uint8 HexDigits[] = "0123456789abcdef";
+
+		uint32 Char = (uint32)Src[Index++];
+		if (Char < 0x80)
+		{
+			if (Char >= 0x20 && Char != '"' && Char != '\\')
+			{
+				*Dst++ = (uint8)Char;
+				return Dst;
+			}
+
+			*Dst++ = '\\';
+			switch (Char)
+			{
+			case '"': *Dst++ = '"'; break;
+			case '\\': *Dst++ = '\\'; break;
+			case '\n': *Dst++ = 'n'; break;
+			case '\r': *Dst++ = 'r'; break;
+			case '\t': *Dst++ = 't'; break;
+			case '\b': *Dst++ = 'b'; break;
+			case '\f': *Dst++ = 'f'; break;
+			default:
+				*Dst++ = 'u';
+				*Dst++ = '0';
+				*Dst++ = '0';
+				*Dst++ = HexDigits[Char >> 4];
+				*Dst++ = HexDigits[Char & 0xF];
+				break;
+			}
+			return Dst;
+		}
+
+		if (Char >= 0xD800 && Char <= 0xDFFF)
+		{
+			const uint32 Low = Index < Len ? (uint32)Src[Index] : 0;
+			if (Char <= 0xDBFF && Low >= 0xDC00 && Low <= 0xDFFF)
+			{
+				Char = 0x10000 + ((Char - 0xD800) << 10) + (Low - 0xDC00);
+				Index++;
+			}
+			else
+			{
+				// Lone surrogate
+				Char = 0xFFFD;
+			}
+		}
+
+		if (Char < 0x800)
+		{
+			*Dst++ = (uint8)(0xC0 | (Char >> 6));
+			*Dst++ = (uint8)(0x80 | (Char & 0x3F));
+		}
+		else if (Char < 0x10000)
+		{
+			*Dst++ = (uint8)(0xE0 | (Char >> 12));
+			*Dst++ = (uint8)(0x80 | ((Char >> 6) & 0x3F));
+			*Dst++ = (uint8)(0x80 | (Char & 0x3F));
+		}
+		else
+		{
+			*Dst++ = (uint8)(0xF0 | (Char >> 18));
+			*Dst++ = (uint8)(0x80 | ((Char >> 12) & 0x3F));
+			*Dst++ = (uint8)(0x80 | ((Char >> 6) & 0x3F));
+			*Dst++ = (uint8)(0x80 | (Char & 0x3F));
+		}
+		return Dst;
+	}
+}
+
+FOpenAIJsonWriter::FOpenAIJsonWriter()
+	: Buffer(GetThreadBuffer())
+	, bNeedComma(false)
+{
+}
+
+FOpenAIJsonWriter::FOpenAIJsonWriter(TArray<uint8>& InBuffer)
+	: Buffer(InBuffer)
+	, bNeedComma(false)
+{
+}
+
+void FOpenAIJsonWriter::Separator()
+{
+	if (bNeedComma)
+	{
+		Buffer.Add(',');
+	}
+	bNeedComma = true;
+}
+
+void FOpenAIJsonWriter::AppendAnsi(FAnsiStringView Text)
+{
+	Buffer.Append((const uint8*)Text.GetData(), Text.Len());
+}
+
+void FOpenAIJsonWriter::BeginObject()
+{
+	Separator();
+	Buffer.Add('{');
+	bNeedComma = false;
+}
+
+void FOpenAIJsonWriter::EndObject()
+{
+	Buffer.Add('}');
+	bNeedComma = true;
+}
+
+void FOpenAIJsonWriter::BeginArray()
+{
+	Separator();
+	Buffer.Add('[');
+	bNeedComma = false;
+}
+
+void FOpenAIJsonWriter::EndArray()
+{
+	Buffer.Add(']');
+	bNeedComma = true;
+}
+
+void FOpenAIJsonWriter::Key(FAnsiStringView Name)
+{
+	Separator();
+	Buffer.Add('"');
+	AppendAnsi(Name);
+	Buffer.Add('"');
+	Buffer.Add(':');
+	// The value that follows belongs to this key
+	bNeedComma = false;
+}
+
+void FOpenAIJsonWriter::Key(FStringView Name)
+{
+	Separator();
+	Buffer.Add('"');
+	EscapeString(Name, Buffer);
+	Buffer.Add('"');
+	Buffer.Add(':');
+	bNeedComma = false;
+}
+
+void FOpenAIJsonWriter::Value(FStringView Text)
+{
+	Separator();
+	Buffer.Add('"');
+	EscapeString(Text, Buffer);
+	Buffer.Add('"');
+}
+
+void FOpenAIJsonWriter::Value(int64 Number)
+{
+	Separator();
+	ANSICHAR Text[24];
+	const int32 Len = FCStringAnsi::Snprintf(Text, UE_ARRAY_COUNT(Text), "%lld", (long long)Number);
+	AppendAnsi(FAnsiStringView(Text, Len));
+}
+
+void FOpenAIJsonWriter::Value(float Number)
+{
+	if (!FMath::IsFinite(Number))
+	{
+		Null();
+		return;
+	}
+
+	// Shortest form that reads back as the same float, so 0.7f is written as 0.7
+	Separator();
+	ANSICHAR Text[32];
+	int32 Len = 0;
+	for (int32 Precision = 6; Precision <= 9; Precision++)
+	{
+		Len = FCStringAnsi::Snprintf(Text, UE_ARRAY_COUNT(Text), "%.*g", Precision, (double)Number);
+		if ((float)FCStringAnsi::Atod(Text) == Number)
+		{
+			break;
+		}
+	}
+	AppendAnsi(FAnsiStringView(Text, Len));
+}
+
+void FOpenAIJsonWriter::Value(double Number)
+{
+	if (!FMath::IsFinite(Number))
+	{
+		Null();
+		return;
+	}
+
+	Separator();
+	ANSICHAR Text[32];
+	int32 Len = 0;
+	for (int32 Precision = 15; Precision <= 17; Precision++)
+	{
+		Len = FCStringAnsi::Snprintf(Text, UE_ARRAY_COUNT(Text), "%.*g", Precision, Number);
+		if (FCStringAnsi::Atod(Text) == Number)
+		{
+			break;
+		}
+	}
+	AppendAnsi(FAnsiStringView(Text, Len));
+}
+
+void FOpenAIJsonWriter::Value(bool bValue)
+{
+	Separator();
+	AppendAnsi(bValue ? ANSITEXTVIEW("true") : ANSITEXTVIEW("false"));
+}
+
+void FOpenAIJsonWriter::Null()
+{
+	Separator();
+	AppendAnsi(ANSITEXTVIEW("null"));
+}
+
+void FOpenAIJsonWriter::Base64Value(TArrayView<const uint8> Data)
+{
+	Separator();
+	Buffer.Add('"');
+
+	const int32 Start = Buffer.Num();
+	// One spare byte for the terminator Encode writes
+	Buffer.AddUninitialized(FBase64::GetEncodedDataSize(Data.Num()) + 1);
+	const uint32 Written = FBase64::Encode(Data.GetData(), Data.Num(), (ANSICHAR*)(Buffer.GetData() + Start));
+	Buffer.SetNum(Start + Written, EAllowShrinking::No);
+
+	Buffer.Add('"');
+}
+
+void FOpenAIJsonWriter::RawValue(FAnsiStringView Json)
+{
+	Separator();
+	AppendAnsi(Json);
+}
+
+void FOpenAIJsonWriter::EscapeString(FStringView Text, TArray<uint8>& Out)
+{
+	const TCHAR* Src = Text.GetData();
+	const int32 Len = Text.Len();
+
+	// Worst case is six bytes per character (\u001f), trimmed at the end
+	const int32 Start = Out.Num();
+	Out.AddUninitialized(Len * 6);
+	uint8* Dst = Out.GetData() + Start;
+	int32 Index = 0;
+
+	if constexpr (sizeof(TCHAR) == 2)
+	{
+#if OPENAI_JSON_SSE2
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i MaxAscii = _mm_set1_epi16(0x7F);
+		const __m128i MaxControl = _mm_set1_epi16(0x1F);
+		const __m128i Quote = _mm_set1_epi16('"');
+		const __m128i Backslash = _mm_set1_epi16('\\');
+
+		while (Index + 8 <= Len)
+		{
+			const __m128i Chars = _mm_loadu_si128((const __m128i*)(Src + Index));
+			// Unsigned compares through saturating subtraction: x <= Limit when x - Limit saturates to 0
+			const __m128i Ascii = _mm_cmpeq_epi16(_mm_subs_epu16(Chars, MaxAscii), Zero);
+			const __m128i Control = _mm_cmpeq_epi16(_mm_subs_epu16(Chars, MaxControl), Zero);
+			const __m128i Special = _mm_or_si128(Control, _mm_or_si128(_mm_cmpeq_epi16(Chars, Quote), _mm_cmpeq_epi16(Chars, Backslash)));
+			const uint32 PlainMask = (uint32)_mm_movemask_epi8(_mm_andnot_si128(Special, Ascii));
+
+			if (PlainMask == 0xFFFF)
+			{
+				_mm_storel_epi64((__m128i*)Dst, _mm_packus_epi16(Chars, Chars));
+				Dst += 8;
+				Index += 8;
+				continue;
+			}
+
+			// Copy the plain prefix, then let the scalar path take the first special character
+			const int32 NumPlain = (int32)FMath::CountTrailingZeros(~PlainMask) / 2;
+			for (int32 i = 0; i < NumPlain; i++)
+			{
+				*Dst++ = (uint8)Src[Index + i];
+			}
+			Index += NumPlain;
+			Dst = EscapeChar(Src, Len, Index, Dst);
+		}
+#elif OPENAI_JSON_NEON
+		const uint16x8_t MaxAscii = vdupq_n_u16(0x7F);
+		const uint16x8_t MinPrintable = vdupq_n_u16(0x20);
+		const uint16x8_t Quote = vdupq_n_u16('"');
+		const uint16x8_t Backslash = vdupq_n_u16('\\');
+
+		while (Index + 8 <= Len)
+		{
+			const uint16x8_t Chars = vld1q_u16((const uint16*)(Src + Index));
+			const uint16x8_t Special = vorrq_u16(vceqq_u16(Chars, Quote), vceqq_u16(Chars, Backslash));
+			const uint16x8_t Plain = vbicq_u16(vandq_u16(vcleq_u16(Chars, MaxAscii), vcgeq_u16(Chars, MinPrintable)), Special);
+
+			if (vminvq_u16(Plain) == 0xFFFF)
+			{
+				vst1_u8(Dst, vmovn_u16(Chars));
+				Dst += 8;
+				Index += 8;
+				continue;
+			}
+
+			const int32 BlockEnd = Index + 8;
+			while (Index < BlockEnd)
+			{
+				Dst = EscapeChar(Src, Len, Index, Dst);
+			}
+		}
+#endif
+	}
+
+	while (Index < Len)
+	{
+		Dst = EscapeChar(Src, Len, Index, Dst);
+	}
+
+	Out.SetNum((int32)(Dst - Out.GetData()), EAllowShrinking::No);
+}
@@ -0,0 +1,404 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAILongTranscription.h"
+#include "OpenAIUtils.h"
+#include "OpenAIParser.h"
+#include "OpenAIAudioCodec.h"
+#include "OpenAIMultipartBody.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Audio.h"
+
+namespace
+{
+	// Energy is measured over 10 ms windows and smoothed over 300 ms, about a short pause
+	constexpr int32 WindowsPerSecond = 100;
+	constexpr int32 SmoothingWindows = 30;
+
+	// Whisper reads at most 224 prompt tokens; this much text stays well inside that
+	constexpr int32 MaxPromptChars = 800;
+
+	FString GetApiKey()
+	{
+		return UOpenAIUtils::getUseApiKeyFromEnvironmentVars() ? UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY")) : UOpenAIUtils::getApiKey();
+	}
+}
+
+UOpenAILongTranscription::UOpenAILongTranscription()
+	: SampleRate(24000)
+	, NumChannels(1)
+	, NextPiece(0)
+	, Completed(0)
+	, NumEncoding(0)
+	, bFinished(false)
+{
+}
+
+UOpenAILongTranscription* UOpenAILongTranscription::Transcribe(TArray<float>&& InSamples, int32 InSampleRate, int32 InNumChannels,
+	const FLongTranscriptionSettings& InSettings, FCallback InCallback, TFunction<void(int32 Completed, int32 Total)> InOnProgress)
+{
+	UOpenAILongTranscription* Transcription = NewObject<UOpenAILongTranscription>();
+	Transcription->AddToRoot();
+	Transcription->Samples = MoveTemp(InSamples);
+	Transcription->SampleRate = FMath::Max(InSampleRate, 1);
+	Transcription->NumChannels = FMath::Max(InNumChannels, 1);
+	Transcription->Settings = InSettings;
+	Transcription->Callback = MoveTemp(InCallback);
+	Transcription->OnProgress = MoveTemp(InOnProgress);
+	Transcription->Start();
+	return Transcription;
+}
+
+UOpenAILongTranscription* UOpenAILongTranscription::TranscribeWavFile(const FString& Path, const FLongTranscriptionSettings& InSettings,
+	FCallback InCallback, TFunction<void(int32 Completed, int32 Total)> InOnProgress)
+{
+	TArray<uint8> FileData;
+	FWaveModInfo WaveInfo;
+	TArray<float> FileSamples;
+	int32 FileSampleRate = 0;
+	int32 FileChannels = 0;
+	if (FFileHelper::LoadFileToArray(FileData, *Path) && WaveInfo.ReadWaveInfo(FileData.GetData(), FileData.Num()) && *WaveInfo.pBitsPerSample == 16)
+	{
+		FileSampleRate = *WaveInfo.pSamplesPerSec;
+		FileChannels = *WaveInfo.pChannels;
+		OpenAIAudioCodec::PCM16ToFloat(MakeArrayView(WaveInfo.SampleDataStart, (int32)WaveInfo.SampleDataSize), FileSamples);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is not a 16 bit PCM WAV file"), *Path);
+	}
+
+	// The raw file is dropped before the upload starts, only the samples are kept
+	FileData.Empty();
+	return Transcribe(MoveTemp(FileSamples), FileSampleRate, FileChannels, InSettings, MoveTemp(InCallback), MoveTemp(InOnProgress));
+}
+
+TArray<int32> UOpenAILongTranscription::FindSplitPoints(TArrayView<const float> InSamples, int32 InSampleRate, int32 InNumChannels, const FLongTranscriptionSettings& InSettings)
+{
+	TArray<int32> SplitPoints;
+	const int32 NumFrames = InSamples.Num() / FMath::Max(InNumChannels, 1);
+	const int32 WindowFrames = FMath::Max(InSampleRate / WindowsPerSecond, 1);
+	const int32 MaxFrames = FMath::Max((int32)(InSettings.maxSegmentSeconds * InSampleRate), WindowFrames);
+	const int32 MinFrames = FMath::Clamp((int32)(InSettings.minSegmentSeconds * InSampleRate), WindowFrames, MaxFrames);
+	if (NumFrames <= MaxFrames)
+	{
+		return SplitPoints;
+	}
+
+	// Mean power per window, then a moving average so a single quiet window between syllables does not count
+	const int32 NumWindows = NumFrames / WindowFrames;
+	TArray<float> Energy;
+	Energy.SetNumUninitialized(NumWindows);
+	for (int32 Window = 0; Window < NumWindows; Window++)
+	{
+		const float* Frame = InSamples.GetData() + (int64)Window * WindowFrames * InNumChannels;
+		double Sum = 0.0;
+		for (int32 Index = 0; Index < WindowFrames * InNumChannels; Index++)
+		{
+			Sum += Frame[Index] * Frame[Index];
+		}
+		Energy[Window] = (float)(Sum / (WindowFrames * InNumChannels));
+	}
+
+	TArray<float> Smoothed;
+	Smoothed.SetNumUninitialized(NumWindows);
+	double Running = 0.0;
+	for (int32 Window = 0; Window < NumWindows; Window++)
+	{
+		Running += Energy[Window];
+		if (Window >= SmoothingWindows)
+		{
+			Running -= Energy[Window - SmoothingWindows];
+		}
+		// Centred on the window, so the cut lands in the middle of the pause
+		const int32 Centre = Window - SmoothingWindows / 2;
+		if (Centre >= 0)
+		{
+			Smoothed[Centre] = (float)(Running / SmoothingWindows);
+		}
+	}
+	for (int32 Window = FMath::Max(NumWindows - SmoothingWindows / 2, 0); Window < NumWindows; Window++)
+	{
+		Smoothed[Window] = Energy[Window];
+	}
+
+	const float Threshold = FMath::Pow(10.0f, InSettings.silenceThresholdDb / 10.0f);
+	int32 Start = 0;
+	while (NumFrames - Start > MaxFrames)
+	{
+		const int32 FirstWindow = FMath::Min((Start + MinFrames) / WindowFrames, NumWindows - 1);
+		const int32 LastWindow = FMath::Min((Start + MaxFrames) / WindowFrames - 1, NumWindows - 1);
+
+		// The latest silence keeps pieces long; without one, the quietest point in reach
+		int32 Best = LastWindow;
+		bool bSilent = false;
+		for (int32 Window = LastWindow; Window >= FirstWindow; Window--)
+		{
+			if (Smoothed[Window] < Threshold)
+			{
+				Best = Window;
+				bSilent = true;
+				break;
+			}
+			if (Smoothed[Window] < Smoothed[Best])
+			{
+				Best = Window;
+			}
+		}
+		if (!bSilent)
+		{
+			UE_LOG(LogTemp, Verbose, TEXT("No silence between %.1f and %.1f s, cutting at the quietest point"), (float)(Start + MinFrames) / InSampleRate, (float)(Start + MaxFrames) / InSampleRate);
+		}
+
+		const int32 Cut = Best * WindowFrames + WindowFrames / 2;
+		if (Cut <= Start)
+		{
+			break;
+		}
+		SplitPoints.Add(Cut);
+		Start = Cut;
+	}
+	return SplitPoints;
+}
+
+void UOpenAILongTranscription::Start()
+{
+	ApiKey = GetApiKey();
+	if (ApiKey.IsEmpty())
+	{
+		Finish(TEXT("Api key is not set"), false);
+		return;
+	}
+
+	const int32 NumFrames = Samples.Num() / NumChannels;
+	if (NumFrames == 0)
+	{
+		Finish(TEXT("No audio to transcribe"), false);
+		return;
+	}
+
+	int32 StartFrame = 0;
+	for (const int32 Cut : FindSplitPoints(Samples, SampleRate, NumChannels, Settings))
+	{
+		FPiece& Piece = Pieces.AddDefaulted_GetRef();
+		Piece.StartFrame = StartFrame;
+		Piece.NumFrames = Cut - StartFrame;
+		StartFrame = Cut;
+	}
+	FPiece& Last = Pieces.AddDefaulted_GetRef();
+	Last.StartFrame = StartFrame;
+	Last.NumFrames = NumFrames - StartFrame;
+
+	UE_LOG(LogTemp, Log, TEXT("Transcribing %.1f s of audio in %d pieces"), (float)NumFrames / SampleRate, Pieces.Num());
+	DispatchNext();
+}
+
+void UOpenAILongTranscription::DispatchNext()
+{
+	while (FirstError.IsEmpty() && NextPiece < Pieces.Num() && InFlight.Num() + NumEncoding < FMath::Max(Settings.maxConcurrentRequests, 1))
+	{
+		Send(NextPiece++);
+	}
+
+	// Every piece has its own copy by now, the samples are not needed any more
+	if (NextPiece == Pieces.Num())
+	{
+		Samples.Empty();
+	}
+}
+
+void UOpenAILongTranscription::Send(int32 Index)
+{
+	const FPiece& Piece = Pieces[Index];
+	TArray<float> PieceSamples(Samples.GetData() + (int64)Piece.StartFrame * NumChannels, Piece.NumFrames * NumChannels);
+
+	NumEncoding++;
+	TWeakObjectPtr<UOpenAILongTranscription> WeakThis(this);
+	OpenAIAudioCodec::EncodeUploadAsync(Settings.uploadFormat, MoveTemp(PieceSamples), SampleRate, NumChannels, Settings.opusBitrate,
+		[WeakThis, Index](OpenAIAudioCodec::FEncodedUpload&& Encoded)
+	{
+		if (UOpenAILongTranscription* This = WeakThis.Get())
+		{
+			This->OnPieceEncoded(Index, MoveTemp(Encoded.Bytes), Encoded.FileName, Encoded.ContentType);
+		}
+	});
+}
+
+void UOpenAILongTranscription::OnPieceEncoded(int32 Index, TArray<uint8>&& Bytes, const FString& FileName, const FString& ContentType)
+{
+	NumEncoding--;
+	if (bFinished)
+	{
+		return;
+	}
+	if (!FirstError.IsEmpty())
+	{
+		if (InFlight.Num() + NumEncoding == 0)
+		{
+			Finish(FirstError, false);
+		}
+		return;
+	}
+
+	// Only whisper-1 returns timed segments; other models answer with the text alone
+	const bool bVerbose = Settings.model == TEXT("whisper-1");
+
+	// Decided after encoding, which gives the previous piece a little longer to come back
+	FString Prompt = Settings.prompt;
+	if (Index > 0 && Pieces[Index - 1].bDone)
+	{
+		Prompt = Pieces[Index - 1].Text.Right(MaxPromptChars);
+	}
+
+	TSharedRef<FOpenAIMultipartBody, ESPMode::ThreadSafe> Body = MakeShared<FOpenAIMultipartBody, ESPMode::ThreadSafe>();
+	Body->AddFile(TEXT("file"), MoveTemp(Bytes), FString::Printf(TEXT("piece%d.%s"), Index, *FPaths::GetExtension(FileName)), ContentType);
+	Body->AddField(TEXT("model"), Settings.model);
+	Body->AddField(TEXT("response_format"), bVerbose ? TEXT("verbose_json") : TEXT("json"));
+	if (!Settings.language.IsEmpty() && !Settings.translate)
+	{
+		Body->AddField(TEXT("language"), Settings.language);
+	}
+	if (!Prompt.IsEmpty())
+	{
+		Body->AddField(TEXT("prompt"), Prompt);
+	}
+	Body->Finish();
+
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(UOpenAIUtils::getBaseUrl() + (Settings.translate ? TEXT("/audio/translations") : TEXT("/audio/transcriptions")));
+	HttpRequest->SetVerb(TEXT("POST"));
+	HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + ApiKey);
+	HttpRequest->SetHeader(TEXT("Content-Type"), Body->GetContentType());
+	HttpRequest->SetContentFromStream(Body);
+	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UOpenAILongTranscription::OnPieceResponse, Index);
+	InFlight.Add(Index, HttpRequest);
+	HttpRequest->ProcessRequest();
+}
+
+void UOpenAILongTranscription::OnPieceResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, int32 Index)
+{
+	InFlight.Remove(Index);
+	FPiece& Piece = Pieces[Index];
+
+	FString ErrorMessage;
+	if (!WasSuccessful || !Response.IsValid())
+	{
+		ErrorMessage = TEXT("No response from server");
+	}
+	else
+	{
+		OpenAIParser parser;
+		parser.DecodeTranscription(Response->GetContent(), Piece.Text, Piece.Segments, ErrorMessage);
+	}
+
+	if (ErrorMessage.IsEmpty())
+	{
+		Piece.bDone = true;
+		Completed++;
+		if (OnProgress)
+		{
+			OnProgress(Completed, Pieces.Num());
+		}
+	}
+	else if (FirstError.IsEmpty())
+	{
+		FirstError = FString::Printf(TEXT("Piece %d of %d failed: %s"), Index + 1, Pieces.Num(), *ErrorMessage);
+	}
+
+	if (Completed == Pieces.Num())
+	{
+		Finish(FString(), true);
+	}
+	else if (!FirstError.IsEmpty() && InFlight.Num() + NumEncoding == 0)
+	{
+		Finish(FirstError, false);
+	}
+	else
+	{
+		DispatchNext();
+	}
+}
+
+void UOpenAILongTranscription::Finish(const FString& ErrorMessage, bool Success)
+{
+	bFinished = true;
+	if (!Success)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Long transcription failed. Error: %s"), *ErrorMessage);
+	}
+
+	// Finished pieces are handed back even after a failure, in recording order
+	TArray<FTranscriptionSegment> Segments;
+	TStringBuilder<4096> Text;
+	for (const FPiece& Piece : Pieces)
+	{
+		if (!Piece.bDone)
+		{
+			continue;
+		}
+
+		const float Offset = (float)Piece.StartFrame / SampleRate;
+		if (Piece.Segments.Num() == 0)
+		{
+			FTranscriptionSegment& Segment = Segments.AddDefaulted_GetRef();
+			Segment.start = Offset;
+			Segment.end = Offset + (float)Piece.NumFrames / SampleRate;
+			Segment.text = Piece.Text;
+		}
+		for (const FTranscriptionSegment& PieceSegment : Piece.Segments)
+		{
+			FTranscriptionSegment& Segment = Segments.Add_GetRef(PieceSegment);
+			Segment.start += Offset;
+			Segment.end += Offset;
+		}
+
+		const FString Trimmed = Piece.Text.TrimStartAndEnd();
+		if (!Trimmed.IsEmpty())
+		{
+			if (Text.Len() > 0)
+			{
+				Text << TEXT(' ');
+			}
+			Text << Trimmed;
+		}
+	}
+
+	FCallback FinishedCallback = MoveTemp(Callback);
+	Callback = nullptr;
+	OnProgress = nullptr;
+	if (FinishedCallback)
+	{
+		FinishedCallback(Segments, FString(Text.ToView()), ErrorMessage, Success);
+	}
+
+	RemoveFromRoot();
+	ConditionalBeginDestroy();
+}
+
+void UOpenAILongTranscription::Cancel()
+{
+	bFinished = true;
+	Callback = nullptr;
+	OnProgress = nullptr;
+	for (TPair<int32, TSharedRef<IHttpRequest, ESPMode::ThreadSafe>>& Pair : InFlight)
+	{
+		Pair.Value->OnProcessRequestComplete().Unbind();
+		Pair.Value->CancelRequest();
+	}
+	InFlight.Empty();
+	RemoveFromRoot();
+	ConditionalBeginDestroy();
+}
+
+void UOpenAILongTranscription::BeginDestroy()
+{
+	for (TPair<int32, TSharedRef<IHttpRequest, ESPMode::ThreadSafe>>& Pair : InFlight)
+	{
+		Pair.Value->OnProcessRequestComplete().Unbind();
+		Pair.Value->CancelRequest();
+	}
+	InFlight.Empty();
+	Super::BeginDestroy();
+}
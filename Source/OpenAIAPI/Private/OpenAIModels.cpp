@@ -0,0 +1,163 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIModels.h"
+
+namespace
+{
+	constexpr EOATokenizerEncoding CL100K = EOATokenizerEncoding::CL100K_BASE;
+	constexpr EOATokenizerEncoding O200K = EOATokenizerEncoding::O200K_BASE;
+
+	// Indexed by EOAChatEngineType; keep in enum order
+	constexpr FOpenAIModelInfo ChatModels[] =
+	{
+		{ TEXT("gpt-3.5-turbo"), 16385, 4096, CL100K, 0.50, 0.50, 1.50 },
+		{ TEXT("gpt-4"), 8192, 8192, CL100K, 30.0, 30.0, 60.0 },
+		{ TEXT("gpt-4-32k"), 32768, 8192, CL100K, 60.0, 60.0, 120.0 },
+		{ TEXT("gpt-4-0125-preview"), 128000, 4096, CL100K, 10.0, 10.0, 30.0 },
+		{ TEXT("gpt-4o"), 128000, 16384, O200K, 2.50, 1.25, 10.0 },
+		{ TEXT("gpt-4o-mini"), 128000, 16384, O200K, 0.15, 0.075, 0.60 },
+	};
+	static_assert(UE_ARRAY_COUNT(ChatModels) == (int32)EOAChatEngineType::GPT_4o_mini + 1, "Every chat model needs a registry entry");
+
+	// Indexed by EOACompletionsEngineType. The legacy models are retired and have no price
+	constexpr FOpenAIModelInfo CompletionsModels[] =
+	{
+		{ TEXT("davinci"), 2049, 2048, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("curie"), 2049, 2048, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("babbage"), 2049, 2048, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("ada"), 2049, 2048, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("text-davinci-002"), 4097, 4096, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("text-curie-001"), 2049, 2048, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("text-babbage-001"), 2049, 2048, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("text-ada-001"), 2049, 2048, CL100K, 0.0, 0.0, 0.0 },
+		{ TEXT("text-davinci-003"), 4097, 4096, CL100K, 0.0, 0.0, 0.0 },
+	};
+	static_assert(UE_ARRAY_COUNT(CompletionsModels) == (int32)EOACompletionsEngineType::TEXT_DAVINCI_003 + 1, "Every completions model needs a registry entry");
+
+	// Indexed by EEmbeddingEngineType
+	constexpr FOpenAIModelInfo EmbeddingModels[] =
+	{
+		{ TEXT("text-embedding-3-small"), 8191, 0, CL100K, 0.02, 0.02, 0.0 },
+		{ TEXT("text-embedding-3-large"), 8191, 0, CL100K, 0.13, 0.13, 0.0 },
+		{ TEXT("text-embedding-ada-002"), 8191, 0, CL100K, 0.10, 0.10, 0.0 },
+	};
+	static_assert(UE_ARRAY_COUNT(EmbeddingModels) == (int32)EEmbeddingEngineType::TEXT_EMBEDDING_ADA_002 + 1, "Every embedding model needs a registry entry");
+
+	// Models without an enum value, reachable by id only
+	constexpr FOpenAIModelInfo NamedModels[] =
+	{
+		{ TEXT("gpt-4-turbo"), 128000, 4096, CL100K, 10.0, 10.0, 30.0 },
+		{ TEXT("gpt-4.1"), 1047576, 32768, O200K, 2.00, 0.50, 8.00 },
+		{ TEXT("gpt-4.1-mini"), 1047576, 32768, O200K, 0.40, 0.10, 1.60 },
+		{ TEXT("gpt-4.1-nano"), 1047576, 32768, O200K, 0.10, 0.025, 0.40 },
+		{ TEXT("o1"), 200000, 100000, O200K, 15.0, 7.50, 60.0 },
+		{ TEXT("o3"), 200000, 100000, O200K, 2.00, 0.50, 8.00 },
+		{ TEXT("o3-mini"), 200000, 100000, O200K, 1.10, 0.55, 4.40 },
+		{ TEXT("o4-mini"), 200000, 100000, O200K, 1.10, 0.275, 4.40 },
+	};
+
+	// Unknown ids are most likely models newer than this table
+	constexpr FOpenAIModelInfo DefaultModel = { TEXT(""), 128000, 16384, O200K, 0.0, 0.0, 0.0 };
+
+	constexpr const TCHAR* ImageSizes[] = { TEXT("256x256"), TEXT("512x512"), TEXT("1024x1024") };
+	static_assert(UE_ARRAY_COUNT(ImageSizes) == (int32)EOAImageSize::LARGE + 1, "Every image size needs a string");
+
+	constexpr const TCHAR* SpeechModels[] = { TEXT("tts-1"), TEXT("tts-1-hd") };
+	static_assert(UE_ARRAY_COUNT(SpeechModels) == (int32)EOASpeechEngineType::TTS_1_HD + 1, "Every speech model needs an id");
+
+	constexpr const TCHAR* SpeechVoices[] = { TEXT("alloy"), TEXT("echo"), TEXT("shimmer"), TEXT("ballad"), TEXT("ash"), TEXT("coral"), TEXT("sage"), TEXT("verse") };
+	static_assert(UE_ARRAY_COUNT(SpeechVoices) == (int32)EOASpeechVoice::VERSE + 1, "Every voice needs a name");
+
+	// Name is Entry's id, or starts with it followed by a snapshot suffix such as "-2024-08-06"
+	int32 MatchLength(FStringView Name, const FOpenAIModelInfo& Entry)
+	{
+		const FStringView Id(Entry.Name);
+		if (!Name.StartsWith(Id, ESearchCase::CaseSensitive))
+		{
+			return 0;
+		}
+		return Name.Len() == Id.Len() || Name[Id.Len()] == TEXT('-') ? Id.Len() : 0;
+	}
+}
+
+const FOpenAIModelInfo& FOpenAIModels::Get(EOAChatEngineType Model)
+{
+	return ChatModels[FMath::Min((int32)Model, (int32)UE_ARRAY_COUNT(ChatModels) - 1)];
+}
+
+const FOpenAIModelInfo& FOpenAIModels::Get(EOACompletionsEngineType Model)
+{
+	return CompletionsModels[FMath::Min((int32)Model, (int32)UE_ARRAY_COUNT(CompletionsModels) - 1)];
+}
+
+const FOpenAIModelInfo& FOpenAIModels::Get(EEmbeddingEngineType Model)
+{
+	return EmbeddingModels[FMath::Min((int32)Model, (int32)UE_ARRAY_COUNT(EmbeddingModels) - 1)];
+}
+
+const FOpenAIModelInfo& FOpenAIModels::Get(const FChatSettings& ChatSettings)
+{
+	return ChatSettings.modelName.IsEmpty() ? Get(ChatSettings.model) : Find(ChatSettings.modelName);
+}
+
+const FOpenAIModelInfo& FOpenAIModels::Get(const FEmbeddingSettings& EmbeddingSettings)
+{
+	return EmbeddingSettings.modelName.IsEmpty() ? Get(EmbeddingSettings.model) : Find(EmbeddingSettings.modelName);
+}
+
+const FOpenAIModelInfo& FOpenAIModels::Find(FStringView Name)
+{
+	const FOpenAIModelInfo* Best = &DefaultModel;
+	int32 BestLength = 0;
+	auto Search = [Name, &Best, &BestLength](TArrayView<const FOpenAIModelInfo> Models)
+	{
+		for (const FOpenAIModelInfo& Entry : Models)
+		{
+			const int32 Length = MatchLength(Name, Entry);
+			if (Length > BestLength)
+			{
+				Best = &Entry;
+				BestLength = Length;
+			}
+		}
+	};
+
+	Search(MakeArrayView(ChatModels));
+	Search(MakeArrayView(NamedModels));
+	Search(MakeArrayView(EmbeddingModels));
+	Search(MakeArrayView(CompletionsModels));
+	return *Best;
+}
+
+FString FOpenAIModels::GetModelName(const FChatSettings& ChatSettings)
+{
+	return ChatSettings.modelName.IsEmpty() ? FString(Get(ChatSettings.model).Name) : ChatSettings.modelName;
+}
+
+FString FOpenAIModels::GetModelName(const FEmbeddingSettings& EmbeddingSettings)
+{
+	return EmbeddingSettings.modelName.IsEmpty() ? FString(Get(EmbeddingSettings.model).Name) : EmbeddingSettings.modelName;
+}
+
+const TCHAR* FOpenAIModels::GetImageSize(EOAImageSize Size)
+{
+	return ImageSizes[FMath::Min((int32)Size, (int32)UE_ARRAY_COUNT(ImageSizes) - 1)];
+}
+
+const TCHAR* FOpenAIModels::GetModelName(EOASpeechEngineType Model)
+{
+	return SpeechModels[FMath::Min((int32)Model, (int32)UE_ARRAY_COUNT(SpeechModels) - 1)];
+}
+
+const TCHAR* FOpenAIModels::GetVoiceName(EOASpeechVoice Voice)
+{
+	return SpeechVoices[FMath::Min((int32)Voice, (int32)UE_ARRAY_COUNT(SpeechVoices) - 1)];
+}
+
+double FOpenAIModels::EstimateCost(const FOpenAIModelInfo& Model, const FChatUsage& Usage)
+{
+	const int32 CachedTokens = FMath::Min(Usage.cachedTokens, Usage.promptTokens);
+	return ((Usage.promptTokens - CachedTokens) * Model.InputPrice
+		+ CachedTokens * Model.CachedInputPrice
+		+ Usage.completionTokens * Model.OutputPrice) / 1000000.0;
+}
@@ -0,0 +1,171 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIMultipartBody.h"
+#include "HAL/FileManager.h"
+#include "Algo/BinarySearch.h"
+
+FOpenAIMultipartBody::FOpenAIMultipartBody()
+	: Boundary(TEXT("openai-") + FGuid::NewGuid().ToString(EGuidFormats::Digits))
+	, Size(0)
+	, Pos(0)
+	, bFinished(false)
+	, OpenPart(INDEX_NONE)
+{
+	SetIsLoading(true);
+}
+
+FOpenAIMultipartBody::~FOpenAIMultipartBody()
+{
+	Close();
+}
+
+FOpenAIMultipartBody::FPart& FOpenAIMultipartBody::AddPart(int64 Num)
+{
+	check(!bFinished);
+	FPart& Part = Parts.AddDefaulted_GetRef();
+	Part.Start = Size;
+	Part.Num = Num;
+	Size += Num;
+	return Part;
+}
+
+void FOpenAIMultipartBody::AppendText(FStringView Text)
+{
+	const FTCHARToUTF8 Utf8(Text.GetData(), Text.Len());
+
+	// Consecutive text goes into one part so a read rarely has to cross parts
+	if (Parts.Num() > 0 && Parts.Last().Path.IsEmpty())
+	{
+		FPart& Part = Parts.Last();
+		Part.Bytes.Append((const uint8*)Utf8.Get(), Utf8.Length());
+		Part.Num += Utf8.Length();
+		Size += Utf8.Length();
+		return;
+	}
+	AddPart(Utf8.Length()).Bytes.Append((const uint8*)Utf8.Get(), Utf8.Length());
+}
+
+void FOpenAIMultipartBody::AppendPartHeader(FStringView Name, FStringView FileName, FStringView ContentType)
+{
+	TStringBuilder<256> Header;
+	Header << TEXT("--") << Boundary << TEXT("\r\nContent-Disposition: form-data; name=\"") << Name << TEXT("\"");
+	if (!FileName.IsEmpty())
+	{
+		Header << TEXT("; filename=\"") << FileName << TEXT("\"");
+	}
+	Header << TEXT("\r\n");
+	if (!ContentType.IsEmpty())
+	{
+		Header << TEXT("Content-Type: ") << ContentType << TEXT("\r\n");
+	}
+	Header << TEXT("\r\n");
+	AppendText(Header);
+}
+
+void FOpenAIMultipartBody::AddField(FStringView Name, FStringView Value)
+{
+	AppendPartHeader(Name, FStringView(), FStringView());
+	AppendText(Value);
+	AppendText(TEXT("\r\n"));
+}
+
+bool FOpenAIMultipartBody::AddFile(FStringView Name, const FString& Path, FStringView FileName, FStringView ContentType)
+{
+	const int64 FileSize = IFileManager::Get().FileSize(*Path);
+	if (FileSize < 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cannot upload %s, the file does not exist"), *Path);
+		return false;
+	}
+
+	AppendPartHeader(Name, FileName, ContentType);
+	AddPart(FileSize).Path = Path;
+	AppendText(TEXT("\r\n"));
+	return true;
+}
+
+void FOpenAIMultipartBody::AddFile(FStringView Name, TArray<uint8>&& Data, FStringView FileName, FStringView ContentType)
+{
+	AppendPartHeader(Name, FileName, ContentType);
+	// Own part, so the data is moved in rather than copied onto the header text
+	FPart& Part = AddPart(Data.Num());
+	Part.Bytes = MoveTemp(Data);
+	AppendText(TEXT("\r\n"));
+}
+
+void FOpenAIMultipartBody::Finish()
+{
+	if (!bFinished)
+	{
+		AppendText(FString::Printf(TEXT("--%s--\r\n"), *Boundary));
+		bFinished = true;
+	}
+}
+
+FString FOpenAIMultipartBody::GetContentType() const
+{
+	return TEXT("multipart/form-data; boundary=") + Boundary;
+}
+
+void FOpenAIMultipartBody::Serialize(void* Data, int64 Num)
+{
+	uint8* Out = (uint8*)Data;
+	while (Num > 0 && !IsError())
+	{
+		// Parts are contiguous and sorted by Start
+		const int32 PartIndex = Algo::UpperBoundBy(Parts, Pos, &FPart::Start) - 1;
+		if (!Parts.IsValidIndex(PartIndex) || Pos >= Size)
+		{
+			SetError();
+			break;
+		}
+
+		FPart& Part = Parts[PartIndex];
+		const int64 Offset = Pos - Part.Start;
+		const int64 Count = FMath::Min(Num, Part.Num - Offset);
+		if (Part.Path.IsEmpty())
+		{
+			FMemory::Memcpy(Out, Part.Bytes.GetData() + Offset, Count);
+		}
+		else
+		{
+			if (OpenPart != PartIndex)
+			{
+				OpenFile.Reset(IFileManager::Get().CreateFileReader(*Part.Path));
+				OpenPart = PartIndex;
+			}
+			if (!OpenFile)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Upload of %s failed, the file could not be opened"), *Part.Path);
+				SetError();
+				break;
+			}
+			if (OpenFile->Tell() != Offset)
+			{
+				OpenFile->Seek(Offset);
+			}
+			OpenFile->Serialize(Out, Count);
+			if (OpenFile->IsError())
+			{
+				SetError();
+				break;
+			}
+		}
+
+		Out += Count;
+		Num -= Count;
+		Pos += Count;
+	}
+}
+
+void FOpenAIMultipartBody::Seek(int64 InPos)
+{
+	Pos = FMath::Clamp<int64>(InPos, 0, Size);
+}
+
+bool FOpenAIMultipartBody::Close()
+{
+	OpenFile.Reset();
+	OpenPart = INDEX_NONE;
+	return !IsError();
+}
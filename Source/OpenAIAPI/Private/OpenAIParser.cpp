@@ -2,10 +2,175 @@
 
 #include "OpenAIParser.h"
 #include "OpenAIUtils.h"
+#include "OpenAIJsonReader.h"
+#include "OpenAIStructuredOutput.h"
 #include "Dom/JsonObject.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/FileManager.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	bool ReadOptionalString(FOpenAIJsonReader& Reader, FString& OutValue)
+	{
+		return Reader.TryReadNull() || Reader.ReadString(OutValue);
+	}
+
+	// Reads the "error" member of a failed request into "Api error: <message>"
+	void ReadApiError(FOpenAIJsonReader& Reader, FString& OutError)
+	{
+		FString Message;
+		if (Reader.Peek() == EOpenAIJsonToken::ObjectStart && Reader.ReadObjectStart())
+		{
+			FAnsiStringView Key;
+			while (Reader.NextMember(Key))
+			{
+				if (Key == "message")
+				{
+					ReadOptionalString(Reader, Message);
+				}
+				else
+				{
+					Reader.Skip();
+				}
+			}
+		}
+		else
+		{
+			Reader.Skip();
+		}
+		OutError = TEXT("Api error: ") + Message;
+	}
+
+	// Reads a message's "tool_calls" array; only function calls are kept
+	void ReadToolCalls(FOpenAIJsonReader& Reader, TArray<FChatToolCall>& OutCalls)
+	{
+		if (Reader.TryReadNull() || !Reader.ReadArrayStart())
+		{
+			return;
+		}
+
+		FAnsiStringView Key;
+		while (Reader.NextElement())
+		{
+			if (!Reader.ReadObjectStart())
+			{
+				return;
+			}
+
+			FChatToolCall& Call = OutCalls.AddDefaulted_GetRef();
+			while (Reader.NextMember(Key))
+			{
+				if (Key == "id")
+				{
+					ReadOptionalString(Reader, Call.id);
+				}
+				else if (Key == "function" && Reader.ReadObjectStart())
+				{
+					while (Reader.NextMember(Key))
+					{
+						if (Key == "name")
+						{
+							ReadOptionalString(Reader, Call.name);
+						}
+						else if (Key == "arguments")
+						{
+							ReadOptionalString(Reader, Call.arguments);
+						}
+						else
+						{
+							Reader.Skip();
+						}
+					}
+				}
+				else
+				{
+					Reader.Skip();
+				}
+			}
+		}
+	}
+
+	// Reads a completion's "usage" object; a null usage leaves OutUsage as it is
+	bool ReadUsage(FOpenAIJsonReader& Reader, FChatUsage& OutUsage)
+	{
+		if (Reader.TryReadNull())
+		{
+			return true;
+		}
+		if (!Reader.ReadObjectStart())
+		{
+			return false;
+		}
+
+		FAnsiStringView Key;
+		while (Reader.NextMember(Key))
+		{
+			int64 Tokens = 0;
+			if (Key == "prompt_tokens")
+			{
+				Reader.ReadInteger(Tokens);
+				OutUsage.promptTokens = (int32)Tokens;
+			}
+			else if (Key == "completion_tokens")
+			{
+				Reader.ReadInteger(Tokens);
+				OutUsage.completionTokens = (int32)Tokens;
+			}
+			else if (Key == "total_tokens")
+			{
+				Reader.ReadInteger(Tokens);
+				OutUsage.totalTokens = (int32)Tokens;
+			}
+			else if (Key == "prompt_tokens_details")
+			{
+				if (Reader.TryReadNull())
+				{
+					continue;
+				}
+				if (!Reader.ReadObjectStart())
+				{
+					break;
+				}
+				while (Reader.NextMember(Key))
+				{
+					if (Key == "cached_tokens")
+					{
+						Reader.ReadInteger(Tokens);
+						OutUsage.cachedTokens = (int32)Tokens;
+					}
+					else
+					{
+						Reader.Skip();
+					}
+				}
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+		return true;
+	}
+
+	bool FinishDecode(const FOpenAIJsonReader& Reader, FString& OutError)
+	{
+		if (Reader.HasError() && OutError.IsEmpty())
+		{
+			OutError = FString::Printf(TEXT("Malformed response at byte %d"), Reader.GetErrorOffset());
+		}
+		return OutError.IsEmpty();
+	}
+}
 
 
 // Constructor
+OpenAIParser::OpenAIParser()
+{
+}
+
 OpenAIParser::OpenAIParser(const FCompletionSettings& settings)
 	: completionSettings(settings)
 {
@@ -62,8 +227,8 @@ FChatCompletion OpenAIParser::ParseChatCompletion(const FJsonObject& json)
 	TSharedPtr<FJsonValue> choice = choices[0];
 	TSharedPtr<FJsonObject> messageObject = choice->AsObject()->GetObjectField("message");
 	message.content = messageObject->GetStringField("content");
-	//res.index = json.GetIntegerField(TEXT("index"));
-	json.TryGetStringField(TEXT("finish_reason"), res.finishReason);
+	choice->AsObject()->TryGetNumberField(TEXT("index"), res.index);
+	choice->AsObject()->TryGetStringField(TEXT("finish_reason"), res.finishReason);
 	res.message = message;
 	
 	return res;
@@ -135,3 +300,701 @@ FString OpenAIParser::ParseGeneratedImage(FJsonObject& json)
 
 	return res;
 }
+
+// decodes the first choice of a chat completion.
+bool OpenAIParser::DecodeChatCompletion(TArrayView<const uint8> Body, FChatCompletion& OutCompletion, FString& OutError)
+{
+	TArray<FChatCompletion> choices;
+	FChatUsage usage;
+	const bool bSuccess = DecodeChatCompletions(Body, choices, usage, OutError);
+	OutCompletion = choices.Num() > 0 ? choices[0] : FChatCompletion();
+	OutCompletion.message.role = EOAChatRole::ASSISTANT;
+	return bSuccess;
+}
+
+// decodes one event of a streamed chat completion: the first choice's content delta and finish reason, and usage in the last event.
+bool OpenAIParser::DecodeChatCompletionChunk(TArrayView<const uint8> Event, FString& OutDelta, FString& OutFinishReason, FChatUsage& OutUsage, FString& OutError)
+{
+	OutDelta.Reset();
+	OutError.Reset();
+
+	FOpenAIJsonReader Reader(Event);
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "choices")
+			{
+				if (!Reader.ReadArrayStart())
+				{
+					break;
+				}
+
+				while (Reader.NextElement())
+				{
+					if (!Reader.ReadObjectStart())
+					{
+						break;
+					}
+
+					// other choices are interleaved with the first; only the first is spoken for
+					int64 Index = 0;
+					FString Content;
+					FString FinishReason;
+					while (Reader.NextMember(Key))
+					{
+						if (Key == "delta" && Reader.ReadObjectStart())
+						{
+							while (Reader.NextMember(Key))
+							{
+								if (Key == "content")
+								{
+									ReadOptionalString(Reader, Content);
+								}
+								else
+								{
+									Reader.Skip();
+								}
+							}
+						}
+						else if (Key == "index")
+						{
+							Reader.ReadInteger(Index);
+						}
+						else if (Key == "finish_reason")
+						{
+							ReadOptionalString(Reader, FinishReason);
+						}
+						else
+						{
+							Reader.Skip();
+						}
+					}
+					if (Index == 0)
+					{
+						OutDelta += Content;
+						if (!FinishReason.IsEmpty())
+						{
+							OutFinishReason = FinishReason;
+						}
+					}
+				}
+			}
+			else if (Key == "usage")
+			{
+				if (!ReadUsage(Reader, OutUsage))
+				{
+					break;
+				}
+			}
+			else if (Key == "error")
+			{
+				ReadApiError(Reader, OutError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+	return FinishDecode(Reader, OutError);
+}
+
+// decodes every choice of a chat completion and the token usage in one pass.
+bool OpenAIParser::DecodeChatCompletions(TArrayView<const uint8> Body, TArray<FChatCompletion>& OutChoices, FChatUsage& OutUsage, FString& OutError)
+{
+	return DecodeChatCompletions(Body, OutChoices, OutUsage, OutError, nullptr);
+}
+
+// as above, decoding the first choice's JSON content into the response struct without a DOM.
+bool OpenAIParser::DecodeChatCompletions(TArrayView<const uint8> Body, TArray<FChatCompletion>& OutChoices, FChatUsage& OutUsage, FString& OutError, void* OutStructured)
+{
+	const UScriptStruct* StructuredType = OutStructured ? chatSettings.responseStruct.Get() : nullptr;
+	bool bStructuredDecoded = false;
+	FString Refusal;
+
+	OutChoices.Reset();
+	OutUsage = {};
+	OutError.Reset();
+
+	FOpenAIJsonReader Reader(Body);
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "choices")
+			{
+				if (!Reader.ReadArrayStart())
+				{
+					break;
+				}
+
+				while (Reader.NextElement())
+				{
+					if (!Reader.ReadObjectStart())
+					{
+						break;
+					}
+
+					FChatCompletion& Choice = OutChoices.AddDefaulted_GetRef();
+					Choice.message.role = EOAChatRole::ASSISTANT;
+					Choice.index = OutChoices.Num() - 1;
+					while (Reader.NextMember(Key))
+					{
+						if (Key == "message" && Reader.ReadObjectStart())
+						{
+							while (Reader.NextMember(Key))
+							{
+								if (Key == "content" && StructuredType && OutChoices.Num() == 1 && Reader.Peek() == EOpenAIJsonToken::String)
+								{
+									// the content is JSON text inside a string; unescape it to UTF-8 and decode that
+									TArray<uint8> Content;
+									if (Reader.ReadUtf8String(Content))
+									{
+										bStructuredDecoded = FOpenAIStructuredOutput::Decode(Content, StructuredType, OutStructured);
+										if (!bStructuredDecoded)
+										{
+											OutError = FString::Printf(TEXT("Reply does not match %s"), *StructuredType->GetName());
+										}
+										const FUTF8ToTCHAR Converted((const ANSICHAR*)Content.GetData(), Content.Num());
+										Choice.message.content = FString(Converted.Length(), Converted.Get());
+									}
+								}
+								else if (Key == "content")
+								{
+									ReadOptionalString(Reader, Choice.message.content);
+								}
+								else if (Key == "refusal" && OutChoices.Num() == 1)
+								{
+									ReadOptionalString(Reader, Refusal);
+								}
+								else if (Key == "tool_calls")
+								{
+									ReadToolCalls(Reader, Choice.message.toolCalls);
+								}
+								else
+								{
+									Reader.Skip();
+								}
+							}
+						}
+						else if (Key == "index")
+						{
+							int64 Index = 0;
+							Reader.ReadInteger(Index);
+							Choice.index = (int32)Index;
+						}
+						else if (Key == "finish_reason")
+						{
+							ReadOptionalString(Reader, Choice.finishReason);
+						}
+						else
+						{
+							Reader.Skip();
+						}
+					}
+				}
+			}
+			else if (Key == "usage")
+			{
+				if (!ReadUsage(Reader, OutUsage))
+				{
+					break;
+				}
+			}
+			else if (Key == "error")
+			{
+				ReadApiError(Reader, OutError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+
+	// The API lists choices in order, but index is what callers select by
+	OutChoices.StableSort([](const FChatCompletion& A, const FChatCompletion& B) { return A.index < B.index; });
+
+	// a turn that only calls tools has no content yet, anything else must have filled the struct
+	const bool bCalledTools = OutChoices.Num() > 0 && OutChoices[0].message.toolCalls.Num() > 0;
+	if (StructuredType && !bStructuredDecoded && !bCalledTools && OutError.IsEmpty() && !Reader.HasError())
+	{
+		OutError = Refusal.IsEmpty() ? FString::Printf(TEXT("Reply has no %s"), *StructuredType->GetName()) : TEXT("Refused: ") + Refusal;
+	}
+
+	return FinishDecode(Reader, OutError);
+}
+
+// decodes the response info and every completion choice.
+bool OpenAIParser::DecodeCompletions(TArrayView<const uint8> Body, TArray<FCompletion>& OutCompletions, FCompletionInfo& OutInfo, FString& OutError)
+{
+	OutCompletions.Reset();
+	OutInfo = {};
+	OutError.Reset();
+
+	FOpenAIJsonReader Reader(Body);
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "id")
+			{
+				ReadOptionalString(Reader, OutInfo.id);
+			}
+			else if (Key == "object")
+			{
+				ReadOptionalString(Reader, OutInfo.object);
+			}
+			else if (Key == "model")
+			{
+				ReadOptionalString(Reader, OutInfo.model);
+			}
+			else if (Key == "created")
+			{
+				int64 Created = 0;
+				Reader.ReadInteger(Created);
+				OutInfo.created = FDateTime::FromUnixTimestamp(Created);
+			}
+			else if (Key == "choices")
+			{
+				if (!Reader.ReadArrayStart())
+				{
+					break;
+				}
+
+				while (Reader.NextElement())
+				{
+					if (!Reader.ReadObjectStart())
+					{
+						break;
+					}
+
+					FCompletion& Completion = OutCompletions.AddDefaulted_GetRef();
+					while (Reader.NextMember(Key))
+					{
+						if (Key == "text")
+						{
+							ReadOptionalString(Reader, Completion.text);
+						}
+						else if (Key == "index")
+						{
+							int64 Index = 0;
+							Reader.ReadInteger(Index);
+							Completion.index = (int32)Index;
+						}
+						else if (Key == "finish_reason")
+						{
+							ReadOptionalString(Reader, Completion.finishReason);
+						}
+						else
+						{
+							Reader.Skip();
+						}
+					}
+					Completion.text += completionSettings.injectRestartText;
+				}
+			}
+			else if (Key == "error")
+			{
+				ReadApiError(Reader, OutError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+
+	return FinishDecode(Reader, OutError);
+}
+
+// decodes the URL of every generated image.
+bool OpenAIParser::DecodeGeneratedImages(TArrayView<const uint8> Body, TArray<FString>& OutUrls, FString& OutError)
+{
+	TArray<TArray<uint8>> Base64Images;
+	return DecodeGeneratedImages(Body, OutUrls, Base64Images, OutError);
+}
+
+// decodes every generated image, as a URL or as base64 text when b64_json was asked for, one entry in each per image.
+bool OpenAIParser::DecodeGeneratedImages(TArrayView<const uint8> Body, TArray<FString>& OutUrls, TArray<TArray<uint8>>& OutBase64Images, FString& OutError)
+{
+	OutUrls.Reset();
+	OutBase64Images.Reset();
+	OutError.Reset();
+
+	FOpenAIJsonReader Reader(Body);
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "data")
+			{
+				if (!Reader.ReadArrayStart())
+				{
+					break;
+				}
+
+				while (Reader.NextElement())
+				{
+					if (!Reader.ReadObjectStart())
+					{
+						break;
+					}
+
+					FString& Url = OutUrls.AddDefaulted_GetRef();
+					TArray<uint8>& Base64 = OutBase64Images.AddDefaulted_GetRef();
+					while (Reader.NextMember(Key))
+					{
+						if (Key == "url")
+						{
+							ReadOptionalString(Reader, Url);
+						}
+						else if (Key == "b64_json")
+						{
+							// megabytes of text; kept as UTF-8 for the image decoder
+							if (!Reader.TryReadNull())
+							{
+								Reader.ReadUtf8String(Base64);
+							}
+						}
+						else
+						{
+							Reader.Skip();
+						}
+					}
+				}
+			}
+			else if (Key == "error")
+			{
+				ReadApiError(Reader, OutError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+
+	return FinishDecode(Reader, OutError);
+}
+
+// reads the first vector of an /embeddings response straight into the result.
+bool OpenAIParser::DecodeEmbedding(TArrayView<const uint8> Body, FEmbeddingResult& OutResult, FString& OutError)
+{
+	TArray<float>& Components = OutResult.embeddingVector.Components;
+	Components.Reset();
+	OutError.Reset();
+	bool bFound = false;
+
+	FOpenAIJsonReader Reader(Body);
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "data")
+			{
+				if (!Reader.ReadArrayStart())
+				{
+					break;
+				}
+
+				while (Reader.NextElement())
+				{
+					if (bFound || !Reader.ReadObjectStart())
+					{
+						Reader.Skip();
+						continue;
+					}
+
+					while (Reader.NextMember(Key))
+					{
+						if (Key == "embedding" && Reader.ReadArrayStart())
+						{
+							// text-embedding-3-large has 3072 dimensions; grow once rather than per component
+							Components.Reserve(3072);
+							double Component = 0.0;
+							while (Reader.NextElement() && Reader.ReadNumber(Component))
+							{
+								Components.Add((float)Component);
+							}
+							bFound = true;
+						}
+						else
+						{
+							Reader.Skip();
+						}
+					}
+				}
+			}
+			else if (Key == "error")
+			{
+				ReadApiError(Reader, OutError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+
+	if (!bFound && OutError.IsEmpty() && !Reader.HasError())
+	{
+		OutError = TEXT("Response has no embedding");
+	}
+	return FinishDecode(Reader, OutError);
+}
+
+// reads the "text" of an /audio/transcriptions json response.
+bool OpenAIParser::DecodeTranscription(TArrayView<const uint8> Body, FString& OutText, FString& OutError)
+{
+	TArray<FTranscriptionSegment> Segments;
+	return DecodeTranscription(Body, OutText, Segments, OutError);
+}
+
+// as above, also reading the timed "segments" of a verbose_json response.
+bool OpenAIParser::DecodeTranscription(TArrayView<const uint8> Body, FString& OutText, TArray<FTranscriptionSegment>& OutSegments, FString& OutError)
+{
+	OutText.Reset();
+	OutSegments.Reset();
+	OutError.Reset();
+	bool bFound = false;
+
+	FOpenAIJsonReader Reader(Body);
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "text")
+			{
+				bFound = ReadOptionalString(Reader, OutText);
+			}
+			else if (Key == "segments" && Reader.Peek() == EOpenAIJsonToken::ArrayStart)
+			{
+				Reader.ReadArrayStart();
+				while (Reader.NextElement())
+				{
+					if (!Reader.ReadObjectStart())
+					{
+						break;
+					}
+
+					FTranscriptionSegment& Segment = OutSegments.AddDefaulted_GetRef();
+					while (Reader.NextMember(Key))
+					{
+						double Seconds = 0.0;
+						if (Key == "start" && Reader.ReadNumber(Seconds))
+						{
+							Segment.start = (float)Seconds;
+						}
+						else if (Key == "end" && Reader.ReadNumber(Seconds))
+						{
+							Segment.end = (float)Seconds;
+						}
+						else if (Key == "text")
+						{
+							ReadOptionalString(Reader, Segment.text);
+						}
+						else if (Key != "start" && Key != "end")
+						{
+							Reader.Skip();
+						}
+					}
+				}
+			}
+			else if (Key == "error")
+			{
+				ReadApiError(Reader, OutError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+
+	if (!bFound && OutError.IsEmpty() && !Reader.HasError())
+	{
+		OutError = TEXT("Failed to get 'text' field from JSON response");
+	}
+	return FinishDecode(Reader, OutError);
+}
+
+// reads the "error" of a failed request to an endpoint that returns audio or other binary data.
+bool OpenAIParser::DecodeError(TArrayView<const uint8> Body, FString& OutError)
+{
+	OutError.Reset();
+
+	FOpenAIJsonReader Reader(Body);
+	FAnsiStringView Key;
+	if (Reader.ReadObjectStart())
+	{
+		while (Reader.NextMember(Key))
+		{
+			if (Key == "error")
+			{
+				ReadApiError(Reader, OutError);
+			}
+			else
+			{
+				Reader.Skip();
+			}
+		}
+	}
+	return !OutError.IsEmpty();
+}
+
+#if !UE_BUILD_SHIPPING
+
+namespace
+{
+	// What one decode leaves in memory: the DOM, when there is one, and the parsed structs
+	struct FDecodedResponse
+	{
+		TSharedPtr<FJsonObject> Dom;
+		FChatCompletion Chat;
+		FCompletionInfo Info;
+		TArray<FCompletion> Completions;
+		TArray<FString> Urls;
+	};
+
+	struct FParseBenchResult
+	{
+		double Seconds = 0.0;
+		// Bytes allocated by one decode and still held at its end, or -1 when LLM is off
+		int64 Bytes = -1;
+	};
+
+	// Times Iterations decodes, then makes one more under the LLM tag TagName and reads the tag
+	// while its result is held. The allocator itself is left alone; the bytes need -llm.
+	template <typename FuncType>
+	FParseBenchResult RunParseBench(int32 Iterations, FName TagName, FuncType&& Func)
+	{
+		FParseBenchResult Result;
+		const double Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			Func();
+		}
+		Result.Seconds = FPlatformTime::Seconds() - Start;
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		if (FLowLevelMemTracker::IsEnabled())
+		{
+			// tag amounts are gathered from the threads once a frame, so they are gathered here as well
+			FLowLevelMemTracker& Tracker = FLowLevelMemTracker::Get();
+			Tracker.UpdateStatsPerFrame();
+			const int64 Before = Tracker.GetTagAmountForTracker(ELLMTracker::Default, TagName, ELLMTagSet::None);
+			{
+				FLLMScope Scope(TagName, false, ELLMTagSet::None, ELLMTracker::Default);
+				const FDecodedResponse Held = Func();
+				Tracker.UpdateStatsPerFrame();
+				Result.Bytes = Tracker.GetTagAmountForTracker(ELLMTracker::Default, TagName, ELLMTagSet::None) - Before;
+			}
+		}
+#endif
+		return Result;
+	}
+
+	FString FormatBenchBytes(int64 Bytes)
+	{
+		return Bytes >= 0 ? FString::Printf(TEXT("%lld B held"), Bytes) : FString(TEXT("run with -llm for memory"));
+	}
+
+	// Compares the DOM path the call nodes used to take against the typed decoders
+	void BenchmarkParser(const TArray<FString>& Args)
+	{
+		const FString Directory = Args.Num() > 0 ? Args[0] : FPaths::ProjectSavedDir() / TEXT("OpenAIResponses");
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 1000;
+
+		TArray<FString> Files;
+		IFileManager::Get().FindFiles(Files, *(Directory / TEXT("*.json")), true, false);
+		if (Files.Num() == 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No recorded responses (*.json) in %s"), *Directory);
+			return;
+		}
+
+		OpenAIParser Parser(FCompletionSettings{});
+		for (const FString& File : Files)
+		{
+			TArray<uint8> Body;
+			if (!FFileHelper::LoadFileToArray(Body, *(Directory / File)))
+			{
+				continue;
+			}
+
+			const FUTF8ToTCHAR Probe((const ANSICHAR*)Body.GetData(), Body.Num());
+			const FString Text(Probe.Length(), Probe.Get());
+			const bool bChat = Text.Contains(TEXT("\"chat.completion\""));
+			const bool bCompletion = Text.Contains(TEXT("\"text_completion\""));
+
+			const FParseBenchResult Dom = RunParseBench(Iterations, TEXT("OpenAI/BenchmarkParser/DOM"), [&]()
+			{
+				// What GetContentAsString() and the DOM parse cost per response
+				FDecodedResponse Decoded;
+				const FUTF8ToTCHAR Converted((const ANSICHAR*)Body.GetData(), Body.Num());
+				TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(FString(Converted.Length(), Converted.Get()));
+				if (FJsonSerializer::Deserialize(Reader, Decoded.Dom) && Decoded.Dom.IsValid())
+				{
+					if (bChat)
+					{
+						Decoded.Chat = Parser.ParseChatCompletion(*Decoded.Dom);
+					}
+					else if (bCompletion)
+					{
+						Decoded.Info = Parser.ParseGPTCompletionInfo(*Decoded.Dom);
+						for (const TSharedPtr<FJsonValue>& Choice : Decoded.Dom->GetArrayField(TEXT("choices")))
+						{
+							Decoded.Completions.Add(Parser.ParseCompletionsResponse(*Choice->AsObject()));
+						}
+					}
+					else
+					{
+						for (const TSharedPtr<FJsonValue>& Image : Decoded.Dom->GetArrayField(TEXT("data")))
+						{
+							Decoded.Urls.Add(Parser.ParseGeneratedImage(*Image->AsObject()));
+						}
+					}
+				}
+				return Decoded;
+			});
+
+			FString Error;
+			const FParseBenchResult Typed = RunParseBench(Iterations, TEXT("OpenAI/BenchmarkParser/Typed"), [&]()
+			{
+				FDecodedResponse Decoded;
+				if (bChat)
+				{
+					Parser.DecodeChatCompletion(Body, Decoded.Chat, Error);
+				}
+				else if (bCompletion)
+				{
+					Parser.DecodeCompletions(Body, Decoded.Completions, Decoded.Info, Error);
+				}
+				else
+				{
+					Parser.DecodeGeneratedImages(Body, Decoded.Urls, Error);
+				}
+				return Decoded;
+			});
+
+			UE_LOG(LogTemp, Display, TEXT("%s (%d bytes): DOM %.2f us, %s | typed %.2f us, %s | %.1fx"),
+				*File, Body.Num(), Dom.Seconds * 1e6 / Iterations, *FormatBenchBytes(Dom.Bytes),
+				Typed.Seconds * 1e6 / Iterations, *FormatBenchBytes(Typed.Bytes), Dom.Seconds / FMath::Max(Typed.Seconds, 1e-9));
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkParserCommand(
+		TEXT("OpenAI.BenchmarkParser"),
+		TEXT("Times the DOM and typed response decoders, and with -llm the memory one decode holds. Usage: OpenAI.BenchmarkParser [Directory of recorded *.json responses] [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkParser));
+}
+
+#endif
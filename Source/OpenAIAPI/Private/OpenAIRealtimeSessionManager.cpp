@@ -0,0 +1,217 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIRealtimeSessionManager.h"
+#include "OpenAICallRealtime.h"
+#include "Async/Async.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Misc/ConfigCacheIni.h"
+#include "HAL/PlatformMisc.h"
+
+namespace
+{
+	// Tasks one strand may run before yielding its worker to other sessions
+	constexpr int32 MaxTasksPerRun = 16;
+
+	FOpenAIRealtimeSessionManager* GSessionManager = nullptr;
+}
+
+void FOpenAIRealtimeStrand::Enqueue(TUniqueFunction<void()>&& Task)
+{
+	Tasks.Enqueue(MoveTemp(Task));
+
+	// The first pending task schedules the strand, later ones ride along
+	if (NumPending.fetch_add(1, std::memory_order_acq_rel) == 0)
+	{
+		FQueuedThreadPool* Pool = FOpenAIRealtimeSessionManager::Get().GetPool();
+		if (Pool)
+		{
+			TSharedRef<FOpenAIRealtimeStrand, ESPMode::ThreadSafe> Self = AsShared();
+			AsyncPool(*Pool, [Self]() { Self->Run(); });
+		}
+		else
+		{
+			Run();
+		}
+	}
+}
+
+void FOpenAIRealtimeStrand::Run()
+{
+	for (int32 i = 0; i < MaxTasksPerRun; i++)
+	{
+		TUniqueFunction<void()> Task;
+		if (Tasks.Dequeue(Task))
+		{
+			FScopeLock RunScope(&RunLock);
+			if (!bClosed)
+			{
+				Task();
+			}
+		}
+
+		if (NumPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			return;
+		}
+	}
+
+	// Still busy, go to the back of the pool queue so other sessions get a turn
+	FQueuedThreadPool* Pool = FOpenAIRealtimeSessionManager::Get().GetPool();
+	TSharedRef<FOpenAIRealtimeStrand, ESPMode::ThreadSafe> Self = AsShared();
+	if (Pool)
+	{
+		AsyncPool(*Pool, [Self]() { Self->Run(); });
+	}
+	else
+	{
+		Self->Run();
+	}
+}
+
+void FOpenAIRealtimeStrand::Close()
+{
+	FScopeLock RunScope(&RunLock);
+	bClosed = true;
+}
+
+FOpenAIRealtimeSessionManager& FOpenAIRealtimeSessionManager::Get()
+{
+	if (!GSessionManager)
+	{
+		GSessionManager = new FOpenAIRealtimeSessionManager();
+	}
+	return *GSessionManager;
+}
+
+FOpenAIRealtimeSessionManager::FOpenAIRealtimeSessionManager()
+	: Pool(nullptr)
+	, MaxSessions(16)
+{
+	GConfig->GetInt(TEXT("OpenAIAPI.Realtime"), TEXT("MaxSessions"), MaxSessions, GEngineIni);
+}
+
+FOpenAIRealtimeSessionManager::~FOpenAIRealtimeSessionManager()
+{
+}
+
+FQueuedThreadPool* FOpenAIRealtimeSessionManager::GetPool()
+{
+	FScopeLock ScopeLock(&Lock);
+	if (!Pool)
+	{
+		int32 NumThreads = FMath::Clamp(FPlatformMisc::NumberOfCoresIncludingHyperthreads() / 2, 2, 8);
+		GConfig->GetInt(TEXT("OpenAIAPI.Realtime"), TEXT("WorkerThreads"), NumThreads, GEngineIni);
+
+		Pool = FQueuedThreadPool::Allocate();
+		if (!Pool->Create(FMath::Max(1, NumThreads), 128 * 1024, TPri_Normal, TEXT("OpenAIRealtimePool")))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to create the realtime worker pool, running session work inline"));
+			delete Pool;
+			Pool = nullptr;
+		}
+		else
+		{
+			UE_LOG(LogTemp, Log, TEXT("Realtime worker pool created with %d threads"), NumThreads);
+		}
+	}
+	return Pool;
+}
+
+bool FOpenAIRealtimeSessionManager::RegisterSession(UOpenAICallRealtime* Session)
+{
+	check(IsInGameThread());
+	FScopeLock ScopeLock(&Lock);
+
+	if (Sessions.Contains(Session))
+	{
+		return true;
+	}
+
+	if (Sessions.Num() >= MaxSessions)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Realtime session limit of %d reached"), MaxSessions);
+		return false;
+	}
+
+	Sessions.Add(Session);
+	UE_LOG(LogTemp, Log, TEXT("Realtime session registered (%d/%d)"), Sessions.Num(), MaxSessions);
+	return true;
+}
+
+void FOpenAIRealtimeSessionManager::UnregisterSession(UOpenAICallRealtime* Session)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (Sessions.Remove(Session) > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Realtime session unregistered (%d/%d)"), Sessions.Num(), MaxSessions);
+	}
+}
+
+TSharedRef<FOpenAIRealtimeStrand, ESPMode::ThreadSafe> FOpenAIRealtimeSessionManager::CreateStrand()
+{
+	return MakeShared<FOpenAIRealtimeStrand, ESPMode::ThreadSafe>();
+}
+
+void FOpenAIRealtimeSessionManager::SetMaxSessions(int32 InMaxSessions)
+{
+	FScopeLock ScopeLock(&Lock);
+	MaxSessions = FMath::Max(1, InMaxSessions);
+}
+
+int32 FOpenAIRealtimeSessionManager::GetNumSessions() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Sessions.Num();
+}
+
+TArray<UOpenAICallRealtime*> FOpenAIRealtimeSessionManager::GetSessions() const
+{
+	FScopeLock ScopeLock(&Lock);
+	TArray<UOpenAICallRealtime*> Result;
+	for (UOpenAICallRealtime* Session : Sessions)
+	{
+		Result.Add(Session);
+	}
+	return Result;
+}
+
+void FOpenAIRealtimeSessionManager::Shutdown()
+{
+	FOpenAIRealtimeSessionManager* Manager = GSessionManager;
+	if (!Manager)
+	{
+		return;
+	}
+
+	for (UOpenAICallRealtime* Session : Manager->GetSessions())
+	{
+		if (IsValid(Session))
+		{
+			Session->StopRealtimeSession();
+		}
+	}
+
+	FQueuedThreadPool* OldPool = nullptr;
+	{
+		FScopeLock ScopeLock(&Manager->Lock);
+		Manager->Sessions.Reset();
+		OldPool = Manager->Pool;
+		Manager->Pool = nullptr;
+	}
+
+	// Drains queued work before the threads exit
+	if (OldPool)
+	{
+		OldPool->Destroy();
+		delete OldPool;
+	}
+
+	GSessionManager = nullptr;
+	delete Manager;
+}
+
+void FOpenAIRealtimeSessionManager::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	FScopeLock ScopeLock(&Lock);
+	Collector.AddReferencedObjects(Sessions);
+}
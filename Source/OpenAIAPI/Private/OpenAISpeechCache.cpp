@@ -0,0 +1,400 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAISpeechCache.h"
+#include "OpenAIModels.h"
+#include "Algo/BinarySearch.h"
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	// Pack layout: header, entry table sorted by key, then the audio, each blob 16 byte aligned.
+	// Everything is little endian, which every platform the engine ships on is.
+	constexpr uint32 PackMagic = 0x4341414F; // "OAAC"
+	constexpr uint32 PackVersion = 1;
+	constexpr int64 PackAlignment = 16;
+
+	struct FPackHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 NumEntries;
+		uint32 Reserved;
+	};
+	static_assert(sizeof(FPackHeader) == 16, "Pack header layout is part of the file format");
+
+	struct FPackEntry
+	{
+		uint64 KeyHigh;
+		uint64 KeyLow;
+		uint64 Offset;
+		uint32 Size;
+		uint8 Format;
+		uint8 Padding[3];
+	};
+	static_assert(sizeof(FPackEntry) == 32, "Pack entry layout is part of the file format");
+
+	bool KeyLess(uint64 High, uint64 Low, const FXxHash128& Key)
+	{
+		return High < Key.HashHigh || (High == Key.HashHigh && Low < Key.HashLow);
+	}
+
+	const TCHAR* GetExtension(EOASpeechResponseFormat Format)
+	{
+		return Format == EOASpeechResponseFormat::OPUS ? TEXT("ogg") : TEXT("pcm");
+	}
+
+	FString GetLooseName(const FXxHash128& Key)
+	{
+		return FString::Printf(TEXT("%016llx%016llx"), Key.HashHigh, Key.HashLow);
+	}
+}
+
+struct FOpenAISpeechCache::FMountedPack
+{
+	FString Path;
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	// Where the platform cannot map files, the whole pack is read instead
+	TArray<uint8> Loaded;
+	TArrayView<const uint8> Data;
+
+	TArrayView<const FPackEntry> GetEntries() const
+	{
+		const FPackHeader* Header = (const FPackHeader*)Data.GetData();
+		return MakeArrayView((const FPackEntry*)(Data.GetData() + sizeof(FPackHeader)), (int32)Header->NumEntries);
+	}
+};
+
+FOpenAISpeechCache::FOpenAISpeechCache()
+	: LooseDir(FPaths::ProjectSavedDir() / TEXT("OpenAISpeechCache"))
+{
+}
+
+FOpenAISpeechCache::~FOpenAISpeechCache()
+{
+	UnmountAll();
+}
+
+FOpenAISpeechCache& FOpenAISpeechCache::Get()
+{
+	static FOpenAISpeechCache Cache;
+	static bool bMountedDefault = false;
+	if (!bMountedDefault)
+	{
+		bMountedDefault = true;
+		const FString DefaultPack = FPaths::ProjectContentDir() / TEXT("OpenAI/Speech.oaspeech");
+		if (IFileManager::Get().FileExists(*DefaultPack))
+		{
+			Cache.Mount(DefaultPack);
+		}
+	}
+	return Cache;
+}
+
+FXxHash128 FOpenAISpeechCache::MakeKey(const FSpeechSettings& Settings)
+{
+	// Speed is rounded so values that differ only by float noise share audio
+	const FString Canonical = FString::Printf(TEXT("%s\n%s\n%.2f\n%s"),
+		FOpenAIModels::GetModelName(Settings.model), FOpenAIModels::GetVoiceName(Settings.voice), FMath::Clamp(Settings.speed, 0.25f, 4.0f), *Settings.input);
+	const FTCHARToUTF8 Utf8(*Canonical);
+	return FXxHash128::HashBuffer(Utf8.Get(), Utf8.Length());
+}
+
+bool FOpenAISpeechCache::Mount(const FString& PackPath)
+{
+	TUniquePtr<FMountedPack> Pack = MakeUnique<FMountedPack>();
+	Pack->Path = PackPath;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	Pack->MappedFile.Reset(PlatformFile.OpenMapped(*PackPath));
+	if (Pack->MappedFile.IsValid())
+	{
+		Pack->MappedRegion.Reset(Pack->MappedFile->MapRegion(0, Pack->MappedFile->GetFileSize()));
+	}
+	if (Pack->MappedRegion.IsValid())
+	{
+		Pack->Data = MakeArrayView(Pack->MappedRegion->GetMappedPtr(), (int32)Pack->MappedRegion->GetMappedSize());
+	}
+	else if (FFileHelper::LoadFileToArray(Pack->Loaded, *PackPath, FILEREAD_Silent))
+	{
+		Pack->Data = Pack->Loaded;
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cannot open speech pack %s"), *PackPath);
+		return false;
+	}
+
+	// The table is checked once here so lookups can trust it
+	const FPackHeader* Header = (const FPackHeader*)Pack->Data.GetData();
+	const int64 TableEnd = sizeof(FPackHeader) + (Pack->Data.Num() >= (int32)sizeof(FPackHeader) ? (int64)Header->NumEntries * sizeof(FPackEntry) : 0);
+	if (Pack->Data.Num() < (int32)sizeof(FPackHeader) || Header->Magic != PackMagic || Header->Version != PackVersion || TableEnd > Pack->Data.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is not a speech pack of version %u"), *PackPath, PackVersion);
+		return false;
+	}
+	for (const FPackEntry& Entry : Pack->GetEntries())
+	{
+		if (Entry.Offset < (uint64)TableEnd || Entry.Offset + Entry.Size > (uint64)Pack->Data.Num())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Speech pack %s is truncated"), *PackPath);
+			return false;
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Mounted speech pack %s with %u lines"), *PackPath, Header->NumEntries);
+	Packs.Add(MoveTemp(Pack));
+	return true;
+}
+
+void FOpenAISpeechCache::UnmountAll()
+{
+	// Regions must go before the file they map
+	for (TUniquePtr<FMountedPack>& Pack : Packs)
+	{
+		Pack->MappedRegion.Reset();
+		Pack->MappedFile.Reset();
+	}
+	Packs.Empty();
+}
+
+bool FOpenAISpeechCache::Find(const FXxHash128& Key, FHit& OutHit) const
+{
+	for (int32 PackIndex = Packs.Num() - 1; PackIndex >= 0; PackIndex--)
+	{
+		const FMountedPack& Pack = *Packs[PackIndex];
+		const TArrayView<const FPackEntry> Entries = Pack.GetEntries();
+		const int32 Index = Algo::LowerBound(Entries, Key, [](const FPackEntry& Entry, const FXxHash128& Value)
+		{
+			return KeyLess(Entry.KeyHigh, Entry.KeyLow, Value);
+		});
+		if (Entries.IsValidIndex(Index) && Entries[Index].KeyHigh == Key.HashHigh && Entries[Index].KeyLow == Key.HashLow)
+		{
+			const FPackEntry& Entry = Entries[Index];
+			OutHit.Audio = MakeArrayView(Pack.Data.GetData() + Entry.Offset, (int32)Entry.Size);
+			OutHit.Format = (EOASpeechResponseFormat)Entry.Format;
+			OutHit.Loaded.Empty();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FOpenAISpeechCache::FindLoose(const FXxHash128& Key, TFunction<void(FHit* Hit)> OnLoaded)
+{
+	check(IsInGameThread());
+
+	// Only a known file is read, a line of speech is a few dozen kilobytes
+	IndexLooseFiles();
+	const FString Name = GetLooseName(Key);
+	FLooseFile* File = LooseFiles.Find(Name);
+	if (!File)
+	{
+		return false;
+	}
+
+	// The time stamp keeps the eviction order across runs
+	File->LastUse = FDateTime::UtcNow();
+	const EOASpeechResponseFormat Format = File->Format;
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [this, Name, Format, Path = GetLoosePath(Key, Format), Now = File->LastUse, OnLoaded = MoveTemp(OnLoaded)]() mutable
+	{
+		TArray<uint8> Loaded;
+		const bool bRead = FFileHelper::LoadFileToArray(Loaded, *Path, FILEREAD_Silent);
+		if (bRead)
+		{
+			IFileManager::Get().SetTimeStamp(*Path, Now);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [this, Name, Format, bRead, Loaded = MoveTemp(Loaded), OnLoaded = MoveTemp(OnLoaded)]() mutable
+		{
+			if (!bRead)
+			{
+				// Deleted behind our back, or evicted while it was being read
+				if (const FLooseFile* Missing = LooseFiles.Find(Name))
+				{
+					LooseBytes -= Missing->Size;
+					LooseFiles.Remove(Name);
+				}
+				OnLoaded(nullptr);
+				return;
+			}
+
+			FHit Hit;
+			Hit.Loaded = MoveTemp(Loaded);
+			Hit.Audio = Hit.Loaded;
+			Hit.Format = Format;
+			OnLoaded(&Hit);
+		});
+	});
+	return true;
+}
+
+bool FOpenAISpeechCache::ReadLoose(const FXxHash128& Key, FHit& OutHit) const
+{
+	IndexLooseFiles();
+	const FString Name = GetLooseName(Key);
+	FLooseFile* File = LooseFiles.Find(Name);
+	if (!File)
+	{
+		return false;
+	}
+
+	const FString Path = GetLoosePath(Key, File->Format);
+	if (!FFileHelper::LoadFileToArray(OutHit.Loaded, *Path, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	OutHit.Audio = OutHit.Loaded;
+	OutHit.Format = File->Format;
+	return true;
+}
+
+void FOpenAISpeechCache::IndexLooseFiles() const
+{
+	if (bIndexed)
+	{
+		return;
+	}
+	bIndexed = true;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.IterateDirectoryStat(*LooseDir, [this](const TCHAR* Path, const FFileStatData& Stat)
+	{
+		const FString Extension = FPaths::GetExtension(Path);
+		if (!Stat.bIsDirectory && (Extension == TEXT("ogg") || Extension == TEXT("pcm")))
+		{
+			FLooseFile& File = LooseFiles.FindOrAdd(FPaths::GetBaseFilename(Path));
+			LooseBytes += Stat.FileSize - File.Size;
+			File.Format = Extension == TEXT("ogg") ? EOASpeechResponseFormat::OPUS : EOASpeechResponseFormat::PCM;
+			File.Size = Stat.FileSize;
+			File.LastUse = Stat.ModificationTime;
+		}
+		return true;
+	});
+}
+
+void FOpenAISpeechCache::AddLooseFile(const FString& Name, EOASpeechResponseFormat Format, int64 Size)
+{
+	IndexLooseFiles();
+	FLooseFile& File = LooseFiles.FindOrAdd(Name);
+	LooseBytes += Size - File.Size;
+	File.Format = Format;
+	File.Size = Size;
+	File.LastUse = FDateTime::UtcNow();
+	TrimLooseFiles();
+}
+
+void FOpenAISpeechCache::TrimLooseFiles()
+{
+	if (LooseBytes <= MaxLooseBytes)
+	{
+		return;
+	}
+
+	// Down to 90% of the cap, so the next few lines do not each delete one file
+	TArray<TPair<FString, FLooseFile>> ByAge = LooseFiles.Array();
+	ByAge.Sort([](const TPair<FString, FLooseFile>& A, const TPair<FString, FLooseFile>& B)
+	{
+		return A.Value.LastUse < B.Value.LastUse;
+	});
+
+	TArray<FString> Deleted;
+	for (const TPair<FString, FLooseFile>& Pair : ByAge)
+	{
+		if (LooseBytes <= MaxLooseBytes / 10 * 9)
+		{
+			break;
+		}
+		Deleted.Add(LooseDir / Pair.Key + TEXT(".") + GetExtension(Pair.Value.Format));
+		LooseBytes -= Pair.Value.Size;
+		LooseFiles.Remove(Pair.Key);
+	}
+
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Deleted = MoveTemp(Deleted)]()
+	{
+		for (const FString& Path : Deleted)
+		{
+			IFileManager::Get().Delete(*Path, false, false, true);
+		}
+	});
+}
+
+void FOpenAISpeechCache::Store(const FXxHash128& Key, EOASpeechResponseFormat Format, TArray<uint8>&& Audio)
+{
+	if (!bStoreMisses || Audio.Num() == 0)
+	{
+		return;
+	}
+
+	// Written to a temporary name first, so a reader never sees half a file; indexed once it is in place
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [this, Name = GetLooseName(Key), Path = GetLoosePath(Key, Format), Format, Audio = MoveTemp(Audio)]()
+	{
+		const FString TempPath = Path + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(Audio, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true, true))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Cannot write speech cache file %s"), *Path);
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [this, Name, Format, Size = (int64)Audio.Num()]()
+		{
+			AddLooseFile(Name, Format, Size);
+		});
+	});
+}
+
+FString FOpenAISpeechCache::GetLoosePath(const FXxHash128& Key, EOASpeechResponseFormat Format) const
+{
+	return LooseDir / GetLooseName(Key) + TEXT(".") + GetExtension(Format);
+}
+
+bool FOpenAISpeechCache::WritePack(const FString& Path, TArray<FEntry>& Entries)
+{
+	Entries.Sort([](const FEntry& A, const FEntry& B)
+	{
+		return KeyLess(A.Key.HashHigh, A.Key.HashLow, B.Key);
+	});
+
+	TArray<FPackEntry> Table;
+	Table.SetNumZeroed(Entries.Num());
+	int64 Offset = Align((int64)sizeof(FPackHeader) + Entries.Num() * (int64)sizeof(FPackEntry), PackAlignment);
+	for (int32 Index = 0; Index < Entries.Num(); Index++)
+	{
+		if (Index > 0 && !KeyLess(Entries[Index - 1].Key.HashHigh, Entries[Index - 1].Key.HashLow, Entries[Index].Key))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Speech pack %s lists the same line twice"), *Path);
+			return false;
+		}
+		Table[Index].KeyHigh = Entries[Index].Key.HashHigh;
+		Table[Index].KeyLow = Entries[Index].Key.HashLow;
+		Table[Index].Offset = (uint64)Offset;
+		Table[Index].Size = (uint32)Entries[Index].Audio.Num();
+		Table[Index].Format = (uint8)Entries[Index].Format;
+		Offset = Align(Offset + Entries[Index].Audio.Num(), PackAlignment);
+	}
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+	if (!Writer)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cannot write speech pack %s"), *Path);
+		return false;
+	}
+
+	FPackHeader Header = { PackMagic, PackVersion, (uint32)Entries.Num(), 0 };
+	Writer->Serialize(&Header, sizeof(Header));
+	Writer->Serialize(Table.GetData(), Table.Num() * sizeof(FPackEntry));
+
+	uint8 Zeros[PackAlignment] = {};
+	for (FEntry& Entry : Entries)
+	{
+		Writer->Serialize(Zeros, Align(Writer->Tell(), PackAlignment) - Writer->Tell());
+		Writer->Serialize(Entry.Audio.GetData(), Entry.Audio.Num());
+	}
+	return Writer->Close();
+}
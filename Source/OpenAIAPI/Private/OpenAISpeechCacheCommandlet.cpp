@@ -0,0 +1,282 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAISpeechCacheCommandlet.h"
+#include "OpenAISpeechCache.h"
+#include "OpenAICallSpeech.h"
+#include "OpenAIUtils.h"
+#include "OpenAIParser.h"
+#include "OpenAIModels.h"
+#include "OpenAIJsonWriter.h"
+#include "HttpModule.h"
+#include "HttpManager.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	constexpr float TickSeconds = 0.01f;
+	constexpr int32 MaxAttempts = 3;
+
+	template <typename EnumType>
+	bool FindByName(const FString& Name, TFunctionRef<const TCHAR*(EnumType)> GetName, EnumType& OutValue)
+	{
+		const UEnum* Enum = StaticEnum<EnumType>();
+		// the last entry is the generated _MAX
+		for (int32 Index = 0; Index < Enum->NumEnums() - 1; Index++)
+		{
+			const EnumType Value = (EnumType)Enum->GetValueByIndex(Index);
+			if (Name.Equals(GetName(Value), ESearchCase::IgnoreCase))
+			{
+				OutValue = Value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ParseVoice(const FString& Name, EOASpeechVoice& OutVoice)
+	{
+		return FindByName<EOASpeechVoice>(Name, [](EOASpeechVoice Voice) { return FOpenAIModels::GetVoiceName(Voice); }, OutVoice);
+	}
+
+	bool ParseModel(const FString& Name, EOASpeechEngineType& OutModel)
+	{
+		return FindByName<EOASpeechEngineType>(Name, [](EOASpeechEngineType Model) { return FOpenAIModels::GetModelName(Model); }, OutModel);
+	}
+
+	struct FPendingLine
+	{
+		FSpeechSettings Settings;
+		int32 Entry = INDEX_NONE;
+		int32 Attempts = 0;
+	};
+}
+
+UOpenAISpeechCacheCommandlet::UOpenAISpeechCacheCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Pre-generates text to speech lines into a pack for the OpenAI speech cache");
+	HelpUsage = TEXT("-run=OpenAISpeechCache -Lines=<manifest> [-Output=<pack>] [-Voice=alloy] [-Model=tts-1] [-Speed=1.0] [-Format=opus|pcm] [-Concurrency=8]");
+}
+
+int32 UOpenAISpeechCacheCommandlet::Main(const FString& Params)
+{
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamValues;
+	ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+	const FString LinesPath = ParamValues.FindRef(TEXT("Lines"));
+	if (LinesPath.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: %s"), *HelpUsage);
+		return 1;
+	}
+	FString OutputPath = ParamValues.FindRef(TEXT("Output"));
+	if (OutputPath.IsEmpty())
+	{
+		OutputPath = FPaths::ProjectContentDir() / TEXT("OpenAI/Speech.oaspeech");
+	}
+
+	FString _apiKey;
+	if (UOpenAIUtils::getUseApiKeyFromEnvironmentVars())
+		_apiKey = UOpenAIUtils::GetEnvironmentVariable(TEXT("OPENAI_API_KEY"));
+	else
+		_apiKey = UOpenAIUtils::getApiKey();
+
+	// defaults for rows that leave fields out
+	FSpeechSettings Defaults;
+	if (const FString* Voice = ParamValues.Find(TEXT("Voice")); Voice && !ParseVoice(*Voice, Defaults.voice))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unknown voice %s"), **Voice);
+		return 1;
+	}
+	if (const FString* Model = ParamValues.Find(TEXT("Model")); Model && !ParseModel(*Model, Defaults.model))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unknown model %s"), **Model);
+		return 1;
+	}
+	if (const FString* Speed = ParamValues.Find(TEXT("Speed")))
+	{
+		Defaults.speed = FCString::Atof(**Speed);
+	}
+	Defaults.responseFormat = ParamValues.FindRef(TEXT("Format")).Equals(TEXT("pcm"), ESearchCase::IgnoreCase) ? EOASpeechResponseFormat::PCM : EOASpeechResponseFormat::OPUS;
+	const int32 Concurrency = FMath::Max(1, ParamValues.Contains(TEXT("Concurrency")) ? FCString::Atoi(*ParamValues[TEXT("Concurrency")]) : 8);
+
+	TArray<FString> Rows;
+	if (!FFileHelper::LoadFileToStringArray(Rows, *LinesPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot read %s"), *LinesPath);
+		return 1;
+	}
+
+	// lines already generated, in the pack being replaced or spoken at runtime, are reused
+	FOpenAISpeechCache Existing;
+	Existing.bStoreMisses = false;
+	if (IFileManager::Get().FileExists(*OutputPath))
+	{
+		Existing.Mount(OutputPath);
+	}
+
+	TArray<FOpenAISpeechCache::FEntry> Entries;
+	TArray<FPendingLine> Pending;
+	TSet<TTuple<uint64, uint64>> Seen;
+	bool bFailed = false;
+	for (int32 RowIndex = 0; RowIndex < Rows.Num(); RowIndex++)
+	{
+		const FString Row = Rows[RowIndex].TrimStartAndEnd();
+		if (Row.IsEmpty() || Row.StartsWith(TEXT("#")))
+		{
+			continue;
+		}
+
+		FSpeechSettings Settings = Defaults;
+		TArray<FString> Fields;
+		Rows[RowIndex].ParseIntoArray(Fields, TEXT("\t"), false);
+		if (Fields.Num() >= 4)
+		{
+			Fields[0].TrimStartAndEndInline();
+			Fields[1].TrimStartAndEndInline();
+			Fields[2].TrimStartAndEndInline();
+			if ((!Fields[0].IsEmpty() && !ParseVoice(Fields[0], Settings.voice)) || (!Fields[1].IsEmpty() && !ParseModel(Fields[1], Settings.model)))
+			{
+				UE_LOG(LogTemp, Error, TEXT("%s:%d: unknown voice or model"), *LinesPath, RowIndex + 1);
+				bFailed = true;
+				continue;
+			}
+			if (!Fields[2].IsEmpty())
+			{
+				Settings.speed = FCString::Atof(*Fields[2]);
+			}
+			// the text may itself contain tabs
+			Settings.input = FString::Join(MakeArrayView(Fields).Slice(3, Fields.Num() - 3), TEXT("\t")).TrimStartAndEnd();
+		}
+		else
+		{
+			Settings.input = Row;
+		}
+
+		const FXxHash128 Key = FOpenAISpeechCache::MakeKey(Settings);
+		bool bAlreadyInSet = false;
+		Seen.Add(MakeTuple(Key.HashHigh, Key.HashLow), &bAlreadyInSet);
+		if (bAlreadyInSet)
+		{
+			continue;
+		}
+
+		FOpenAISpeechCache::FEntry& Entry = Entries.AddDefaulted_GetRef();
+		Entry.Key = Key;
+		Entry.Format = Settings.responseFormat;
+
+		FOpenAISpeechCache::FHit Hit;
+		if ((Existing.Find(Key, Hit) || Existing.ReadLoose(Key, Hit)) && Hit.Format == Settings.responseFormat)
+		{
+			Entry.Audio = Hit.Audio;
+			continue;
+		}
+		Pending.Add({ Settings, Entries.Num() - 1 });
+	}
+
+	// the pack may be replaced below, which a mapping would keep locked
+	Existing.UnmountAll();
+
+	const int32 NumReused = Entries.Num() - Pending.Num();
+	UE_LOG(LogTemp, Display, TEXT("%d lines, %d reused, %d to generate"), Entries.Num(), NumReused, Pending.Num());
+	if (Pending.Num() > 0 && _apiKey.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Api key is not set"));
+		return 1;
+	}
+
+	// requests run Concurrency at a time; the HTTP manager is ticked by hand as there is no engine loop
+	const double StartTime = FPlatformTime::Seconds();
+	int32 NextPending = 0;
+	int32 NumInFlight = 0;
+	int32 NumGenerated = 0;
+	while (NextPending < Pending.Num() || NumInFlight > 0)
+	{
+		while (NumInFlight < Concurrency && NextPending < Pending.Num())
+		{
+			const int32 PendingIndex = NextPending++;
+			FPendingLine& Line = Pending[PendingIndex];
+			Line.Attempts++;
+
+			FOpenAIJsonWriter Writer;
+			UOpenAICallSpeech::WriteRequestBody(Writer, Line.Settings, Line.Settings.responseFormat == EOASpeechResponseFormat::OPUS);
+
+			TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+			HttpRequest->SetURL(UOpenAIUtils::getBaseUrl() + TEXT("/audio/speech"));
+			HttpRequest->SetVerb(TEXT("POST"));
+			HttpRequest->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+			HttpRequest->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + _apiKey);
+			HttpRequest->SetContent(Writer.GetBuffer());
+			HttpRequest->OnProcessRequestComplete().BindLambda([&, PendingIndex](FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful)
+			{
+				NumInFlight--;
+				FPendingLine& Done = Pending[PendingIndex];
+				const int32 Code = Response.IsValid() ? Response->GetResponseCode() : 0;
+				if (WasSuccessful && EHttpResponseCodes::IsOk(Code) && Response->GetContentLength() > 0)
+				{
+					Entries[Done.Entry].Audio = Response->GetContent();
+					NumGenerated++;
+					return;
+				}
+
+				// rate limits and server errors are worth another go, at the back of the queue
+				if ((!WasSuccessful || Code == EHttpResponseCodes::TooManyRequests || Code >= 500) && Done.Attempts < MaxAttempts)
+				{
+					const FPendingLine Retry = Done;
+					Pending.Add(Retry);
+					return;
+				}
+
+				FString ErrorMessage;
+				OpenAIParser parser;
+				if (!Response.IsValid() || !parser.DecodeError(Response->GetContent(), ErrorMessage))
+				{
+					ErrorMessage = Response.IsValid() ? FString::Printf(TEXT("Request failed with status %d"), Code) : TEXT("No response from server");
+				}
+				UE_LOG(LogTemp, Error, TEXT("\"%s\": %s"), *Done.Settings.input.Left(80), *ErrorMessage);
+				bFailed = true;
+			});
+
+			if (HttpRequest->ProcessRequest())
+			{
+				NumInFlight++;
+			}
+			else
+			{
+				UE_LOG(LogTemp, Error, TEXT("\"%s\": Error sending request"), *Line.Settings.input.Left(80));
+				bFailed = true;
+			}
+		}
+
+		FHttpModule::Get().GetHttpManager().Tick(TickSeconds);
+		FPlatformProcess::Sleep(TickSeconds);
+	}
+	if (Pending.Num() > 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Generated %d lines in %.1f s"), NumGenerated, FPlatformTime::Seconds() - StartTime);
+	}
+
+	// lines that failed are left out, the game requests them at runtime
+	Entries.RemoveAll([](const FOpenAISpeechCache::FEntry& Entry) { return Entry.Audio.Num() == 0; });
+
+	// written beside the old pack first so a failed run leaves it intact
+	const FString TempPath = OutputPath + TEXT(".tmp");
+	if (!FOpenAISpeechCache::WritePack(TempPath, Entries) || !IFileManager::Get().Move(*OutputPath, *TempPath, true, true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot write %s"), *OutputPath);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %d lines to %s"), Entries.Num(), *OutputPath);
+	return bFailed ? 1 : 0;
+}
@@ -0,0 +1,384 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIStructuredOutput.h"
+#include "OpenAIJsonReader.h"
+#include "OpenAIJsonWriter.h"
+#include "UObject/UnrealType.h"
+#include "UObject/TextProperty.h"
+#include "UObject/EnumProperty.h"
+
+namespace
+{
+	// Structs on the way down from the root, so a struct that contains itself through an array is cut off
+	using FStructStack = TArray<const UScriptStruct*, TInlineAllocator<8>>;
+
+	const UEnum* GetEnum(const FProperty* Property)
+	{
+		if (const FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+		{
+			return EnumProperty->GetEnum();
+		}
+		if (const FByteProperty* ByteProperty = CastField<FByteProperty>(Property))
+		{
+			return ByteProperty->Enum;
+		}
+		return nullptr;
+	}
+
+	int32 NumEnumValues(const UEnum* Enum)
+	{
+		return Enum->ContainsExistingMax() ? Enum->NumEnums() - 1 : Enum->NumEnums();
+	}
+
+	bool IsSupported(const FProperty* Property, const FStructStack& Stack)
+	{
+		if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+		{
+			return IsSupported(ArrayProperty->Inner, Stack);
+		}
+		if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+		{
+			return !Stack.Contains(StructProperty->Struct);
+		}
+		return Property->IsA<FBoolProperty>() || Property->IsA<FNumericProperty>() || Property->IsA<FEnumProperty>()
+			|| Property->IsA<FStrProperty>() || Property->IsA<FNameProperty>() || Property->IsA<FTextProperty>();
+	}
+
+	void WriteValueSchema(FOpenAIJsonWriter& Writer, const FProperty* Property, FStructStack& Stack, const FString& Description);
+
+	void WriteObjectSchema(FOpenAIJsonWriter& Writer, const UScriptStruct* Struct, FStructStack& Stack, const FString& Description)
+	{
+		Stack.Push(Struct);
+
+		Writer.BeginObject();
+		Writer.Field("type", TEXT("object"));
+		if (!Description.IsEmpty())
+		{
+			Writer.Field("description", Description);
+		}
+
+		// Strict mode wants every property listed as required
+		TArray<FString, TInlineAllocator<16>> Required;
+		Writer.Key("properties");
+		Writer.BeginObject();
+		for (TFieldIterator<FProperty> It(Struct); It; ++It)
+		{
+			if (!IsSupported(*It, Stack))
+			{
+				UE_LOG(LogTemp, Verbose, TEXT("Structured output leaves %s.%s out of the schema"), *Struct->GetName(), *It->GetName());
+				continue;
+			}
+
+			FString PropertyDescription;
+#if WITH_METADATA
+			PropertyDescription = It->GetMetaData(TEXT("ToolTip"));
+#endif
+			const FString& Name = Required.Add_GetRef(It->GetAuthoredName());
+			Writer.Key(Name);
+			WriteValueSchema(Writer, *It, Stack, PropertyDescription);
+		}
+		Writer.EndObject();
+
+		Writer.Key("required");
+		Writer.BeginArray();
+		for (const FString& Name : Required)
+		{
+			Writer.Value(Name);
+		}
+		Writer.EndArray();
+		Writer.Field("additionalProperties", false);
+		Writer.EndObject();
+
+		Stack.Pop();
+	}
+
+	void WriteValueSchema(FOpenAIJsonWriter& Writer, const FProperty* Property, FStructStack& Stack, const FString& Description)
+	{
+		if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+		{
+			WriteObjectSchema(Writer, StructProperty->Struct, Stack, Description);
+			return;
+		}
+
+		Writer.BeginObject();
+		if (!Description.IsEmpty())
+		{
+			Writer.Field("description", Description);
+		}
+
+		if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+		{
+			Writer.Field("type", TEXT("array"));
+			Writer.Key("items");
+			WriteValueSchema(Writer, ArrayProperty->Inner, Stack, FString());
+		}
+		else if (const UEnum* Enum = GetEnum(Property))
+		{
+			Writer.Field("type", TEXT("string"));
+			Writer.Key("enum");
+			Writer.BeginArray();
+			for (int32 Index = 0; Index < NumEnumValues(Enum); Index++)
+			{
+				Writer.Value(Enum->GetAuthoredNameStringByIndex(Index));
+			}
+			Writer.EndArray();
+		}
+		else if (Property->IsA<FBoolProperty>())
+		{
+			Writer.Field("type", TEXT("boolean"));
+		}
+		else if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+		{
+			Writer.Field("type", NumericProperty->IsFloatingPoint() ? TEXT("number") : TEXT("integer"));
+		}
+		else
+		{
+			Writer.Field("type", TEXT("string"));
+		}
+		Writer.EndObject();
+	}
+
+	class FStructDecoder
+	{
+	public:
+		explicit FStructDecoder(FOpenAIJsonReader& InReader)
+			: Reader(InReader)
+		{
+		}
+
+		bool ReadStruct(const UScriptStruct* Struct, void* Data)
+		{
+			if (!Reader.ReadObjectStart())
+			{
+				return false;
+			}
+
+			FAnsiStringView Key;
+			while (Reader.NextMember(Key))
+			{
+				const FProperty* Property = FindProperty(Struct, Key);
+				if (!Property)
+				{
+					Reader.Skip();
+					continue;
+				}
+				if (!ReadValue(Property, Property->ContainerPtrToValuePtr<void>(Data)))
+				{
+					return false;
+				}
+			}
+			return !Reader.HasError();
+		}
+
+	private:
+		struct FNamedProperty
+		{
+			TArray<ANSICHAR> Name;
+			const FProperty* Property;
+		};
+
+		const FProperty* FindProperty(const UScriptStruct* Struct, FAnsiStringView Key)
+		{
+			// Authored names are converted to UTF-8 once per struct type and decode
+			TArray<FNamedProperty>* Properties = PropertiesByStruct.Find(Struct);
+			if (!Properties)
+			{
+				Properties = &PropertiesByStruct.Add(Struct);
+				for (TFieldIterator<FProperty> It(Struct); It; ++It)
+				{
+					const FTCHARToUTF8 Name(*It->GetAuthoredName());
+					Properties->Add({ TArray<ANSICHAR>(Name.Get(), Name.Length()), *It });
+				}
+			}
+
+			for (const FNamedProperty& Entry : *Properties)
+			{
+				if (Key == FAnsiStringView(Entry.Name.GetData(), Entry.Name.Num()))
+				{
+					return Entry.Property;
+				}
+			}
+			return nullptr;
+		}
+
+		bool ReadEnum(const UEnum* Enum, int64& OutValue)
+		{
+			FString Name;
+			if (!Reader.ReadString(Name))
+			{
+				return false;
+			}
+			for (int32 Index = 0; Index < NumEnumValues(Enum); Index++)
+			{
+				if (Enum->GetAuthoredNameStringByIndex(Index) == Name)
+				{
+					OutValue = Enum->GetValueByIndex(Index);
+					return true;
+				}
+			}
+			UE_LOG(LogTemp, Warning, TEXT("Structured output has %s, which is not a value of %s"), *Name, *Enum->GetName());
+			return false;
+		}
+
+		bool ReadValue(const FProperty* Property, void* Value)
+		{
+			// Strict schemas never produce null for these types, but a missing value keeps its default
+			if (Reader.TryReadNull())
+			{
+				return true;
+			}
+
+			if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+			{
+				bool bValue = false;
+				if (!Reader.ReadBool(bValue))
+				{
+					return false;
+				}
+				BoolProperty->SetPropertyValue(Value, bValue);
+			}
+			else if (const FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+			{
+				int64 EnumValue = 0;
+				if (!ReadEnum(EnumProperty->GetEnum(), EnumValue))
+				{
+					return false;
+				}
+				EnumProperty->GetUnderlyingProperty()->SetIntPropertyValue(Value, EnumValue);
+			}
+			else if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+			{
+				if (const UEnum* Enum = GetEnum(Property))
+				{
+					int64 EnumValue = 0;
+					if (!ReadEnum(Enum, EnumValue))
+					{
+						return false;
+					}
+					NumericProperty->SetIntPropertyValue(Value, EnumValue);
+				}
+				else if (NumericProperty->IsFloatingPoint())
+				{
+					double Number = 0.0;
+					if (!Reader.ReadNumber(Number))
+					{
+						return false;
+					}
+					NumericProperty->SetFloatingPointPropertyValue(Value, Number);
+				}
+				else
+				{
+					int64 Number = 0;
+					if (!Reader.ReadInteger(Number))
+					{
+						return false;
+					}
+					NumericProperty->SetIntPropertyValue(Value, Number);
+				}
+			}
+			else if (const FStrProperty* StrProperty = CastField<FStrProperty>(Property))
+			{
+				return Reader.ReadString(*StrProperty->GetPropertyValuePtr(Value));
+			}
+			else if (const FNameProperty* NameProperty = CastField<FNameProperty>(Property))
+			{
+				FString Text;
+				if (!Reader.ReadString(Text))
+				{
+					return false;
+				}
+				NameProperty->SetPropertyValue(Value, FName(*Text));
+			}
+			else if (const FTextProperty* TextProperty = CastField<FTextProperty>(Property))
+			{
+				FString Text;
+				if (!Reader.ReadString(Text))
+				{
+					return false;
+				}
+				TextProperty->SetPropertyValue(Value, FText::FromString(MoveTemp(Text)));
+			}
+			else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+			{
+				if (!Reader.ReadArrayStart())
+				{
+					return false;
+				}
+				FScriptArrayHelper Array(ArrayProperty, Value);
+				Array.EmptyValues();
+				while (Reader.NextElement())
+				{
+					const int32 Index = Array.AddValue();
+					if (!ReadValue(ArrayProperty->Inner, Array.GetRawPtr(Index)))
+					{
+						return false;
+					}
+				}
+			}
+			else if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+			{
+				return ReadStruct(StructProperty->Struct, Value);
+			}
+			else
+			{
+				return Reader.Skip();
+			}
+			return !Reader.HasError();
+		}
+
+		FOpenAIJsonReader& Reader;
+		TMap<const UScriptStruct*, TArray<FNamedProperty>> PropertiesByStruct;
+	};
+
+	// Schema names may only use letters, digits, underscores and dashes
+	FString MakeSchemaName(const UScriptStruct* Struct)
+	{
+		FString Name = Struct->GetName();
+		for (TCHAR& Char : Name)
+		{
+			if (!FChar::IsAlnum(Char) && Char != TEXT('_') && Char != TEXT('-'))
+			{
+				Char = TEXT('_');
+			}
+		}
+		return Name.Left(64);
+	}
+}
+
+void FOpenAIStructuredOutput::WriteResponseFormat(FOpenAIJsonWriter& Writer, const UScriptStruct* Struct)
+{
+	Writer.BeginObject();
+	Writer.Field("type", TEXT("json_schema"));
+	Writer.Key("json_schema");
+	Writer.BeginObject();
+	Writer.Field("name", MakeSchemaName(Struct));
+	Writer.Field("strict", true);
+	Writer.Key("schema");
+	WriteSchema(Writer, Struct);
+	Writer.EndObject();
+	Writer.EndObject();
+}
+
+void FOpenAIStructuredOutput::WriteSchema(FOpenAIJsonWriter& Writer, const UScriptStruct* Struct)
+{
+	FStructStack Stack;
+	WriteObjectSchema(Writer, Struct, Stack, FString());
+}
+
+bool FOpenAIStructuredOutput::Decode(FOpenAIJsonReader& Reader, const UScriptStruct* Struct, void* Data)
+{
+	FStructDecoder Decoder(Reader);
+	return Decoder.ReadStruct(Struct, Data);
+}
+
+bool FOpenAIStructuredOutput::Decode(TArrayView<const uint8> Utf8Json, const UScriptStruct* Struct, void* Data)
+{
+	FOpenAIJsonReader Reader(Utf8Json);
+	return Decode(Reader, Struct, Data);
+}
+
+bool FOpenAIStructuredOutput::Decode(const FString& Json, const UScriptStruct* Struct, void* Data)
+{
+	const FTCHARToUTF8 Utf8(*Json, Json.Len());
+	return Decode(TArrayView<const uint8>((const uint8*)Utf8.Get(), Utf8.Length()), Struct, Data);
+}
@@ -0,0 +1,1121 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAITokenizer.h"
+#include "OpenAIModels.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/Base64.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/ScopeLock.h"
+#include "Async/Async.h"
+#include <atomic>
+
+namespace
+{
+	// Character classes the pre-tokenizer patterns distinguish
+	enum ECharClass : uint8
+	{
+		CC_Upper,
+		CC_Lower,
+		CC_OtherLetter,
+		CC_Mark,
+		CC_Digit,
+		CC_Newline,
+		CC_Space,
+		CC_Other,
+
+		// Range kinds that resolve to one of the above per codepoint
+		CC_EvenUpper,
+		CC_OddUpper,
+		CC_Indic,
+		CC_Fullwidth,
+	};
+
+	FORCEINLINE bool IsLetter(uint8 Class) { return Class <= CC_OtherLetter; }
+	FORCEINLINE bool IsSpace(uint8 Class) { return Class == CC_Newline || Class == CC_Space; }
+	// Neither whitespace, a letter nor a number
+	FORCEINLINE bool IsPunctuation(uint8 Class) { return Class == CC_Mark || Class == CC_Other; }
+	// Letters in o200k's [\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}] and [\p{Ll}\p{Lm}\p{Lo}\p{M}] sets
+	FORCEINLINE bool IsUpperSet(uint8 Class) { return Class == CC_Upper || Class == CC_OtherLetter || Class == CC_Mark; }
+	FORCEINLINE bool IsLowerSet(uint8 Class) { return Class == CC_Lower || Class == CC_OtherLetter || Class == CC_Mark; }
+
+	struct FCharRange
+	{
+		uint32 First;
+		uint32 Last;
+		uint8 Class;
+	};
+
+	// General categories of the scripts prompts are written in. Blocks that are not listed count as
+	// letters below U+10000 and as symbols above it; case is only tracked where it is regular.
+	const FCharRange CharRanges[] =
+	{
+		{ 0x0080, 0x0084, CC_Other }, { 0x0085, 0x0085, CC_Space }, { 0x0086, 0x009F, CC_Other },
+		{ 0x00A0, 0x00A0, CC_Space }, { 0x00A1, 0x00A9, CC_Other }, { 0x00AA, 0x00AA, CC_OtherLetter },
+		{ 0x00AB, 0x00B1, CC_Other }, { 0x00B2, 0x00B3, CC_Digit }, { 0x00B4, 0x00B4, CC_Other },
+		{ 0x00B5, 0x00B5, CC_Lower }, { 0x00B6, 0x00B8, CC_Other }, { 0x00B9, 0x00B9, CC_Digit },
+		{ 0x00BA, 0x00BA, CC_OtherLetter }, { 0x00BB, 0x00BB, CC_Other }, { 0x00BC, 0x00BE, CC_Digit },
+		{ 0x00BF, 0x00BF, CC_Other }, { 0x00C0, 0x00D6, CC_Upper }, { 0x00D7, 0x00D7, CC_Other },
+		{ 0x00D8, 0x00DE, CC_Upper }, { 0x00DF, 0x00F6, CC_Lower }, { 0x00F7, 0x00F7, CC_Other },
+		{ 0x00F8, 0x00FF, CC_Lower },
+
+		// Latin Extended-A, Latin Extended-B, IPA, spacing modifiers, combining marks
+		{ 0x0100, 0x0137, CC_EvenUpper }, { 0x0138, 0x0138, CC_Lower }, { 0x0139, 0x0148, CC_OddUpper },
+		{ 0x0149, 0x0149, CC_Lower }, { 0x014A, 0x0177, CC_EvenUpper }, { 0x0178, 0x0178, CC_Upper },
+		{ 0x0179, 0x017E, CC_OddUpper }, { 0x017F, 0x017F, CC_Lower },
+		{ 0x0180, 0x0180, CC_Lower }, { 0x0181, 0x0182, CC_Upper }, { 0x0183, 0x0186, CC_EvenUpper },
+		{ 0x0187, 0x0187, CC_Upper }, { 0x0188, 0x0188, CC_Lower }, { 0x0189, 0x018B, CC_Upper },
+		{ 0x018C, 0x018D, CC_Lower }, { 0x018E, 0x0191, CC_Upper }, { 0x0192, 0x0192, CC_Lower },
+		{ 0x0193, 0x0194, CC_Upper }, { 0x0195, 0x0195, CC_Lower }, { 0x0196, 0x0198, CC_Upper },
+		{ 0x0199, 0x019B, CC_Lower }, { 0x019C, 0x019D, CC_Upper }, { 0x019E, 0x019E, CC_Lower },
+		{ 0x019F, 0x01A0, CC_Upper }, { 0x01A1, 0x01A6, CC_EvenUpper }, { 0x01A7, 0x01AA, CC_OddUpper },
+		{ 0x01AB, 0x01AE, CC_EvenUpper }, { 0x01AF, 0x01AF, CC_Upper }, { 0x01B0, 0x01B0, CC_Lower },
+		{ 0x01B1, 0x01B3, CC_Upper }, { 0x01B4, 0x01B7, CC_OddUpper }, { 0x01B8, 0x01B8, CC_Upper },
+		{ 0x01B9, 0x01BA, CC_Lower }, { 0x01BB, 0x01BB, CC_OtherLetter }, { 0x01BC, 0x01BC, CC_Upper },
+		{ 0x01BD, 0x01BF, CC_Lower }, { 0x01C0, 0x01C3, CC_OtherLetter }, { 0x01C4, 0x01C5, CC_Upper },
+		{ 0x01C6, 0x01C6, CC_Lower }, { 0x01C7, 0x01C8, CC_Upper }, { 0x01C9, 0x01C9, CC_Lower },
+		{ 0x01CA, 0x01CB, CC_Upper }, { 0x01CC, 0x01DC, CC_OddUpper }, { 0x01DD, 0x01EF, CC_EvenUpper },
+		{ 0x01F0, 0x01F0, CC_Lower }, { 0x01F1, 0x01F2, CC_Upper }, { 0x01F3, 0x01F6, CC_EvenUpper },
+		{ 0x01F7, 0x01F8, CC_Upper }, { 0x01F9, 0x0233, CC_EvenUpper }, { 0x0234, 0x0239, CC_Lower },
+		{ 0x023A, 0x023B, CC_Upper }, { 0x023C, 0x023C, CC_Lower }, { 0x023D, 0x023E, CC_Upper },
+		{ 0x023F, 0x0240, CC_Lower }, { 0x0241, 0x0241, CC_Upper }, { 0x0242, 0x0242, CC_Lower },
+		{ 0x0243, 0x0246, CC_Upper }, { 0x0247, 0x024F, CC_EvenUpper },
+		{ 0x0250, 0x02AF, CC_Lower }, { 0x02B0, 0x02C1, CC_OtherLetter }, { 0x02C2, 0x02C5, CC_Other },
+		{ 0x02C6, 0x02D1, CC_OtherLetter }, { 0x02D2, 0x02DF, CC_Other }, { 0x02E0, 0x02E4, CC_OtherLetter },
+		{ 0x02E5, 0x02EB, CC_Other }, { 0x02EC, 0x02EC, CC_OtherLetter }, { 0x02ED, 0x02ED, CC_Other },
+		{ 0x02EE, 0x02EE, CC_OtherLetter }, { 0x02EF, 0x02FF, CC_Other }, { 0x0300, 0x036F, CC_Mark },
+
+		// Greek
+		{ 0x0370, 0x0373, CC_EvenUpper }, { 0x0374, 0x0375, CC_Other }, { 0x0376, 0x0377, CC_EvenUpper },
+		{ 0x037A, 0x037D, CC_Lower }, { 0x037E, 0x037E, CC_Other }, { 0x037F, 0x037F, CC_Upper },
+		{ 0x0384, 0x0385, CC_Other }, { 0x0386, 0x0386, CC_Upper }, { 0x0387, 0x0387, CC_Other },
+		{ 0x0388, 0x038F, CC_Upper }, { 0x0390, 0x0390, CC_Lower }, { 0x0391, 0x03AB, CC_Upper },
+		{ 0x03AC, 0x03CE, CC_Lower }, { 0x03CF, 0x03CF, CC_Upper }, { 0x03D0, 0x03F5, CC_OtherLetter },
+		{ 0x03F6, 0x03F6, CC_Other }, { 0x03F7, 0x03FF, CC_OtherLetter },
+
+		// Cyrillic, Armenian
+		{ 0x0400, 0x042F, CC_Upper }, { 0x0430, 0x045F, CC_Lower }, { 0x0460, 0x0481, CC_EvenUpper },
+		{ 0x0482, 0x0482, CC_Other }, { 0x0483, 0x0489, CC_Mark }, { 0x048A, 0x04BF, CC_EvenUpper },
+		{ 0x04C0, 0x04C0, CC_Upper }, { 0x04C1, 0x04CE, CC_OddUpper }, { 0x04CF, 0x04CF, CC_Lower },
+		{ 0x04D0, 0x052F, CC_EvenUpper }, { 0x0531, 0x0556, CC_Upper }, { 0x0559, 0x0559, CC_OtherLetter },
+		{ 0x055A, 0x055F, CC_Other }, { 0x0560, 0x0588, CC_Lower }, { 0x0589, 0x058F, CC_Other },
+
+		// Hebrew, Arabic
+		{ 0x0591, 0x05BD, CC_Mark }, { 0x05BE, 0x05BE, CC_Other }, { 0x05BF, 0x05BF, CC_Mark },
+		{ 0x05C0, 0x05C0, CC_Other }, { 0x05C1, 0x05C2, CC_Mark }, { 0x05C3, 0x05C3, CC_Other },
+		{ 0x05C4, 0x05C5, CC_Mark }, { 0x05C6, 0x05C6, CC_Other }, { 0x05C7, 0x05C7, CC_Mark },
+		{ 0x05D0, 0x05EA, CC_OtherLetter }, { 0x05EF, 0x05F2, CC_OtherLetter }, { 0x05F3, 0x060F, CC_Other },
+		{ 0x0610, 0x061A, CC_Mark }, { 0x061B, 0x061F, CC_Other }, { 0x0620, 0x064A, CC_OtherLetter },
+		{ 0x064B, 0x065F, CC_Mark }, { 0x0660, 0x0669, CC_Digit }, { 0x066A, 0x066D, CC_Other },
+		{ 0x066E, 0x066F, CC_OtherLetter }, { 0x0670, 0x0670, CC_Mark }, { 0x0671, 0x06D3, CC_OtherLetter },
+		{ 0x06D4, 0x06D4, CC_Other }, { 0x06D5, 0x06D5, CC_OtherLetter }, { 0x06D6, 0x06DC, CC_Mark },
+		{ 0x06DD, 0x06DE, CC_Other }, { 0x06DF, 0x06E4, CC_Mark }, { 0x06E5, 0x06E6, CC_OtherLetter },
+		{ 0x06E7, 0x06E8, CC_Mark }, { 0x06E9, 0x06E9, CC_Other }, { 0x06EA, 0x06ED, CC_Mark },
+		{ 0x06EE, 0x06EF, CC_OtherLetter }, { 0x06F0, 0x06F9, CC_Digit }, { 0x06FA, 0x06FC, CC_OtherLetter },
+		{ 0x06FD, 0x06FE, CC_Other }, { 0x06FF, 0x06FF, CC_OtherLetter },
+
+		// Devanagari to Sinhala share one layout, Thai
+		{ 0x0900, 0x0DFF, CC_Indic },
+		{ 0x0E01, 0x0E30, CC_OtherLetter }, { 0x0E31, 0x0E31, CC_Mark }, { 0x0E32, 0x0E33, CC_OtherLetter },
+		{ 0x0E34, 0x0E3A, CC_Mark }, { 0x0E3B, 0x0E3F, CC_Other }, { 0x0E40, 0x0E46, CC_OtherLetter },
+		{ 0x0E47, 0x0E4E, CC_Mark }, { 0x0E4F, 0x0E4F, CC_Other }, { 0x0E50, 0x0E59, CC_Digit },
+		{ 0x0E5A, 0x0E5B, CC_Other },
+
+		// Georgian, Hangul Jamo, combining mark extensions, Latin Extended Additional, Greek Extended
+		{ 0x10A0, 0x10C5, CC_Upper }, { 0x10C7, 0x10C7, CC_Upper }, { 0x10CD, 0x10CD, CC_Upper },
+		{ 0x10D0, 0x10FA, CC_Lower }, { 0x10FB, 0x10FB, CC_Other }, { 0x10FC, 0x10FF, CC_OtherLetter },
+		{ 0x1100, 0x11FF, CC_OtherLetter }, { 0x1AB0, 0x1AFF, CC_Mark }, { 0x1DC0, 0x1DFF, CC_Mark },
+		{ 0x1E00, 0x1E95, CC_EvenUpper }, { 0x1E96, 0x1E9D, CC_Lower }, { 0x1E9E, 0x1E9E, CC_Upper },
+		{ 0x1E9F, 0x1E9F, CC_Lower }, { 0x1EA0, 0x1EFF, CC_EvenUpper }, { 0x1F00, 0x1FFF, CC_OtherLetter },
+
+		// Punctuation, super and subscripts, symbols, enclosed and dingbat numbers
+		{ 0x2000, 0x200A, CC_Space }, { 0x200B, 0x2027, CC_Other }, { 0x2028, 0x2029, CC_Space },
+		{ 0x202A, 0x202E, CC_Other }, { 0x202F, 0x202F, CC_Space }, { 0x2030, 0x205E, CC_Other },
+		{ 0x205F, 0x205F, CC_Space }, { 0x2060, 0x206F, CC_Other }, { 0x2070, 0x2070, CC_Digit },
+		{ 0x2071, 0x2071, CC_OtherLetter }, { 0x2072, 0x2073, CC_Other }, { 0x2074, 0x2079, CC_Digit },
+		{ 0x207A, 0x207E, CC_Other }, { 0x207F, 0x207F, CC_OtherLetter }, { 0x2080, 0x2089, CC_Digit },
+		{ 0x208A, 0x208F, CC_Other }, { 0x2090, 0x209C, CC_OtherLetter }, { 0x209D, 0x20CF, CC_Other },
+		{ 0x20D0, 0x20FF, CC_Mark },
+
+		// Letterlike symbols, number forms
+		{ 0x2100, 0x2101, CC_Other }, { 0x2102, 0x2102, CC_Upper }, { 0x2103, 0x2106, CC_Other },
+		{ 0x2107, 0x2107, CC_Upper }, { 0x2108, 0x2109, CC_Other }, { 0x210A, 0x210A, CC_Lower },
+		{ 0x210B, 0x210D, CC_Upper }, { 0x210E, 0x210F, CC_Lower }, { 0x2110, 0x2112, CC_Upper },
+		{ 0x2113, 0x2113, CC_Lower }, { 0x2114, 0x2114, CC_Other }, { 0x2115, 0x2115, CC_Upper },
+		{ 0x2116, 0x2118, CC_Other }, { 0x2119, 0x211D, CC_Upper }, { 0x211E, 0x2123, CC_Other },
+		{ 0x2124, 0x2124, CC_Upper }, { 0x2125, 0x2125, CC_Other }, { 0x2126, 0x2126, CC_Upper },
+		{ 0x2127, 0x2127, CC_Other }, { 0x2128, 0x2128, CC_Upper }, { 0x2129, 0x2129, CC_Other },
+		{ 0x212A, 0x212D, CC_Upper }, { 0x212E, 0x212E, CC_Other }, { 0x212F, 0x212F, CC_Lower },
+		{ 0x2130, 0x2133, CC_Upper }, { 0x2134, 0x2134, CC_Lower }, { 0x2135, 0x2138, CC_OtherLetter },
+		{ 0x2139, 0x2139, CC_Lower }, { 0x213A, 0x213B, CC_Other }, { 0x213C, 0x213D, CC_Lower },
+		{ 0x213E, 0x213F, CC_Upper }, { 0x2140, 0x2144, CC_Other }, { 0x2145, 0x2145, CC_Upper },
+		{ 0x2146, 0x2149, CC_Lower }, { 0x214A, 0x214D, CC_Other }, { 0x214E, 0x214E, CC_Lower },
+		{ 0x214F, 0x214F, CC_Other }, { 0x2150, 0x2182, CC_Digit },
+		{ 0x2183, 0x2184, CC_OddUpper }, { 0x2185, 0x2189, CC_Digit }, { 0x218A, 0x245F, CC_Other },
+		{ 0x2460, 0x249B, CC_Digit }, { 0x249C, 0x24E9, CC_Other }, { 0x24EA, 0x24FF, CC_Digit },
+		{ 0x2500, 0x2775, CC_Other }, { 0x2776, 0x2793, CC_Digit }, { 0x2794, 0x2BFF, CC_Other },
+		{ 0x2C00, 0x2DDF, CC_OtherLetter }, { 0x2DE0, 0x2DFF, CC_Mark }, { 0x2E00, 0x2FFF, CC_Other },
+
+		// CJK punctuation, kana, CJK symbols and ideographs, Hangul syllables
+		{ 0x3000, 0x3000, CC_Space }, { 0x3001, 0x3004, CC_Other }, { 0x3005, 0x3006, CC_OtherLetter },
+		{ 0x3007, 0x3007, CC_Digit }, { 0x3008, 0x3020, CC_Other }, { 0x3021, 0x3029, CC_Digit },
+		{ 0x302A, 0x302F, CC_Mark }, { 0x3030, 0x3030, CC_Other }, { 0x3031, 0x3035, CC_OtherLetter },
+		{ 0x3036, 0x3037, CC_Other }, { 0x3038, 0x303A, CC_Digit }, { 0x303B, 0x303C, CC_OtherLetter },
+		{ 0x303D, 0x3040, CC_Other }, { 0x3041, 0x3096, CC_OtherLetter }, { 0x3097, 0x3098, CC_Other },
+		{ 0x3099, 0x309A, CC_Mark }, { 0x309B, 0x309C, CC_Other }, { 0x309D, 0x309F, CC_OtherLetter },
+		{ 0x30A0, 0x30A0, CC_Other }, { 0x30A1, 0x30FA, CC_OtherLetter }, { 0x30FB, 0x30FB, CC_Other },
+		{ 0x30FC, 0x318F, CC_OtherLetter }, { 0x3190, 0x3191, CC_Other }, { 0x3192, 0x3195, CC_Digit },
+		{ 0x3196, 0x319F, CC_Other }, { 0x31A0, 0x31BF, CC_OtherLetter }, { 0x31C0, 0x31EF, CC_Other },
+		{ 0x31F0, 0x31FF, CC_OtherLetter }, { 0x3200, 0x321F, CC_Other }, { 0x3220, 0x3229, CC_Digit },
+		{ 0x322A, 0x3247, CC_Other }, { 0x3248, 0x324F, CC_Digit }, { 0x3250, 0x3250, CC_Other },
+		{ 0x3251, 0x325F, CC_Digit }, { 0x3260, 0x327F, CC_Other }, { 0x3280, 0x3289, CC_Digit },
+		{ 0x328A, 0x32B0, CC_Other }, { 0x32B1, 0x32BF, CC_Digit }, { 0x32C0, 0x33FF, CC_Other },
+		{ 0x3400, 0x4DBF, CC_OtherLetter }, { 0x4DC0, 0x4DFF, CC_Other }, { 0x4E00, 0xA48F, CC_OtherLetter },
+		{ 0xA490, 0xA4CF, CC_Other }, { 0xA4D0, 0xD7FF, CC_OtherLetter },
+
+		// Surrogates and private use, compatibility ideographs, presentation forms, halfwidth and fullwidth forms
+		{ 0xD800, 0xF8FF, CC_Other }, { 0xF900, 0xFAFF, CC_OtherLetter }, { 0xFB00, 0xFB06, CC_Lower },
+		{ 0xFB13, 0xFB17, CC_Lower }, { 0xFB1D, 0xFB1D, CC_OtherLetter }, { 0xFB1E, 0xFB1E, CC_Mark },
+		{ 0xFB1F, 0xFB28, CC_OtherLetter }, { 0xFB29, 0xFB29, CC_Other }, { 0xFB2A, 0xFDFF, CC_OtherLetter },
+		{ 0xFE00, 0xFE0F, CC_Mark }, { 0xFE10, 0xFE1F, CC_Other }, { 0xFE20, 0xFE2F, CC_Mark },
+		{ 0xFE30, 0xFE6F, CC_Other }, { 0xFE70, 0xFEFC, CC_OtherLetter }, { 0xFEFD, 0xFF00, CC_Other },
+		{ 0xFF01, 0xFF5E, CC_Fullwidth }, { 0xFF5F, 0xFF65, CC_Other }, { 0xFF66, 0xFFDC, CC_OtherLetter },
+		{ 0xFFDD, 0xFFFF, CC_Other },
+
+		// Historic scripts, mathematical alphanumerics, emoji and pictographs, CJK extensions, tags
+		{ 0x10000, 0x1D7CD, CC_OtherLetter }, { 0x1D7CE, 0x1D7FF, CC_Digit }, { 0x1D800, 0x1EFFF, CC_OtherLetter },
+		{ 0x1F000, 0x1F0FF, CC_Other }, { 0x1F100, 0x1F10C, CC_Digit }, { 0x1F10D, 0x1FBEF, CC_Other },
+		{ 0x1FBF0, 0x1FBF9, CC_Digit }, { 0x1FBFA, 0x1FFFF, CC_Other }, { 0x20000, 0x3FFFF, CC_OtherLetter },
+		{ 0xE0000, 0xE007F, CC_Other }, { 0xE0100, 0xE01EF, CC_Mark },
+	};
+
+	constexpr uint8 ClassifyAscii(uint32 Codepoint)
+	{
+		if (Codepoint >= 'A' && Codepoint <= 'Z') return CC_Upper;
+		if (Codepoint >= 'a' && Codepoint <= 'z') return CC_Lower;
+		if (Codepoint >= '0' && Codepoint <= '9') return CC_Digit;
+		if (Codepoint == '\r' || Codepoint == '\n') return CC_Newline;
+		if (Codepoint == ' ' || (Codepoint >= '\t' && Codepoint <= '\f') || (Codepoint >= 0x1C && Codepoint <= 0x1F)) return CC_Space;
+		return CC_Other;
+	}
+
+	uint8 ResolveRangeClass(const FCharRange& Range, uint32 Codepoint)
+	{
+		switch (Range.Class)
+		{
+		case CC_EvenUpper:
+			return (Codepoint & 1) == 0 ? CC_Upper : CC_Lower;
+		case CC_OddUpper:
+			return (Codepoint & 1) != 0 ? CC_Upper : CC_Lower;
+		case CC_Fullwidth:
+			return ClassifyAscii(Codepoint - 0xFEE0);
+		case CC_Indic:
+		{
+			const uint32 Offset = Codepoint & 0x7F;
+			if (Offset <= 0x03 || (Offset >= 0x3A && Offset <= 0x3C) || (Offset >= 0x3E && Offset <= 0x4F)
+				|| (Offset >= 0x51 && Offset <= 0x57) || Offset == 0x62 || Offset == 0x63)
+			{
+				return CC_Mark;
+			}
+			if (Offset == 0x64 || Offset == 0x65) return CC_Other;
+			if (Offset >= 0x66 && Offset <= 0x6F) return CC_Digit;
+			return CC_OtherLetter;
+		}
+		default:
+			return Range.Class;
+		}
+	}
+
+	uint8 ClassifySlow(uint32 Codepoint)
+	{
+		if (Codepoint < 0x80)
+		{
+			return ClassifyAscii(Codepoint);
+		}
+
+		int32 Low = 0;
+		int32 High = UE_ARRAY_COUNT(CharRanges) - 1;
+		while (Low <= High)
+		{
+			const int32 Mid = (Low + High) / 2;
+			if (Codepoint < CharRanges[Mid].First)
+			{
+				High = Mid - 1;
+			}
+			else if (Codepoint > CharRanges[Mid].Last)
+			{
+				Low = Mid + 1;
+			}
+			else
+			{
+				return ResolveRangeClass(CharRanges[Mid], Codepoint);
+			}
+		}
+		return Codepoint < 0x10000 ? CC_OtherLetter : CC_Other;
+	}
+
+	// The basic multilingual plane is resolved once into a flat table
+	struct FBmpClassTable
+	{
+		uint8 Classes[0x10000];
+
+		FBmpClassTable()
+		{
+			for (uint32 Codepoint = 0; Codepoint < 0x10000; Codepoint++)
+			{
+				Classes[Codepoint] = ClassifySlow(Codepoint);
+			}
+		}
+	};
+
+	struct FAsciiClassTable
+	{
+		uint8 Classes[0x80];
+
+		constexpr FAsciiClassTable()
+			: Classes{}
+		{
+			for (uint32 Codepoint = 0; Codepoint < 0x80; Codepoint++)
+			{
+				Classes[Codepoint] = ClassifyAscii(Codepoint);
+			}
+		}
+	};
+
+	constexpr FAsciiClassTable AsciiClasses;
+
+	FORCEINLINE uint8 Classify(uint32 Codepoint)
+	{
+		static const FBmpClassTable Table;
+		return Codepoint < 0x10000 ? Table.Classes[Codepoint] : ClassifySlow(Codepoint);
+	}
+
+	FORCEINLINE uint8 ToLowerAscii(uint8 Byte)
+	{
+		return (Byte >= 'A' && Byte <= 'Z') ? Byte + ('a' - 'A') : Byte;
+	}
+
+	/** Text decoded once into UTF-8 with a class and byte offset per codepoint, reused per thread. */
+	struct FCodepointText
+	{
+		TArray<uint8> Utf8;
+		TArray<uint8> Classes;
+		TArray<int32> Offsets;
+
+		int32 Num() const { return Classes.Num(); }
+
+		// True when codepoint Index is the ASCII character Char. Lead bytes of longer sequences are never ASCII.
+		FORCEINLINE bool Is(int32 Index, uint8 Char) const
+		{
+			return Index < Num() && Utf8[Offsets[Index]] == Char;
+		}
+
+		FORCEINLINE uint8 LowerAt(int32 Index) const
+		{
+			return Index < Num() ? ToLowerAscii(Utf8[Offsets[Index]]) : 0;
+		}
+
+		void Release()
+		{
+			Utf8.Empty();
+			Classes.Empty();
+			Offsets.Empty();
+		}
+
+		void Decode(FStringView Text)
+		{
+			const TCHAR* Src = Text.GetData();
+			const int32 Len = Text.Len();
+
+			Utf8.SetNumUninitialized(Len * 3, EAllowShrinking::No);
+			Classes.SetNumUninitialized(Len, EAllowShrinking::No);
+			Offsets.SetNumUninitialized(Len + 1, EAllowShrinking::No);
+			uint8* const Start = Utf8.GetData();
+			uint8* Dst = Start;
+			uint8* ClassDst = Classes.GetData();
+			int32* OffsetDst = Offsets.GetData();
+
+			for (int32 Index = 0; Index < Len;)
+			{
+				*OffsetDst++ = (int32)(Dst - Start);
+
+				uint32 Char = (uint32)Src[Index++];
+				if (Char < 0x80)
+				{
+					*Dst++ = (uint8)Char;
+					*ClassDst++ = AsciiClasses.Classes[Char];
+					continue;
+				}
+
+				if (Char >= 0xD800 && Char <= 0xDFFF)
+				{
+					const uint32 Low = Index < Len ? (uint32)Src[Index] : 0;
+					if (Char <= 0xDBFF && Low >= 0xDC00 && Low <= 0xDFFF)
+					{
+						Char = 0x10000 + ((Char - 0xD800) << 10) + (Low - 0xDC00);
+						Index++;
+					}
+					else
+					{
+						Char = 0xFFFD;
+					}
+				}
+
+				if (Char < 0x800)
+				{
+					*Dst++ = (uint8)(0xC0 | (Char >> 6));
+					*Dst++ = (uint8)(0x80 | (Char & 0x3F));
+				}
+				else if (Char < 0x10000)
+				{
+					*Dst++ = (uint8)(0xE0 | (Char >> 12));
+					*Dst++ = (uint8)(0x80 | ((Char >> 6) & 0x3F));
+					*Dst++ = (uint8)(0x80 | (Char & 0x3F));
+				}
+				else
+				{
+					*Dst++ = (uint8)(0xF0 | (Char >> 18));
+					*Dst++ = (uint8)(0x80 | ((Char >> 12) & 0x3F));
+					*Dst++ = (uint8)(0x80 | ((Char >> 6) & 0x3F));
+					*Dst++ = (uint8)(0x80 | (Char & 0x3F));
+				}
+				*ClassDst++ = Classify(Char);
+			}
+
+			// Surrogate pairs leave fewer codepoints than UTF-16 units
+			const int32 NumBytes = (int32)(Dst - Start);
+			*OffsetDst++ = NumBytes;
+			Classes.SetNum((int32)(ClassDst - Classes.GetData()), EAllowShrinking::No);
+			Offsets.SetNum((int32)(OffsetDst - Offsets.GetData()), EAllowShrinking::No);
+			Utf8.SetNum(NumBytes, EAllowShrinking::No);
+		}
+	};
+
+	// Whitespace alternatives shared by both patterns, for a piece starting at Index
+	int32 MatchWhitespace(const FCodepointText& Text, int32 Index, bool bWholeTrailingRun)
+	{
+		const int32 Num = Text.Num();
+		int32 RunEnd = Index;
+		int32 LastNewline = INDEX_NONE;
+		while (RunEnd < Num && IsSpace(Text.Classes[RunEnd]))
+		{
+			if (Text.Classes[RunEnd] == CC_Newline)
+			{
+				LastNewline = RunEnd;
+			}
+			RunEnd++;
+		}
+
+		// cl100k: \s++$
+		if (bWholeTrailingRun && RunEnd == Num)
+		{
+			return RunEnd;
+		}
+		// \s*[\r\n] and \s*[\r\n]+ both end after the last line break of the run
+		if (LastNewline != INDEX_NONE)
+		{
+			return LastNewline + 1;
+		}
+		// \s+(?!\S) leaves the last space to prefix the next word, \s takes a lone one
+		if (RunEnd == Num)
+		{
+			return RunEnd;
+		}
+		return RunEnd - Index >= 2 ? RunEnd - 1 : Index + 1;
+	}
+
+	// ' ?[^\s\p{L}\p{N}]+' followed by trailing line breaks (and slashes for o200k)
+	int32 MatchPunctuation(const FCodepointText& Text, int32 Index, bool bTrailingSlashes)
+	{
+		const int32 Num = Text.Num();
+		int32 End = Index;
+		if (Text.Is(End, ' '))
+		{
+			End++;
+		}
+		if (End >= Num || !IsPunctuation(Text.Classes[End]))
+		{
+			return INDEX_NONE;
+		}
+		while (End < Num && IsPunctuation(Text.Classes[End]))
+		{
+			End++;
+		}
+		while (End < Num && (Text.Classes[End] == CC_Newline || (bTrailingSlashes && Text.Is(End, '/'))))
+		{
+			End++;
+		}
+		return End;
+	}
+
+	int32 MatchDigits(const FCodepointText& Text, int32 Index)
+	{
+		int32 End = Index;
+		while (End < Text.Num() && End - Index < 3 && Text.Classes[End] == CC_Digit)
+		{
+			End++;
+		}
+		return End;
+	}
+
+	// 's 't 're 've 'm 'll 'd, case insensitive. Returns the length matched at Index.
+	int32 MatchContraction(const FCodepointText& Text, int32 Index)
+	{
+		if (!Text.Is(Index, '\''))
+		{
+			return 0;
+		}
+		const uint8 First = Text.LowerAt(Index + 1);
+		if (First == 's' || First == 'd' || First == 'm' || First == 't')
+		{
+			return 2;
+		}
+		const uint8 Second = Text.LowerAt(Index + 2);
+		if ((First == 'l' && Second == 'l') || (First == 'v' && Second == 'e') || (First == 'r' && Second == 'e'))
+		{
+			return 3;
+		}
+		return 0;
+	}
+
+	/**
+	 * cl100k_base:
+	 * '(?i:[sdmt]|ll|ve|re)|[^\r\n\p{L}\p{N}]?+\p{L}++|\p{N}{1,3}+| ?[^\s\p{L}\p{N}]++[\r\n]*+|\s++$|\s*[\r\n]|\s+(?!\S)|\s
+	 */
+	int32 NextPieceCl100k(const FCodepointText& Text, int32 Index)
+	{
+		const int32 Num = Text.Num();
+		const uint8 Class = Text.Classes[Index];
+
+		if (const int32 Contraction = MatchContraction(Text, Index))
+		{
+			return Index + Contraction;
+		}
+
+		int32 LetterStart = INDEX_NONE;
+		if (IsLetter(Class))
+		{
+			LetterStart = Index;
+		}
+		else if (Class != CC_Newline && Class != CC_Digit && Index + 1 < Num && IsLetter(Text.Classes[Index + 1]))
+		{
+			LetterStart = Index + 1;
+		}
+		if (LetterStart != INDEX_NONE)
+		{
+			int32 End = LetterStart + 1;
+			while (End < Num && IsLetter(Text.Classes[End]))
+			{
+				End++;
+			}
+			return End;
+		}
+
+		if (Class == CC_Digit)
+		{
+			return MatchDigits(Text, Index);
+		}
+
+		const int32 PunctuationEnd = MatchPunctuation(Text, Index, false);
+		if (PunctuationEnd != INDEX_NONE)
+		{
+			return PunctuationEnd;
+		}
+
+		return MatchWhitespace(Text, Index, true);
+	}
+
+	int32 ScanUpperSet(const FCodepointText& Text, int32 Start)
+	{
+		int32 End = Start;
+		while (End < Text.Num() && IsUpperSet(Text.Classes[End]))
+		{
+			End++;
+		}
+		return End;
+	}
+
+	int32 ScanLowerSet(const FCodepointText& Text, int32 Start)
+	{
+		int32 End = Start;
+		while (End < Text.Num() && IsLowerSet(Text.Classes[End]))
+		{
+			End++;
+		}
+		return End;
+	}
+
+	// [\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}]*[\p{Ll}\p{Lm}\p{Lo}\p{M}]+ with an optional contraction
+	int32 MatchLowerWord(const FCodepointText& Text, int32 Start)
+	{
+		const int32 UpperEnd = ScanUpperSet(Text, Start);
+		int32 End = ScanLowerSet(Text, UpperEnd);
+		if (End == UpperEnd)
+		{
+			// The upper run has to give back its last character that is also in the lower set
+			End = INDEX_NONE;
+			for (int32 Index = UpperEnd - 1; Index >= Start; Index--)
+			{
+				if (IsLowerSet(Text.Classes[Index]))
+				{
+					End = Index + 1;
+					break;
+				}
+			}
+			if (End == INDEX_NONE)
+			{
+				return INDEX_NONE;
+			}
+		}
+		return End + MatchContraction(Text, End);
+	}
+
+	// [\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}]+[\p{Ll}\p{Lm}\p{Lo}\p{M}]* with an optional contraction
+	int32 MatchUpperWord(const FCodepointText& Text, int32 Start)
+	{
+		const int32 UpperEnd = ScanUpperSet(Text, Start);
+		if (UpperEnd == Start)
+		{
+			return INDEX_NONE;
+		}
+		const int32 End = ScanLowerSet(Text, UpperEnd);
+		return End + MatchContraction(Text, End);
+	}
+
+	/**
+	 * o200k_base:
+	 * [^\r\n\p{L}\p{N}]?[\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}]*[\p{Ll}\p{Lm}\p{Lo}\p{M}]+(?i:'s|'t|'re|'ve|'m|'ll|'d)?
+	 * |[^\r\n\p{L}\p{N}]?[\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}]+[\p{Ll}\p{Lm}\p{Lo}\p{M}]*(?i:'s|'t|'re|'ve|'m|'ll|'d)?
+	 * |\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n/]*|\s*[\r\n]+|\s+(?!\S)|\s+
+	 */
+	int32 NextPieceO200k(const FCodepointText& Text, int32 Index)
+	{
+		const uint8 Class = Text.Classes[Index];
+
+		// Each word alternative is tried with the optional prefix character before without it
+		const bool bCanPrefix = Class != CC_Newline && Class != CC_Digit && !IsLetter(Class);
+		const bool bInWord = IsUpperSet(Class) || IsLowerSet(Class);
+		int32 WordEnd = INDEX_NONE;
+		if (bCanPrefix)
+		{
+			WordEnd = MatchLowerWord(Text, Index + 1);
+		}
+		if (WordEnd == INDEX_NONE && bInWord)
+		{
+			WordEnd = MatchLowerWord(Text, Index);
+		}
+		if (WordEnd == INDEX_NONE && bCanPrefix)
+		{
+			WordEnd = MatchUpperWord(Text, Index + 1);
+		}
+		if (WordEnd == INDEX_NONE && bInWord)
+		{
+			WordEnd = MatchUpperWord(Text, Index);
+		}
+		if (WordEnd != INDEX_NONE)
+		{
+			return WordEnd;
+		}
+
+		if (Class == CC_Digit)
+		{
+			return MatchDigits(Text, Index);
+		}
+
+		const int32 PunctuationEnd = MatchPunctuation(Text, Index, true);
+		if (PunctuationEnd != INDEX_NONE)
+		{
+			return PunctuationEnd;
+		}
+
+		return MatchWhitespace(Text, Index, false);
+	}
+
+	// Up to the first eight bytes, zero padded. Byte by byte below eight so short tokens do not
+	// become a call to memcpy.
+	FORCEINLINE uint64 LoadPrefix(const uint8* Bytes, int32 Len)
+	{
+		if (Len >= 8)
+		{
+			uint64 Word;
+			FMemory::Memcpy(&Word, Bytes, 8);
+			return Word;
+		}
+		uint64 Word = 0;
+		for (int32 i = 0; i < Len; i++)
+		{
+			Word |= (uint64)Bytes[i] << (i * 8);
+		}
+		return Word;
+	}
+
+	FORCEINLINE uint32 HashBytes(const uint8* Bytes, int32 Len)
+	{
+		uint64 Hash = 0x9E3779B97F4A7C15ull ^ (uint64)Len;
+		while (Len > 0)
+		{
+			Hash = (Hash ^ LoadPrefix(Bytes, Len)) * 0xFF51AFD7ED558CCDull;
+			Hash ^= Hash >> 32;
+			Bytes += 8;
+			Len -= 8;
+		}
+		return (uint32)Hash;
+	}
+
+	constexpr uint32 NoRank = MAX_uint32;
+
+	constexpr int32 MaxRetainedCodepoints = 1024 * 1024;
+
+	FString GetTokenizerPath(EOATokenizerEncoding Encoding)
+	{
+		FString Directory;
+		if (!GConfig || !GConfig->GetString(TEXT("OpenAIAPI.Tokenizer"), TEXT("Directory"), Directory, GEngineIni) || Directory.IsEmpty())
+		{
+			Directory = FPaths::ProjectContentDir() / TEXT("OpenAI/Tokenizers");
+		}
+		else if (FPaths::IsRelative(Directory))
+		{
+			Directory = FPaths::ProjectDir() / Directory;
+		}
+
+		return Directory / (Encoding == EOATokenizerEncoding::O200K_BASE ? TEXT("o200k_base.tiktoken") : TEXT("cl100k_base.tiktoken"));
+	}
+}
+
+FOpenAITokenizer::FOpenAITokenizer(EOATokenizerEncoding InEncoding)
+	: Encoding(InEncoding)
+	, TableMask(0)
+	, NumTokens(0)
+{
+}
+
+namespace
+{
+	struct FSharedTokenizer
+	{
+		FCriticalSection LoadLock;
+		TUniquePtr<FOpenAITokenizer> Owned;
+		// Set once the table is indexed, read without the lock
+		std::atomic<const FOpenAITokenizer*> Loaded{ nullptr };
+		std::atomic<bool> bLoadStarted{ false };
+	};
+
+	FSharedTokenizer& GetShared(EOATokenizerEncoding Encoding)
+	{
+		static FSharedTokenizer Shared[2];
+		return Shared[Encoding == EOATokenizerEncoding::O200K_BASE ? 1 : 0];
+	}
+
+	const FOpenAITokenizer& LoadShared(EOATokenizerEncoding Encoding)
+	{
+		FSharedTokenizer& Shared = GetShared(Encoding);
+		FScopeLock ScopeLock(&Shared.LoadLock);
+		if (!Shared.Owned)
+		{
+			TUniquePtr<FOpenAITokenizer> Tokenizer = MakeUnique<FOpenAITokenizer>(Encoding);
+			const FString Path = GetTokenizerPath(Encoding);
+			if (!Tokenizer->LoadFromFile(Path))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Tokenizer file %s not found, token counts are estimates"), *Path);
+			}
+			Shared.Owned = MoveTemp(Tokenizer);
+			Shared.Loaded.store(Shared.Owned.Get(), std::memory_order_release);
+		}
+		return *Shared.Owned;
+	}
+}
+
+const FOpenAITokenizer& FOpenAITokenizer::Get(EOATokenizerEncoding Encoding, bool bWait)
+{
+	FSharedTokenizer& Shared = GetShared(Encoding);
+	if (const FOpenAITokenizer* Loaded = Shared.Loaded.load(std::memory_order_acquire))
+	{
+		return *Loaded;
+	}
+	if (bWait)
+	{
+		return LoadShared(Encoding);
+	}
+
+	// Indexing the table takes long enough to hitch a frame; counts are estimated until it is ready
+	Preload(Encoding);
+	static const FOpenAITokenizer Estimates[2] = { FOpenAITokenizer(EOATokenizerEncoding::CL100K_BASE), FOpenAITokenizer(EOATokenizerEncoding::O200K_BASE) };
+	return Estimates[Encoding == EOATokenizerEncoding::O200K_BASE ? 1 : 0];
+}
+
+void FOpenAITokenizer::Preload(EOATokenizerEncoding Encoding)
+{
+	if (!GetShared(Encoding).bLoadStarted.exchange(true))
+	{
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Encoding]()
+		{
+			LoadShared(Encoding);
+		});
+	}
+}
+
+EOATokenizerEncoding FOpenAITokenizer::GetEncodingForModel(EOAChatEngineType Model)
+{
+	return FOpenAIModels::Get(Model).Encoding;
+}
+
+int32 FOpenAITokenizer::GetContextWindow(EOAChatEngineType Model)
+{
+	return FOpenAIModels::Get(Model).ContextWindow;
+}
+
+bool FOpenAITokenizer::LoadFromFile(const FString& Path)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Path))
+	{
+		return false;
+	}
+
+	// The region has to go before the handle that owns it
+	TUniquePtr<IMappedFileHandle> Handle(PlatformFile.OpenMapped(*Path));
+	TUniquePtr<IMappedFileRegion> Region(Handle ? Handle->MapRegion() : nullptr);
+	if (Region)
+	{
+		return LoadFromMemory(MakeArrayView(Region->GetMappedPtr(), (int32)Region->GetMappedSize()));
+	}
+
+	// Pak files and platforms without mapping support
+	TArray<uint8> Contents;
+	return FFileHelper::LoadFileToArray(Contents, *Path, FILEREAD_Silent) && LoadFromMemory(Contents);
+}
+
+bool FOpenAITokenizer::LoadFromMemory(TArrayView<const uint8> FileContents)
+{
+	TokenBytes.Reset();
+	Table.Reset();
+	TableMask = 0;
+	NumTokens = 0;
+
+	// Decoded tokens take three quarters of their base64 text; lines average about 16 bytes
+	TokenBytes.Reserve(FileContents.Num() * 3 / 4);
+	const int32 ExpectedTokens = FileContents.Num() / 16 + 1;
+	Table.SetNumZeroed(FMath::RoundUpToPowerOfTwo(ExpectedTokens * 2));
+	TableMask = Table.Num() - 1;
+
+	const uint8* Cursor = FileContents.GetData();
+	const uint8* End = Cursor + FileContents.Num();
+	while (Cursor < End)
+	{
+		const uint8* LineEnd = Cursor;
+		while (LineEnd < End && *LineEnd != '\n')
+		{
+			LineEnd++;
+		}
+
+		const uint8* Space = Cursor;
+		while (Space < LineEnd && *Space != ' ')
+		{
+			Space++;
+		}
+
+		if (Space > Cursor && Space < LineEnd)
+		{
+			uint64 Rank = 0;
+			for (const uint8* Digit = Space + 1; Digit < LineEnd && *Digit >= '0' && *Digit <= '9'; Digit++)
+			{
+				Rank = Rank * 10 + (*Digit - '0');
+			}
+
+			const uint32 EncodedLen = (uint32)(Space - Cursor);
+			const uint32 DecodedLen = FBase64::GetDecodedDataSize((const ANSICHAR*)Cursor, EncodedLen);
+			const int32 Offset = TokenBytes.Num();
+			TokenBytes.AddUninitialized(DecodedLen);
+			if (DecodedLen == 0 || DecodedLen > MaxTokenLen || Rank > MaxRank || !FBase64::Decode((const ANSICHAR*)Cursor, EncodedLen, TokenBytes.GetData() + Offset))
+			{
+				UE_LOG(LogTemp, Error, TEXT("Malformed tokenizer file at byte %d"), (int32)(Cursor - FileContents.GetData()));
+				TokenBytes.Reset();
+				Table.Reset();
+				TableMask = 0;
+				NumTokens = 0;
+				return false;
+			}
+			AddEntry((uint32)Offset, (int32)DecodedLen, (uint32)Rank);
+		}
+
+		Cursor = LineEnd + 1;
+	}
+
+	TokenBytes.Shrink();
+	return NumTokens > 0;
+}
+
+void FOpenAITokenizer::AddEntry(uint32 Offset, int32 Len, uint32 Rank)
+{
+	// Keep the table at most half full
+	if ((NumTokens + 1) * 2 > Table.Num())
+	{
+		TArray<FEntry> OldTable = MoveTemp(Table);
+		Table.SetNumZeroed(OldTable.Num() * 2);
+		TableMask = Table.Num() - 1;
+		for (const FEntry& Entry : OldTable)
+		{
+			if (Entry.Len() > 0)
+			{
+				uint32 Slot = HashBytes(TokenBytes.GetData() + Entry.Offset, Entry.Len()) & TableMask;
+				while (Table[Slot].Len() > 0)
+				{
+					Slot = (Slot + 1) & TableMask;
+				}
+				Table[Slot] = Entry;
+			}
+		}
+	}
+
+	const uint8* Bytes = TokenBytes.GetData() + Offset;
+	uint32 Slot = HashBytes(Bytes, Len) & TableMask;
+	while (Table[Slot].Len() > 0)
+	{
+		const FEntry& Existing = Table[Slot];
+		if (Existing.Len() == Len && FMemory::Memcmp(TokenBytes.GetData() + Existing.Offset, Bytes, Len) == 0)
+		{
+			// Duplicate line, keep the first rank
+			TokenBytes.SetNum(Offset, EAllowShrinking::No);
+			return;
+		}
+		Slot = (Slot + 1) & TableMask;
+	}
+
+	Table[Slot] = FEntry{ LoadPrefix(Bytes, Len), Offset, (Rank << 8) | (uint32)Len };
+	NumTokens++;
+}
+
+uint32 FOpenAITokenizer::FindRank(const uint8* Bytes, int32 Len) const
+{
+	if (Len > MaxTokenLen)
+	{
+		return NoRank;
+	}
+
+	const uint64 Prefix = LoadPrefix(Bytes, Len);
+	uint32 Slot = HashBytes(Bytes, Len) & TableMask;
+	while (true)
+	{
+		const FEntry& Entry = Table[Slot];
+		if (Entry.Len() == 0)
+		{
+			return NoRank;
+		}
+		if (Entry.Prefix == Prefix && Entry.Len() == Len
+			&& (Len <= 8 || FMemory::Memcmp(TokenBytes.GetData() + Entry.Offset + 8, Bytes + 8, Len - 8) == 0))
+		{
+			return Entry.Rank();
+		}
+		Slot = (Slot + 1) & TableMask;
+	}
+}
+
+int32 FOpenAITokenizer::EncodePiece(const uint8* Piece, int32 Len, TArray<int32>* OutTokens) const
+{
+	// Most pieces are a token of their own
+	const uint32 WholeRank = FindRank(Piece, Len);
+	if (WholeRank != NoRank)
+	{
+		if (OutTokens)
+		{
+			OutTokens->Add((int32)WholeRank);
+		}
+		return 1;
+	}
+
+	// Merge the adjacent pair with the lowest rank until no pair is a token. Parts[i].Rank is the
+	// rank of the bytes from part i to the end of part i + 1.
+	struct FPart
+	{
+		int32 Start;
+		uint32 Rank;
+	};
+	TArray<FPart, TInlineAllocator<64>> Parts;
+	Parts.SetNumUninitialized(Len + 1);
+	for (int32 i = 0; i <= Len; i++)
+	{
+		Parts[i] = FPart{ i, i + 2 <= Len ? FindRank(Piece + i, 2) : NoRank };
+	}
+
+	auto PairRank = [&Parts, Piece, this](int32 Index) -> uint32
+	{
+		if (Index + 3 < Parts.Num())
+		{
+			return FindRank(Piece + Parts[Index].Start, Parts[Index + 3].Start - Parts[Index].Start);
+		}
+		return NoRank;
+	};
+
+	while (Parts.Num() > 2)
+	{
+		uint32 MinRank = NoRank;
+		int32 MinIndex = INDEX_NONE;
+		for (int32 i = 0; i < Parts.Num() - 1; i++)
+		{
+			if (Parts[i].Rank < MinRank)
+			{
+				MinRank = Parts[i].Rank;
+				MinIndex = i;
+			}
+		}
+		if (MinIndex == INDEX_NONE)
+		{
+			break;
+		}
+
+		if (MinIndex > 0)
+		{
+			Parts[MinIndex - 1].Rank = PairRank(MinIndex - 1);
+		}
+		Parts[MinIndex].Rank = PairRank(MinIndex);
+		Parts.RemoveAt(MinIndex + 1, 1, EAllowShrinking::No);
+	}
+
+	if (OutTokens)
+	{
+		for (int32 i = 0; i + 1 < Parts.Num(); i++)
+		{
+			const uint32 Rank = FindRank(Piece + Parts[i].Start, Parts[i + 1].Start - Parts[i].Start);
+			// Every single byte is a token in a complete table
+			if (Rank != NoRank)
+			{
+				OutTokens->Add((int32)Rank);
+			}
+		}
+	}
+	return Parts.Num() - 1;
+}
+
+int32 FOpenAITokenizer::CountOrEncode(FStringView Text, TArray<int32>* OutTokens) const
+{
+	if (Text.IsEmpty())
+	{
+		return 0;
+	}
+
+	static thread_local FCodepointText Decoded;
+	Decoded.Decode(Text);
+	ON_SCOPE_EXIT
+	{
+		// Keep the scratch for prompt sized text, not for the odd huge document
+		if (Decoded.Offsets.Max() > MaxRetainedCodepoints)
+		{
+			Decoded.Release();
+		}
+	};
+
+	const bool bO200k = Encoding == EOATokenizerEncoding::O200K_BASE;
+	const bool bExact = IsExact();
+	const int32 Num = Decoded.Num();
+	const uint8* Utf8 = Decoded.Utf8.GetData();
+
+	int32 Count = 0;
+	for (int32 Index = 0; Index < Num;)
+	{
+		const int32 End = bO200k ? NextPieceO200k(Decoded, Index) : NextPieceCl100k(Decoded, Index);
+		check(End > Index);
+
+		const int32 ByteStart = Decoded.Offsets[Index];
+		const int32 ByteLen = Decoded.Offsets[End] - ByteStart;
+		if (bExact)
+		{
+			Count += EncodePiece(Utf8 + ByteStart, ByteLen, OutTokens);
+		}
+		else
+		{
+			// About four characters per token for Latin text, one per character for the rest
+			const int32 NumChars = End - Index;
+			const int32 NumWide = FMath::Min((ByteLen - NumChars) / 2, NumChars);
+			Count += FMath::Max(1, (NumChars - NumWide + 3) / 4 + NumWide);
+		}
+		Index = End;
+	}
+	return Count;
+}
+
+int32 FOpenAITokenizer::CountTokens(FStringView Text) const
+{
+	return CountOrEncode(Text, nullptr);
+}
+
+void FOpenAITokenizer::Encode(FStringView Text, TArray<int32>& OutTokens) const
+{
+	if (IsExact())
+	{
+		CountOrEncode(Text, &OutTokens);
+	}
+}
+
+int32 FOpenAITokenizer::CountChatTokens(TArrayView<const FChatLog> Messages) const
+{
+	int32 Count = TokensPerReply;
+	for (const FChatLog& Message : Messages)
+	{
+		// "system", "user", "assistant" and "tool" are one token each
+		Count += TokensPerMessage + 1 + CountTokens(Message.content);
+		for (const FChatToolCall& Call : Message.toolCalls)
+		{
+			// Approximate, the service's framing of a call is not documented
+			Count += TokensPerMessage + CountTokens(Call.name) + CountTokens(Call.arguments);
+		}
+	}
+	return Count;
+}
+
+#if !UE_BUILD_SHIPPING
+
+namespace
+{
+	// Throughput of CountTokens over a text file, or over a mix of prose and code when none is given
+	void BenchmarkTokenizer(const TArray<FString>& Args)
+	{
+		const EOATokenizerEncoding Encoding = Args.Num() > 1 && Args[1].StartsWith(TEXT("o200k")) ? EOATokenizerEncoding::O200K_BASE : EOATokenizerEncoding::CL100K_BASE;
+		const FOpenAITokenizer& Tokenizer = FOpenAITokenizer::Get(Encoding, true);
+
+		FString Text;
+		if (Args.Num() > 0 && Args[0] != TEXT("-"))
+		{
+			if (!FFileHelper::LoadFileToString(Text, *Args[0]))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Cannot read %s"), *Args[0]);
+				return;
+			}
+		}
+		else
+		{
+			const TCHAR* Sample = TEXT("The innkeeper looks up from the bar. \"You're the third traveller today asking about the mill, ")
+				TEXT("and I'll tell you what I told them: nobody's been up there since 1987.\"\n")
+				TEXT("void UOpenAICallChat::Activate()\n{\n\tconst int32 MaxTokens = FMath::Min(chatSettings.maxTokens, 4096);\n}\n");
+			while (Text.Len() < 4 * 1024 * 1024)
+			{
+				Text += Sample;
+			}
+		}
+
+		const int64 Utf8Bytes = FTCHARToUTF8(*Text).Length();
+		constexpr int32 Iterations = 5;
+		int32 NumTokens = 0;
+		const double Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			NumTokens = Tokenizer.CountTokens(Text);
+		}
+		const double Seconds = (FPlatformTime::Seconds() - Start) / Iterations;
+
+		UE_LOG(LogTemp, Display, TEXT("%s%s: %lld bytes, %d tokens in %.2f ms, %.1f MB/s"),
+			Encoding == EOATokenizerEncoding::O200K_BASE ? TEXT("o200k_base") : TEXT("cl100k_base"),
+			Tokenizer.IsExact() ? TEXT("") : TEXT(" (estimate, no merge table)"),
+			Utf8Bytes, NumTokens, Seconds * 1000.0, Utf8Bytes / FMath::Max(Seconds, 1e-9) / (1024.0 * 1024.0));
+	}
+
+	FAutoConsoleCommand BenchmarkTokenizerCommand(
+		TEXT("OpenAI.BenchmarkTokenizer"),
+		TEXT("Times token counting. Usage: OpenAI.BenchmarkTokenizer [UTF-8 text file, or - for built in text] [cl100k_base|o200k_base]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkTokenizer));
+}
+
+#endif
@@ -0,0 +1,134 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#include "OpenAIToolbox.h"
+#include "OpenAIJsonWriter.h"
+#include "Async/Async.h"
+#include <atomic>
+
+void FOpenAIToolbox::Add(const FChatTool& Definition, FHandler Handler)
+{
+	const int32 Index = Definitions.IndexOfByPredicate([&Definition](const FChatTool& Tool) { return Tool.name == Definition.name; });
+	if (Index != INDEX_NONE)
+	{
+		Definitions[Index] = Definition;
+		Handlers[Index] = MoveTemp(Handler);
+	}
+	else
+	{
+		Definitions.Add(Definition);
+		Handlers.Add(MoveTemp(Handler));
+	}
+}
+
+FString FOpenAIToolbox::Run(const FChatToolCall& Call) const
+{
+	const int32 Index = Definitions.IndexOfByPredicate([&Call](const FChatTool& Tool) { return Tool.name == Call.name; });
+	if (Index == INDEX_NONE || !Handlers[Index])
+	{
+		// Answered anyway, the follow-up request is rejected if any call is left without a result
+		UE_LOG(LogTemp, Warning, TEXT("Model called unknown tool %s"), *Call.name);
+		return FString::Printf(TEXT("Error: there is no tool named %s"), *Call.name);
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FString Result = Handlers[Index](Call.arguments);
+	UE_LOG(LogTemp, Verbose, TEXT("Tool %s took %.2f ms"), *Call.name, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return Result;
+}
+
+void FOpenAIToolbox::Dispatch(const TArray<FChatToolCall>& Calls, TFunction<void(TArray<FChatLog>&& Results)> OnComplete) const
+{
+	struct FDispatchState
+	{
+		TArray<FChatLog> Results;
+		std::atomic<int32> Remaining{ 0 };
+		TFunction<void(TArray<FChatLog>&& Results)> OnComplete;
+	};
+
+	TSharedRef<FDispatchState, ESPMode::ThreadSafe> State = MakeShared<FDispatchState, ESPMode::ThreadSafe>();
+	State->Results.SetNum(Calls.Num());
+	State->Remaining = Calls.Num();
+	State->OnComplete = MoveTemp(OnComplete);
+
+	for (int32 Index = 0; Index < Calls.Num(); Index++)
+	{
+		State->Results[Index].role = EOAChatRole::TOOL;
+		State->Results[Index].toolCallId = Calls[Index].id;
+	}
+
+	if (Calls.Num() == 0)
+	{
+		AsyncTask(ENamedThreads::GameThread, [State]()
+		{
+			State->OnComplete(MoveTemp(State->Results));
+		});
+		return;
+	}
+
+	// Each task writes only its own slot; the last one to finish hands the batch back
+	TSharedRef<const FOpenAIToolbox, ESPMode::ThreadSafe> This = AsShared();
+	for (int32 Index = 0; Index < Calls.Num(); Index++)
+	{
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [This, State, Index, Call = Calls[Index]]()
+		{
+			State->Results[Index].content = This->Run(Call);
+			if (--State->Remaining == 0)
+			{
+				AsyncTask(ENamedThreads::GameThread, [State]()
+				{
+					State->OnComplete(MoveTemp(State->Results));
+				});
+			}
+		});
+	}
+}
+
+void FOpenAIToolbox::WriteDefinitions(FOpenAIJsonWriter& Writer, const TArray<FChatTool>& Tools, bool bRealtime, bool bSorted)
+{
+	TArray<const FChatTool*> Ordered;
+	Ordered.Reserve(Tools.Num());
+	for (const FChatTool& Tool : Tools)
+	{
+		Ordered.Add(&Tool);
+	}
+	if (bSorted)
+	{
+		Ordered.StableSort([](const FChatTool& A, const FChatTool& B) { return A.name < B.name; });
+	}
+
+	Writer.BeginArray();
+	for (const FChatTool* Tool : Ordered)
+	{
+		Writer.BeginObject();
+		Writer.Field("type", TEXT("function"));
+		if (!bRealtime)
+		{
+			Writer.Key("function");
+			Writer.BeginObject();
+		}
+		Writer.Field("name", Tool->name);
+		if (!Tool->description.IsEmpty())
+		{
+			Writer.Field("description", Tool->description);
+		}
+
+		// The schema is already JSON and goes in as written
+		Writer.Key("parameters");
+		if (Tool->parameters.IsEmpty())
+		{
+			Writer.RawValue(ANSITEXTVIEW("{\"type\":\"object\",\"properties\":{}}"));
+		}
+		else
+		{
+			const FTCHARToUTF8 Schema(*Tool->parameters, Tool->parameters.Len());
+			Writer.RawValue(FAnsiStringView(Schema.Get(), Schema.Length()));
+		}
+
+		if (!bRealtime)
+		{
+			Writer.EndObject();
+		}
+		Writer.EndObject();
+	}
+	Writer.EndArray();
+}
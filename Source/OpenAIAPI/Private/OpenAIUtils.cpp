@@ -5,13 +5,12 @@
 #include "OpenAIDefinitions.h"
 #include "OpenAIAPI.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/ConfigCacheIni.h"
 #include "OpenAICallRealtime.h"
+#include "OpenAIModels.h"
+#include "OpenAITokenizer.h"
+#include "OpenAIStructuredOutput.h"
 
-<<<<<<< HEAD
-
-
-=======
->>>>>>> 84098f5661dbf475c0e73e58b73fa0e894b8df9e
 UOpenAICallRealtime* UOpenAIUtils::OpenAICallRealtime(FString Instructions, FString CreateResponseMessage, EOAOpenAIVoices Voice)
 {
     return UOpenAICallRealtime::OpenAICallRealtime(Instructions, CreateResponseMessage, Voice);
@@ -42,6 +41,19 @@ FString UOpenAIUtils::GetVoiceString(EOAOpenAIVoices Voice)
     }
 }
 
+FString UOpenAIUtils::GetRealtimeAudioFormatString(EOARealtimeAudioFormat Format)
+{
+    switch (Format)
+    {
+    case EOARealtimeAudioFormat::G711_ULAW:
+        return TEXT("g711_ulaw");
+    case EOARealtimeAudioFormat::G711_ALAW:
+        return TEXT("g711_alaw");
+    default:
+        return TEXT("pcm16");
+    }
+}
+
 void UOpenAIUtils::setOpenAIApiKey(FString apiKey)
 {
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
@@ -54,6 +66,28 @@ FString UOpenAIUtils::getApiKey()
 	return mod._apiKey;
 }
 
+void UOpenAIUtils::setOpenAIBaseUrl(FString baseUrl)
+{
+	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	mod._baseUrl = baseUrl;
+}
+
+FString UOpenAIUtils::getBaseUrl()
+{
+	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
+	FString baseUrl = mod._baseUrl;
+	if (baseUrl.IsEmpty() && GConfig)
+	{
+		GConfig->GetString(TEXT("OpenAIAPI"), TEXT("BaseUrl"), baseUrl, GEngineIni);
+	}
+	if (baseUrl.IsEmpty())
+	{
+		baseUrl = TEXT("https://api.openai.com/v1");
+	}
+	baseUrl.RemoveFromEnd(TEXT("/"));
+	return baseUrl;
+}
+
 void UOpenAIUtils::	setUseOpenAIApiKeyFromEnvironmentVars(bool bUseEnvVariable)
 {
 	FOpenAIAPIModule& mod = FModuleManager::Get().LoadModuleChecked<FOpenAIAPIModule>("OpenAIAPI");
@@ -138,3 +172,105 @@ float UOpenAIUtils::HDVectorCosineSimilarity(const FHighDimensionalVector& A, co
 	float LengthProduct = HDVectorLength(A) * HDVectorLength(B);
 	return DotProductValue / LengthProduct;
 }
+
+int32 UOpenAIUtils::CountTokens(const FString& Text, EOATokenizerEncoding Encoding)
+{
+	return FOpenAITokenizer::Get(Encoding).CountTokens(Text);
+}
+
+int32 UOpenAIUtils::CountChatTokens(const FChatSettings& ChatSettings)
+{
+	return FOpenAITokenizer::Get(FOpenAIModels::Get(ChatSettings).Encoding).CountChatTokens(ChatSettings.messages);
+}
+
+float UOpenAIUtils::EstimateChatCost(const FChatSettings& ChatSettings, const FChatUsage& Usage)
+{
+	return (float)FOpenAIModels::EstimateCost(FOpenAIModels::Get(ChatSettings), Usage);
+}
+
+namespace
+{
+	// Only touched from the game thread, where chat responses complete
+	int64 TotalPromptTokens = 0;
+	int64 TotalCachedTokens = 0;
+
+	FString CanonicalizeContent(const FString& Content)
+	{
+		FString Result;
+		Result.Reserve(Content.Len());
+		int32 LineStart = 0;
+		while (LineStart <= Content.Len())
+		{
+			int32 LineEnd = LineStart;
+			while (LineEnd < Content.Len() && Content[LineEnd] != TEXT('\n'))
+			{
+				LineEnd++;
+			}
+
+			// \r of a CRLF ending is trailing whitespace too
+			int32 TrimmedEnd = LineEnd;
+			while (TrimmedEnd > LineStart && FChar::IsWhitespace(Content[TrimmedEnd - 1]))
+			{
+				TrimmedEnd--;
+			}
+			Result.AppendChars(*Content + LineStart, TrimmedEnd - LineStart);
+			if (LineEnd < Content.Len())
+			{
+				Result.AppendChar(TEXT('\n'));
+			}
+			LineStart = LineEnd + 1;
+		}
+		Result.TrimStartAndEndInline();
+		return Result;
+	}
+}
+
+void UOpenAIUtils::CanonicalizePromptPrefix(TArray<FChatLog>& Messages)
+{
+	Messages.StableSort([](const FChatLog& A, const FChatLog& B)
+	{
+		return A.role == EOAChatRole::SYSTEM && B.role != EOAChatRole::SYSTEM;
+	});
+
+	for (FChatLog& Message : Messages)
+	{
+		if (Message.role != EOAChatRole::SYSTEM)
+		{
+			break;
+		}
+		Message.content = CanonicalizeContent(Message.content);
+	}
+}
+
+void UOpenAIUtils::RecordPromptCacheUsage(const FChatUsage& Usage)
+{
+	TotalPromptTokens += Usage.promptTokens;
+	TotalCachedTokens += Usage.cachedTokens;
+}
+
+float UOpenAIUtils::GetPromptCacheHitRate()
+{
+	return TotalPromptTokens > 0 ? (float)((double)TotalCachedTokens / (double)TotalPromptTokens) : 0.0f;
+}
+
+void UOpenAIUtils::ResetPromptCacheStats()
+{
+	TotalPromptTokens = 0;
+	TotalCachedTokens = 0;
+}
+
+DEFINE_FUNCTION(UOpenAIUtils::execParseStructuredOutput)
+{
+	P_GET_STRUCT_REF(FChatCompletion, Completion);
+
+	Stack.MostRecentProperty = nullptr;
+	Stack.MostRecentPropertyAddress = nullptr;
+	Stack.StepCompiledIn<FStructProperty>(nullptr);
+	const FStructProperty* OutProperty = CastField<FStructProperty>(Stack.MostRecentProperty);
+	void* OutData = Stack.MostRecentPropertyAddress;
+	P_FINISH;
+
+	P_NATIVE_BEGIN;
+	*(bool*)RESULT_PARAM = OutProperty && OutData && FOpenAIStructuredOutput::Decode(Completion.message.content, OutProperty->Struct, OutData);
+	P_NATIVE_END;
+}
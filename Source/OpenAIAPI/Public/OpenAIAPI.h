@@ -16,4 +16,5 @@ public:
 private:
 	FString _apiKey = "";
 	bool _useApiKeyFromEnvVariable = false;
+	FString _baseUrl = "";
 };
@@ -4,10 +4,55 @@
 #include "Components/ActorComponent.h"
 #include "AudioCapture.h"
 #include "Sound/SampleBufferIO.h"
+#include "OpenAIAudioResampler.h"
+#include "OpenAIAudioRingBuffer.h"
+#include <atomic>
 #include "OpenAIAudioCapture.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAudioBufferCaptured, const TArray<float>&, AudioBuffer);
 
+// Zero-copy native variant, called on a worker thread with a view into the capture ring buffer
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnAudioSamplesCaptured, TArrayView<const float>);
+
+USTRUCT(BlueprintType)
+struct FOpenAIAudioCaptureStats
+{
+    GENERATED_BODY()
+
+    // Samples written into the capture ring buffer since capture started
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    int64 TotalSamples = 0;
+
+    // Samples dropped because the consumer fell behind
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    int64 OverrunSamples = 0;
+
+    // Number of capture callbacks that dropped samples
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    int64 OverrunEvents = 0;
+
+    // Highest number of samples held in the ring buffer at once
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    int32 HighWaterMark = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    int32 Capacity = 0;
+
+    // Chunks delivered to listeners
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    int64 ChunksEmitted = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    int32 ChunkSamples = 0;
+
+    // Time from a chunk becoming complete in the capture callback to its delivery
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    float AverageDispatchLatencyMs = 0.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Audio")
+    float MaxDispatchLatencyMs = 0.0f;
+};
+
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class OPENAIAPI_API UOpenAIAudioCapture : public UActorComponent
 {
@@ -28,25 +73,87 @@ public:
     void StopCapturing();
 
     void DestroyAudioCapture();
-    void ProcessAndBroadcastBuffer();
 
+    // Delivers every complete chunk; with bFlush the trailing partial chunk is delivered as well
+    void ProcessAndBroadcastBuffer(bool bFlush = false);
+
+    /**
+     * Sets the size of the chunks delivered to listeners, counted in samples at 24 kHz.
+     * Every chunk adds its own duration to the uplink latency, while each one costs a message
+     * of framing: ~47 bytes of JSON for a Realtime append event against 64 KB/s of base64 audio,
+     * so 20 ms chunks spend ~3.7% on framing, 40 ms ~1.8% and 400 ms ~0.2%.
+     * Use 20-40 ms for Realtime and a second or more for batch transcription.
+     */
+    UFUNCTION(BlueprintCallable, Category = "Audio")
+    void SetChunkDurationMs(int32 DurationMs);
+
+    // Duration of the chunks delivered now; less than requested while a larger chunk waits for capture to restart
+    UFUNCTION(BlueprintPure, Category = "Audio")
+    int32 GetChunkDurationMs() const { return (int32)(((int64)ChunkSamples.load(std::memory_order_relaxed) * 1000) / TargetSampleRate); }
+
+    UFUNCTION(BlueprintPure, Category = "Audio")
+    FOpenAIAudioCaptureStats GetCaptureStats() const;
+
+    // Broadcast on the game thread with a copy of the captured samples
     UPROPERTY(BlueprintAssignable, Category = "Audio")
     FOnAudioBufferCaptured OnAudioBufferCaptured;
 
+    // Native listeners are called on the drain thread. Adding and removing waits for a delivery
+    // in progress, so once RemoveSamplesListener returns the listener is never called again.
+    FDelegateHandle AddSamplesListener(FOnAudioSamplesCaptured::FDelegate&& Listener);
+    void RemoveSamplesListener(FDelegateHandle Handle);
+
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio")
     int32 NumChannels; // Add this property to specify the number of channels
 
+    // Requested duration of each delivered chunk; change at runtime through SetChunkDurationMs
+    UPROPERTY(EditAnywhere, Category = "Audio", meta = (ClampMin = "10", ClampMax = "10000"))
+    int32 ChunkDurationMs = 40;
+
 private:
     UPROPERTY()
     UAudioCapture* AudioCapture;
-    TArray<float> AudioBuffer;
     TArray<int16> PCMBuffer; // Buffer for storing 16-bit PCM audio
 
-    bool bIsCapturing;
-    double LastBroadcastTime;
-    static constexpr float MaxBufferTime = 0.4f; // 400 ms
-    static constexpr int32 MaxBufferSize = 12000; // Approximately 24000 bytes
+    // Written by the capture callback, drained by ProcessAndBroadcastBuffer
+    FOpenAIAudioRingBuffer CaptureBuffer;
+    TArray<float> ReadScratch; // Only used when a read wraps around the ring
+
+    // Shared with drain tasks, so a task that runs after the component is gone can tell
+    struct FConsumerState
+    {
+        FCriticalSection Lock; // Serializes consumers, the producer never takes it
+        bool bAlive = true;
+    };
+    TSharedRef<FConsumerState, ESPMode::ThreadSafe> Consumer = MakeShared<FConsumerState, ESPMode::ThreadSafe>();
+    FOnAudioSamplesCaptured OnAudioSamplesCaptured;
+    std::atomic<bool> bDrainPending{ false };
+    static constexpr int32 MinCaptureBufferCapacity = 65536; // ~2.7 s at 24 kHz
+
+    // Chunk size in samples, read by the capture callback
+    std::atomic<int32> ChunkSamples{ 960 }; // 40 ms
+    // Cycle count at which the pending drain was requested
+    std::atomic<uint64> DrainRequestCycles{ 0 };
+    int64 ChunksEmitted = 0;
+    int64 NumDispatches = 0;
+    double TotalDispatchLatencyMs = 0.0;
+    float MaxDispatchLatencyMs = 0.0f;
+
+    // Converts the device format to 24 kHz mono
+    FOpenAIAudioResampler Resampler;
+    TArray<float> ResampleScratch; // Preallocated resampler output for one block
+    static constexpr int32 TargetSampleRate = 24000;
+    // 4096 frames covers the callback sizes of all capture backends; larger callbacks are processed in blocks
+    static constexpr int32 MaxCallbackFrames = 4096;
+
+    // Set on the game thread, read by the audio callback
+    std::atomic<bool> bIsCapturing{ false };
     FString GetDefaultInputDeviceName();
+    bool InitResampler();
+    void ScheduleDrain();
 
     void OnAudioGenerate(const float* InAudio, int32 NumSamples);
+
+protected:
+    virtual void BeginDestroy() override;
 };
\ No newline at end of file
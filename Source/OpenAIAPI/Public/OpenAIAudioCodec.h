@@ -0,0 +1,153 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+
+#ifndef WITH_OPENAI_OPUS
+#define WITH_OPENAI_OPUS 0
+#endif
+
+struct OpusEncoder;
+struct OpusDecoder;
+
+/** Sample format conversions shared by the Realtime audio pipelines. */
+namespace OpenAIAudioCodec
+{
+	/** Appends little endian PCM16 bytes for Num float samples. */
+	OPENAIAPI_API void FloatToPCM16(const float* Samples, int32 Num, TArray<uint8>& OutBytes);
+
+	/** Appends float samples for the little endian PCM16 bytes in Bytes. */
+	OPENAIAPI_API void PCM16ToFloat(TArrayView<const uint8> Bytes, TArray<float>& OutSamples);
+
+	/** Appends the 44 byte header of a PCM WAV file holding DataBytes of samples. */
+	OPENAIAPI_API void WriteWavHeader(TArray<uint8>& OutBytes, int32 DataBytes, int32 SampleRate, int32 NumChannels, int32 BitsPerSample = 16);
+
+	/** Appends a complete 16 bit WAV file of interleaved float samples, sized once up front. */
+	OPENAIAPI_API void EncodeWav(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, TArray<uint8>& OutBytes);
+
+	/**
+	 * Appends a 16 bit FLAC file of interleaved float samples, up to 8 channels.
+	 * Each 4096 sample block uses the best of the fixed predictors with Rice coded residuals.
+	 */
+	OPENAIAPI_API void EncodeFlac(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, TArray<uint8>& OutBytes);
+
+	/**
+	 * Appends an Ogg Opus file of interleaved float samples.
+	 * Returns false, leaving OutBytes untouched, when Opus is unavailable, there are more than two
+	 * channels or SampleRate is not one Opus encodes (8, 12, 16, 24 or 48 kHz).
+	 */
+	OPENAIAPI_API bool EncodeOggOpus(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, int32 BitrateBps, TArray<uint8>& OutBytes);
+
+	/** Audio file ready for a multipart upload. The file name's extension tells the API the format. */
+	struct FEncodedUpload
+	{
+		TArray<uint8> Bytes;
+		FString FileName;
+		FString ContentType;
+	};
+
+	/** Encodes for a transcription upload, sending FLAC when Opus is asked for but unavailable. */
+	OPENAIAPI_API FEncodedUpload EncodeUpload(EOAUploadAudioFormat Format, TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, int32 OpusBitrateBps);
+
+	/** Runs EncodeUpload on a background thread and hands the file to OnEncoded on the game thread. */
+	OPENAIAPI_API void EncodeUploadAsync(EOAUploadAudioFormat Format, TArray<float>&& Samples, int32 SampleRate, int32 NumChannels, int32 OpusBitrateBps,
+		TFunction<void(FEncodedUpload&& Encoded)> OnEncoded);
+}
+
+/**
+ * ITU-T G.711 companding, one byte per sample.
+ * The Realtime API accepts it at 8 kHz as "g711_ulaw" and "g711_alaw".
+ */
+struct OPENAIAPI_API FOpenAIG711
+{
+	static uint8 LinearToULaw(int16 Sample);
+	static int16 ULawToLinear(uint8 Code);
+	static uint8 LinearToALaw(int16 Sample);
+	static int16 ALawToLinear(uint8 Code);
+
+	/** Appends one code per float sample. */
+	static void Encode(bool bALaw, const float* Samples, int32 Num, TArray<uint8>& OutCodes);
+
+	/** Appends one float sample per code. */
+	static void Decode(bool bALaw, TArrayView<const uint8> Codes, TArray<float>& OutSamples);
+};
+
+/**
+ * Opus encoder for relaying 24 kHz mono session audio between machines.
+ *
+ * Input of any length is cut into 20 ms frames; a partial frame is held until the next call.
+ * Each encoded frame is appended to the packet as a little endian uint16 length followed by
+ * the Opus payload, so one packet can carry several frames and be split again by the decoder.
+ */
+class OPENAIAPI_API FOpenAIOpusEncoder
+{
+public:
+	static constexpr int32 SampleRate = 24000;
+	static constexpr int32 FrameSamples = SampleRate / 50;
+
+	FOpenAIOpusEncoder();
+	~FOpenAIOpusEncoder();
+
+	/** Returns false when Opus is not available on this platform or the encoder cannot be created. */
+	bool Init(int32 BitrateBps = 24000);
+
+	/** Encodes every complete frame and returns how many were appended to OutPacket. */
+	int32 Encode(const float* Samples, int32 Num, TArray<uint8>& OutPacket);
+
+	bool IsInitialized() const { return Encoder != nullptr; }
+
+private:
+	OpusEncoder* Encoder;
+	TArray<float> Pending;
+	TArray<uint8> FrameScratch;
+};
+
+/** Decodes packets produced by FOpenAIOpusEncoder back into 24 kHz mono float samples. */
+class OPENAIAPI_API FOpenAIOpusDecoder
+{
+public:
+	FOpenAIOpusDecoder();
+	~FOpenAIOpusDecoder();
+
+	bool Init();
+
+	/** Appends the decoded samples of every frame in Packet; returns false on a malformed packet. */
+	bool Decode(TArrayView<const uint8> Packet, TArray<float>& OutSamples);
+
+	bool IsInitialized() const { return Decoder != nullptr; }
+
+private:
+	OpusDecoder* Decoder;
+};
+
+/**
+ * Decodes an Ogg Opus stream as it arrives, e.g. a streamed /audio/speech response.
+ * Bytes can be fed in any chunking; a page is decoded once it is complete. Output is mono at the
+ * rate given to Init, with the stream's pre-skip dropped.
+ */
+class OPENAIAPI_API FOpenAIOggOpusDecoder
+{
+public:
+	FOpenAIOggOpusDecoder();
+	~FOpenAIOggOpusDecoder();
+
+	/** Returns false when Opus is not available on this platform. */
+	bool Init(int32 OutputSampleRate = 24000);
+
+	/** Appends the samples of every packet completed by Bytes; returns false on a malformed stream. */
+	bool Decode(TArrayView<const uint8> Bytes, TArray<float>& OutSamples);
+
+private:
+	bool DecodePacket(TArrayView<const uint8> Packet, TArray<float>& OutSamples);
+
+	OpusDecoder* Decoder;
+	int32 SampleRate;
+	// Start of a page that has not fully arrived
+	TArray<uint8> PendingPage;
+	// A packet continued across pages
+	TArray<uint8> Packet;
+	int32 NumPackets;
+	int32 SamplesToSkip;
+};
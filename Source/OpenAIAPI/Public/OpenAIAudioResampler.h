@@ -0,0 +1,70 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Polyphase windowed-sinc resampler with a built-in channel mixer.
+ *
+ * Converts interleaved audio of any channel count and sample rate into mono at the
+ * requested output rate. The ratio is reduced to L/M and the Kaiser windowed prototype
+ * filter is split into L phases, so every output sample is a single dot product over
+ * TapsPerPhase input samples. Output is written into a caller supplied buffer; the only
+ * internal storage is the filter bank and a history buffer sized at Init().
+ */
+class OPENAIAPI_API FOpenAIAudioResampler
+{
+public:
+	FOpenAIAudioResampler();
+
+	/** Builds the filter bank for the given conversion. Returns false if the formats are invalid. */
+	bool Init(int32 InInputSampleRate, int32 InInputNumChannels, int32 InOutputSampleRate, int32 InMaxInputFrames = 4096);
+
+	/** Clears the filter history without rebuilding the filter bank. */
+	void Reset();
+
+	/** Upper bound of output frames produced for NumInputFrames input frames. */
+	int32 GetMaxOutputFrames(int32 NumInputFrames) const;
+
+	/**
+	 * Resamples NumInputFrames interleaved frames into OutMono.
+	 * @return the number of mono samples written, never more than MaxOutputSamples.
+	 */
+	int32 Process(const float* InInterleaved, int32 NumInputFrames, float* OutMono, int32 MaxOutputSamples);
+
+	bool IsInitialized() const { return TapsPerPhase > 0; }
+	int32 GetInputSampleRate() const { return InputSampleRate; }
+	int32 GetInputNumChannels() const { return InputNumChannels; }
+	int32 GetOutputSampleRate() const { return OutputSampleRate; }
+
+private:
+	void DownmixToHistory(const float* InInterleaved, int32 NumInputFrames);
+
+	/** Highest number of phases kept in the filter bank; larger ratios use the nearest phase. */
+	static constexpr int32 MaxPhases = 1024;
+	/** Taps per phase when not decimating; scaled by the decimation ratio otherwise. */
+	static constexpr int32 BaseTapsPerPhase = 16;
+
+	int32 InputSampleRate;
+	int32 InputNumChannels;
+	int32 OutputSampleRate;
+
+	// Rational ratio Output/Input = Interpolation/Decimation
+	int32 Interpolation;
+	int32 Decimation;
+	int32 NumPhases;
+	int32 TapsPerPhase;
+
+	// Phase accumulator in units of 1/Interpolation input samples
+	int32 PhaseAccumulator;
+
+	// NumPhases rows of TapsPerPhase coefficients, each row time-reversed for a forward dot product
+	TArray<float> FilterBank;
+
+	// Mono input history; the first TapsPerPhase - 1 samples are carried over between calls
+	TArray<float> History;
+	int32 HistoryNum;
+	// Start of the next filter window within History
+	int32 ReadIndex;
+};
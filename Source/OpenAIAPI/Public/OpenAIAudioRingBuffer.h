@@ -0,0 +1,67 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Fixed-capacity single-producer/single-consumer ring buffer of audio samples.
+ *
+ * The producer (the audio capture callback) never blocks and never allocates: when the
+ * consumer falls behind, the samples that do not fit are dropped and counted as an overrun.
+ * The consumer reads through Peek()/Consume(), which hands out a view into the ring itself
+ * and only copies when the requested span wraps around the end of the storage.
+ */
+class OPENAIAPI_API FOpenAIAudioRingBuffer
+{
+public:
+	FOpenAIAudioRingBuffer();
+
+	/** Allocates storage for at least MinCapacity samples. Must not race with Write or Peek. */
+	void Init(int32 MinCapacity);
+
+	/** Drops all buffered samples. Consumer side only. */
+	void Reset();
+
+	// Producer
+
+	/** Appends up to Num samples and returns how many were stored; the rest count as an overrun. */
+	int32 Write(const float* Data, int32 Num);
+
+	// Consumer
+
+	int32 NumAvailable() const;
+
+	/**
+	 * Returns a view of the next Num buffered samples without consuming them.
+	 * The view points into the ring unless the span wraps, in which case it is assembled in Scratch.
+	 * It stays valid until the next Consume() or Reset().
+	 */
+	TArrayView<const float> Peek(int32 Num, TArray<float>& Scratch) const;
+
+	/** Releases Num samples back to the producer. */
+	void Consume(int32 Num);
+
+	// Monitoring, safe from any thread
+
+	int32 GetCapacity() const { return Capacity; }
+	uint64 GetTotalWritten() const { return TotalWritten.load(std::memory_order_relaxed); }
+	uint64 GetOverrunSamples() const { return OverrunSamples.load(std::memory_order_relaxed); }
+	uint64 GetOverrunEvents() const { return OverrunEvents.load(std::memory_order_relaxed); }
+	int32 GetHighWaterMark() const { return HighWaterMark.load(std::memory_order_relaxed); }
+
+private:
+	TArray<float> Storage;
+	int32 Capacity;
+	uint32 Mask;
+
+	// Monotonic sample counters, masked on access; kept on separate cache lines to avoid false sharing
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> WriteIndex;
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> ReadIndex;
+
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> TotalWritten;
+	std::atomic<uint64> OverrunSamples;
+	std::atomic<uint64> OverrunEvents;
+	std::atomic<int32> HighWaterMark;
+};
@@ -0,0 +1,42 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Interfaces/IHttpRequest.h"
+#include "OpenAIDefinitions.h"
+
+/**
+ * The upload shared by the /audio/transcriptions and /audio/translations nodes.
+ *
+ * A bounced wav is streamed from disk while the request is sent; captured samples are compressed
+ * on a worker thread and sent from memory. The endpoint and form fields are all that differ.
+ */
+namespace OpenAIAudioUpload
+{
+	struct FUpload
+	{
+		// Path under the base URL, e.g. /audio/transcriptions
+		FString Endpoint;
+
+		// Name of a wav in Saved/BouncedWavFiles, used when there are no samples
+		FString FileName;
+
+		// Interleaved samples, sent instead of the file
+		TArray<float> Samples;
+		int32 SampleRate = 24000;
+		int32 NumChannels = 1;
+		EOAUploadAudioFormat UploadFormat = EOAUploadAudioFormat::FLAC;
+		int32 OpusBitrate = 24000;
+
+		// Form fields, in order after the file part
+		TArray<TPair<FString, FString>> Fields;
+	};
+
+	/**
+	 * Sends Upload. OnComplete runs on the game thread, with no response if the request could not
+	 * be sent after encoding. Returns false with OutError set, and OnComplete never runs, when the
+	 * API key is missing or there is no audio to send. Game thread.
+	 */
+	OPENAIAPI_API bool Send(FUpload&& Upload, FHttpRequestCompleteDelegate OnComplete, FString& OutError);
+}
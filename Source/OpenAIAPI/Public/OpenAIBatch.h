@@ -0,0 +1,123 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/IHttpRequest.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIBatch.generated.h"
+
+class FOpenAIJsonWriter;
+
+/**
+ * Writes a Batch API input file one request line at a time.
+ *
+ * Each Add call serializes a single request into a reused line buffer and appends it to the
+ * file, so building a job of tens of thousands of requests never holds more than one of them in
+ * memory. A file may only target one endpoint; the first request picks it.
+ */
+class OPENAIAPI_API FOpenAIBatchWriter
+{
+public:
+	explicit FOpenAIBatchWriter(const FString& Path);
+	~FOpenAIBatchWriter();
+
+	/** Appends a chat request. CustomId matches the result back to the request and must be unique in the file. */
+	bool AddChat(const FString& CustomId, const FChatSettings& ChatSettings);
+
+	bool AddEmbedding(const FString& CustomId, const FEmbeddingSettings& EmbeddingSettings);
+
+	/** Flushes and closes the file; returns false if anything failed to write. */
+	bool Close();
+
+	bool IsOpen() const { return File.IsValid(); }
+	int32 Num() const { return Count; }
+	EOABatchEndpoint GetEndpoint() const { return Endpoint; }
+
+private:
+	/** Checks the file is open, targets LineEndpoint and has room for another request. */
+	bool CanAdd(EOABatchEndpoint LineEndpoint);
+
+	/** Starts the line's object and leaves the writer expecting the "body" value. */
+	void BeginLine(FOpenAIJsonWriter& Writer, const FString& CustomId);
+	bool EndLine();
+
+	TUniquePtr<FArchive> File;
+	FString Path;
+	TArray<uint8> Line;
+	int32 Count;
+	int64 Bytes;
+	EOABatchEndpoint Endpoint;
+	bool bError;
+};
+
+/**
+ * Runs a Batch API job: uploads an input file written by FOpenAIBatchWriter, creates the batch,
+ * polls it until it ends and saves the results, failed requests included, to a JSONL file.
+ * ReadChatResults and ReadEmbeddingResults then stream that file back into typed results.
+ *
+ * Requests go to UOpenAIUtils::getBaseUrl(), so a job can be run against a local mock server.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAIBatch : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAIBatch();
+
+	static UOpenAIBatch* Run(const FString& InputPath, const FString& OutputPath, EOABatchEndpoint Endpoint,
+		TFunction<void(const FBatchStatus& Status, const FString& ErrorMessage, bool Success)> Callback,
+		TFunction<void(const FBatchStatus& Status)> OnProgress = nullptr);
+
+	/** Asks the server to cancel the job. Results finished so far are still saved. */
+	void Cancel();
+
+	const FBatchStatus& GetStatus() const { return Status; }
+
+	/** Calls OnResult for every line of a results file, in file order. Returns false if the file cannot be read. */
+	static bool ReadChatResults(const FString& Path,
+		TFunctionRef<void(const FString& CustomId, const TArray<FChatCompletion>& Choices, const FChatUsage& Usage, const FString& ErrorMessage)> OnResult);
+
+	static bool ReadEmbeddingResults(const FString& Path,
+		TFunctionRef<void(const FString& CustomId, const FEmbeddingResult& Result, const FString& ErrorMessage)> OnResult);
+
+	float PollIntervalSeconds;
+
+protected:
+	virtual void BeginDestroy() override;
+
+private:
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> CreateRequest(const FString& Verb, const FString& Path) const;
+
+	void Upload();
+	void OnUploaded(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	void OnCreated(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	bool Poll(float DeltaTime);
+	void OnPolled(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+
+	/** Streams the output file to OutputPath, then appends the error file, then finishes. */
+	void Download(const FString& FileId, bool bAppend);
+	void OnDownloaded(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, bool bAppend, TSharedRef<FArchive> File);
+
+	/** Reads a batch object into Status; returns false with OutError set when the request failed. */
+	bool ReadStatus(FHttpResponsePtr Response, bool WasSuccessful, FString& OutError);
+
+	void Finish(const FString& ErrorMessage, bool Success);
+
+	FString InputPath;
+	FString OutputPath;
+	EOABatchEndpoint Endpoint;
+	FBatchStatus Status;
+	// First entry of the batch's "errors", e.g. why validating the input failed
+	FString BatchError;
+	FString ApiKey;
+
+	TFunction<void(const FBatchStatus& Status, const FString& ErrorMessage, bool Success)> Callback;
+	TFunction<void(const FBatchStatus& Status)> OnProgress;
+
+	FTSTicker::FDelegateHandle PollHandle;
+	TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> CurrentRequest;
+};
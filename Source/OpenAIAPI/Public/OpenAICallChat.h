@@ -8,7 +8,14 @@
 #include "HttpModule.h"
 #include "OpenAICallChat.generated.h"
 
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnResponseRecievedPin, const FChatCompletion, message, const FString&, errorMessage, bool, Success);
+class FOpenAIToolbox;
+class FStructOnScope;
+class FOpenAIJsonWriter;
+class FOpenAIChatStream;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FiveParams(FOnResponseRecievedPin, const FChatCompletion, message, const TArray<FChatCompletion>&, choices, const FChatUsage&, usage, const FString&, errorMessage, bool, Success);
+DECLARE_DELEGATE_FiveParams(FOnChatResponseReceivedF, const FChatCompletion&, const TArray<FChatCompletion>&, const FChatUsage&, const FString&, bool);
+DECLARE_DELEGATE_OneParam(FOnChatDeltaF, const FString&);
 /**
  * 
  */
@@ -27,12 +34,79 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
 	FOnResponseRecievedPin Finished;
 
+	FOnChatResponseReceivedF FinishedF;
+
+	// Pieces of the reply as they are generated, for requests sent with ChatStreamed
+	FOnChatDeltaF DeltaF;
+
+	/** Sends a chat request from C++. The node is kept alive until Callback has run. */
+	static UOpenAICallChat* Chat(const FChatSettings& ChatSettings, TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback);
+
+	/**
+	 * Sends a chat request with Toolbox's tools. Tool calls are answered and sent back until the
+	 * model replies without calling one, at most MaxToolRounds times; Callback gets that final
+	 * reply with the usage of every round.
+	 */
+	static UOpenAICallChat* Chat(const FChatSettings& ChatSettings, TSharedRef<const FOpenAIToolbox, ESPMode::ThreadSafe> Toolbox, TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback);
+
+	/** Sends a chat request whose reply must follow Struct, decoded into an instance of it. Result is null on failure. */
+	static UOpenAICallChat* ChatStructured(const FChatSettings& ChatSettings, const UScriptStruct* Struct, TFunction<void(const void* Result, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback);
+
+	template <typename StructType>
+	static UOpenAICallChat* ChatStructured(const FChatSettings& ChatSettings, TFunction<void(const StructType& Result, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback)
+	{
+		return ChatStructured(ChatSettings, StructType::StaticStruct(), [Callback](const void* Result, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)
+		{
+			if (Callback)
+			{
+				Callback(Result ? *static_cast<const StructType*>(Result) : StructType(), Usage, ErrorMessage, Success);
+			}
+		});
+	}
+
+	/**
+	 * Sends a chat request whose reply is streamed. OnDelta gets each piece of the first choice's
+	 * content on the game thread as it is generated, then Callback gets the whole reply as with Chat.
+	 * Requests with tools or a response struct are not streamed; OnDelta gets their content at once.
+	 */
+	static UOpenAICallChat* ChatStreamed(const FChatSettings& ChatSettings, TFunction<void(const FString& Delta)> OnDelta,
+		TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback);
+
+	/** Stops the request. Finished is not called. */
+	void Cancel();
+
+	int32 MaxToolRounds = 8;
+
+	/** Writes the request JSON for ChatSettings, as sent to /chat/completions. */
+	static void WriteRequestBody(FOpenAIJsonWriter& Writer, const FChatSettings& ChatSettings, bool bStream = false);
+
+protected:
+	virtual void BeginDestroy() override;
+
 private:
 
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
 		static UOpenAICallChat* OpenAICallChat(FChatSettings chatSettings);
 
 	virtual void Activate() override;
+
+	// set by the C++ Chat overload that runs tools
+	TSharedPtr<const FOpenAIToolbox, ESPMode::ThreadSafe> Toolbox;
+	int32 ToolRounds = 0;
+	FChatUsage ToolUsage;
+
+	// reply decoded into chatSettings.responseStruct
+	TSharedPtr<FStructOnScope> StructuredOutput;
+
+	// set by ChatStreamed; the stream of the request in flight
+	bool bStreamReply = false;
+	TSharedPtr<FOpenAIChatStream, ESPMode::ThreadSafe> Stream;
+	FString StreamedContent;
+	FHttpRequestPtr CurrentRequest;
+
+	void DrainStream();
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	UOpenAICallChat* Start(TFunction<void(const FChatCompletion& Message, const FChatUsage& Usage, const FString& ErrorMessage, bool Success)> Callback);
+	void BroadcastFinished(const FChatCompletion& Message, const TArray<FChatCompletion>& Choices, const FChatUsage& Usage, const FString& ErrorMessage, bool Success);
 	
 };
\ No newline at end of file
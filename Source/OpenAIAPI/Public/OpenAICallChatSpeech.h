@@ -0,0 +1,123 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "HttpModule.h"
+#include "Hash/xxhash.h"
+#include "OpenAICallChatSpeech.generated.h"
+
+class USoundWaveProcedural;
+class UOpenAICallChat;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnChatSpeechStartedPin, USoundWaveProcedural*, sound);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FiveParams(FOnChatSpeechFinishedPin, USoundWaveProcedural*, sound, const FChatCompletion&, message, float, duration, const FString&, errorMessage, bool, Success);
+DECLARE_DELEGATE_OneParam(FOnChatSpeechStartedF, USoundWaveProcedural*);
+DECLARE_DELEGATE_FiveParams(FOnChatSpeechFinishedF, USoundWaveProcedural*, const FChatCompletion&, float, const FString&, bool);
+
+/**
+ * Speaks a chat reply while it is still being written.
+ *
+ * The reply is streamed and cut into sentences as it arrives. Each sentence goes to /audio/speech
+ * as soon as it is complete, a few at a time, and its audio is queued into one procedural sound in
+ * reply order. Started fires with that sound once the first sentence is in, so an NPC starts
+ * talking after the first sentence instead of after the whole reply. Finished fires when the last
+ * sentence has been queued, with the reply and the speech's duration; as with the speech node, the
+ * sound plays silence after that, stop it after duration.
+ *
+ * speechSettings.input is ignored, every sentence is spoken with the rest of the settings.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallChatSpeech : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAICallChatSpeech();
+	~UOpenAICallChatSpeech();
+
+	FChatSettings chatSettings;
+	FSpeechSettings speechSettings;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnChatSpeechStartedPin Started;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnChatSpeechFinishedPin Finished;
+
+	FOnChatSpeechStartedF StartedF;
+	FOnChatSpeechFinishedF FinishedF;
+
+	// Sentences requested from /audio/speech at once
+	int32 MaxConcurrentSpeech = 3;
+
+	// Time from sending the chat request to the first queued audio, once Started has fired
+	float FirstAudioLatencyMs = 0.0f;
+
+	/** Chats and speaks from C++. The node is kept alive until OnFinished has run. */
+	static UOpenAICallChatSpeech* ChatAndSpeak(const FChatSettings& ChatSettings, const FSpeechSettings& SpeechSettings,
+		TFunction<void(USoundWaveProcedural* Sound)> OnStarted,
+		TFunction<void(USoundWaveProcedural* Sound, const FChatCompletion& Message, float Duration, const FString& ErrorMessage, bool Success)> OnFinished);
+
+	/** Stops the chat and every speech request. Audio already queued stays in the sound; Finished is not called. */
+	void Cancel();
+
+protected:
+	virtual void BeginDestroy() override;
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+		static UOpenAICallChatSpeech* OpenAICallChatSpeech(FChatSettings chatSettings, FSpeechSettings speechSettings);
+
+	struct FSentence
+	{
+		FString Text;
+		FXxHash128 CacheKey;
+		// PCM16 at UOpenAICallSpeech::SampleRate, until it is queued
+		TArray<uint8> PCM;
+		FHttpRequestPtr Request;
+		bool bDone = false;
+	};
+
+	virtual void Activate() override;
+	void OnDelta(const FString& Delta);
+	void OnChatFinished(const FChatCompletion& Message, const FString& ErrorMessage, bool Success);
+	void AddSentence(const FString& Text);
+	void Pump();
+	void RequestSentence(int32 Index);
+	void SendSentenceRequest(int32 Index);
+	void OnSentenceResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, int32 Index);
+	bool DecodeSentence(FSentence& Sentence, EOASpeechResponseFormat Format, TArrayView<const uint8> Audio);
+	void CancelRequests();
+
+	void BroadcastStarted();
+	void BroadcastFinished(const FChatCompletion& Message, float Duration, const FString& ErrorMessage, bool Success);
+
+	UPROPERTY()
+	TObjectPtr<USoundWaveProcedural> SoundWave;
+
+	TWeakObjectPtr<UOpenAICallChat> ChatNode;
+	FString AuthHeader;
+	bool bOpus = false;
+
+	// Reply text not yet cut into a sentence
+	FString PendingText;
+	TArray<FSentence> Sentences;
+	int32 NextToRequest = 0;
+	int32 NextToQueue = 0;
+	// Requests and cache reads under way
+	int32 NumInFlight = 0;
+	// Set once the requests are cancelled, so a cache read finishing afterwards sends nothing
+	bool bCancelled = false;
+
+	FChatCompletion Reply;
+	FString ChatError;
+	FString SpeechError;
+	bool bChatDone = false;
+	bool bStarted = false;
+	bool bFinished = false;
+	int64 NumSamples = 0;
+	uint64 StartCycles = 0;
+};
@@ -30,8 +30,6 @@ public:
 		FOnGptResponseRecievedPin Finished;
 
 private:
-	OpenAIValueMapping mapping;
-
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI", meta=(DeprecatedFunction, DeprecationMessage="Function has been deprecated, Please use OpenAICallChat instead"))
 		static UOpenAICallCompletions* OpenAICallCompletions(EOACompletionsEngineType engine, FString prompt, FCompletionSettings settings);
 
@@ -8,6 +8,8 @@
 #include "HttpModule.h"
 #include "OpenAICallDALLE.generated.h"
 
+class FOpenAIJsonWriter;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnDalleResponseRecievedPin, const TArray<FString>&, generatedImageUrls, const FString&, errorMessage, bool, Success);
 
 /**
@@ -30,9 +32,10 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
 		FOnDalleResponseRecievedPin Finished;
 
-private:
-	OpenAIValueMapping mapping;
+	/** Writes the request JSON, as sent to /images/generations. bBase64 asks for the images inline instead of URLs. */
+	static void WriteRequestBody(FOpenAIJsonWriter& Writer, EOAImageSize ImageSize, const FString& Prompt, int32 NumImages, bool bBase64 = false);
 
+private:
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
 		static UOpenAICallDALLE* OpenAICallDALLE(EOAImageSize imageSize, FString prompt, int32 numImages);
 
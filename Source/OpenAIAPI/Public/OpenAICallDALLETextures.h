@@ -0,0 +1,102 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "HttpModule.h"
+#include "Hash/xxhash.h"
+#include "Serialization/BufferArchive.h"
+#include "OpenAICallDALLETextures.generated.h"
+
+class UTexture2D;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnDalleTexturesLoadedPin, const TArray<UTexture2D*>&, textures, const TArray<FString>&, generatedImageUrls, const FString&, errorMessage, bool, Success);
+DECLARE_DELEGATE_FourParams(FOnDalleTexturesLoadedF, const TArray<UTexture2D*>&, const TArray<FString>&, const FString&, bool);
+
+/**
+ * Generates images and hands them back as textures, without decoding on the game thread.
+ *
+ * The images come inline as base64, or as URLs that are fetched here. Parsing the response,
+ * base64 and PNG decoding all run on worker threads, maxConcurrentImages images at a time; the
+ * game thread only creates each texture from its decoded pixels. Textures are transient and in
+ * request order, null for an image that failed. Keep a reference to those you use.
+ *
+ * With useCache, a prompt that FOpenAIImageCache already holds numImages images for is answered
+ * from there without a request, and new images are stored there. Cached images have no URL.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallDALLETextures : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAICallDALLETextures();
+	~UOpenAICallDALLETextures();
+
+	EOAImageSize imageSize = EOAImageSize::LARGE;
+	FString prompt = "";
+	int32 numImages = 1;
+
+	// Images inline in the response, which saves a request per image. URLs are only given when this is off
+	bool base64 = true;
+
+	// Images downloaded or decoded at once
+	int32 maxConcurrentImages = 4;
+
+	bool useCache = true;
+
+	// Largest side of images loaded from the cache, which reads the nearest stored mip. 0 loads full resolution
+	int32 maxCachedSize = 0;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnDalleTexturesLoadedPin Finished;
+
+	FOnDalleTexturesLoadedF FinishedF;
+
+	/** Generates textures from C++. The node is kept alive until Callback has run. */
+	static UOpenAICallDALLETextures* Generate(EOAImageSize ImageSize, const FString& Prompt, int32 NumImages,
+		TFunction<void(const TArray<UTexture2D*>& Textures, const TArray<FString>& Urls, const FString& ErrorMessage, bool Success)> Callback, bool bBase64 = true, bool bUseCache = true);
+
+	/** Stops every request. Finished is not called. */
+	void Cancel();
+
+protected:
+	virtual void BeginDestroy() override;
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+		static UOpenAICallDALLETextures* OpenAICallDALLETextures(EOAImageSize imageSize, FString prompt, int32 numImages, bool base64 = true, bool useCache = true);
+
+	struct FPendingImage
+	{
+		// base64 text until it is decoded
+		TArray<uint8> Base64;
+		// Set when the image comes from FOpenAIImageCache
+		FString CachedPath;
+		FHttpRequestPtr Request;
+	};
+
+	virtual void Activate() override;
+	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, TSharedRef<FBufferArchive> Body);
+	void OnParsed(TArray<FString>&& InUrls, TArray<TArray<uint8>>&& Base64Images, const FString& ErrorMessage);
+	void Pump();
+	void StartImage(int32 Index);
+	void OnImageLoaded(int32 Index, UTexture2D* Texture, const FString& ErrorMessage);
+	void CancelRequests();
+
+	void BroadcastFinished(const FString& ErrorMessage, bool Success);
+
+	UPROPERTY()
+	TArray<TObjectPtr<UTexture2D>> Textures;
+
+	TArray<FString> Urls;
+	TArray<FPendingImage> Images;
+	FHttpRequestPtr CurrentRequest;
+	int32 NextImage = 0;
+	int32 NumInFlight = 0;
+	int32 NumDone = 0;
+	FString FirstError;
+	FXxHash128 CacheKey;
+};
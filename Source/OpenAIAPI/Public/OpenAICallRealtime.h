@@ -8,9 +8,15 @@
 #include "IWebSocket.h"
 #include "Components/AudioComponent.h"
 #include "OpenAIAudioCapture.h"
+#include "OpenAIAudioResampler.h"
+#include "OpenAIAudioCodec.h"
 #include "Sound/SoundWaveProcedural.h"
+#include <atomic>
 #include "OpenAICallRealtime.generated.h"
 
+class FOpenAIRealtimeStrand;
+class FOpenAIToolbox;
+
 // Delegate for receiving text responses
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(
     FOnRealtimeResponseReceivedPin,
@@ -30,6 +36,76 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(
     FOnRealtimeCancelAudioReceivedPin,
     bool, bWasCancelled);
 
+// Opus relay packets of the session's output audio, called on a worker thread
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnRealtimeRelayAudioEncoded, TArrayView<const uint8>);
+
+USTRUCT(BlueprintType)
+struct FOpenAIRealtimeSessionStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int32 SessionId = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    float DurationSeconds = 0.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 BytesSent = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 BytesReceived = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 MessagesSent = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 MessagesReceived = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    float UplinkKbps = 0.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    float DownlinkKbps = 0.0f;
+
+    // Wire format of the audio exchanged with the server
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    EOARealtimeAudioFormat AudioFormat = EOARealtimeAudioFormat::PCM16;
+
+    // Encoded audio payload before base64, per direction
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 AudioBytesSent = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 AudioBytesReceived = 0;
+
+    // Opus relay traffic, see SendInputAudioOpus and EnableOutputRelay
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 RelayBytesIn = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int64 RelayBytesOut = 0;
+
+    // Time spent converting, resampling, encoding and decoding audio for this session
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    float CodecCpuMs = 0.0f;
+
+    // CodecCpuMs as a share of one core over the session duration
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    float CodecCpuPercent = 0.0f;
+
+    // Time from the server detecting the end of speech to the first response delta
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    float LastResponseLatencyMs = 0.0f;
+
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    float AverageResponseLatencyMs = 0.0f;
+
+    // Tasks waiting on the shared worker pool for this session
+    UPROPERTY(BlueprintReadOnly, Category = "OpenAI|Realtime")
+    int32 PendingTasks = 0;
+};
+
 UCLASS(BlueprintType, Blueprintable)
 class OPENAIAPI_API UOpenAICallRealtime : public UBlueprintAsyncActionBase
 {
@@ -44,14 +120,13 @@ public:
     static UOpenAICallRealtime* OpenAICallRealtime(
         FString Instructions,
         FString CreateResponseMessage,
-<<<<<<< HEAD
-=======
-
->>>>>>> 84098f5661dbf475c0e73e58b73fa0e894b8df9e
         EOAOpenAIVoices Voice,
         float vadThreshold = 0.5,
         int32 SilenceDurationMs = 500,
-        int32 PrefixPaddingMs = 300);
+        int32 PrefixPaddingMs = 300,
+        int32 AudioChunkMs = 40,
+        bool bCaptureMicrophone = true,
+        EOARealtimeAudioFormat AudioFormat = EOARealtimeAudioFormat::PCM16);
 
     UPROPERTY(BlueprintAssignable, Category = "OpenAI|Realtime")
     FOnAudioDataReceived OnAudioDataReceived;
@@ -85,18 +160,41 @@ public:
     UFUNCTION(BlueprintCallable, Category = "OpenAI", meta = (WorldContext = "WorldContextObject"))
     void SetSocketCloseTimer(UObject* WorldContextObject, float DelaySeconds);
 
+    UFUNCTION(BlueprintPure, Category = "OpenAI|Realtime")
+    FOpenAIRealtimeSessionStats GetSessionStats() const;
+
+    // Feed 24 kHz mono audio from another source, e.g. a client's voice on a dedicated server. Any thread.
+    void SendInputAudio(TArrayView<const float> AudioBuffer);
+
+    // Feed a packet from FOpenAIOpusEncoder as input audio, e.g. relayed from a client. Any thread.
+    void SendInputAudioOpus(TArray<uint8> RelayPacket);
+
+    // Also encode the output audio to Opus and deliver it through OnRelayAudioEncoded. Call before the session starts.
+    bool EnableOutputRelay(int32 BitrateBps = 24000);
+
+    FOnRealtimeRelayAudioEncoded OnRelayAudioEncoded;
+
+    // Offer the toolbox's tools to the model and answer its calls. Call before the session starts.
+    void SetToolbox(TSharedRef<const FOpenAIToolbox, ESPMode::ThreadSafe> InToolbox);
+
     virtual void BeginDestroy() override;
 
 private:
     bool bHasSentWavHeader = false;
     int32 numberOfSentAudioBuffers = 0;
-    bool bSessionStopped = false;
+    std::atomic<bool> bSessionStopped{ false };
+    bool bCaptureMicrophone = true;
 
     FTimerHandle SocketCloseTimerHandle;
-    // WebSocket connection
+    // WebSocket connection, guarded by SocketLock since sends come from the worker pool
     TSharedPtr<IWebSocket> WebSocket;
+    FCriticalSection SocketLock;
 
-    static TWeakObjectPtr<UOpenAICallRealtime> CurrentSession;
+    // Parses incoming messages and encodes outgoing audio in order on the shared worker pool
+    TSharedPtr<FOpenAIRealtimeStrand, ESPMode::ThreadSafe> Strand;
+    int32 SessionId = 0;
+    double StartTime = 0.0;
+    double StopTime = 0.0;
 
     void OnSocketCloseTimerExpired();
 
@@ -119,6 +217,44 @@ private:
     float VadThreshold;
     int32 SilenceDurationMs;
     int32 PrefixPaddingMs;
+    int32 AudioChunkMs;
+    EOARealtimeAudioFormat AudioFormat = EOARealtimeAudioFormat::PCM16;
+
+    // Codec state, only touched from the session strand. G.711 runs at 8 kHz, everything else at 24 kHz.
+    FOpenAIAudioResampler UplinkResampler;
+    FOpenAIAudioResampler DownlinkResampler;
+    TArray<float> UplinkScratch;
+    TArray<float> DownlinkScratch;
+    TUniquePtr<FOpenAIOpusEncoder> RelayEncoder;
+    TUniquePtr<FOpenAIOpusDecoder> RelayDecoder;
+
+    std::atomic<uint64> CodecCycles{ 0 };
+    std::atomic<int64> AudioBytesReceived{ 0 };
+    std::atomic<int64> RelayBytesIn{ 0 };
+    std::atomic<int64> RelayBytesOut{ 0 };
+
+    // Uplink framing cost: encoded audio bytes vs. bytes actually put on the socket
+    std::atomic<int64> AudioEventsSent{ 0 };
+    std::atomic<int64> AudioPayloadBytes{ 0 };
+    std::atomic<int64> AudioWireBytes{ 0 };
+
+    std::atomic<int64> BytesSent{ 0 };
+    std::atomic<int64> BytesReceived{ 0 };
+    std::atomic<int64> MessagesSent{ 0 };
+    std::atomic<int64> MessagesReceived{ 0 };
+
+    // Tools offered in session.update; calls are collected from response.done
+    TSharedPtr<const FOpenAIToolbox, ESPMode::ThreadSafe> Toolbox;
+
+    // Runs the function calls of a finished response and sends all outputs before one response.create. Strand only.
+    void DispatchToolCalls(const TSharedPtr<FJsonObject>& Response);
+    void SendToolResults(const TArray<FChatLog>& Results);
+
+    // Response latency, written from the session strand and read by GetSessionStats on the game thread
+    std::atomic<uint64> SpeechStoppedCycles{ 0 };
+    std::atomic<int32> NumLatencySamples{ 0 };
+    std::atomic<double> TotalResponseLatencyMs{ 0.0 };
+    std::atomic<float> LastResponseLatencyMs{ 0.0f };
 
     // Initialize WebSocket connection
     void InitializeWebSocket();
@@ -133,20 +269,25 @@ private:
                            const FString& Reason,
                            bool bWasClean);
     void OnWebSocketMessage(const FString& Message);
+    void HandleWebSocketMessage(const FString& Message);
+    void RecordResponseLatency();
 
     // Send event to OpenAI Realtime API
-    void SendRealtimeEvent(const TSharedPtr<FJsonObject>& Event, bool isAudioStreamEvent = false);
+    void SendText(const FString& Text);
+    void SendUtf8(TArrayView<const uint8> Utf8);
 
     // Send audio data to OpenAI API
-    void SendAudioDataToAPI(const TArray<float>& AudioBuffer);
+    void SendAudioDataToAPI(const TArray<uint8>& EncodedAudio);
 
-    // Handle captured audio buffer
-    UFUNCTION()
-    void OnAudioBufferCaptured(const TArray<float>& AudioBuffer);
+    // Converts 24 kHz float input to the session's wire format and sends it. Strand only.
+    void EncodeAndSendInputAudio(const float* Samples, int32 Num);
 
-    
+    // Converts a server audio payload to 24 kHz PCM16 and feeds the output relay. Strand only.
+    void DecodeOutputAudio(const TArray<uint8>& Payload, TArray<uint8>& OutPCM16);
 
-    void CreateWavHeader(const TArray<uint8>& AudioData, TArray<uint8>& OutWavData, uint32 SampleRate = 24000, uint16 NumChannels = 1, uint16 BitsPerSample = 16);
+    // Handle captured audio, called on a worker thread with a view into the capture buffer
+    void OnAudioSamplesCaptured(TArrayView<const float> AudioBuffer);
+    FDelegateHandle AudioCapturedHandle;
 
     // Play received audio data
     void PlayAudioData(const TArray<uint8>& AudioData);
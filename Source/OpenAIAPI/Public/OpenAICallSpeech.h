@@ -0,0 +1,101 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "OpenAIDefinitions.h"
+#include "HttpModule.h"
+#include "OpenAISpeechCache.h"
+#include "OpenAICallSpeech.generated.h"
+
+class USoundWaveProcedural;
+class FOpenAISpeechStream;
+class FOpenAIJsonWriter;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSpeechStartedPin, USoundWaveProcedural*, sound);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnSpeechResponseRecievedPin, USoundWaveProcedural*, sound, float, duration, const FString&, errorMessage, bool, Success);
+DECLARE_DELEGATE_OneParam(FOnSpeechStartedF, USoundWaveProcedural*);
+DECLARE_DELEGATE_FourParams(FOnSpeechResponseReceivedF, USoundWaveProcedural*, float, const FString&, bool);
+
+/**
+ * Text to speech through /audio/speech, played while it downloads.
+ *
+ * The response is read as it arrives and queued into a procedural sound wave, PCM directly and Opus
+ * after decoding, so Started fires with a playable sound as soon as the first audio is in; play it
+ * then and the rest of the speech follows. Finished fires once everything has been received, with
+ * the speech's duration. The sound keeps playing silence after the speech, stop it after duration.
+ *
+ * Lines found in FOpenAISpeechCache play without a request, at once from a pack and once read
+ * for a loose file, and successful responses are stored there.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallSpeech : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAICallSpeech();
+	~UOpenAICallSpeech();
+
+	FSpeechSettings speechSettings;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnSpeechStartedPin Started;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnSpeechResponseRecievedPin Finished;
+
+	FOnSpeechStartedF StartedF;
+	FOnSpeechResponseReceivedF FinishedF;
+
+	// Time from sending the request to the first queued audio, once Started has fired
+	float FirstAudioLatencyMs = 0.0f;
+
+	/** Speaks from C++. The node is kept alive until OnFinished has run. */
+	static UOpenAICallSpeech* Speak(const FSpeechSettings& SpeechSettings, TFunction<void(USoundWaveProcedural* Sound)> OnStarted,
+		TFunction<void(USoundWaveProcedural* Sound, float Duration, const FString& ErrorMessage, bool Success)> OnFinished);
+
+	/** Stops the download. Audio already queued stays in the sound; Finished is not called. */
+	void Cancel();
+
+	/** Writes the request JSON for Settings, as sent to /audio/speech. */
+	static void WriteRequestBody(FOpenAIJsonWriter& Writer, const FSpeechSettings& Settings, bool bOpus);
+
+	/**
+	 * An empty procedural sound in the format /audio/speech answers with, to queue speech into.
+	 * Pass an outer that lives as long as the sound plays, e.g. the transient package.
+	 */
+	static USoundWaveProcedural* CreateSound(UObject* Outer);
+
+	// /audio/speech always answers at 24 kHz mono
+	static constexpr int32 SampleRate = 24000;
+
+protected:
+	virtual void BeginDestroy() override;
+
+private:
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+		static UOpenAICallSpeech* OpenAICallSpeech(FSpeechSettings speechSettings);
+
+	virtual void Activate() override;
+	void SendRequest();
+	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+	bool PlayCached(const FOpenAISpeechCache::FHit& Hit);
+
+	void BroadcastStarted();
+	void BroadcastFinished(float Duration, const FString& ErrorMessage, bool Success);
+
+	UPROPERTY()
+	TObjectPtr<USoundWaveProcedural> SoundWave;
+
+	TSharedPtr<FOpenAISpeechStream, ESPMode::ThreadSafe> Stream;
+	FHttpRequestPtr CurrentRequest;
+	uint64 SentCycles = 0;
+	FXxHash128 CacheKey;
+	FString AuthHeader;
+	bool bOpus = false;
+	bool bStarted = false;
+	// Set by Cancel, so a cache read finishing afterwards sends nothing
+	bool bCancelled = false;
+};
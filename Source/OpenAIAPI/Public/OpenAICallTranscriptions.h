@@ -5,10 +5,12 @@
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
 #include "HttpModule.h"
+#include "OpenAIDefinitions.h"
 #include "OpenAICallTranscriptions.generated.h"
 
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnTranscriptionResponseRecievedPin, const FString, Transcription, const FString&, errorMessage, bool, Success);
+DECLARE_DELEGATE_ThreeParams(FOnTranscriptionResponseRecievedF, const FString&, const FString&, bool);
 /**
  * 
  */
@@ -23,16 +25,38 @@ public:
 	~UOpenAICallTranscriptions();
 
 	FString fileName;
+
+	// Interleaved samples to send instead of a file, encoded into the request body without touching disk
+	TArray<float> samples;
+	int32 sampleRate = 24000;
+	int32 numChannels = 1;
+
+	// How captured samples are compressed before upload, on a worker thread. Files on disk are sent as they are
+	EOAUploadAudioFormat uploadFormat = EOAUploadAudioFormat::FLAC;
+	int32 opusBitrate = 24000;
 	
 	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
 	FOnTranscriptionResponseRecievedPin Finished;
 
+	FOnTranscriptionResponseRecievedF FinishedF;
+
+	/** Transcribes captured audio, e.g. from UOpenAIAudioCapture, straight from memory. */
+	static UOpenAICallTranscriptions* Transcribe(TArray<float>&& Samples, int32 SampleRate, int32 NumChannels,
+		TFunction<void(const FString& Transcription, const FString& ErrorMessage, bool Success)> Callback,
+		EOAUploadAudioFormat UploadFormat = EOAUploadAudioFormat::FLAC, int32 OpusBitrate = 24000);
+
 private:
 	
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
 		static UOpenAICallTranscriptions* OpenAICallTranscriptions(FString fileName);
 
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+		static UOpenAICallTranscriptions* OpenAICallTranscriptionsFromAudio(const TArray<float>& Samples, int32 SampleRate = 24000, int32 NumChannels = 1,
+			EOAUploadAudioFormat UploadFormat = EOAUploadAudioFormat::FLAC, int32 OpusBitrate = 24000);
+
 	virtual void Activate() override;
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+
+	void BroadcastFinished(const FString& Transcription, const FString& ErrorMessage, bool Success);
 	
 };
@@ -0,0 +1,67 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "HttpModule.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAICallTranslations.generated.h"
+
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnTranslationResponseRecievedPin, const FString, Translation, const FString&, errorMessage, bool, Success);
+DECLARE_DELEGATE_ThreeParams(FOnTranslationResponseRecievedF, const FString&, const FString&, bool);
+
+/**
+ * Translates speech into English text through /audio/translations.
+ *
+ * Uploads through OpenAIAudioUpload, as UOpenAICallTranscriptions does: a bounced wav is streamed
+ * from disk, captured samples are compressed on a worker thread and sent from memory. With a response_format of text, srt or vtt
+ * the translation is the body as it is. For recordings too long for one request, use
+ * UOpenAILongTranscription with translate set.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAICallTranslations : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAICallTranslations();
+	~UOpenAICallTranslations();
+
+	FString fileName;
+	FTranslationSettings translationSettings;
+
+	// Interleaved samples to send instead of a file, encoded into the request body without touching disk
+	TArray<float> samples;
+	int32 sampleRate = 24000;
+	int32 numChannels = 1;
+
+	// How captured samples are compressed before upload, on a worker thread. Files on disk are sent as they are
+	EOAUploadAudioFormat uploadFormat = EOAUploadAudioFormat::FLAC;
+	int32 opusBitrate = 24000;
+
+	UPROPERTY(BlueprintAssignable, Category = "OpenAI")
+	FOnTranslationResponseRecievedPin Finished;
+
+	FOnTranslationResponseRecievedF FinishedF;
+
+	/** Translates captured audio, e.g. from UOpenAIAudioCapture, straight from memory. */
+	static UOpenAICallTranslations* Translate(TArray<float>&& Samples, int32 SampleRate, int32 NumChannels, const FTranslationSettings& TranslationSettings,
+		TFunction<void(const FString& Translation, const FString& ErrorMessage, bool Success)> Callback,
+		EOAUploadAudioFormat UploadFormat = EOAUploadAudioFormat::FLAC, int32 OpusBitrate = 24000);
+
+private:
+
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+		static UOpenAICallTranslations* OpenAICallTranslations(FString fileName, FTranslationSettings translationSettings);
+
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "OpenAI")
+		static UOpenAICallTranslations* OpenAICallTranslationsFromAudio(const TArray<float>& Samples, FTranslationSettings translationSettings,
+			int32 SampleRate = 24000, int32 NumChannels = 1, EOAUploadAudioFormat UploadFormat = EOAUploadAudioFormat::FLAC, int32 OpusBitrate = 24000);
+
+	virtual void Activate() override;
+	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
+
+	void BroadcastFinished(const FString& Translation, const FString& ErrorMessage, bool Success);
+};
@@ -0,0 +1,106 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIChatContext.generated.h"
+
+/**
+ * Rolling conversation history that stays under a prompt token budget.
+ *
+ * System messages are pinned and always sent. Other turns are kept newest first until the
+ * budget is reached; older ones are evicted. With bSummarizeEvicted the evicted turns are folded
+ * into a short summary by SummaryModel in the background, sent as a system message between the
+ * pinned messages and the window. The summary counts towards the budget, so the request size
+ * stays flat however long the conversation runs.
+ */
+UCLASS(BlueprintType)
+class OPENAIAPI_API UOpenAIChatContext : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAIChatContext();
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static UOpenAIChatContext* CreateChatContext(EOAChatEngineType Model = EOAChatEngineType::GPT_4o, int32 TokenBudget = 4000, bool bSummarizeEvicted = false);
+
+	/** Appends a message and evicts the oldest turns that no longer fit. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void AddMessage(const FChatLog& Message);
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void AddMessages(const TArray<FChatLog>& Messages);
+
+	/** Pinned messages, the summary if there is one, then the kept turns in order. */
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	TArray<FChatLog> GetMessages() const;
+
+	/** Sets the messages and model of ChatSettings from this context. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void ApplyTo(UPARAM(ref) FChatSettings& ChatSettings) const;
+
+	/** Prompt tokens GetMessages() will cost, including the reply priming. */
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	int32 GetTokenCount() const;
+
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	FString GetSummary() const { return Summary; }
+
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	bool IsSummarizing() const { return bSummaryInFlight; }
+
+	/** Drops every message and the summary. A summary still in flight is discarded. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	void Clear();
+
+	/** Model the context is sent to; picks the tokenizer used for the budget. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	EOAChatEngineType Model;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ClampMin = "1"))
+	int32 TokenBudget;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	bool bSummarizeEvicted;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	EOAChatEngineType SummaryModel;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ClampMin = "16"))
+	int32 SummaryMaxTokens;
+
+private:
+	struct FCountedMessage
+	{
+		FChatLog Message;
+		int32 Tokens;
+	};
+
+	int32 CountMessage(const FChatLog& Message) const;
+	void Append(const FChatLog& Message);
+
+	/** Evicts the oldest turns until the context fits TokenBudget, always keeping the newest one. A tool-call message and its results are evicted together. */
+	void Trim();
+
+	/** Sends the queued evicted turns to SummaryModel unless a summary is already on its way. */
+	void StartSummary();
+	void OnSummary(const FChatCompletion& Message, const FString& ErrorMessage, bool Success);
+
+	TArray<FCountedMessage> Pinned;
+	TArray<FCountedMessage> Window;
+	int32 PinnedTokens;
+	int32 WindowTokens;
+
+	FString Summary;
+	int32 SummaryTokens;
+
+	// Evicted turns waiting to be folded into the summary, and the ones being folded right now
+	TArray<FChatLog> PendingSummary;
+	TArray<FChatLog> SummaryInFlight;
+	bool bSummaryInFlight;
+	// Bumped by Clear() so a reply for a discarded conversation is ignored
+	uint32 Generation;
+};
@@ -19,6 +19,29 @@ enum class EOAOpenAIVoices : uint8
 	VERSE = 7 UMETA(DisplayName = "Verse")
 };
 
+UENUM(BlueprintType)
+enum class EOARealtimeAudioFormat : uint8
+{
+	PCM16 = 0 UMETA(DisplayName = "PCM16", ToolTip = "16 bit PCM at 24 kHz, about 64 KB/s per direction before base64."),
+	G711_ULAW = 1 UMETA(DisplayName = "G.711 u-law", ToolTip = "8 kHz u-law, one byte per sample. A sixth of the PCM16 bandwidth at telephone quality."),
+	G711_ALAW = 2 UMETA(DisplayName = "G.711 A-law", ToolTip = "8 kHz A-law, one byte per sample. A sixth of the PCM16 bandwidth at telephone quality."),
+};
+
+UENUM(BlueprintType)
+enum class EOAUploadAudioFormat : uint8
+{
+	WAV = 0 UMETA(DisplayName = "WAV", ToolTip = "Uncompressed 16 bit PCM. Nothing to encode, largest upload."),
+	FLAC = 1 UMETA(DisplayName = "FLAC", ToolTip = "Lossless, usually about half the size of WAV for speech."),
+	OPUS = 2 UMETA(DisplayName = "Opus", ToolTip = "Lossy Ogg Opus at the chosen bitrate, 10x or more smaller than WAV. Needs Opus on this platform and a sample rate of 8, 12, 16, 24 or 48 kHz; otherwise FLAC is sent."),
+};
+
+UENUM(BlueprintType)
+enum class EOATokenizerEncoding : uint8
+{
+	CL100K_BASE = 0 UMETA(DisplayName = "cl100k_base", ToolTip = "GPT-3.5 Turbo, GPT-4 and the text-embedding models."),
+	O200K_BASE = 1 UMETA(DisplayName = "o200k_base", ToolTip = "GPT-4o and GPT-4o mini."),
+};
+
 UENUM(BlueprintType)
 enum class EOACompletionsEngineType : uint8
 {
@@ -51,6 +74,7 @@ enum class EOAChatRole : uint8
 	SYSTEM = 0 UMETA(ToolTip = "More capable than any GPT-3.5 model, able to do more complex tasks, and optimized for chat. Will be updated with our latest model iteration."),
 	USER= 1 UMETA(ToolTip = "More capable than any GPT-3.5 model, able to do more complex tasks, and optimized for chat. Will be updated with our latest model iteration."),
 	ASSISTANT = 2 UMETA(ToolTip = "Same capabilities as the base gpt-4 model but with 4x the context length. Will be updated with our latest model iteration."),
+	TOOL = 3 UMETA(ToolTip = "Result of a tool call, answering the assistant message that made it."),
 };
 
 UENUM(BlueprintType)
@@ -86,18 +110,58 @@ The voice to use when generating the audio. Supported voices are alloy, echo, fa
 UENUM(BlueprintType)
 enum class EOASpeechVoice : uint8
 {
-	ALLOY = 0 UMETA(ToolTip = "Generates 256x256 images. This settings takes the least amount of time to generate images."),
-	ECHO = 1 UMETA(ToolTip = "Generates 512x512 images. This setting takes a moderate amount of time to generate images."),
-	SHIMMER = 2 UMETA(ToolTip = "Generates 1024x1024 images. This setting takes the longest amount of time to generate images."),
-	BALLAD = 3 UMETA(ToolTip = "Generates 1024x1024 images. This setting takes the longest amount of time to generate images."),
+	ALLOY = 0 UMETA(DisplayName = "Alloy"),
+	ECHO = 1 UMETA(DisplayName = "Echo"),
+	SHIMMER = 2 UMETA(DisplayName = "Shimmer"),
+	BALLAD = 3 UMETA(DisplayName = "Ballad"),
 	ASH = 4 UMETA(DisplayName = "Ash"),
 	CORAL = 5 UMETA(DisplayName = "Coral"),
 	SAGE = 6 UMETA(DisplayName = "Sage"),
 	VERSE = 7 UMETA(DisplayName = "Verse")
 };
 
+UENUM(BlueprintType)
+enum class EOASpeechResponseFormat : uint8
+{
+	PCM = 0 UMETA(DisplayName = "PCM", ToolTip = "Raw 16 bit mono at 24 kHz. Playable from the first byte, about 48 KB per second of speech."),
+	OPUS = 1 UMETA(DisplayName = "Opus", ToolTip = "Ogg Opus, a tenth of the PCM download, decoded as it arrives. Needs Opus on this platform; otherwise PCM is requested."),
+};
+
 // Structs for GPT
 
+// A function the model may call.
+USTRUCT(BlueprintType)
+struct FChatTool
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString name = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString description = "";
+
+	// JSON schema of the arguments object. Empty for a function without arguments.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString parameters = "";
+};
+
+USTRUCT(BlueprintType)
+struct FChatToolCall
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString id = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString name = "";
+
+	// JSON object, as generated by the model.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString arguments = "";
+};
+
 USTRUCT(BlueprintType)
 struct FChatLog
 {
@@ -107,6 +171,14 @@ struct FChatLog
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	FString content = "";
+
+	// Calls made by an assistant message; send it back unchanged ahead of the tool results.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	TArray<FChatToolCall> toolCalls;
+
+	// The call a TOOL message answers.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString toolCallId = "";
 };
 
 USTRUCT(BlueprintType)
@@ -156,28 +228,43 @@ struct FChatCompletion
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	FString finishReason = "";
+
+	// Position of this choice when more than one was requested.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 index = 0;
 };
 
 USTRUCT(BlueprintType)
-struct FSpeechCompletion
+struct FChatUsage
 {
 	GENERATED_USTRUCT_BODY()
 
-	// OpenAI's response.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
-	FString audioFilePath = "";
+	int32 promptTokens = 0;
 
+	// Summed over all choices.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
-	FString finishReason = "";
+	int32 completionTokens = 0;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 totalTokens = 0;
+
+	// Part of promptTokens served from the prompt cache, billed at a discount.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 cachedTokens = 0;
 };
 
-class OpenAIValueMapping
+USTRUCT(BlueprintType)
+struct FSpeechCompletion
 {
-public:
-	OpenAIValueMapping();
+	GENERATED_USTRUCT_BODY()
 
-	TMap<EOACompletionsEngineType, FString> engineTypes;
-	TMap<EOAImageSize, FString> imageSizes;
+	// OpenAI's response.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString audioFilePath = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString finishReason = "";
 };
 
 USTRUCT(BlueprintType)
@@ -243,6 +330,9 @@ struct FChatSettings
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	EOAChatEngineType model = EOAChatEngineType::GPT_4;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Model id to send instead of model, e.g. a dated snapshot or a model newer than the list. Its limits come from the closest known model."))
+	FString modelName;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	TArray<FChatLog> messages;
 
@@ -251,6 +341,21 @@ struct FChatSettings
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	int32 maxTokens = 250;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ClampMin = "1", ClampMax = "128", ToolTip = "How many alternative replies to generate. Every choice is billed for its completion tokens."))
+	int32 numChoices = 1;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Send system messages first with normalized whitespace, and tools sorted by name, so the prompt prefix is byte identical between calls and can be served from the prompt cache. Put per request state in user messages."))
+	bool canonicalPromptPrefix = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Functions the model may call. Calls come back in the message's toolCalls with finish reason tool_calls."))
+	TArray<FChatTool> tools;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Struct the reply must follow. Its JSON schema is sent as the response format; read the reply with Parse Structured Output."))
+	TObjectPtr<UScriptStruct> responseStruct = nullptr;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Optional prompt_cache_key. Requests that share a prefix and a key are routed to the same cache."))
+	FString promptCacheKey = "";
 };
 /*
 *Create speech
@@ -306,6 +411,9 @@ struct FSpeechSettings
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	float speed = 1.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	EOASpeechResponseFormat responseFormat = EOASpeechResponseFormat::PCM;
 };
 
 /*
@@ -366,6 +474,58 @@ struct FTranslationSettings
 	float temperature = 0.0f;
 };
 
+// A timed piece of a transcript. Times are in seconds from the start of the recording.
+USTRUCT(BlueprintType)
+struct FTranscriptionSegment
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float start = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	float end = 0.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString text = "";
+};
+
+USTRUCT(BlueprintType)
+struct FLongTranscriptionSettings
+{
+	GENERATED_USTRUCT_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString model = "whisper-1";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Optional ISO-639-1 code of the spoken language. Skips detection on every piece."))
+	FString language = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Translate into English through /audio/translations instead of transcribing. language is not sent then, and prompts should be English."))
+	bool translate = false;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Text that guides the first piece. Later pieces get the end of the piece before them."))
+	FString prompt = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ClampMin = "1", ToolTip = "Pieces are never cut shorter than this, unless the recording ends."))
+	float minSegmentSeconds = 30.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ClampMin = "1", ToolTip = "Longest piece sent in one request. 16 bit mono at 24 kHz stays under the 25 MB upload limit up to about 500 seconds."))
+	float maxSegmentSeconds = 120.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Level below which audio counts as silence and a piece may end."))
+	float silenceThresholdDb = -40.0f;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ClampMin = "1", ClampMax = "16"))
+	int32 maxConcurrentRequests = 4;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "How each piece is compressed before upload. Encoding runs on a worker thread."))
+	EOAUploadAudioFormat uploadFormat = EOAUploadAudioFormat::FLAC;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ClampMin = "6000", ClampMax = "128000", ToolTip = "Opus bitrate in bits per second. 24 kbps keeps speech fully intelligible."))
+	int32 opusBitrate = 24000;
+};
+
 UENUM(BlueprintType)
 enum class EEmbeddingEngineType : uint8
 {
@@ -382,6 +542,9 @@ struct FEmbeddingSettings
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	EEmbeddingEngineType model = EEmbeddingEngineType::TEXT_EMBEDDING_3_SMALL;
 
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI", meta = (ToolTip = "Model id to send instead of model."))
+	FString modelName;
+
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
 	FString input = "";
 };
@@ -424,4 +587,43 @@ struct FEmbeddingResult
 	{
 		embeddingVector = FHighDimensionalVector();
 	}
+};
+
+UENUM(BlueprintType)
+enum class EOABatchEndpoint : uint8
+{
+	CHAT_COMPLETIONS = 0 UMETA(DisplayName = "Chat Completions"),
+	EMBEDDINGS = 1 UMETA(DisplayName = "Embeddings"),
+};
+
+USTRUCT(BlueprintType)
+struct FBatchStatus
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString id = "";
+
+	// validating, in_progress, finalizing, completed, failed, expired, cancelling or cancelled.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString status = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString inputFileId = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString outputFileId = "";
+
+	// Requests that failed are reported here instead of in the output file.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	FString errorFileId = "";
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 total = 0;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 completed = 0;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenAI")
+	int32 failed = 0;
 };
\ No newline at end of file
@@ -47,6 +47,9 @@ private:
 	void OnResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful);
 
 public:
+	/** Writes the request JSON for Settings, as sent to /embeddings. */
+	static void WriteRequestBody(class FOpenAIJsonWriter& Writer, const FEmbeddingSettings& Settings);
+
 	static UOpenAIEmbedding* Embedding(const FEmbeddingSettings& EmbeddingSettings, TFunction<void(const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)> Callback);
 
 private:
@@ -0,0 +1,92 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Hash/xxhash.h"
+#include "UObject/StrongObjectPtr.h"
+#include "OpenAIDefinitions.h"
+
+class UTexture2D;
+struct FImage;
+
+/**
+ * Generated images by prompt and size, so the same request is answered without generating again.
+ *
+ * The key is a hash of the size and the normalized prompt; case, repeated whitespace and trailing
+ * punctuation do not make a prompt new. A prompt can have several images. Each is a file under
+ * Saved/OpenAIImageCache holding a chain of PNG mips, largest first, down to 64 pixels, so a
+ * thumbnail reads and decodes only its own small mip.
+ *
+ * Loaded textures stay resident, up to MemoryBudget bytes, least recently used first out. Images
+ * whose difference hash (dHash) is within MaxDHashDistance bits are treated as the same picture:
+ * a near duplicate of an image already stored for the prompt is not written again, and a loaded
+ * image that matches a resident texture of the same size shares that texture.
+ *
+ * UOpenAICallDALLETextures looks here before it goes to the network and stores what it generates.
+ */
+class OPENAIAPI_API FOpenAIImageCache
+{
+public:
+	FOpenAIImageCache();
+
+	/** The cache UOpenAICallDALLETextures uses. */
+	static FOpenAIImageCache& Get();
+
+	static FXxHash128 MakeKey(const FString& Prompt, EOAImageSize ImageSize);
+
+	/** Difference hash of Image: one bit per neighbouring pixel pair of a 9x8 greyscale copy. */
+	static uint64 ComputeDHash(const FImage& Image);
+
+	/** Files of the images stored for Key. Game thread. */
+	TArray<FString> FindImages(const FXxHash128& Key) const;
+
+	/**
+	 * Loads a stored image as a texture, the largest mip no bigger than MaxSize on either side, or
+	 * full resolution when MaxSize is 0. Read and decoded on a worker thread; OnLoaded runs on the
+	 * game thread, on the next tick for a resident texture. Game thread.
+	 */
+	void LoadAsync(const FString& Path, int32 MaxSize, TFunction<void(UTexture2D* Texture, const FString& ErrorMessage)> OnLoaded);
+
+	/** Keeps Image, BGRA8, for Key: mips are built, compressed and written on a background thread. Any thread. */
+	void Store(const FXxHash128& Key, const FImage& Image);
+
+	/** Drops every resident texture the cache holds. Textures referenced elsewhere stay alive. */
+	void EmptyMemory();
+
+	int64 GetResidentBytes() const { return ResidentBytes; }
+
+	/** Whether Store writes anything. On by default. */
+	bool bStoreResults = true;
+
+	// Bytes of resident textures kept by the cache
+	int64 MemoryBudget = 128 * 1024 * 1024;
+
+	// Differing dHash bits up to which two images count as one
+	int32 MaxDHashDistance = 4;
+
+	// Smallest mip kept in a file
+	static constexpr int32 MinMipSize = 64;
+
+private:
+	struct FResident
+	{
+		TStrongObjectPtr<UTexture2D> Texture;
+		int64 Bytes = 0;
+		uint64 DHash = 0;
+		int32 SizeX = 0;
+		int32 SizeY = 0;
+		uint64 LastUse = 0;
+	};
+
+	UTexture2D* FindSimilar(uint64 DHash, int32 SizeX, int32 SizeY);
+	void AddResident(const FString& ResidentKey, UTexture2D* Texture, uint64 DHash);
+	void Trim();
+
+	static bool WriteImage(const FString& Path, const FImage& Image, uint64 DHash);
+
+	FString Dir;
+	TMap<FString, FResident> Resident;
+	int64 ResidentBytes = 0;
+	uint64 UseCounter = 0;
+};
@@ -0,0 +1,45 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/Texture2D.h"
+
+class IImageWrapperModule;
+struct FImage;
+
+/**
+ * Decoding of generated images, kept off the game thread.
+ *
+ * PNG and JPEG bytes, or base64 text of them, are decoded on a worker thread straight into a
+ * texture's platform data. The game thread only wraps that in a UTexture2D; the pixels are
+ * uploaded to the GPU when the render thread creates the resource.
+ */
+namespace OpenAIImageCodec
+{
+	/** Decodes base64 text, e.g. a b64_json image, into bytes. Any thread. */
+	OPENAIAPI_API bool DecodeBase64(TArrayView<const uint8> Base64, TArray<uint8>& OutBytes);
+
+	/** Decodes a PNG or JPEG into 8 bit sRGB BGRA. Any thread, with the same caveat as DecodeToPlatformData. */
+	OPENAIAPI_API bool DecodeImage(IImageWrapperModule& ImageWrapper, TArrayView<const uint8> Encoded, FImage& OutImage, FString& OutError);
+
+	/** Platform data with Image, which must be BGRA8, as its one mip. Any thread. */
+	OPENAIAPI_API TUniquePtr<FTexturePlatformData> CreatePlatformData(const FImage& Image);
+
+	/**
+	 * Decodes a PNG or JPEG into platform data with one BGRA8 mip. Any thread, but the ImageWrapper
+	 * module has to be loaded on the game thread first; LoadTextureAsync does that.
+	 */
+	OPENAIAPI_API TUniquePtr<FTexturePlatformData> DecodeToPlatformData(IImageWrapperModule& ImageWrapper, TArrayView<const uint8> Encoded, FString& OutError);
+
+	/** Wraps decoded platform data in a transient texture. Game thread. */
+	OPENAIAPI_API UTexture2D* CreateTexture(TUniquePtr<FTexturePlatformData>&& PlatformData);
+
+	/**
+	 * Decodes Encoded, base64 text when bBase64, on a worker thread and creates the texture on the
+	 * game thread. OnLoaded gets null and an error when the image cannot be decoded. OnDecoded, when
+	 * set, sees the decoded pixels on the worker thread first, e.g. to cache them.
+	 */
+	OPENAIAPI_API void LoadTextureAsync(TArray<uint8>&& Encoded, bool bBase64, TFunction<void(UTexture2D* Texture, const FString& ErrorMessage)> OnLoaded,
+		TFunction<void(const FImage& Image)> OnDecoded = nullptr);
+}
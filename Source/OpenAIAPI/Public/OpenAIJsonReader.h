@@ -0,0 +1,96 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EOpenAIJsonToken : uint8
+{
+	Error,
+	End,
+	ObjectStart,
+	ObjectEnd,
+	ArrayStart,
+	ArrayEnd,
+	String,
+	Number,
+	Boolean,
+	Null,
+};
+
+/**
+ * Forward-only pull reader over a UTF-8 JSON document.
+ *
+ * Reads straight from the response bytes without building a DOM or converting the whole body
+ * to UTF-16: keys are handed out as views into the input, only the string values a decoder
+ * asks for are converted, and anything else is skipped in place. Typical use:
+ *
+ *	FOpenAIJsonReader Reader(Response->GetContent());
+ *	FAnsiStringView Key;
+ *	if (Reader.ReadObjectStart())
+ *	{
+ *		while (Reader.NextMember(Key))
+ *		{
+ *			if (Key == "id") Reader.ReadString(Id);
+ *			else Reader.Skip();
+ *		}
+ *	}
+ *	if (Reader.HasError()) ...
+ */
+class OPENAIAPI_API FOpenAIJsonReader
+{
+public:
+	explicit FOpenAIJsonReader(TArrayView<const uint8> InUtf8);
+
+	/** Type of the next value without consuming it. */
+	EOpenAIJsonToken Peek();
+
+	bool ReadObjectStart();
+	bool ReadArrayStart();
+
+	/**
+	 * Advances to the next member of the current object and returns its key, or consumes the
+	 * closing brace and returns false. Keys are raw views into the input; escapes are not decoded.
+	 */
+	bool NextMember(FAnsiStringView& OutKey);
+
+	/** Advances to the next element of the current array, or consumes the closing bracket and returns false. */
+	bool NextElement();
+
+	bool ReadString(FString& OutValue);
+
+	/** Reads a string value as unescaped UTF-8, e.g. JSON text embedded in a string. */
+	bool ReadUtf8String(TArray<uint8>& OutValue);
+	bool ReadNumber(double& OutValue);
+	bool ReadInteger(int64& OutValue);
+	bool ReadBool(bool& OutValue);
+
+	/** Consumes a null; returns false and leaves the value in place when it is something else. */
+	bool TryReadNull();
+
+	/** Skips the next value including any nested objects and arrays. */
+	bool Skip();
+
+	/** Skips the next value and returns its raw bytes, e.g. to decode a nested document with another decoder. */
+	bool ReadRawValue(TArrayView<const uint8>& OutValue);
+
+	bool HasError() const { return bError; }
+	int32 GetErrorOffset() const { return ErrorOffset; }
+
+private:
+	void SkipWhitespace();
+	bool Expect(uint8 Char);
+	bool SetError();
+
+	/** Scans a string starting at the opening quote; returns the raw span and whether it has escapes. */
+	bool ScanString(const uint8*& OutStart, int32& OutLen, bool& bOutHasEscapes);
+	bool ScanNumber(const uint8*& OutStart, int32& OutLen);
+
+	const uint8* Data;
+	int32 Num;
+	int32 Pos;
+	bool bError;
+	int32 ErrorOffset;
+	// Set after a member or element has been read so the next call expects a separator
+	bool bNeedSeparator;
+};
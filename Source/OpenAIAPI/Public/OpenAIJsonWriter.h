@@ -0,0 +1,72 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Streaming JSON writer that emits condensed UTF-8 straight into a byte buffer.
+ *
+ * Request payloads are written member by member without an FJsonObject tree or a UTF-16
+ * intermediate, so the bytes can go to SetContent() or a web socket as they are. Strings are
+ * escaped and transcoded in one pass that handles eight ASCII characters at a time.
+ * The default constructor writes into a per-thread buffer that keeps its capacity between
+ * requests; the contents are only valid until the next writer on the same thread.
+ */
+class OPENAIAPI_API FOpenAIJsonWriter
+{
+public:
+	/** Writes into the calling thread's reusable buffer, cleared first. */
+	FOpenAIJsonWriter();
+
+	/** Appends to Buffer. */
+	explicit FOpenAIJsonWriter(TArray<uint8>& InBuffer);
+
+	void BeginObject();
+	void EndObject();
+	void BeginArray();
+	void EndArray();
+
+	/** Writes a member name. Names are plain ASCII identifiers and are not escaped. */
+	void Key(FAnsiStringView Name);
+
+	/** Writes a member name that comes from data, escaped like a string value. */
+	void Key(FStringView Name);
+
+	void Value(FStringView Text);
+	void Value(const FString& Text) { Value(FStringView(Text)); }
+	void Value(const TCHAR* Text) { Value(FStringView(Text)); }
+	void Value(int32 Number) { Value((int64)Number); }
+	void Value(int64 Number);
+	void Value(float Number);
+	void Value(double Number);
+	void Value(bool bValue);
+	void Null();
+
+	/** Writes Data as a base64 string without an intermediate FString. */
+	void Base64Value(TArrayView<const uint8> Data);
+
+	/** Writes already serialized JSON as the next value. */
+	void RawValue(FAnsiStringView Json);
+
+	template <typename ValueType>
+	void Field(FAnsiStringView Name, const ValueType& InValue)
+	{
+		Key(Name);
+		Value(InValue);
+	}
+
+	const TArray<uint8>& GetBuffer() const { return Buffer; }
+	int32 Num() const { return Buffer.Num(); }
+
+	/** Appends the escaped UTF-8 form of Text, without quotes. */
+	static void EscapeString(FStringView Text, TArray<uint8>& Out);
+
+private:
+	void Separator();
+	void AppendAnsi(FAnsiStringView Text);
+
+	TArray<uint8>& Buffer;
+	// True once a value has been written at the current level so the next one needs a comma
+	bool bNeedComma;
+};
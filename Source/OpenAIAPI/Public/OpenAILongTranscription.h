@@ -0,0 +1,84 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Interfaces/IHttpRequest.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAILongTranscription.generated.h"
+
+/**
+ * Transcribes recordings too long for one request.
+ *
+ * The audio is cut into pieces between minSegmentSeconds and maxSegmentSeconds long, each ending
+ * in the quietest stretch the window allows, so words are not split. Pieces are uploaded
+ * concurrently, at most maxConcurrentRequests at a time, and each is compressed in uploadFormat
+ * on a worker thread when its turn comes. A piece whose predecessor has already come back is sent
+ * with the end of that text as its prompt, which keeps names and spelling consistent across cuts. Results are stitched in
+ * recording order, with segment times offset to the start of the recording. With translate set the
+ * pieces go to /audio/translations instead, and the text comes back in English.
+ */
+UCLASS()
+class OPENAIAPI_API UOpenAILongTranscription : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	using FCallback = TFunction<void(const TArray<FTranscriptionSegment>& Segments, const FString& Text, const FString& ErrorMessage, bool Success)>;
+
+	UOpenAILongTranscription();
+
+	/** Transcribes interleaved float samples. */
+	static UOpenAILongTranscription* Transcribe(TArray<float>&& Samples, int32 SampleRate, int32 NumChannels,
+		const FLongTranscriptionSettings& Settings, FCallback Callback, TFunction<void(int32 Completed, int32 Total)> OnProgress = nullptr);
+
+	/** Transcribes a 16 bit PCM WAV file. */
+	static UOpenAILongTranscription* TranscribeWavFile(const FString& Path, const FLongTranscriptionSettings& Settings,
+		FCallback Callback, TFunction<void(int32 Completed, int32 Total)> OnProgress = nullptr);
+
+	/** Frames at which the recording is cut, in order. Useful for tuning the silence settings. */
+	static TArray<int32> FindSplitPoints(TArrayView<const float> Samples, int32 SampleRate, int32 NumChannels, const FLongTranscriptionSettings& Settings);
+
+	/** Stops sending pieces and drops those in flight. The callback is not called. */
+	void Cancel();
+
+protected:
+	virtual void BeginDestroy() override;
+
+private:
+	struct FPiece
+	{
+		int32 StartFrame = 0;
+		int32 NumFrames = 0;
+		bool bDone = false;
+		FString Text;
+		TArray<FTranscriptionSegment> Segments;
+	};
+
+	void Start();
+	void DispatchNext();
+	void Send(int32 Index);
+	void OnPieceEncoded(int32 Index, TArray<uint8>&& Bytes, const FString& FileName, const FString& ContentType);
+	void OnPieceResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool WasSuccessful, int32 Index);
+	void Finish(const FString& ErrorMessage, bool Success);
+
+	TArray<float> Samples;
+	int32 SampleRate;
+	int32 NumChannels;
+	FLongTranscriptionSettings Settings;
+	FString ApiKey;
+
+	TArray<FPiece> Pieces;
+	int32 NextPiece;
+	int32 Completed;
+	// Pieces on a worker thread being compressed; they count towards maxConcurrentRequests
+	int32 NumEncoding;
+	bool bFinished;
+	// First failure; no new pieces are sent once it is set
+	FString FirstError;
+
+	TMap<int32, TSharedRef<IHttpRequest, ESPMode::ThreadSafe>> InFlight;
+	FCallback Callback;
+	TFunction<void(int32 Completed, int32 Total)> OnProgress;
+};
@@ -0,0 +1,54 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+
+/** What the plugin knows about a model: the id it is sent as, its limits, tokenizer and list price. */
+struct FOpenAIModelInfo
+{
+	const TCHAR* Name;
+	/** Tokens shared between the prompt and the reply; for embeddings, the input limit. */
+	int32 ContextWindow;
+	int32 MaxOutputTokens;
+	EOATokenizerEncoding Encoding;
+	/** USD per million tokens, zero where the model has no list price any more. */
+	double InputPrice;
+	double CachedInputPrice;
+	double OutputPrice;
+};
+
+/**
+ * Registry of the models the plugin calls, built at compile time.
+ *
+ * Every request and every pre-flight token check resolves its model here, so the id that is sent
+ * and the limits that are checked cannot drift apart. Models the enums do not list can be used by
+ * id: Find matches the longest registered id the name starts with, so a dated snapshot such as
+ * gpt-4o-2024-08-06 gets gpt-4o's data, and any other name gets defaults suited to current models.
+ */
+class OPENAIAPI_API FOpenAIModels
+{
+public:
+	static const FOpenAIModelInfo& Get(EOAChatEngineType Model);
+	static const FOpenAIModelInfo& Get(EOACompletionsEngineType Model);
+	static const FOpenAIModelInfo& Get(EEmbeddingEngineType Model);
+
+	/** Model of a request: the one named by modelName when set, the enum otherwise. */
+	static const FOpenAIModelInfo& Get(const FChatSettings& ChatSettings);
+	static const FOpenAIModelInfo& Get(const FEmbeddingSettings& EmbeddingSettings);
+
+	/** Registered model for Name, or the defaults when nothing matches. */
+	static const FOpenAIModelInfo& Find(FStringView Name);
+
+	/** The "model" value of a request. A modelName is sent as given, snapshot suffix and all. */
+	static FString GetModelName(const FChatSettings& ChatSettings);
+	static FString GetModelName(const FEmbeddingSettings& EmbeddingSettings);
+
+	static const TCHAR* GetImageSize(EOAImageSize Size);
+	static const TCHAR* GetModelName(EOASpeechEngineType Model);
+	static const TCHAR* GetVoiceName(EOASpeechVoice Voice);
+
+	/** List price of a request in USD, with cached prompt tokens at the cached rate. */
+	static double EstimateCost(const FOpenAIModelInfo& Model, const FChatUsage& Usage);
+};
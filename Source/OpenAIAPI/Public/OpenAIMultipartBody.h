@@ -0,0 +1,67 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/Archive.h"
+
+/**
+ * multipart/form-data request body that is read while it is sent.
+ *
+ * Hand it to IHttpRequest::SetContentFromStream. Form fields and part headers are kept in memory,
+ * file parts are read from disk in whatever chunks the HTTP thread asks for, so uploading a file
+ * costs a few upload buffers however large it is. Parts are fixed once Finish() has been called;
+ * after that the archive is only touched by the HTTP thread.
+ */
+class OPENAIAPI_API FOpenAIMultipartBody : public FArchive
+{
+public:
+	FOpenAIMultipartBody();
+	virtual ~FOpenAIMultipartBody();
+
+	void AddField(FStringView Name, FStringView Value);
+
+	/** Adds a part streamed from the file at Path. Returns false if the file cannot be read. */
+	bool AddFile(FStringView Name, const FString& Path, FStringView FileName, FStringView ContentType);
+
+	/** Adds a part from memory, e.g. audio encoded for this request. */
+	void AddFile(FStringView Name, TArray<uint8>&& Data, FStringView FileName, FStringView ContentType);
+
+	/** Writes the closing boundary. */
+	void Finish();
+
+	/** Value of the request's Content-Type header. */
+	FString GetContentType() const;
+
+	// FArchive
+	virtual void Serialize(void* Data, int64 Num) override;
+	virtual void Seek(int64 InPos) override;
+	virtual int64 Tell() override { return Pos; }
+	virtual int64 TotalSize() override { return Size; }
+	virtual bool Close() override;
+	virtual FString GetArchiveName() const override { return TEXT("FOpenAIMultipartBody"); }
+
+private:
+	struct FPart
+	{
+		// In-memory bytes, or empty for a file part
+		TArray<uint8> Bytes;
+		FString Path;
+		int64 Start = 0;
+		int64 Num = 0;
+	};
+
+	void AppendText(FStringView Text);
+	void AppendPartHeader(FStringView Name, FStringView FileName, FStringView ContentType);
+	FPart& AddPart(int64 Num);
+
+	FString Boundary;
+	TArray<FPart> Parts;
+	int64 Size;
+	int64 Pos;
+	bool bFinished;
+
+	// The file part being read, kept open between reads
+	int32 OpenPart;
+	TUniquePtr<FArchive> OpenFile;
+};
@@ -32,4 +32,28 @@ public:
 	FSpeechCompletion ParseSpeechCompletion (const FJsonObject&);
 	FString ParseTranscriptionCompletion(const FJsonObject&);
 	FString ParseGeneratedImage(FJsonObject&);
+
+	// Typed decoders that read the UTF-8 response body directly, without a JSON DOM or a UTF-16 copy.
+	// They return false with OutError set when the API reports an error or the body is malformed.
+	bool DecodeChatCompletion(TArrayView<const uint8> Body, FChatCompletion& OutCompletion, FString& OutError);
+	bool DecodeChatCompletions(TArrayView<const uint8> Body, TArray<FChatCompletion>& OutChoices, FChatUsage& OutUsage, FString& OutError);
+
+	// Also fills OutStructured, an instance of chatSettings.responseStruct, from the first choice's content.
+	bool DecodeChatCompletions(TArrayView<const uint8> Body, TArray<FChatCompletion>& OutChoices, FChatUsage& OutUsage, FString& OutError, void* OutStructured);
+
+	// One "data:" payload of a streamed chat completion. OutUsage is only written by the event that carries usage.
+	bool DecodeChatCompletionChunk(TArrayView<const uint8> Event, FString& OutDelta, FString& OutFinishReason, FChatUsage& OutUsage, FString& OutError);
+	bool DecodeCompletions(TArrayView<const uint8> Body, TArray<FCompletion>& OutCompletions, FCompletionInfo& OutInfo, FString& OutError);
+	bool DecodeGeneratedImages(TArrayView<const uint8> Body, TArray<FString>& OutUrls, FString& OutError);
+
+	// With response_format b64_json the images come inline: OutBase64Images holds each one's base64 text, OutUrls is empty for them.
+	bool DecodeGeneratedImages(TArrayView<const uint8> Body, TArray<FString>& OutUrls, TArray<TArray<uint8>>& OutBase64Images, FString& OutError);
+	bool DecodeEmbedding(TArrayView<const uint8> Body, FEmbeddingResult& OutResult, FString& OutError);
+	bool DecodeTranscription(TArrayView<const uint8> Body, FString& OutText, FString& OutError);
+
+	// verbose_json transcriptions; segment times are as the service reports them, relative to the uploaded audio.
+	bool DecodeTranscription(TArrayView<const uint8> Body, FString& OutText, TArray<FTranscriptionSegment>& OutSegments, FString& OutError);
+
+	// For endpoints that answer with binary data on success: true, with OutError set, when Body is an API error.
+	bool DecodeError(TArrayView<const uint8> Body, FString& OutError);
 };
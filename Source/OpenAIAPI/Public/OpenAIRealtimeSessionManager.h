@@ -0,0 +1,82 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "UObject/GCObject.h"
+#include <atomic>
+
+class UOpenAICallRealtime;
+class FQueuedThreadPool;
+
+/**
+ * Runs tasks for one session one at a time, in order, on the shared realtime worker pool.
+ * Different sessions' strands run in parallel; enqueueing is safe from any thread.
+ * Tasks may hold a raw pointer to their session, which closes the strand before it goes away.
+ */
+class OPENAIAPI_API FOpenAIRealtimeStrand : public TSharedFromThis<FOpenAIRealtimeStrand, ESPMode::ThreadSafe>
+{
+public:
+	void Enqueue(TUniqueFunction<void()>&& Task);
+
+	int32 GetNumPending() const { return NumPending.load(std::memory_order_relaxed); }
+
+	/** Waits for a running task to return; queued and later tasks are dropped. Not from a task. */
+	void Close();
+
+private:
+	void Run();
+
+	TQueue<TUniqueFunction<void()>, EQueueMode::Mpsc> Tasks;
+	std::atomic<int32> NumPending{ 0 };
+
+	// Held while a task runs, so Close can wait it out
+	FCriticalSection RunLock;
+	bool bClosed = false;
+};
+
+/**
+ * Process-wide registry of running Realtime sessions.
+ *
+ * Owns the worker pool that parses incoming socket messages and encodes outgoing audio for
+ * every session, keeps registered sessions alive, and enforces the per-process session cap.
+ */
+class OPENAIAPI_API FOpenAIRealtimeSessionManager : public FGCObject
+{
+public:
+	static FOpenAIRealtimeSessionManager& Get();
+
+	/** Adds a session; returns false when the session cap has been reached. Game thread only. */
+	bool RegisterSession(UOpenAICallRealtime* Session);
+	void UnregisterSession(UOpenAICallRealtime* Session);
+
+	/** Creates a task strand that runs on the shared worker pool. */
+	TSharedRef<FOpenAIRealtimeStrand, ESPMode::ThreadSafe> CreateStrand();
+
+	void SetMaxSessions(int32 InMaxSessions);
+	int32 GetMaxSessions() const { return MaxSessions; }
+	int32 GetNumSessions() const;
+
+	TArray<UOpenAICallRealtime*> GetSessions() const;
+
+	/** Stops all sessions and destroys the manager and its worker pool. Called on module shutdown. */
+	static void Shutdown();
+
+	// FGCObject
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FOpenAIRealtimeSessionManager"); }
+
+private:
+	friend class FOpenAIRealtimeStrand;
+
+	FOpenAIRealtimeSessionManager();
+	virtual ~FOpenAIRealtimeSessionManager();
+
+	FQueuedThreadPool* GetPool();
+
+	mutable FCriticalSection Lock;
+	TArray<TObjectPtr<UOpenAICallRealtime>> Sessions;
+	FQueuedThreadPool* Pool;
+	int32 MaxSessions;
+};
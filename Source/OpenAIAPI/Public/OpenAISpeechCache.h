@@ -0,0 +1,103 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Hash/xxhash.h"
+#include "OpenAIDefinitions.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Generated speech by content: the key is a hash of model, voice, speed and text, so a line that
+ * has been spoken once is never requested again.
+ *
+ * Lines known ahead of time are pre-generated into a pack file by the OpenAISpeechCache
+ * commandlet. Packs are memory mapped, and a hit reads the encoded audio straight out of the
+ * mapping. Lines generated at runtime are kept as loose files under Saved/OpenAISpeechCache,
+ * indexed in memory on first lookup so a miss never touches the disk, read on a background
+ * thread on a hit, and the least recently used are deleted once they pass MaxLooseBytes.
+ * UOpenAICallSpeech looks here before it goes to the network.
+ *
+ * The default pack, Content/OpenAI/Speech.oaspeech, is mounted on first use. Add Content/OpenAI to
+ * "Additional Non-Asset Directories to Package" so it ships with the game.
+ */
+class OPENAIAPI_API FOpenAISpeechCache
+{
+public:
+	struct FEntry
+	{
+		FXxHash128 Key;
+		EOASpeechResponseFormat Format = EOASpeechResponseFormat::PCM;
+		TArray<uint8> Audio;
+	};
+
+	/** Encoded audio of a cached line. Audio points into a mounted pack, or into Loaded for a loose file. */
+	struct FHit
+	{
+		TArrayView<const uint8> Audio;
+		EOASpeechResponseFormat Format = EOASpeechResponseFormat::PCM;
+		TArray<uint8> Loaded;
+	};
+
+	FOpenAISpeechCache();
+	~FOpenAISpeechCache();
+
+	/** The cache UOpenAICallSpeech uses. */
+	static FOpenAISpeechCache& Get();
+
+	static FXxHash128 MakeKey(const FSpeechSettings& Settings);
+
+	/** Adds a pack to search. Packs mounted later are searched first. */
+	bool Mount(const FString& PackPath);
+	void UnmountAll();
+
+	/** Looks Key up in the mounted packs. Never blocks: the audio is read out of the mapping. */
+	bool Find(const FXxHash128& Key, FHit& OutHit) const;
+
+	/**
+	 * Returns whether there is a loose file for Key, and if so reads it on a background thread.
+	 * OnLoaded runs on the game thread with the hit, or null when the file could not be read.
+	 * Shared cache and game thread only.
+	 */
+	bool FindLoose(const FXxHash128& Key, TFunction<void(FHit* Hit)> OnLoaded);
+
+	/** Reads the loose file for Key on this thread, for tools such as the commandlet. */
+	bool ReadLoose(const FXxHash128& Key, FHit& OutHit) const;
+
+	/** Keeps audio generated at runtime as a loose file, written on a background thread. */
+	void Store(const FXxHash128& Key, EOASpeechResponseFormat Format, TArray<uint8>&& Audio);
+
+	/** Whether Store writes anything. On by default. */
+	bool bStoreMisses = true;
+
+	// Total size of the loose files; past it the least recently used are deleted
+	int64 MaxLooseBytes = 256 * 1024 * 1024;
+
+	/** Writes Entries, sorted by key, to a pack at Path. */
+	static bool WritePack(const FString& Path, TArray<FEntry>& Entries);
+
+private:
+	struct FMountedPack;
+
+	struct FLooseFile
+	{
+		EOASpeechResponseFormat Format = EOASpeechResponseFormat::PCM;
+		int64 Size = 0;
+		FDateTime LastUse;
+	};
+
+	FString GetLoosePath(const FXxHash128& Key, EOASpeechResponseFormat Format) const;
+	void IndexLooseFiles() const;
+	void AddLooseFile(const FString& Name, EOASpeechResponseFormat Format, int64 Size);
+	void TrimLooseFiles();
+
+	TArray<TUniquePtr<FMountedPack>> Packs;
+	FString LooseDir;
+
+	// Loose files by key, as hex. Game thread only
+	mutable TMap<FString, FLooseFile> LooseFiles;
+	mutable int64 LooseBytes = 0;
+	mutable bool bIndexed = false;
+};
@@ -0,0 +1,29 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "OpenAISpeechCacheCommandlet.generated.h"
+
+/**
+ * Pre-generates known lines into a speech pack for FOpenAISpeechCache, requesting them in parallel.
+ *
+ * UnrealEditor-Cmd <Project> -run=OpenAISpeechCache -Lines=<manifest> [-Output=<pack>]
+ *     [-Voice=alloy] [-Model=tts-1] [-Speed=1.0] [-Format=opus|pcm] [-Concurrency=8]
+ *
+ * The manifest has one line per row, either just the text, spoken with the defaults above, or
+ * voice, model, speed and text separated by tabs, where empty fields take the defaults. Rows
+ * starting with # are skipped. Lines already in the output pack, or in the runtime cache, are
+ * reused rather than requested again. Output defaults to Content/OpenAI/Speech.oaspeech.
+ */
+UCLASS()
+class UOpenAISpeechCacheCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UOpenAISpeechCacheCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
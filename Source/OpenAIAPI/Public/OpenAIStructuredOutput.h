@@ -0,0 +1,33 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FOpenAIJsonReader;
+class FOpenAIJsonWriter;
+
+/**
+ * Structured output for chat requests, driven by a USTRUCT's reflection data.
+ *
+ * The request side turns the struct into a strict JSON schema: booleans, numbers, strings,
+ * names, texts, enums (by name), arrays and nested structs. Other property types are left out of
+ * the schema and keep their default values. The response side fills an instance of the struct
+ * straight from the model's JSON text without building a DOM. Properties are matched by their
+ * authored name, so Blueprint structs work as well.
+ */
+class OPENAIAPI_API FOpenAIStructuredOutput
+{
+public:
+	/** Writes the value of a "response_format" member that asks for JSON matching Struct. */
+	static void WriteResponseFormat(FOpenAIJsonWriter& Writer, const UScriptStruct* Struct);
+
+	/** Writes the JSON schema of Struct as the next value. */
+	static void WriteSchema(FOpenAIJsonWriter& Writer, const UScriptStruct* Struct);
+
+	/** Fills Data, an instance of Struct, from the next value of Reader. Members missing from the JSON keep their values. */
+	static bool Decode(FOpenAIJsonReader& Reader, const UScriptStruct* Struct, void* Data);
+
+	static bool Decode(TArrayView<const uint8> Utf8Json, const UScriptStruct* Struct, void* Data);
+	static bool Decode(const FString& Json, const UScriptStruct* Struct, void* Data);
+};
@@ -0,0 +1,101 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+
+/**
+ * Byte pair encoding tokenizer compatible with the cl100k_base and o200k_base encodings.
+ *
+ * Used to count what a prompt will cost before it is sent. Text is split with a hand written
+ * equivalent of the encoding's pre-tokenizer pattern and each piece is merged by rank, the same
+ * way the service tokenizes it. The pattern's Unicode classes come from a compact table that is
+ * exact for Latin, Greek, Cyrillic, Armenian, Hebrew, Arabic, Indic, Thai and CJK text; rarer
+ * blocks are approximated, so text in them can count a few tokens off. The merge table is read from the encoding's .tiktoken file
+ * (one "<base64 token> <rank>" line per token), memory mapped and indexed once on a background
+ * thread, started when the module loads.
+ *
+ * The files are not shipped with the plugin. They are looked up in the directory set by
+ * [OpenAIAPI.Tokenizer] Directory, Content/OpenAI/Tokenizers by default, as
+ * cl100k_base.tiktoken and o200k_base.tiktoken; stage that directory as non-asset content when
+ * packaging. Without a file the tokenizer falls back to an estimate and IsExact() returns false.
+ */
+class OPENAIAPI_API FOpenAITokenizer
+{
+public:
+	explicit FOpenAITokenizer(EOATokenizerEncoding InEncoding);
+
+	/**
+	 * Shared tokenizer for Encoding. Until the background load has finished this is an estimating
+	 * tokenizer, IsExact() false, unless bWait blocks for the load. Safe to call from any thread.
+	 */
+	static const FOpenAITokenizer& Get(EOATokenizerEncoding Encoding, bool bWait = false);
+
+	/** Starts loading the shared tokenizer for Encoding on a background thread, if it has not been. */
+	static void Preload(EOATokenizerEncoding Encoding);
+
+	/** Shorthands for the FOpenAIModels registry. */
+	static EOATokenizerEncoding GetEncodingForModel(EOAChatEngineType Model);
+
+	/** Context window of Model in tokens, shared between the prompt and the reply. */
+	static int32 GetContextWindow(EOAChatEngineType Model);
+
+	/** Loads a .tiktoken merge table, replacing any loaded one. */
+	bool LoadFromFile(const FString& Path);
+
+	/** Indexes the contents of a .tiktoken file. Only the decoded token bytes are kept. */
+	bool LoadFromMemory(TArrayView<const uint8> FileContents);
+
+	int32 CountTokens(FStringView Text) const;
+
+	/** Appends the token ids of Text. Does nothing unless IsExact(). */
+	void Encode(FStringView Text, TArray<int32>& OutTokens) const;
+
+	/** Prompt tokens of a chat request, including the per message framing and the reply priming. */
+	int32 CountChatTokens(TArrayView<const FChatLog> Messages) const;
+
+	/**
+	 * True when a merge table is loaded, so counts come from real merges rather than an estimate.
+	 * They match the service for the scripts the character table covers, see above.
+	 */
+	bool IsExact() const { return NumTokens > 0; }
+
+	EOATokenizerEncoding GetEncoding() const { return Encoding; }
+
+	/** Tokens the chat API adds around every message and before the reply. */
+	static constexpr int32 TokensPerMessage = 3;
+	static constexpr int32 TokensPerReply = 3;
+
+private:
+	struct FEntry
+	{
+		// First eight bytes of the token, zero padded, so most lookups never touch TokenBytes
+		uint64 Prefix;
+		uint32 Offset;
+		// Rank in the high 24 bits, byte length in the low 8; zero for an empty slot
+		uint32 RankAndLen;
+
+		int32 Len() const { return (int32)(RankAndLen & 0xFF); }
+		uint32 Rank() const { return RankAndLen >> 8; }
+	};
+
+	static constexpr int32 MaxTokenLen = 255;
+	static constexpr uint32 MaxRank = (1u << 24) - 1;
+
+	uint32 FindRank(const uint8* Bytes, int32 Len) const;
+	void AddEntry(uint32 Offset, int32 Len, uint32 Rank);
+
+	/** Number of tokens in one pre-tokenized piece, appending their ids when OutTokens is set. */
+	int32 EncodePiece(const uint8* Piece, int32 Len, TArray<int32>* OutTokens) const;
+
+	int32 CountOrEncode(FStringView Text, TArray<int32>* OutTokens) const;
+
+	EOATokenizerEncoding Encoding;
+
+	// Token bytes, indexed by an open addressing table sized to a power of two
+	TArray<uint8> TokenBytes;
+	TArray<FEntry> Table;
+	uint32 TableMask;
+	int32 NumTokens;
+};
@@ -0,0 +1,46 @@
+// Copyright Kellan Mythen 2023. All rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenAIDefinitions.h"
+
+class FOpenAIJsonWriter;
+
+/**
+ * Tools the model may call, with the native functions that answer them.
+ *
+ * Give a toolbox to UOpenAICallChat::Chat or UOpenAICallRealtime::SetToolbox. Every call of a
+ * turn is dispatched at the same time on background task threads and the results are handed back
+ * together on the game thread, so a turn that calls several tools costs one follow-up request.
+ * Handlers run off the game thread and must only read state that is safe to read concurrently.
+ */
+class OPENAIAPI_API FOpenAIToolbox : public TSharedFromThis<FOpenAIToolbox, ESPMode::ThreadSafe>
+{
+public:
+	/** Takes the call's JSON arguments and returns the result for the model, usually JSON. */
+	using FHandler = TFunction<FString(const FString& Arguments)>;
+
+	/** Registers a tool, replacing one with the same name. */
+	void Add(const FChatTool& Definition, FHandler Handler);
+
+	const TArray<FChatTool>& GetDefinitions() const { return Definitions; }
+
+	/**
+	 * Runs Calls concurrently. OnComplete is called on the game thread once all have returned,
+	 * with one TOOL message per call in call order.
+	 */
+	void Dispatch(const TArray<FChatToolCall>& Calls, TFunction<void(TArray<FChatLog>&& Results)> OnComplete) const;
+
+	/**
+	 * Writes Tools as the value of a "tools" member. Chat nests each function under "function",
+	 * Realtime sessions take the members flat. bSorted orders tools by name for a stable prefix.
+	 */
+	static void WriteDefinitions(FOpenAIJsonWriter& Writer, const TArray<FChatTool>& Tools, bool bRealtime, bool bSorted);
+
+private:
+	FString Run(const FChatToolCall& Call) const;
+
+	TArray<FChatTool> Definitions;
+	TArray<FHandler> Handlers;
+};
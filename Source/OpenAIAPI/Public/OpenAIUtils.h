@@ -39,8 +39,17 @@ public:
 
 	static FString getApiKey();
 
+	/** Overrides the API root, e.g. a proxy or a local mock server. Empty restores the default. */
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static void setOpenAIBaseUrl(FString baseUrl);
+
+	/** API root without a trailing slash: the override, else [OpenAIAPI] BaseUrl, else https://api.openai.com/v1. */
+	static FString getBaseUrl();
+
 	static FString GetVoiceString(EOAOpenAIVoices Voice);
 
+	static FString GetRealtimeAudioFormatString(EOARealtimeAudioFormat Format);
+
 	UFUNCTION(BlueprintCallable, Category = "OpenAI")
 	static void setUseOpenAIApiKeyFromEnvironmentVars(bool bUseEnvVariable);
 
@@ -70,4 +79,38 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "OpenAI")
 	static float HDVectorCosineSimilarity(const FHighDimensionalVector& A, const FHighDimensionalVector& B);
+
+	/** Number of tokens Text encodes to. An estimate when the encoding's .tiktoken file is missing. */
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	static int32 CountTokens(const FString& Text, EOATokenizerEncoding Encoding);
+
+	/** Prompt tokens the messages of ChatSettings will cost with its model. */
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	static int32 CountChatTokens(const FChatSettings& ChatSettings);
+
+	/** List price in USD of a chat request's usage with the model of ChatSettings. */
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	static float EstimateChatCost(const FChatSettings& ChatSettings, const FChatUsage& Usage);
+
+	/**
+	 * Moves system messages ahead of the conversation, keeping the order within each group, and
+	 * normalizes their line endings and trailing whitespace so the same prompt always serializes
+	 * to the same bytes.
+	 */
+	static void CanonicalizePromptPrefix(TArray<FChatLog>& Messages);
+
+	/** Adds a chat response's usage to the prompt cache statistics. */
+	static void RecordPromptCacheUsage(const FChatUsage& Usage);
+
+	/** Share of prompt tokens served from the prompt cache since start up or the last reset, 0 to 1. */
+	UFUNCTION(BlueprintPure, Category = "OpenAI")
+	static float GetPromptCacheHitRate();
+
+	UFUNCTION(BlueprintCallable, Category = "OpenAI")
+	static void ResetPromptCacheStats();
+
+	/** Fills OutStruct from the JSON reply of a chat request made with a response struct. Implemented by the custom thunk. */
+	UFUNCTION(BlueprintCallable, CustomThunk, Category = "OpenAI", meta = (CustomStructureParam = "OutStruct"))
+	static bool ParseStructuredOutput(const FChatCompletion& Completion, int32& OutStruct);
+	DECLARE_FUNCTION(execParseStructuredOutput);
 };